@@ -8,6 +8,8 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 
 #include "Animation.h"
+#include <cmath>
+#include <algorithm>
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/weak_ptr.hpp>
 #include <boost/serialization/vector.hpp>
@@ -15,6 +17,11 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "GraphState.h"
 #include "SerializationHelper.h"
 #include "Data/SequencerEntryBlock.h"
+#include "KeyframeCodec.h"
+#include "BinaryArchive.h"
+#include <cstring>
+#include <limits>
+#include <iostream>
 
 namespace
 {
@@ -65,35 +72,95 @@ double calculateBezierRatio(double start, double outTan, double inTan, double en
     return ratio;
 }//calculateBezierRatio
 
-double doBezierInterpolation(std::shared_ptr<Keyframe> beforeKeyframe, std::shared_ptr<Keyframe> afterKeyframe, int tick)
+double doBezierInterpolation(const Keyframe &beforeKeyframe, const Keyframe &afterKeyframe, double tick)
 {
-    double ratio =  calculateBezierRatio(beforeKeyframe->tick, beforeKeyframe->outTangent[0] + beforeKeyframe->tick,
-                                            afterKeyframe->tick - afterKeyframe->inTangent[0], afterKeyframe->tick, (double)tick);
+    double ratio =  calculateBezierRatio(beforeKeyframe.tick, beforeKeyframe.outTangent[0] + beforeKeyframe.tick,
+                                            afterKeyframe.tick - afterKeyframe.inTangent[0], afterKeyframe.tick, tick);
             
     double oneMinusRatio = 1 - ratio;
 
     //Solve for parametric form of bezier
-    double resultVal =  (beforeKeyframe->value * oneMinusRatio * oneMinusRatio * oneMinusRatio) + (3 * (beforeKeyframe->outTangent[1] + beforeKeyframe->value) * oneMinusRatio * oneMinusRatio * ratio) +
-                        (3 * (afterKeyframe->value - afterKeyframe->inTangent[1]) * oneMinusRatio * ratio * ratio) + (afterKeyframe->value * ratio * ratio * ratio);
+    double resultVal =  (beforeKeyframe.value * oneMinusRatio * oneMinusRatio * oneMinusRatio) + (3 * (beforeKeyframe.outTangent[1] + beforeKeyframe.value) * oneMinusRatio * oneMinusRatio * ratio) +
+                        (3 * (afterKeyframe.value - afterKeyframe.inTangent[1]) * oneMinusRatio * ratio * ratio) + (afterKeyframe.value * ratio * ratio * ratio);
 
     return resultVal;
 }//doLinearInterpolation
 
-double doLinearInterpolation(std::shared_ptr<Keyframe> beforeKeyframe, std::shared_ptr<Keyframe> afterKeyframe, int tick)
+double doLinearInterpolation(const Keyframe &beforeKeyframe, const Keyframe &afterKeyframe, double tick)
 {
-    double ratio =  ((double)(tick - beforeKeyframe->tick)) / ((double)(afterKeyframe->tick - beforeKeyframe->tick));
-    double resultVal = beforeKeyframe->value + (afterKeyframe->value - beforeKeyframe->value) * ratio;
+    double ratio =  (tick - (double)beforeKeyframe.tick) / ((double)(afterKeyframe.tick - beforeKeyframe.tick));
+    double resultVal = beforeKeyframe.value + (afterKeyframe.value - beforeKeyframe.value) * ratio;
 
     return resultVal;
 }//doLinearInterpolation
 
-double doStepInterpolation(std::shared_ptr<Keyframe> beforeKeyframe, std::shared_ptr<Keyframe> afterKeyframe, int tick)
+double doStepInterpolation(const Keyframe &beforeKeyframe, const Keyframe &afterKeyframe, double tick)
 {
-    double resultVal = beforeKeyframe->value;
+    double resultVal = beforeKeyframe.value;
 
     return resultVal;
 }//doStepInterpolation
 
+double doInterpolation(const Keyframe &beforeKeyframe, const Keyframe &afterKeyframe, double tick)
+{
+    switch (beforeKeyframe.curveType) {
+        case CurveType::Bezier:
+            return doBezierInterpolation(beforeKeyframe, afterKeyframe, tick);
+
+        case CurveType::Linear:
+            return doLinearInterpolation(beforeKeyframe, afterKeyframe, tick);
+        case CurveType::Step:
+            return doStepInterpolation(beforeKeyframe, afterKeyframe, tick);
+        default:
+            break;
+    }//switch
+
+    return 0;
+}//doInterpolation
+
+//Same as Animation::sample on the keyframe map, but on the arrays in the file; packed keys have to be unpacked first
+double sampleMappedKeyframes(const MappedKeyframes &mappedKeyframes, double tick)
+{
+    if (0 == mappedKeyframes.numKeys) {
+        return 0;
+    }//if
+
+    if (1 == mappedKeyframes.numKeys) {
+        return mappedKeyframes.values[0];
+    }//if
+
+    const int *ticksEnd = mappedKeyframes.ticks + mappedKeyframes.numKeys;
+    const int *tickIter = std::upper_bound(mappedKeyframes.ticks, ticksEnd, (int)std::floor(tick));
+
+    if (tickIter == ticksEnd) {
+        return mappedKeyframes.values[mappedKeyframes.numKeys - 1];
+    }//if
+
+    if (tickIter == mappedKeyframes.ticks) {
+        return mappedKeyframes.values[0];
+    }//if
+
+    unsigned int afterIndex = tickIter - mappedKeyframes.ticks;
+
+    return doInterpolation(mappedKeyframes.getKeyframe(afterIndex - 1), mappedKeyframes.getKeyframe(afterIndex), tick);
+}//sampleMappedKeyframes
+
+//In doubles, for the layout below
+size_t keyBufferSize(unsigned int numKeys)
+{
+    return numKeys * 5 + (numKeys * (sizeof(int) + 1) + sizeof(double) - 1) / sizeof(double);
+}//keyBufferSize
+
+//Laid out as in a binary project's KEYS: values, in tangents, out tangents, ticks, curve types
+void layOutKeys(double *keys, unsigned int numKeys, double *&values, double *&inTangents, double *&outTangents, int *&ticks, unsigned char *&curveTypes)
+{
+    values = keys;
+    inTangents = values + numKeys;
+    outTangents = inTangents + numKeys * 2;
+    ticks = (int *)(outTangents + numKeys * 2);
+    curveTypes = (unsigned char *)(ticks + numKeys);
+}//layOutKeys
+
 }//anonymous namespace
 
 Keyframe::Keyframe()
@@ -108,6 +175,128 @@ Keyframe::Keyframe()
     //selectedState = KeySelectedType::NotSelected;
 };//constructor
 
+MappedKeyframes::MappedKeyframes() : resident(false)
+{
+    numKeys = 0;
+    ticks = nullptr;
+    values = nullptr;
+    inTangents = nullptr;
+    outTangents = nullptr;
+    curveTypes = nullptr;
+    packedKeys = nullptr;
+    packedSize = 0;
+    lastTickStored = false;
+    lastTick = 0;
+}//constructor
+
+void MappedKeyframes::allocateKeys() const
+{
+    ownKeys.reset(new double[keyBufferSize(numKeys)]);
+
+    double *keyValues, *keyInTangents, *keyOutTangents;
+    int *keyTicks;
+    unsigned char *keyCurveTypes;
+    layOutKeys(ownKeys.get(), numKeys, keyValues, keyInTangents, keyOutTangents, keyTicks, keyCurveTypes);
+
+    values = keyValues;
+    inTangents = keyInTangents;
+    outTangents = keyOutTangents;
+    ticks = keyTicks;
+    curveTypes = keyCurveTypes;
+}//allocateKeys
+
+void MappedKeyframes::unpack() const
+{
+    if (nullptr == packedKeys) {
+        return;
+    }//if
+
+    std::call_once(unpackOnce, [this]() {
+        allocateKeys();
+
+        if (false == KeyframeCodec::unpack(packedKeys, packedSize, numKeys, (double *)values, (double *)inTangents, (double *)outTangents,
+                                           (int *)ticks, (unsigned char *)curveTypes)) {
+            std::cerr << "Packed keys are damaged; " << numKeys << " keys read as well as they could be" << std::endl;
+        }//if
+
+        resident = true;
+    });
+}//unpack
+
+void MappedKeyframes::copyFrom(const std::map<int, std::shared_ptr<Keyframe> > &keyframes)
+{
+    numKeys = keyframes.size();
+    allocateKeys();
+
+    unsigned int index = 0;
+    for (const auto &keyIter : keyframes) {
+        const Keyframe &keyframe = *keyIter.second;
+
+        ((double *)values)[index] = keyframe.value;
+        ((double *)inTangents)[index * 2] = keyframe.inTangent[0];
+        ((double *)inTangents)[index * 2 + 1] = keyframe.inTangent[1];
+        ((double *)outTangents)[index * 2] = keyframe.outTangent[0];
+        ((double *)outTangents)[index * 2 + 1] = keyframe.outTangent[1];
+        ((int *)ticks)[index] = keyframe.tick;
+        ((unsigned char *)curveTypes)[index] = (unsigned char)keyframe.curveType;
+        ++index;
+    }//foreach
+
+    resident = true;
+}//copyFrom
+
+void MappedKeyframes::copyOutOfMapping() const
+{
+    std::unique_ptr<double[]> copiedKeys(new double[keyBufferSize(numKeys)]);
+
+    double *keyValues, *keyInTangents, *keyOutTangents;
+    int *keyTicks;
+    unsigned char *keyCurveTypes;
+    layOutKeys(copiedKeys.get(), numKeys, keyValues, keyInTangents, keyOutTangents, keyTicks, keyCurveTypes);
+
+    std::copy(values, values + numKeys, keyValues);
+    std::copy(inTangents, inTangents + numKeys * 2, keyInTangents);
+    std::copy(outTangents, outTangents + numKeys * 2, keyOutTangents);
+    std::copy(ticks, ticks + numKeys, keyTicks);
+    std::copy(curveTypes, curveTypes + numKeys, keyCurveTypes);
+
+    //Only pointed at once it's filled in; the mapping stays, so a reader part way through still has the old arrays
+    values = keyValues;
+    inTangents = keyInTangents;
+    outTangents = keyOutTangents;
+    ticks = keyTicks;
+    curveTypes = keyCurveTypes;
+    ownKeys = std::move(copiedKeys);
+}//copyOutOfMapping
+
+Keyframe MappedKeyframes::getKeyframe(unsigned int index) const
+{
+    Keyframe keyframe;
+    keyframe.tick = ticks[index];
+    keyframe.value = values[index];
+    keyframe.inTangent[0] = inTangents[index * 2];
+    keyframe.inTangent[1] = inTangents[index * 2 + 1];
+    keyframe.outTangent[0] = outTangents[index * 2];
+    keyframe.outTangent[1] = outTangents[index * 2 + 1];
+    keyframe.curveType = (CurveType)curveTypes[index];
+
+    return keyframe;
+}//getKeyframe
+
+int MappedKeyframes::getLastTick() const
+{
+    if (0 == numKeys) {
+        return 0;
+    }//if
+
+    if (true == lastTickStored) {
+        return lastTick;
+    }//if
+
+    unpack();
+    return ticks[numKeys - 1];
+}//getLastTick
+
 std::shared_ptr<Keyframe> Keyframe::deepClone()
 {
     std::shared_ptr<Keyframe> clone(new Keyframe);
@@ -116,10 +305,13 @@ std::shared_ptr<Keyframe> Keyframe::deepClone()
     return clone;
 }//deepClone
 
+std::function<std::shared_ptr<void> ()> Animation::pauseSampling;
+
 Animation::Animation(SequencerEntryBlock *owningEntryBlock_, std::shared_ptr<Animation> instanceOf_)
 {
     startTick = owningEntryBlock_->getRawStartTick();
     instanceOf = instanceOf_;
+    keyframesMapped = false;
 }//constructor
 
 Animation::~Animation()
@@ -127,10 +319,143 @@ Animation::~Animation()
     //Nothing
 }//destructor
 
+void Animation::setMappedKeyframes(std::shared_ptr<const MappedKeyframes> mappedKeyframes_)
+{
+    keyframes.clear();
+    mappedKeyframes = mappedKeyframes_;
+    keyframesMapped = true;
+}//setMappedKeyframes
+
+void Animation::materializeKeyframes()
+{
+    if (false == keyframesMapped) {
+        return;
+    }//if
+
+    mappedKeyframes->unpack();
+
+    std::map<int, std::shared_ptr<Keyframe> > newKeyframes;
+    for (unsigned int index = 0; index < mappedKeyframes->numKeys; ++index) {
+        std::shared_ptr<Keyframe> keyframe = std::make_shared<Keyframe>(mappedKeyframes->getKeyframe(index));
+        newKeyframes.insert(newKeyframes.end(), std::make_pair(keyframe->tick, keyframe));
+    }//for
+
+    //Filled in beforehand so the engine only waits on the swap
+    std::shared_ptr<void> samplingPause;
+    if (pauseSampling) {
+        samplingPause = pauseSampling();
+    }//if
+
+    keyframes.swap(newKeyframes);
+    keyframesMapped = false;
+}//materializeKeyframes
+
+std::shared_ptr<const MappedKeyframes> Animation::packKeyframes() const
+{
+    if (instanceOf != nullptr) {
+        return std::shared_ptr<const MappedKeyframes>();
+    }//if
+
+    //Unpacked since it was frozen (or loaded packed): back to just the packed keys, which haven't changed
+    if (true == keyframesMapped) {
+        if ((nullptr == mappedKeyframes->packedKeys) || (false == mappedKeyframes->resident)) {
+            return std::shared_ptr<const MappedKeyframes>();
+        }//if
+
+        std::shared_ptr<MappedKeyframes> packedKeyframes(new MappedKeyframes);
+        packedKeyframes->mapping = mappedKeyframes->mapping;
+        packedKeyframes->numKeys = mappedKeyframes->numKeys;
+        packedKeyframes->packedKeys = mappedKeyframes->packedKeys;
+        packedKeyframes->packedSize = mappedKeyframes->packedSize;
+        packedKeyframes->lastTickStored = true;
+        packedKeyframes->lastTick = mappedKeyframes->getLastTick();
+
+        return packedKeyframes;
+    }//if
+
+    if (true == keyframes.empty()) {
+        return std::shared_ptr<const MappedKeyframes>();
+    }//if
+
+    for (const auto &keyIter : keyframes) {
+        if (keyIter.second.use_count() > 1) {
+            return std::shared_ptr<const MappedKeyframes>();
+        }//if
+    }//foreach
+
+    MappedKeyframes unpackedKeyframes;
+    unpackedKeyframes.copyFrom(keyframes);
+
+    BinaryProjectContext context;
+    BinaryOArchive packedArchive(context);
+    KeyframeCodec::pack(packedArchive, unpackedKeyframes);
+
+    const std::vector<unsigned char> &packedBuffer = packedArchive.getBuffer();
+    std::shared_ptr<unsigned char> packedKeys(new unsigned char[packedBuffer.size()], std::default_delete<unsigned char[]>());
+    memcpy(packedKeys.get(), packedBuffer.data(), packedBuffer.size());
+
+    std::shared_ptr<MappedKeyframes> packedKeyframes(new MappedKeyframes);
+    packedKeyframes->mapping = packedKeys;
+    packedKeyframes->numKeys = keyframes.size();
+    packedKeyframes->packedKeys = packedKeys.get();
+    packedKeyframes->packedSize = packedBuffer.size();
+    packedKeyframes->lastTickStored = true;
+    packedKeyframes->lastTick = keyframes.rbegin()->first;
+
+    return packedKeyframes;
+}//packKeyframes
+
+void Animation::freezeKeyframes(std::shared_ptr<const MappedKeyframes> packedKeyframes, std::vector<std::shared_ptr<const void> > &retired)
+{
+    if (mappedKeyframes != nullptr) {
+        retired.push_back(mappedKeyframes);
+    }//if
+
+    mappedKeyframes = packedKeyframes;
+    keyframesMapped = true;
+
+    //Moved out whole so freeing the Keyframes waits until after the pause
+    if (false == keyframes.empty()) {
+        std::shared_ptr<std::map<int, std::shared_ptr<Keyframe> > > oldKeyframes(new std::map<int, std::shared_ptr<Keyframe> >);
+        oldKeyframes->swap(keyframes);
+        retired.push_back(oldKeyframes);
+    }//if
+}//freezeKeyframes
+
+std::map<int, std::shared_ptr<Keyframe> > &Animation::getEditableKeyframes()
+{
+    Animation *keySource = this;
+    if (instanceOf != nullptr) {
+        keySource = instanceOf.get();
+    }//if
+
+    keySource->materializeKeyframes();
+    return keySource->keyframes;
+}//getEditableKeyframes
+
+const MappedKeyframes *Animation::getMappedKeyframes() const
+{
+    const Animation *keySource = this;
+    if (instanceOf != nullptr) {
+        keySource = instanceOf.get();
+    }//if
+
+    if (false == keySource->keyframesMapped) {
+        return nullptr;
+    }//if
+
+    return keySource->mappedKeyframes.get();
+}//getMappedKeyframes
+
 std::shared_ptr<Animation> Animation::deepClone(int *startTick_)
 {
     std::shared_ptr<Animation> clone(new Animation);
 
+    //The mapped keys can't change, so a clone can share them until one of the two is edited
+    if (true == keyframesMapped) {
+        clone->setMappedKeyframes(mappedKeyframes);
+    }//if
+
     for(std::map<int, std::shared_ptr<Keyframe> >::const_iterator mapIter = keyframes.begin(); mapIter != keyframes.end(); ++mapIter) {
         clone->keyframes[mapIter->first] = mapIter->second->deepClone();
     }//for
@@ -147,6 +472,8 @@ std::pair<std::shared_ptr<Animation>, std::shared_ptr<Animation> > Animation::de
 {
     std::shared_ptr<Animation> animClone1 = deepClone(owningEntryBlock1->getRawStartTick());
     std::shared_ptr<Animation> animClone2 = deepClone(owningEntryBlock2->getRawStartTick());
+    animClone1->materializeKeyframes();
+    animClone2->materializeKeyframes();
 
     std::map<int, std::shared_ptr<Keyframe> > keyframesAfter;
     auto splitIter = animClone1->keyframes.lower_bound(offset);
@@ -171,6 +498,9 @@ std::pair<std::shared_ptr<Animation>, std::shared_ptr<Animation> > Animation::de
 
 void Animation::mergeOtherAnimation(std::shared_ptr<Animation> otherAnim, InsertMode insertMode)
 {
+    materializeKeyframes();
+    otherAnim->materializeKeyframes();
+
     if (otherAnim->keyframes.empty() == true) {
         return;
     }//if
@@ -208,15 +538,18 @@ void Animation::mergeOtherAnimation(std::shared_ptr<Animation> otherAnim, Insert
 
 void Animation::absorbCurve(std::shared_ptr<Animation> otherAnim)
 {
+    if (true == otherAnim->keyframesMapped) {
+        setMappedKeyframes(otherAnim->mappedKeyframes);
+        return;
+    }//if
+
     this->keyframes = otherAnim->keyframes;
+    keyframesMapped = false;
 }//absorbCurve
 
 std::shared_ptr<Keyframe> Animation::getNextKeyframe(std::shared_ptr<Keyframe> keyframe)
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
-    if (instanceOf != nullptr) {
-        curKeyframes = &instanceOf->keyframes;
-    }//if
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
 
     std::map<int, std::shared_ptr<Keyframe> >::iterator keyIter = curKeyframes->find(keyframe->tick);
     if (keyIter == curKeyframes->end()) {
@@ -235,10 +568,7 @@ std::shared_ptr<Keyframe> Animation::getNextKeyframe(std::shared_ptr<Keyframe> k
 
 std::shared_ptr<Keyframe> Animation::getPrevKeyframe(std::shared_ptr<Keyframe> keyframe)
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
-    if (instanceOf != nullptr) {
-        curKeyframes = &instanceOf->keyframes;
-    }//if
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
 
     std::map<int, std::shared_ptr<Keyframe> >::iterator keyIter = curKeyframes->find(keyframe->tick);
     if (keyIter == curKeyframes->end()) {
@@ -257,10 +587,7 @@ std::shared_ptr<Keyframe> Animation::getPrevKeyframe(std::shared_ptr<Keyframe> k
 
 void Animation::addKey(std::shared_ptr<Keyframe> keyframe)
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
-    if (instanceOf != nullptr) {
-        curKeyframes = &instanceOf->keyframes;
-    }//if
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
 
     if (curKeyframes->find(keyframe->tick) == curKeyframes->end()) {
         (*curKeyframes)[keyframe->tick] = keyframe;
@@ -309,10 +636,7 @@ void Animation::addKey(std::shared_ptr<Keyframe> keyframe)
 
 void Animation::deleteKey(std::shared_ptr<Keyframe> keyframe)
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
-    if (instanceOf != nullptr) {
-        curKeyframes = &instanceOf->keyframes;
-    }//if
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
 
 //    std::cout << "deleteKey1: " << keyframe->tick << std::endl;
 
@@ -323,6 +647,63 @@ void Animation::deleteKey(std::shared_ptr<Keyframe> keyframe)
     }//if
 }//deleteKey
 
+//Linear keys are dropped while the straight line from the last key kept to the key after still passes within
+// tolerance of every key dropped since.  That's tracked as the range of slopes from the last key kept that
+// would, so each key is only looked at once.
+unsigned int Animation::simplify(double tolerance)
+{
+    if (instanceOf != nullptr) {
+        return 0;
+    }//if
+
+    std::map<int, std::shared_ptr<Keyframe> > &curKeyframes = getEditableKeyframes();
+    if (curKeyframes.size() < 3) {
+        return 0;
+    }//if
+
+    unsigned int numRemoved = 0;
+
+    std::map<int, std::shared_ptr<Keyframe> >::iterator keptIter = curKeyframes.begin();
+    std::map<int, std::shared_ptr<Keyframe> >::iterator keyIter = std::next(keptIter);
+    double minSlope = -std::numeric_limits<double>::infinity();
+    double maxSlope = std::numeric_limits<double>::infinity();
+
+    //The first and last keys always stay, so the block keeps its extent
+    while (std::next(keyIter) != curKeyframes.end()) {
+        const Keyframe &keptKeyframe = *keptIter->second;
+        const Keyframe &keyframe = *keyIter->second;
+        const Keyframe &nextKeyframe = *std::next(keyIter)->second;
+
+        bool redundant = false;
+        if ((CurveType::Step == keptKeyframe.curveType) && (CurveType::Step == keyframe.curveType)) {
+            redundant = (std::fabs(keyframe.value - keptKeyframe.value) <= tolerance);
+        } else if ((CurveType::Linear == keptKeyframe.curveType) && (CurveType::Linear == keyframe.curveType)) {
+            double tickDiff = keyframe.tick - keptKeyframe.tick;
+            double newMinSlope = std::max(minSlope, (keyframe.value - tolerance - keptKeyframe.value) / tickDiff);
+            double newMaxSlope = std::min(maxSlope, (keyframe.value + tolerance - keptKeyframe.value) / tickDiff);
+            double slope = (nextKeyframe.value - keptKeyframe.value) / (nextKeyframe.tick - keptKeyframe.tick);
+
+            if ((slope >= newMinSlope) && (slope <= newMaxSlope)) {
+                redundant = true;
+                minSlope = newMinSlope;
+                maxSlope = newMaxSlope;
+            }//if
+        }//if
+
+        if (true == redundant) {
+            keyIter = curKeyframes.erase(keyIter);
+            ++numRemoved;
+        } else {
+            keptIter = keyIter;
+            ++keyIter;
+            minSlope = -std::numeric_limits<double>::infinity();
+            maxSlope = std::numeric_limits<double>::infinity();
+        }//if
+    }//while
+
+    return numRemoved;
+}//simplify
+
 /*
 void Animation::deleteKey(int tick)
 {
@@ -342,6 +723,11 @@ asm ("int $0x03;");
 
 int Animation::getNumKeyframes() const
 {
+    const MappedKeyframes *curMappedKeyframes = getMappedKeyframes();
+    if (curMappedKeyframes != nullptr) {
+        return curMappedKeyframes->numKeys;
+    }//if
+
     if (instanceOf == nullptr) {
         return keyframes.size();
     } else {
@@ -349,13 +735,31 @@ int Animation::getNumKeyframes() const
     }//if
 }//getNumKeyframes
 
-std::shared_ptr<Keyframe> Animation::getKeyframe(unsigned int index)
+int Animation::getLastKeyframeTick() const
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
+    const MappedKeyframes *curMappedKeyframes = getMappedKeyframes();
+    if (curMappedKeyframes != nullptr) {
+        return curMappedKeyframes->getLastTick();
+    }//if
+
+    const std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
     if (instanceOf != nullptr) {
         curKeyframes = &instanceOf->keyframes;
     }//if
 
+    return (true == curKeyframes->empty()) ? 0 : curKeyframes->rbegin()->second->tick;
+}//getLastKeyframeTick
+
+bool Animation::areKeysResident() const
+{
+    const MappedKeyframes *curMappedKeyframes = getMappedKeyframes();
+    return (nullptr == curMappedKeyframes) || (true == curMappedKeyframes->resident);
+}//areKeysResident
+
+std::shared_ptr<Keyframe> Animation::getKeyframe(unsigned int index)
+{
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
+
     index = std::min(index, (unsigned int)curKeyframes->size());
     std::map<int, std::shared_ptr<Keyframe> >::const_iterator keyIter = curKeyframes->begin();
     std::advance(keyIter, index);
@@ -364,10 +768,7 @@ std::shared_ptr<Keyframe> Animation::getKeyframe(unsigned int index)
 
 std::shared_ptr<Keyframe> Animation::getKeyframeAtTick(int tick)
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
-    if (instanceOf != nullptr) {
-        curKeyframes = &instanceOf->keyframes;
-    }//if
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
 
     tick -= *startTick;
 
@@ -399,10 +800,37 @@ void Keyframe::serialize(Archive &ar, const unsigned int version)
 template<class Archive>
 void Animation::serialize(Archive &ar, const unsigned int version)
 {
+    materializeKeyframes();
     ar & BOOST_SERIALIZATION_NVP(keyframes);
 }//serialize
 
 double Animation::sample(int tick)
+{
+    return sample((double)tick);
+}//sample
+
+double Animation::sample(double tick)
+{
+    const MappedKeyframes *curMappedKeyframes = getMappedKeyframes();
+    if (curMappedKeyframes != nullptr) {
+        curMappedKeyframes->unpack();
+    }//if
+
+    return sampleKeys(curMappedKeyframes, tick);
+}//sample
+
+bool Animation::sampleResident(double tick, double &value)
+{
+    const MappedKeyframes *curMappedKeyframes = getMappedKeyframes();
+    if ((curMappedKeyframes != nullptr) && (false == curMappedKeyframes->resident)) {
+        return false;
+    }//if
+
+    value = sampleKeys(curMappedKeyframes, tick);
+    return true;
+}//sampleResident
+
+double Animation::sampleKeys(const MappedKeyframes *curMappedKeyframes, double tick)
 {
     std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
     if (instanceOf != nullptr) {
@@ -411,6 +839,10 @@ double Animation::sample(int tick)
 
     tick -= *startTick;
 
+    if (curMappedKeyframes != nullptr) {
+        return sampleMappedKeyframes(*curMappedKeyframes, tick);
+    }//if
+
     if (curKeyframes->empty() == true) {
         return 0;
     }//if
@@ -419,7 +851,8 @@ double Animation::sample(int tick)
         return curKeyframes->begin()->second->value;
     }//if
 
-    std::map<int, std::shared_ptr<Keyframe> >::const_iterator keyIter = curKeyframes->upper_bound(tick);
+    //Keyframes sit on whole ticks, so the one at or before a fractional tick is the one at or before its floor
+    std::map<int, std::shared_ptr<Keyframe> >::const_iterator keyIter = curKeyframes->upper_bound((int)std::floor(tick));
 
     if (keyIter == curKeyframes->end()) {
         --keyIter;
@@ -433,20 +866,8 @@ double Animation::sample(int tick)
     std::map<int, std::shared_ptr<Keyframe> >::const_iterator beforeKeyIter = keyIter;
     --beforeKeyIter;
 
-    switch (beforeKeyIter->second->curveType) {
-        case CurveType::Bezier:
-            return doBezierInterpolation(beforeKeyIter->second, keyIter->second, tick);
-
-        case CurveType::Linear:
-            return doLinearInterpolation(beforeKeyIter->second, keyIter->second, tick);
-        case CurveType::Step:
-            return doStepInterpolation(beforeKeyIter->second, keyIter->second, tick);
-        default:
-            break;
-    }//switch
-
-    return 0;
-}//sample
+    return doInterpolation(*beforeKeyIter->second, *keyIter->second, tick);
+}//sampleKeys
 
 /*
 KeySelectedType Keyframe::getSelectedState()
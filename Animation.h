@@ -10,11 +10,15 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __ANIMATION_H
 #define __ANIMATION_H
 
+#ifndef FMA_HEADLESS
 #include <gtkmm.h>
+#endif
 #include <vector>
 #include <map>
 #include <memory>
 #include <functional>
+#include <atomic>
+#include <mutex>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/version.hpp>
@@ -77,17 +81,77 @@ private:
     friend class boost::serialization::access;
 };//Keyframe
 
+//A curve's keys where they lie in a mapped binary project (see BinaryProject.h).  Nothing is read until
+// something samples the curve, and then only the pages it touches.
+//
+//Keys can also be packed (see KeyframeCodec.h), in the file or in memory; then the arrays stay null until
+// unpack() decodes them into a buffer of its own, on KeyframePrefetcher's thread or whichever other thread gets
+// to the curve first; never the process callbacks, which wait for resident instead.
+//
+//Resident keys stay in memory: their pages are locked, or copied out when they can't be.  The mapping is of the
+// project file itself, so if something else truncates the file while it's open, reading keys past the new end
+// raises SIGBUS.  Saving never does; ProjectSaver writes a new file and renames it over the old one.
+struct MappedKeyframes
+{
+    MappedKeyframes();
+
+    std::shared_ptr<const unsigned char> mapping; //keeps the file mapped (or the packed keys allocated) while any curve still points into it
+    unsigned int numKeys;
+    mutable const int *ticks;
+    mutable const double *values;
+    mutable const double *inTangents; //two per key
+    mutable const double *outTangents; //two per key
+    mutable const unsigned char *curveTypes;
+
+    const unsigned char *packedKeys; //nullptr unless packed
+    size_t packedSize;
+
+    //Format 3 files keep it with the block, so a block's extent doesn't fault in its keys; packed keys always have it
+    bool lastTickStored;
+    int lastTick;
+
+    mutable std::atomic<bool> resident; //set once KeyframePrefetcher has brought its pages in and locked them, or once it's been unpacked
+
+    void unpack() const; //before using the arrays; does nothing if they're already there
+    void copyFrom(const std::map<int, std::shared_ptr<Keyframe> > &keyframes); //into arrays of its own, for packing
+    void copyOutOfMapping() const; //into arrays of its own, for when the mapped pages can't be locked
+
+    Keyframe getKeyframe(unsigned int index) const;
+    int getLastTick() const;
+
+private:
+    mutable std::unique_ptr<double[]> ownKeys;
+    mutable std::once_flag unpackOnce;
+
+    void allocateKeys() const;
+};//MappedKeyframes
+
 class Animation : public std::enable_shared_from_this<Animation>
 {
     std::shared_ptr<Animation> instanceOf;
     std::map<int, std::shared_ptr<Keyframe> > keyframes; //XXX: We use the ordered map properties.. reconsider if ever changing to a hash map
     int *startTick;
 
-    Animation() {}
+    //While keyframesMapped is set the keys are only in mappedKeyframes and keyframes is empty.  Anything that
+    // hands out a Keyframe (and so might change it) copies them into keyframes first, and swaps them in inside
+    // a sampling pause (see pauseSampling) so no sample is part way through either.
+    std::shared_ptr<const MappedKeyframes> mappedKeyframes;
+    std::atomic<bool> keyframesMapped;
+
+    Animation() : startTick(nullptr), keyframesMapped(false) {}
 
     void absorbCurve(std::shared_ptr<Animation> otherAnim);
+    void setMappedKeyframes(std::shared_ptr<const MappedKeyframes> mappedKeyframes);
+    void materializeKeyframes();
+    std::map<int, std::shared_ptr<Keyframe> > &getEditableKeyframes(); //of instanceOf, if there is one
+    const MappedKeyframes *getMappedKeyframes() const; //nullptr once editable
+    double sampleKeys(const MappedKeyframes *curMappedKeyframes, double tick); //with the mapped keys unpacked, if there are any
 
 public:
+    //Installed by the engine (a SamplingPause, see jack.h) so curves can hold it still without depending on it;
+    // the pause lasts as long as what it returns.  Left empty where nothing samples the project behind our back.
+    static std::function<std::shared_ptr<void> ()> pauseSampling;
+
     Animation(SequencerEntryBlock *owningEntryBlock, std::shared_ptr<Animation> instanceOf);
     ~Animation();
 
@@ -99,6 +163,17 @@ public:
     //void deleteKey(int tick);
     void deleteKey(std::shared_ptr<Keyframe> keyframe);
     int getNumKeyframes() const;
+    int getLastKeyframeTick() const; //0 with no keyframes; doesn't make the curve editable
+    bool areKeysResident() const; //false while its mapped keys are still waiting on the prefetcher, or packed
+
+    //Packs the keys of a curve nobody's working on (see KeyframeCodec.h), for freezeKeyframes; nullptr if it can't be
+    // frozen.  Editing afterwards makes new Keyframes, so it's only done when nothing outside the curve (undo, the
+    // clipboard, a selection) holds on to one of them.
+    std::shared_ptr<const MappedKeyframes> packKeyframes() const;
+    //Swaps in what packKeyframes made, with nothing changed in between; they're unpacked again the next time the
+    // curve is sampled, drawn or edited.  Only inside a SamplingPause (see jack.h).  Whatever's replaced goes in
+    // retired, to be dropped after the pause rather than during it.
+    void freezeKeyframes(std::shared_ptr<const MappedKeyframes> packedKeyframes, std::vector<std::shared_ptr<const void> > &retired);
     std::shared_ptr<Keyframe> getKeyframe(unsigned int index);
     std::shared_ptr<Keyframe> getKeyframeAtTick(int tick);
 
@@ -107,18 +182,35 @@ public:
 
     void mergeOtherAnimation(std::shared_ptr<Animation> otherAnim, InsertMode insertMode);
 
+    //Drops the keys that move the curve by no more than tolerance (in the entry's units): step keys near the
+    // value of the key kept before them, linear keys near the line through the keys kept either side.  That's
+    // most of a recorded lane.  Bezier keys and instances are left alone.  Returns how many keys went.
+    unsigned int simplify(double tolerance);
+
     double sample(int tick);
+    double sample(double tick); //for sampling between whole ticks
+    //For the process callbacks, which mustn't unpack keys or fault in a file's pages: false, and value left alone,
+    // while the keys are still waiting on KeyframePrefetcher
+    bool sampleResident(double tick, double &value);
 
+#ifndef FMA_HEADLESS
     void render(Cairo::RefPtr<Cairo::Context> context, GraphState &graphState, unsigned int areaWidth, unsigned int areaHeight, std::shared_ptr<SequencerEntryBlockUI> entryBlock);
+#endif
 //    std::pair<int, SelectedEntity> getSelection(int tick, double value);
 
     template<class Archive> void serialize(Archive &ar, const unsigned int version);
     friend class boost::serialization::access;
     friend class SequencerEntryBlock;
+    friend class BinaryProjectWriter;
+    friend class BinaryProjectReader;
+    friend class ProjectJournal;
+    friend class KeyframePrefetcher;
 };//Animation
 
+#ifndef FMA_HEADLESS
 void drawAnimation(Gtk::DrawingArea *graphDrawingArea, Cairo::RefPtr<Cairo::Context> context, GraphState &graphState, unsigned int areaWidth, unsigned int areaHeight, 
                     std::vector<int> &verticalPixelTickValues, std::vector<float> &horizontalPixelValues, std::shared_ptr<Animation> animation);
+#endif
 
 
 BOOST_CLASS_VERSION(Animation, 1);
@@ -0,0 +1,379 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "BinaryArchive.h"
+#include <cstring>
+
+namespace
+{
+
+unsigned long long doubleBits(double value)
+{
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}//doubleBits
+
+double bitsDouble(unsigned long long bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}//bitsDouble
+
+}//anonymous namespace
+
+unsigned int BinaryProjectContext::addString(const std::string &str)
+{
+    auto stringIter = stringIndices.find(str);
+    if (stringIter != stringIndices.end()) {
+        return stringIter->second;
+    }//if
+
+    unsigned int index = strings.size();
+    strings.push_back(str);
+    stringIndices[str] = index;
+
+    return index;
+}//addString
+
+void BinaryProjectContext::addEntry(std::shared_ptr<SequencerEntry> entry)
+{
+    entryIndices[entry.get()] = entries.size();
+    entries.push_back(entry);
+}//addEntry
+
+void BinaryProjectContext::addEntryBlock(std::shared_ptr<SequencerEntryBlock> entryBlock)
+{
+    entryBlockIndices[entryBlock.get()] = entryBlocks.size();
+    entryBlocks.push_back(entryBlock);
+}//addEntryBlock
+
+BinaryOArchive::BinaryOArchive(BinaryProjectContext &context_) : context(context_)
+{
+    //Nothing
+}//constructor
+
+BinaryOArchive::~BinaryOArchive()
+{
+    //Nothing
+}//destructor
+
+const std::vector<unsigned char> &BinaryOArchive::getBuffer() const
+{
+    return buffer;
+}//getBuffer
+
+BinaryProjectContext &BinaryOArchive::getContext()
+{
+    return context;
+}//getContext
+
+void BinaryOArchive::saveByte(unsigned char value)
+{
+    buffer.push_back(value);
+}//saveByte
+
+void BinaryOArchive::saveVarint(unsigned long long value)
+{
+    while (value >= 0x80) {
+        buffer.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }//while
+
+    buffer.push_back((unsigned char)value);
+}//saveVarint
+
+void BinaryOArchive::saveZigzag(long long value)
+{
+    saveVarint(((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}//saveZigzag
+
+void BinaryOArchive::saveFixed32(unsigned int value)
+{
+    for (unsigned int byte = 0; byte < 4; ++byte) {
+        buffer.push_back((unsigned char)(value >> (byte * 8)));
+    }//for
+}//saveFixed32
+
+void BinaryOArchive::saveFixed64(unsigned long long value)
+{
+    for (unsigned int byte = 0; byte < 8; ++byte) {
+        buffer.push_back((unsigned char)(value >> (byte * 8)));
+    }//for
+}//saveFixed64
+
+void BinaryOArchive::saveDoubles(const double *values, size_t count)
+{
+    if (true == hostIsLittleEndian) {
+        saveRaw(values, count * sizeof(double));
+        return;
+    }//if
+
+    for (size_t index = 0; index < count; ++index) {
+        saveFixed64(doubleBits(values[index]));
+    }//for
+}//saveDoubles
+
+void BinaryOArchive::saveRaw(const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}//saveRaw
+
+void BinaryOArchive::alignTo(size_t alignment)
+{
+    while (0 != (buffer.size() % alignment)) {
+        buffer.push_back(0);
+    }//while
+}//alignTo
+
+void BinaryOArchive::save(bool value)
+{
+    saveByte((true == value) ? 1 : 0);
+}//save
+
+void BinaryOArchive::save(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    saveFixed32(bits);
+}//save
+
+void BinaryOArchive::save(double value)
+{
+    saveFixed64(doubleBits(value));
+}//save
+
+void BinaryOArchive::save(const std::string &value)
+{
+    saveVarint(context.addString(value));
+}//save
+
+void BinaryOArchive::save(const std::shared_ptr<SequencerEntry> &entry)
+{
+    if (entry == nullptr) {
+        saveVarint(0);
+        return;
+    }//if
+
+    auto indexIter = context.entryIndices.find(entry.get());
+    saveVarint((indexIter != context.entryIndices.end()) ? (indexIter->second + 1) : 0);
+}//save
+
+void BinaryOArchive::save(const std::shared_ptr<SequencerEntryBlock> &entryBlock)
+{
+    if (entryBlock == nullptr) {
+        saveVarint(0);
+        return;
+    }//if
+
+    auto indexIter = context.entryBlockIndices.find(entryBlock.get());
+    saveVarint((indexIter != context.entryBlockIndices.end()) ? (indexIter->second + 1) : 0);
+}//save
+
+BinaryIArchive::BinaryIArchive(BinaryProjectContext &context_, const unsigned char *data_, size_t size_) : context(context_)
+{
+    data = data_;
+    size = size_;
+    position = 0;
+    failed = false;
+}//constructor
+
+BinaryIArchive::~BinaryIArchive()
+{
+    //Nothing
+}//destructor
+
+BinaryProjectContext &BinaryIArchive::getContext()
+{
+    return context;
+}//getContext
+
+const unsigned char *BinaryIArchive::getData() const
+{
+    return data;
+}//getData
+
+bool BinaryIArchive::hasFailed() const
+{
+    return failed;
+}//hasFailed
+
+void BinaryIArchive::setFailed()
+{
+    failed = true;
+    position = size;
+}//setFailed
+
+size_t BinaryIArchive::getPosition() const
+{
+    return position;
+}//getPosition
+
+size_t BinaryIArchive::getSize() const
+{
+    return size;
+}//getSize
+
+void BinaryIArchive::seek(size_t position_)
+{
+    if (position_ > size) {
+        setFailed();
+        return;
+    }//if
+
+    position = position_;
+}//seek
+
+unsigned char BinaryIArchive::loadByte()
+{
+    if (position >= size) {
+        setFailed();
+        return 0;
+    }//if
+
+    return data[position++];
+}//loadByte
+
+unsigned long long BinaryIArchive::loadVarint()
+{
+    unsigned long long value = 0;
+
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (position >= size) {
+            setFailed();
+            return 0;
+        }//if
+
+        unsigned char byte = data[position++];
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+
+        if (0 == (byte & 0x80)) {
+            return value;
+        }//if
+    }//for
+
+    setFailed();
+    return 0;
+}//loadVarint
+
+long long BinaryIArchive::loadZigzag()
+{
+    unsigned long long value = loadVarint();
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}//loadZigzag
+
+unsigned int BinaryIArchive::loadFixed32()
+{
+    if (size - position < 4) {
+        setFailed();
+        return 0;
+    }//if
+
+    unsigned int value = 0;
+    for (unsigned int byte = 0; byte < 4; ++byte) {
+        value |= (unsigned int)data[position++] << (byte * 8);
+    }//for
+
+    return value;
+}//loadFixed32
+
+unsigned long long BinaryIArchive::loadFixed64()
+{
+    if (size - position < 8) {
+        setFailed();
+        return 0;
+    }//if
+
+    unsigned long long value = 0;
+    for (unsigned int byte = 0; byte < 8; ++byte) {
+        value |= (unsigned long long)data[position++] << (byte * 8);
+    }//for
+
+    return value;
+}//loadFixed64
+
+void BinaryIArchive::loadDoubles(double *values, size_t count)
+{
+    if ((size - position) / sizeof(double) < count) {
+        setFailed();
+        for (size_t index = 0; index < count; ++index) {
+            values[index] = 0.0;
+        }//for
+        return;
+    }//if
+
+    if (true == hostIsLittleEndian) {
+        memcpy(values, data + position, count * sizeof(double));
+        position += count * sizeof(double);
+        return;
+    }//if
+
+    for (size_t index = 0; index < count; ++index) {
+        values[index] = bitsDouble(loadFixed64());
+    }//for
+}//loadDoubles
+
+void BinaryIArchive::alignTo(size_t alignment)
+{
+    size_t aligned = ((position + alignment - 1) / alignment) * alignment;
+    seek(aligned);
+}//alignTo
+
+void BinaryIArchive::load(bool &value)
+{
+    value = (0 != loadByte());
+}//load
+
+void BinaryIArchive::load(float &value)
+{
+    unsigned int bits = loadFixed32();
+    memcpy(&value, &bits, sizeof(value));
+}//load
+
+void BinaryIArchive::load(double &value)
+{
+    value = bitsDouble(loadFixed64());
+}//load
+
+void BinaryIArchive::load(std::string &value)
+{
+    unsigned long long index = loadVarint();
+    if (index >= context.strings.size()) {
+        setFailed();
+        value.clear();
+        return;
+    }//if
+
+    value = context.strings[index];
+}//load
+
+void BinaryIArchive::load(std::shared_ptr<SequencerEntry> &entry)
+{
+    unsigned long long index = loadVarint();
+    if (index > context.entries.size()) {
+        setFailed();
+        index = 0;
+    }//if
+
+    entry = (0 == index) ? std::shared_ptr<SequencerEntry>() : context.entries[index - 1];
+}//load
+
+void BinaryIArchive::load(std::shared_ptr<SequencerEntryBlock> &entryBlock)
+{
+    unsigned long long index = loadVarint();
+    if (index > context.entryBlocks.size()) {
+        setFailed();
+        index = 0;
+    }//if
+
+    entryBlock = (0 == index) ? std::shared_ptr<SequencerEntryBlock>() : context.entryBlocks[index - 1];
+}//load
+
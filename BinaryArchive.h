@@ -0,0 +1,259 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __BINARYARCHIVE_H
+#define __BINARYARCHIVE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/version.hpp>
+#include <boost/serialization/access.hpp>
+
+class SequencerEntry;
+class SequencerEntryBlock;
+
+//Files are little-endian; on hosts that are too, arrays of doubles can be used where they lie
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+const bool hostIsLittleEndian = true;
+#else
+const bool hostIsLittleEndian = false;
+#endif
+
+//What every chunk of one binary project shares: the string table, and the entries and blocks in the order
+// the model chunk wrote them.  Anything else that points at an entry or block writes its index into those
+// (plus one, so zero is null) instead of the object.
+struct BinaryProjectContext
+{
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, unsigned int> stringIndices;
+
+    std::vector<std::shared_ptr<SequencerEntry> > entries;
+    std::vector<std::shared_ptr<SequencerEntryBlock> > entryBlocks;
+    std::unordered_map<const SequencerEntry *, unsigned int> entryIndices;
+    std::unordered_map<const SequencerEntryBlock *, unsigned int> entryBlockIndices;
+
+    unsigned int addString(const std::string &str);
+    void addEntry(std::shared_ptr<SequencerEntry> entry);
+    void addEntryBlock(std::shared_ptr<SequencerEntryBlock> entryBlock);
+};//BinaryProjectContext
+
+//Looks enough like a boost saving archive (ar & BOOST_SERIALIZATION_NVP(x)) that the existing serialize and
+// doSave templates can be instantiated on it.  Integers are varints (zigzag when signed), floating point is
+// little-endian IEEE, strings go through the string table.  Classes are written as their version and then
+// their serialize(); there is no object tracking, so only entries and blocks may be shared.
+class BinaryOArchive
+{
+    BinaryProjectContext &context;
+    std::vector<unsigned char> buffer;
+
+public:
+    explicit BinaryOArchive(BinaryProjectContext &context);
+    ~BinaryOArchive();
+
+    const std::vector<unsigned char> &getBuffer() const;
+    BinaryProjectContext &getContext();
+
+    void saveByte(unsigned char value);
+    void saveVarint(unsigned long long value);
+    void saveZigzag(long long value);
+    void saveFixed32(unsigned int value);
+    void saveFixed64(unsigned long long value);
+    void saveDoubles(const double *values, size_t count);
+    void saveRaw(const void *data, size_t size);
+    void alignTo(size_t alignment);
+
+    template<class T> BinaryOArchive &operator&(const boost::serialization::nvp<T> &nvp)
+    {
+        save(nvp.value());
+        return *this;
+    }//operator&
+
+    void save(bool value);
+    void save(float value);
+    void save(double value);
+    void save(const std::string &value);
+    void save(const std::shared_ptr<SequencerEntry> &entry);
+    void save(const std::shared_ptr<SequencerEntryBlock> &entryBlock);
+
+    template<class T> typename std::enable_if<(true == std::is_integral<T>::value) && (true == std::is_signed<T>::value)>::type save(const T &value)
+    {
+        saveZigzag(value);
+    }//save
+
+    template<class T> typename std::enable_if<(true == std::is_integral<T>::value) && (false == std::is_signed<T>::value)>::type save(const T &value)
+    {
+        saveVarint(value);
+    }//save
+
+    template<class T> typename std::enable_if<true == std::is_enum<T>::value>::type save(const T &value)
+    {
+        saveZigzag((long long)value);
+    }//save
+
+    template<class T, size_t N> void save(const T (&values)[N])
+    {
+        for (size_t index = 0; index < N; ++index) {
+            save(values[index]);
+        }//for
+    }//save
+
+    template<class T> void save(const std::vector<T> &values)
+    {
+        saveVarint(values.size());
+        for (const T &value : values) {
+            save(value);
+        }//foreach
+    }//save
+
+    template<class K, class V> void save(const std::map<K, V> &values)
+    {
+        saveVarint(values.size());
+        for (auto mapIter : values) {
+            save(mapIter.first);
+            save(mapIter.second);
+        }//foreach
+    }//save
+
+    //Owned, not shared: written in place
+    template<class T> void save(const std::shared_ptr<T> &value)
+    {
+        saveByte((value != nullptr) ? 1 : 0);
+        if (value != nullptr) {
+            save(*value);
+        }//if
+    }//save
+
+    template<class T> typename std::enable_if<true == std::is_class<T>::value>::type save(const T &value)
+    {
+        unsigned int version = boost::serialization::version<T>::value;
+        saveVarint(version);
+        boost::serialization::access::serialize(*this, const_cast<T &>(value), version);
+    }//save
+};//BinaryOArchive
+
+//The loading half.  Reads never go past the end of the data; a short or corrupt chunk sets the failed flag
+// and everything after reads as zero, so callers check hasFailed() once at the end instead of per field.
+class BinaryIArchive
+{
+    BinaryProjectContext &context;
+    const unsigned char *data;
+    size_t size;
+    size_t position;
+    bool failed;
+
+public:
+    BinaryIArchive(BinaryProjectContext &context, const unsigned char *data, size_t size);
+    ~BinaryIArchive();
+
+    BinaryProjectContext &getContext();
+    const unsigned char *getData() const;
+    bool hasFailed() const;
+    void setFailed();
+    size_t getPosition() const;
+    size_t getSize() const;
+    void seek(size_t position);
+
+    unsigned char loadByte();
+    unsigned long long loadVarint();
+    long long loadZigzag();
+    unsigned int loadFixed32();
+    unsigned long long loadFixed64();
+    void loadDoubles(double *values, size_t count);
+    void alignTo(size_t alignment);
+
+    template<class T> BinaryIArchive &operator&(const boost::serialization::nvp<T> &nvp)
+    {
+        load(nvp.value());
+        return *this;
+    }//operator&
+
+    void load(bool &value);
+    void load(float &value);
+    void load(double &value);
+    void load(std::string &value);
+    void load(std::shared_ptr<SequencerEntry> &entry);
+    void load(std::shared_ptr<SequencerEntryBlock> &entryBlock);
+
+    template<class T> typename std::enable_if<(true == std::is_integral<T>::value) && (true == std::is_signed<T>::value)>::type load(T &value)
+    {
+        value = (T)loadZigzag();
+    }//load
+
+    template<class T> typename std::enable_if<(true == std::is_integral<T>::value) && (false == std::is_signed<T>::value)>::type load(T &value)
+    {
+        value = (T)loadVarint();
+    }//load
+
+    template<class T> typename std::enable_if<true == std::is_enum<T>::value>::type load(T &value)
+    {
+        value = (T)loadZigzag();
+    }//load
+
+    template<class T, size_t N> void load(T (&values)[N])
+    {
+        for (size_t index = 0; index < N; ++index) {
+            load(values[index]);
+        }//for
+    }//load
+
+    template<class T> void load(std::vector<T> &values)
+    {
+        unsigned long long count = loadVarint();
+        values.clear();
+
+        //Every element takes at least a byte, so a count past the data left is corrupt
+        if (count > size - position) {
+            setFailed();
+            return;
+        }//if
+
+        values.resize(count);
+        for (T &value : values) {
+            load(value);
+        }//foreach
+    }//load
+
+    template<class K, class V> void load(std::map<K, V> &values)
+    {
+        unsigned long long count = loadVarint();
+        values.clear();
+
+        for (unsigned long long index = 0; (index < count) && (false == failed); ++index) {
+            K key = K();
+            V value = V();
+            load(key);
+            load(value);
+            values.insert(values.end(), std::make_pair(key, value));
+        }//for
+    }//load
+
+    template<class T> void load(std::shared_ptr<T> &value)
+    {
+        value.reset();
+        if (0 != loadByte()) {
+            value.reset(new T);
+            load(*value);
+        }//if
+    }//load
+
+    template<class T> typename std::enable_if<true == std::is_class<T>::value>::type load(T &value)
+    {
+        unsigned int version = (unsigned int)loadVarint();
+        boost::serialization::access::serialize(*this, value, version);
+    }//load
+};//BinaryIArchive
+
+
+#endif
+
@@ -0,0 +1,786 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "BinaryProject.h"
+#include "Globals.h"
+#include "Tempo.h"
+#include "Animation.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+#include "jack.h"
+#include "ProjectSaver.h"
+#include "KeyframePrefetcher.h"
+#include "KeyframeCodec.h"
+#include <fstream>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+
+const char binaryProjectMagic[4] = { 'F', 'M', 'A', 'B' };
+const size_t fileHeaderSize = 16;
+const size_t chunkHeaderSize = 16;
+
+//What a keyframe takes in KEYS: five doubles, the tick and the curve type
+const size_t keyframeBytes = 5 * sizeof(double) + sizeof(int) + 1;
+
+//Format 1: the same, but with the tick as a varint delta of at least a byte
+const size_t minDeltaKeyframeBytes = 5 * sizeof(double) + 2;
+
+enum BlockFlags
+{
+    CurveIsInstance = 1,
+    SecondaryCurveIsInstance = 2,
+    CurveIsPacked = 4, //format 4 on
+    SecondaryCurveIsPacked = 8
+};//BlockFlags
+
+//A block as ENTR describes it
+struct EntryBlockRecord
+{
+    int startTick;
+    std::string title;
+    unsigned long long instanceOfIndex;
+    unsigned char flags;
+    unsigned long long keysOffset;
+    unsigned long long numCurveKeys;
+    unsigned long long numSecondaryCurveKeys;
+    bool lastTicksStored; //format 3 on
+    int curveLastTick;
+    int secondaryCurveLastTick;
+};//EntryBlockRecord
+
+struct EntryRecord
+{
+    std::shared_ptr<SequencerEntry> entry;
+    std::vector<std::string> inputPortNames;
+    std::vector<std::string> outputPortNames;
+    std::vector<EntryBlockRecord> entryBlockRecords;
+    std::vector<std::shared_ptr<SequencerEntryBlock> > entryBlocks; //built from entryBlockRecords, in the same order
+};//EntryRecord
+
+}//anonymous namespace
+
+BinaryProjectWriter::BinaryProjectWriter()
+{
+    projectVersion = 0;
+}//constructor
+
+BinaryProjectWriter::~BinaryProjectWriter()
+{
+    //Nothing
+}//destructor
+
+BinaryOArchive &BinaryProjectWriter::addChunk(const std::string &tag)
+{
+    std::shared_ptr<BinaryOArchive> archive(new BinaryOArchive(context));
+    chunks.push_back(std::make_pair(tag, archive));
+    return *archive;
+}//addChunk
+
+unsigned int BinaryProjectWriter::getNumStoredKeys(std::shared_ptr<Animation> curve)
+{
+    if (true == curve->keyframesMapped) {
+        return curve->mappedKeyframes->numKeys;
+    }//if
+
+    return curve->keyframes.size();
+}//getNumStoredKeys
+
+int BinaryProjectWriter::getLastStoredKeyTick(std::shared_ptr<Animation> curve)
+{
+    if (true == curve->keyframesMapped) {
+        return curve->mappedKeyframes->getLastTick();
+    }//if
+
+    return (true == curve->keyframes.empty()) ? 0 : curve->keyframes.rbegin()->first;
+}//getLastStoredKeyTick
+
+bool BinaryProjectWriter::writeCurve(BinaryOArchive &keysArchive, std::shared_ptr<Animation> curve)
+{
+    keysArchive.alignTo(8);
+
+    //Packed keys (loaded that way, or frozen) go across as they are; they can't have changed
+    std::shared_ptr<const MappedKeyframes> mappedKeyframes;
+    if (true == curve->keyframesMapped) {
+        mappedKeyframes = curve->mappedKeyframes;
+
+        if (mappedKeyframes->packedKeys != nullptr) {
+            keysArchive.saveVarint(mappedKeyframes->packedSize);
+            keysArchive.saveRaw(mappedKeyframes->packedKeys, mappedKeyframes->packedSize);
+            return true;
+        }//if
+    } else {
+        std::shared_ptr<MappedKeyframes> copiedKeyframes(new MappedKeyframes);
+        copiedKeyframes->copyFrom(curve->keyframes);
+        mappedKeyframes = copiedKeyframes;
+    }//if
+
+    const MappedKeyframes &keys = *mappedKeyframes;
+    unsigned int numKeys = keys.numKeys;
+
+    //Packed keys have to be unpacked before they're used, where plain ones are used where they lie, so only
+    // pack what it halves at least (recorded lanes come out at a tenth or less)
+    if (numKeys > 0) {
+        BinaryOArchive packedArchive(context);
+        KeyframeCodec::pack(packedArchive, keys);
+
+        const std::vector<unsigned char> &packedKeys = packedArchive.getBuffer();
+        if (packedKeys.size() * 2 <= numKeys * keyframeBytes) {
+            keysArchive.saveVarint(packedKeys.size());
+            keysArchive.saveRaw(packedKeys.data(), packedKeys.size());
+            return true;
+        }//if
+    }//if
+
+    keysArchive.saveDoubles(keys.values, numKeys);
+    keysArchive.saveDoubles(keys.inTangents, numKeys * 2);
+    keysArchive.saveDoubles(keys.outTangents, numKeys * 2);
+    for (unsigned int key = 0; key < numKeys; ++key) {
+        keysArchive.saveFixed32((unsigned int)keys.ticks[key]);
+    }//for
+    keysArchive.saveRaw(keys.curveTypes, numKeys);
+
+    return false;
+}//writeCurve
+
+void BinaryProjectWriter::addProject(unsigned int projectVersion_)
+{
+    projectVersion = projectVersion_;
+
+    Globals &globals = Globals::Instance();
+    std::shared_ptr<Sequencer> sequencer = globals.projectData.getSequencer();
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    //Every index first, since an instance can be of a block in a later entry
+    for (std::shared_ptr<SequencerEntry> entry : sequencer->getEntryPair()) {
+        context.addEntry(entry);
+
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            context.addEntryBlock(entryBlockIter.second);
+        }//foreach
+    }//foreach
+
+    BinaryOArchive &jackArchive = addChunk("JACK");
+    jackSingleton.doSave(jackArchive);
+
+    BinaryOArchive &tempoArchive = addChunk("TMPO");
+    tempoArchive.save(globals.projectData.tempoChanges);
+
+    BinaryOArchive &entryArchive = addChunk("ENTR");
+    BinaryOArchive &keysArchive = addChunk("KEYS");
+
+    entryArchive.saveVarint(context.entries.size());
+    for (std::shared_ptr<SequencerEntry> entry : context.entries) {
+        entryArchive.save(*entry->getImpl());
+
+        std::vector<std::string> inputPortNames;
+        std::vector<std::string> outputPortNames;
+
+        for (jack_port_t *port : entry->getInputPorts()) {
+            inputPortNames.push_back(jackSingleton.getInputPortName(port));
+        }//foreach
+
+        for (jack_port_t *port : entry->getOutputPorts()) {
+            outputPortNames.push_back(jackSingleton.getOutputPortName(port));
+        }//foreach
+
+        entryArchive.save(inputPortNames);
+        entryArchive.save(outputPortNames);
+
+        auto entryBlocksPair = entry->getEntryBlocksPair();
+        entryArchive.saveVarint(std::distance(entryBlocksPair.begin(), entryBlocksPair.end()));
+
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+
+            unsigned int instanceOfIndex = 0;
+            if (entryBlock->instanceOf != nullptr) {
+                auto indexIter = context.entryBlockIndices.find(entryBlock->instanceOf.get());
+                if (indexIter != context.entryBlockIndices.end()) {
+                    instanceOfIndex = indexIter->second + 1;
+                }//if
+            }//if
+
+            //Kept apart from instanceOf: a block loaded from XML knows what it's an instance of but its curves don't
+            unsigned char flags = 0;
+            if (entryBlock->curve->instanceOf != nullptr) {
+                flags |= CurveIsInstance;
+            }//if
+            if (entryBlock->secondaryCurve->instanceOf != nullptr) {
+                flags |= SecondaryCurveIsInstance;
+            }//if
+
+            keysArchive.alignTo(8);
+            size_t keysOffset = keysArchive.getBuffer().size();
+
+            //The keys go first, so the flags can say which curves were packed
+            if (true == writeCurve(keysArchive, entryBlock->curve)) {
+                flags |= CurveIsPacked;
+            }//if
+            if (true == writeCurve(keysArchive, entryBlock->secondaryCurve)) {
+                flags |= SecondaryCurveIsPacked;
+            }//if
+
+            entryArchive.saveZigzag(entryBlock->startTick);
+            entryArchive.save(fmastring_to_locale(entryBlock->title));
+            entryArchive.saveVarint(instanceOfIndex);
+            entryArchive.saveByte(flags);
+            entryArchive.saveVarint(keysOffset);
+            entryArchive.saveVarint(getNumStoredKeys(entryBlock->curve));
+            entryArchive.saveVarint(getNumStoredKeys(entryBlock->secondaryCurve));
+            entryArchive.saveZigzag(getLastStoredKeyTick(entryBlock->curve));
+            entryArchive.saveZigzag(getLastStoredKeyTick(entryBlock->secondaryCurve));
+        }//foreach
+    }//foreach
+}//addProject
+
+BinaryOArchive &BinaryProjectWriter::addWindowChunk()
+{
+    return addChunk("WIND");
+}//addWindowChunk
+
+bool BinaryProjectWriter::save(const std::string &filename, std::string &error, SaveProgress *progress)
+{
+    //The string table is only complete now, but goes first so it's there before anything refers to it
+    BinaryOArchive stringArchive(context);
+    stringArchive.saveVarint(context.strings.size());
+    for (const std::string &str : context.strings) {
+        stringArchive.saveVarint(str.size());
+        stringArchive.saveRaw(str.data(), str.size());
+    }//foreach
+
+    std::vector<std::pair<std::string, const BinaryOArchive *> > fileChunks;
+    fileChunks.push_back(std::make_pair(std::string("STRS"), &stringArchive));
+    for (auto chunkIter : chunks) {
+        fileChunks.push_back(std::make_pair(chunkIter.first, chunkIter.second.get()));
+    }//foreach
+
+    BinaryOArchive header(context);
+    header.saveRaw(binaryProjectMagic, sizeof(binaryProjectMagic));
+    header.saveFixed32(binaryProjectFormatVersion);
+    header.saveFixed32(projectVersion);
+    header.saveFixed32(fileChunks.size());
+
+    const unsigned char padding[8] = { 0 };
+
+    std::vector<std::shared_ptr<BinaryOArchive> > chunkHeaders;
+    std::vector<std::pair<const void *, size_t> > pieces;
+    pieces.push_back(std::make_pair((const void *)header.getBuffer().data(), header.getBuffer().size()));
+
+    for (auto chunkIter : fileChunks) {
+        const std::vector<unsigned char> &payload = chunkIter.second->getBuffer();
+
+        std::shared_ptr<BinaryOArchive> chunkHeader(new BinaryOArchive(context));
+        chunkHeader->saveRaw(chunkIter.first.data(), 4);
+        chunkHeader->saveFixed32(0);
+        chunkHeader->saveFixed64(payload.size());
+        chunkHeaders.push_back(chunkHeader);
+
+        pieces.push_back(std::make_pair((const void *)chunkHeader->getBuffer().data(), chunkHeader->getBuffer().size()));
+        pieces.push_back(std::make_pair((const void *)payload.data(), payload.size()));
+        pieces.push_back(std::make_pair((const void *)padding, (8 - (payload.size() % 8)) % 8));
+    }//foreach
+
+    return writeFileAtomically(filename, pieces, error, progress);
+}//save
+
+BinaryProjectReader::BinaryProjectReader()
+{
+    fileSize = 0;
+    formatVersion = 0;
+    projectVersion = 0;
+}//constructor
+
+BinaryProjectReader::~BinaryProjectReader()
+{
+    //Nothing
+}//destructor
+
+bool BinaryProjectReader::isBinaryProject(const std::string &filename)
+{
+    std::ifstream inputStream(filename.c_str(), std::ios::in | std::ios::binary);
+
+    char magic[sizeof(binaryProjectMagic)];
+    inputStream.read(magic, sizeof(magic));
+
+    return (true == inputStream.good()) && (0 == memcmp(magic, binaryProjectMagic, sizeof(magic)));
+}//isBinaryProject
+
+bool BinaryProjectReader::open(const std::string &filename, std::string &error)
+{
+    int fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        error = "can't open " + filename;
+        return false;
+    }//if
+
+    struct stat fileStat;
+    if (0 != fstat(fileDescriptor, &fileStat)) {
+        close(fileDescriptor);
+        error = "can't read " + filename;
+        return false;
+    }//if
+
+    if (fileStat.st_size < (off_t)fileHeaderSize) {
+        close(fileDescriptor);
+        error = filename + " is too short to be a project";
+        return false;
+    }//if
+
+    fileSize = fileStat.st_size;
+    void *mappedData = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+
+    if (MAP_FAILED == mappedData) {
+        error = "can't map " + filename;
+        return false;
+    }//if
+
+    size_t mappedSize = fileSize;
+    //KeyframePrefetcher locks the pages of the keys it brings in; they're all let go here
+    fileData.reset((const unsigned char *)mappedData, [mappedSize](const unsigned char *data) {
+        munlock((void *)data, mappedSize);
+        munmap((void *)data, mappedSize);
+    });
+
+    if (0 != memcmp(fileData.get(), binaryProjectMagic, sizeof(binaryProjectMagic))) {
+        error = filename + " isn't a binary project";
+        return false;
+    }//if
+
+    BinaryIArchive header(context, fileData.get(), fileSize);
+    header.seek(sizeof(binaryProjectMagic));
+    formatVersion = header.loadFixed32();
+    projectVersion = header.loadFixed32();
+    unsigned int numChunks = header.loadFixed32();
+
+    if ((0 == formatVersion) || (formatVersion > binaryProjectFormatVersion)) {
+        error = filename + " was written by a newer version of FMidiAutomation";
+        return false;
+    }//if
+
+    size_t offset = fileHeaderSize;
+    for (unsigned int chunk = 0; chunk < numChunks; ++chunk) {
+        if (fileSize - offset < chunkHeaderSize) {
+            error = filename + " is truncated";
+            return false;
+        }//if
+
+        std::string tag((const char *)fileData.get() + offset, 4);
+
+        header.seek(offset + 8);
+        unsigned long long payloadSize = header.loadFixed64();
+        offset += chunkHeaderSize;
+
+        if (payloadSize > fileSize - offset) {
+            error = filename + " is truncated";
+            return false;
+        }//if
+
+        chunks[tag] = std::make_pair(offset, (size_t)payloadSize);
+
+        offset += payloadSize;
+        offset = std::min(fileSize, offset + (size_t)((8 - (payloadSize % 8)) % 8));
+    }//for
+
+    std::shared_ptr<BinaryIArchive> stringArchive = getChunk("STRS");
+    if (stringArchive == nullptr) {
+        error = filename + " has no string table";
+        return false;
+    }//if
+
+    unsigned long long numStrings = stringArchive->loadVarint();
+    for (unsigned long long stringIndex = 0; (stringIndex < numStrings) && (false == stringArchive->hasFailed()); ++stringIndex) {
+        unsigned long long length = stringArchive->loadVarint();
+        size_t position = stringArchive->getPosition();
+        stringArchive->seek(position + length);
+
+        if (false == stringArchive->hasFailed()) {
+            context.strings.push_back(std::string((const char *)fileData.get() + chunks["STRS"].first + position, length));
+        }//if
+    }//for
+
+    if (true == stringArchive->hasFailed()) {
+        error = filename + " has a corrupt string table";
+        return false;
+    }//if
+
+    return true;
+}//open
+
+std::shared_ptr<BinaryIArchive> BinaryProjectReader::getChunk(const std::string &tag)
+{
+    auto chunkIter = chunks.find(tag);
+    if (chunkIter == chunks.end()) {
+        return std::shared_ptr<BinaryIArchive>();
+    }//if
+
+    return std::shared_ptr<BinaryIArchive>(new BinaryIArchive(context, fileData.get() + chunkIter->second.first, chunkIter->second.second));
+}//getChunk
+
+bool BinaryProjectReader::readCurve(BinaryIArchive &keysArchive, std::shared_ptr<Animation> curve, unsigned long long numKeys,
+                                    bool lastTickStored, int lastTick, bool packed)
+{
+    keysArchive.alignTo(8);
+
+    //Left packed in the mapping until something needs them; every key takes at least a byte
+    if (true == packed) {
+        unsigned long long packedSize = keysArchive.loadVarint();
+        if ((packedSize > keysArchive.getSize() - keysArchive.getPosition()) || (numKeys > packedSize) || (false == lastTickStored)) {
+            keysArchive.setFailed();
+            return false;
+        }//if
+
+        std::shared_ptr<MappedKeyframes> mappedKeyframes(new MappedKeyframes);
+        mappedKeyframes->mapping = fileData;
+        mappedKeyframes->numKeys = numKeys;
+        mappedKeyframes->packedKeys = keysArchive.getData() + keysArchive.getPosition();
+        mappedKeyframes->packedSize = packedSize;
+        mappedKeyframes->lastTickStored = true;
+        mappedKeyframes->lastTick = lastTick;
+
+        curve->setMappedKeyframes(mappedKeyframes);
+        keysArchive.seek(keysArchive.getPosition() + packedSize);
+
+        return true;
+    }//if
+
+    //Only the bounds are checked here; nothing in the keys themselves can send a read outside the file
+    if (numKeys > (keysArchive.getSize() - keysArchive.getPosition()) / keyframeBytes) {
+        keysArchive.setFailed();
+        return false;
+    }//if
+
+    if (0 == numKeys) {
+        return true;
+    }//if
+
+    if (true == hostIsLittleEndian) {
+        const unsigned char *keys = keysArchive.getData() + keysArchive.getPosition();
+
+        std::shared_ptr<MappedKeyframes> mappedKeyframes(new MappedKeyframes);
+        mappedKeyframes->mapping = fileData;
+        mappedKeyframes->numKeys = numKeys;
+        mappedKeyframes->values = (const double *)keys;
+        mappedKeyframes->inTangents = mappedKeyframes->values + numKeys;
+        mappedKeyframes->outTangents = mappedKeyframes->inTangents + numKeys * 2;
+        mappedKeyframes->ticks = (const int *)(mappedKeyframes->outTangents + numKeys * 2);
+        mappedKeyframes->curveTypes = (const unsigned char *)(mappedKeyframes->ticks + numKeys);
+        mappedKeyframes->lastTickStored = lastTickStored;
+        mappedKeyframes->lastTick = lastTick;
+
+        curve->setMappedKeyframes(mappedKeyframes);
+        keysArchive.seek(keysArchive.getPosition() + numKeys * keyframeBytes);
+
+        return true;
+    }//if
+
+    std::vector<double> values(numKeys);
+    std::vector<double> inTangents(numKeys * 2);
+    std::vector<double> outTangents(numKeys * 2);
+
+    keysArchive.loadDoubles(values.data(), values.size());
+    keysArchive.loadDoubles(inTangents.data(), inTangents.size());
+    keysArchive.loadDoubles(outTangents.data(), outTangents.size());
+
+    std::vector<int> ticks(numKeys);
+    for (unsigned long long key = 0; key < numKeys; ++key) {
+        ticks[key] = (int)keysArchive.loadFixed32();
+    }//for
+
+    for (unsigned long long key = 0; (key < numKeys) && (false == keysArchive.hasFailed()); ++key) {
+        std::shared_ptr<Keyframe> keyframe = std::make_shared<Keyframe>();
+        keyframe->tick = ticks[key];
+        keyframe->value = values[key];
+        keyframe->inTangent[0] = inTangents[key * 2];
+        keyframe->inTangent[1] = inTangents[key * 2 + 1];
+        keyframe->outTangent[0] = outTangents[key * 2];
+        keyframe->outTangent[1] = outTangents[key * 2 + 1];
+        keyframe->curveType = (CurveType)keysArchive.loadByte();
+
+        curve->keyframes.insert(curve->keyframes.end(), std::make_pair(keyframe->tick, keyframe));
+    }//for
+
+    return (false == keysArchive.hasFailed());
+}//readCurve
+
+bool BinaryProjectReader::readDeltaCurve(BinaryIArchive &keysArchive, std::shared_ptr<Animation> curve, unsigned long long numKeys)
+{
+    if (numKeys > (keysArchive.getSize() - keysArchive.getPosition()) / minDeltaKeyframeBytes) {
+        keysArchive.setFailed();
+        return false;
+    }//if
+
+    std::vector<double> values(numKeys);
+    std::vector<double> inTangents(numKeys * 2);
+    std::vector<double> outTangents(numKeys * 2);
+
+    keysArchive.loadDoubles(values.data(), values.size());
+    keysArchive.loadDoubles(inTangents.data(), inTangents.size());
+    keysArchive.loadDoubles(outTangents.data(), outTangents.size());
+
+    std::vector<unsigned char> curveTypes(numKeys);
+    for (unsigned long long key = 0; key < numKeys; ++key) {
+        curveTypes[key] = keysArchive.loadByte();
+        if (curveTypes[key] > (unsigned char)CurveType::Bezier) {
+            keysArchive.setFailed();
+        }//if
+    }//for
+
+    long long tick = 0;
+    for (unsigned long long key = 0; (key < numKeys) && (false == keysArchive.hasFailed()); ++key) {
+        tick += keysArchive.loadZigzag();
+
+        std::shared_ptr<Keyframe> keyframe = std::make_shared<Keyframe>();
+        keyframe->tick = (int)tick;
+        keyframe->value = values[key];
+        keyframe->inTangent[0] = inTangents[key * 2];
+        keyframe->inTangent[1] = inTangents[key * 2 + 1];
+        keyframe->outTangent[0] = outTangents[key * 2];
+        keyframe->outTangent[1] = outTangents[key * 2 + 1];
+        keyframe->curveType = (CurveType)curveTypes[key];
+
+        //Written in tick order, so each one goes on the end
+        curve->keyframes.insert(curve->keyframes.end(), std::make_pair(keyframe->tick, keyframe));
+    }//for
+
+    return (false == keysArchive.hasFailed());
+}//readDeltaCurve
+
+bool BinaryProjectReader::loadProject(std::string &error)
+{
+    Globals &globals = Globals::Instance();
+    std::shared_ptr<Sequencer> sequencer = globals.projectData.getSequencer();
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    std::shared_ptr<BinaryIArchive> jackArchive = getChunk("JACK");
+    std::shared_ptr<BinaryIArchive> tempoArchive = getChunk("TMPO");
+    std::shared_ptr<BinaryIArchive> entryArchive = getChunk("ENTR");
+    std::shared_ptr<BinaryIArchive> keysArchive = getChunk("KEYS");
+
+    if ((jackArchive == nullptr) || (tempoArchive == nullptr) || (entryArchive == nullptr) || (keysArchive == nullptr)) {
+        error = "the project is missing part of its data";
+        return false;
+    }//if
+
+    //Ports first, so the entries can find theirs by name
+    jackSingleton.doLoad(*jackArchive, projectVersion);
+    if (true == jackArchive->hasFailed()) {
+        error = "the jack settings are corrupt";
+        return false;
+    }//if
+
+    tempoArchive->load(globals.projectData.tempoChanges);
+    if (true == tempoArchive->hasFailed()) {
+        error = "the tempo map is corrupt";
+        return false;
+    }//if
+
+    //ENTR is a stream of varints, so it's read in order; that's the cheap part.  The blocks and their keys
+    // are then built entry by entry on as many threads as there are cores, and everything that touches
+    // shared state (ports, the sequencer, the indices instances refer to) is done after, in file order.
+    std::vector<EntryRecord> entryRecords;
+
+    unsigned long long numEntries = entryArchive->loadVarint();
+    for (unsigned long long entryIndex = 0; (entryIndex < numEntries) && (false == entryArchive->hasFailed()); ++entryIndex) {
+        entryRecords.push_back(EntryRecord());
+        EntryRecord &entryRecord = entryRecords.back();
+
+        entryRecord.entry.reset(new SequencerEntry);
+        entryArchive->load(*entryRecord.entry->getImpl());
+
+        entryArchive->load(entryRecord.inputPortNames);
+        entryArchive->load(entryRecord.outputPortNames);
+
+        unsigned long long numEntryBlocks = entryArchive->loadVarint();
+        for (unsigned long long entryBlockIndex = 0; (entryBlockIndex < numEntryBlocks) && (false == entryArchive->hasFailed()); ++entryBlockIndex) {
+            EntryBlockRecord entryBlockRecord;
+            entryBlockRecord.startTick = (int)entryArchive->loadZigzag();
+            entryArchive->load(entryBlockRecord.title);
+            entryBlockRecord.instanceOfIndex = entryArchive->loadVarint();
+            entryBlockRecord.flags = entryArchive->loadByte();
+            entryBlockRecord.keysOffset = entryArchive->loadVarint();
+            entryBlockRecord.numCurveKeys = entryArchive->loadVarint();
+            entryBlockRecord.numSecondaryCurveKeys = entryArchive->loadVarint();
+
+            entryBlockRecord.lastTicksStored = (formatVersion >= 3);
+            if (true == entryBlockRecord.lastTicksStored) {
+                entryBlockRecord.curveLastTick = (int)entryArchive->loadZigzag();
+                entryBlockRecord.secondaryCurveLastTick = (int)entryArchive->loadZigzag();
+            }//if
+
+            entryRecord.entryBlockRecords.push_back(entryBlockRecord);
+        }//for
+    }//for
+
+    if (true == entryArchive->hasFailed()) {
+        error = "the entries are corrupt";
+        return false;
+    }//if
+
+    std::atomic<size_t> nextEntry(0);
+    std::atomic<bool> keysFailed(false);
+    auto worker = [&]() {
+        //Each thread reads KEYS through its own archive, since an archive has a position
+        std::shared_ptr<BinaryIArchive> threadKeysArchive = getChunk("KEYS");
+
+        for (size_t index = nextEntry++; (index < entryRecords.size()) && (false == keysFailed); index = nextEntry++) {
+            EntryRecord &entryRecord = entryRecords[index];
+
+            for (const EntryBlockRecord &entryBlockRecord : entryRecord.entryBlockRecords) {
+                std::shared_ptr<SequencerEntryBlock> entryBlock(new SequencerEntryBlock(entryRecord.entry, entryBlockRecord.startTick,
+                                                                                        std::shared_ptr<SequencerEntryBlock>()));
+                entryBlock->title = entryBlockRecord.title;
+
+                threadKeysArchive->seek(entryBlockRecord.keysOffset);
+
+                bool keysRead = false;
+                if (1 == formatVersion) {
+                    keysRead = (true == readDeltaCurve(*threadKeysArchive, entryBlock->curve, entryBlockRecord.numCurveKeys)) &&
+                               (true == readDeltaCurve(*threadKeysArchive, entryBlock->secondaryCurve, entryBlockRecord.numSecondaryCurveKeys));
+                } else {
+                    bool packsCurves = (formatVersion >= 4);
+                    keysRead = (true == readCurve(*threadKeysArchive, entryBlock->curve, entryBlockRecord.numCurveKeys,
+                                                  entryBlockRecord.lastTicksStored, entryBlockRecord.curveLastTick,
+                                                  (true == packsCurves) && (0 != (entryBlockRecord.flags & CurveIsPacked)))) &&
+                               (true == readCurve(*threadKeysArchive, entryBlock->secondaryCurve, entryBlockRecord.numSecondaryCurveKeys,
+                                                  entryBlockRecord.lastTicksStored, entryBlockRecord.secondaryCurveLastTick,
+                                                  (true == packsCurves) && (0 != (entryBlockRecord.flags & SecondaryCurveIsPacked))));
+                }//if
+
+                if (false == keysRead) {
+                    keysFailed = true;
+                    break;
+                }//if
+
+                entryRecord.entryBlocks.push_back(entryBlock);
+            }//foreach
+        }//for
+    };
+
+    unsigned int numThreads = std::max(1U, std::min((unsigned int)entryRecords.size(), std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (unsigned int index = 1; index < numThreads; ++index) {
+        threads.push_back(std::thread(worker));
+    }//for
+
+    worker();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }//foreach
+
+    if (true == keysFailed) {
+        error = "the keyframes are corrupt";
+        return false;
+    }//if
+
+    std::vector<std::pair<std::shared_ptr<SequencerEntryBlock>, std::pair<unsigned long long, unsigned char> > > instances;
+    std::vector<std::pair<int, std::shared_ptr<const MappedKeyframes> > > mappedCurves;
+
+    for (EntryRecord &entryRecord : entryRecords) {
+        std::shared_ptr<SequencerEntry> entry = entryRecord.entry;
+
+        std::set<jack_port_t *> inputPorts;
+        std::set<jack_port_t *> outputPorts;
+
+        for (const std::string &portName : entryRecord.inputPortNames) {
+            inputPorts.insert(jackSingleton.getInputPort(portName));
+        }//foreach
+
+        for (const std::string &portName : entryRecord.outputPortNames) {
+            outputPorts.insert(jackSingleton.getOutputPort(portName));
+        }//foreach
+
+        entry->setInputPorts(inputPorts);
+        entry->setOutputPorts(outputPorts);
+
+        for (size_t entryBlockIndex = 0; entryBlockIndex < entryRecord.entryBlocks.size(); ++entryBlockIndex) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryRecord.entryBlocks[entryBlockIndex];
+            const EntryBlockRecord &entryBlockRecord = entryRecord.entryBlockRecords[entryBlockIndex];
+
+            if (0 != entryBlockRecord.instanceOfIndex) {
+                instances.push_back(std::make_pair(entryBlock, std::make_pair(entryBlockRecord.instanceOfIndex, entryBlockRecord.flags)));
+            }//if
+
+            for (std::shared_ptr<Animation> curve : { entryBlock->curve, entryBlock->secondaryCurve }) {
+                if (true == curve->keyframesMapped) {
+                    mappedCurves.push_back(std::make_pair(entryBlock->startTick, curve->mappedKeyframes));
+                }//if
+            }//foreach
+
+            entry->addEntryBlock(entryBlock);
+            context.addEntryBlock(entryBlock);
+        }//for
+
+        sequencer->addEntry(entry);
+        context.addEntry(entry);
+    }//foreach
+
+    for (auto instanceIter : instances) {
+        std::shared_ptr<SequencerEntryBlock> entryBlock = instanceIter.first;
+        unsigned long long instanceOfIndex = instanceIter.second.first;
+        unsigned char flags = instanceIter.second.second;
+
+        if (instanceOfIndex > context.entryBlocks.size()) {
+            error = "an instance refers to a block that isn't there";
+            return false;
+        }//if
+
+        std::shared_ptr<SequencerEntryBlock> instanceOf = context.entryBlocks[instanceOfIndex - 1];
+        entryBlock->instanceOf = instanceOf;
+
+        if (0 != (flags & CurveIsInstance)) {
+            entryBlock->curve->instanceOf = instanceOf->curve;
+        }//if
+        if (0 != (flags & SecondaryCurveIsInstance)) {
+            entryBlock->secondaryCurve->instanceOf = instanceOf->secondaryCurve;
+        }//if
+    }//foreach
+
+    //The keys follow in the background, from the start of the song
+    std::stable_sort(mappedCurves.begin(), mappedCurves.end(),
+                        [](const std::pair<int, std::shared_ptr<const MappedKeyframes> > &first,
+                           const std::pair<int, std::shared_ptr<const MappedKeyframes> > &second) { return first.first < second.first; });
+
+    std::vector<std::shared_ptr<const MappedKeyframes> > prefetchCurves;
+    prefetchCurves.reserve(mappedCurves.size());
+    for (auto mappedCurve : mappedCurves) {
+        prefetchCurves.push_back(mappedCurve.second);
+    }//foreach
+
+    KeyframePrefetcher::Instance().start(prefetchCurves);
+
+    return true;
+}//loadProject
+
+unsigned int BinaryProjectReader::getProjectVersion() const
+{
+    return projectVersion;
+}//getProjectVersion
+
+BinaryIArchive *BinaryProjectReader::getWindowChunk()
+{
+    if (windowArchive == nullptr) {
+        windowArchive = getChunk("WIND");
+    }//if
+
+    return windowArchive.get();
+}//getWindowChunk
+
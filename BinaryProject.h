@@ -0,0 +1,106 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __BINARYPROJECT_H
+#define __BINARYPROJECT_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BinaryArchive.h"
+
+class Animation;
+struct SaveProgress;
+
+//The binary (.fmab) project file.  Same content as the XML .fma, laid out for loading speed:
+//
+//  header   "FMAB", format version, project version (what FMidiAutomationVersion would be), chunk count
+//  chunks   4 byte tag, 4 reserved, 8 byte payload size, payload padded to 8 bytes
+//
+//  STRS  string table: titles and port names, referenced by index everywhere else
+//  JACK  JackSingleton::doSave through a BinaryOArchive
+//  TMPO  the tempo map
+//  ENTR  entries, and for each of their blocks the start tick, title, instance, where its keys are in KEYS
+//        and the tick of each curve's last key, so the blocks can be drawn before any keys are read
+//  KEYS  per block and curve, each curve 8 byte aligned: values, in tangents, out tangents as little-endian
+//        doubles, ticks as little-endian 32 bit ints, then curve types as bytes.  Or, when the block's flags in
+//        ENTR say so, a varint size and the keys packed by KeyframeCodec, for curves that halve that way at least
+//  WIND  editor window state (WindowManager::doSave), absent from files the engine writes
+//
+//All integers in the header and chunk table are little-endian.  Unknown chunks are skipped.
+//
+//Every payload starts 8 byte aligned in the file, so the reader maps it and leaves each curve's keys where
+// they are (see MappedKeyframes) until the curve is edited.  Opening costs the entries and blocks, not the keys.
+// KeyframePrefetcher then brings the keys in behind the open, unpacking the packed ones.  Format 1 files stored
+// the ticks as zigzag deltas and are still read, copying the keys in up front; format 2 files have no last key
+// ticks in ENTR; format 3 files pack nothing.
+//
+//Since a loaded project can still be reading from its file, saving writes a new file and renames it over
+// the old one (writeFileAtomically) rather than rewriting it in place.
+const unsigned int binaryProjectFormatVersion = 4;
+
+class BinaryProjectWriter
+{
+    BinaryProjectContext context;
+    std::vector<std::pair<std::string, std::shared_ptr<BinaryOArchive> > > chunks;
+    unsigned int projectVersion;
+
+    BinaryOArchive &addChunk(const std::string &tag);
+    unsigned int getNumStoredKeys(std::shared_ptr<Animation> curve);
+    int getLastStoredKeyTick(std::shared_ptr<Animation> curve);
+    bool writeCurve(BinaryOArchive &keysArchive, std::shared_ptr<Animation> curve); //true if it went in packed
+
+public:
+    BinaryProjectWriter();
+    ~BinaryProjectWriter();
+
+    void addProject(unsigned int projectVersion); //Globals' project data and the jack settings
+    BinaryOArchive &addWindowChunk();
+
+    //Everything it writes was copied in by addProject and addWindowChunk, so this can run on another thread
+    bool save(const std::string &filename, std::string &error, SaveProgress *progress = nullptr);
+};//BinaryProjectWriter
+
+class BinaryProjectReader
+{
+    BinaryProjectContext context;
+    std::shared_ptr<const unsigned char> fileData; //the mapped file
+    size_t fileSize;
+    std::map<std::string, std::pair<size_t, size_t> > chunks; //tag -> offset, size
+    std::shared_ptr<BinaryIArchive> windowArchive;
+    unsigned int formatVersion;
+    unsigned int projectVersion;
+
+    std::shared_ptr<BinaryIArchive> getChunk(const std::string &tag);
+    bool readCurve(BinaryIArchive &keysArchive, std::shared_ptr<Animation> curve, unsigned long long numKeys, bool lastTickStored, int lastTick,
+                   bool packed);
+    bool readDeltaCurve(BinaryIArchive &keysArchive, std::shared_ptr<Animation> curve, unsigned long long numKeys);
+
+public:
+    BinaryProjectReader();
+    ~BinaryProjectReader();
+
+    static bool isBinaryProject(const std::string &filename);
+
+    //Maps the file and checks the header and chunk table; nothing is touched yet, so a bad file can be
+    // turned away before the current project is thrown out
+    bool open(const std::string &filename, std::string &error);
+
+    //Into a freshly reset Globals and the JackSingleton.  Entries' blocks and keys are built on a thread per
+    // core; ports, instance links and the sequencer are filled in afterwards on the calling thread.
+    bool loadProject(std::string &error);
+
+    unsigned int getProjectVersion() const;
+    BinaryIArchive *getWindowChunk(); //nullptr when the file has no editor state
+};//BinaryProjectReader
+
+
+#endif
+
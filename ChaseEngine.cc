@@ -0,0 +1,342 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "ChaseEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Tempo.h"
+#include "Globals.h"
+
+namespace
+{
+
+bool chaseValueLess(const ChaseValue &a, const ChaseValue &b)
+{
+    if (a.port != b.port) {
+        return a.port < b.port;
+    }//if
+
+    if (a.channel != b.channel) {
+        return a.channel < b.channel;
+    }//if
+
+    return a.msb < b.msb;
+}//chaseValueLess
+
+}//anonymous namespace
+
+ChaseEngine::ChaseEngine()
+{
+    std::shared_ptr<ChaseTiming> initialTiming(new ChaseTiming);
+    initialTiming->loopEnabled = false;
+    initialTiming->loopStartTick = 0;
+    initialTiming->loopEndTick = 0;
+
+    currentTiming = initialTiming;
+    timing.store(initialTiming.get());
+    activeSamplers.store(0);
+}//constructor
+
+ChaseEngine::~ChaseEngine()
+{
+    //Nothing
+}//destructor
+
+ChaseValue ChaseEngine::makeLane(SequencerEntry &entry, jack_port_t *port)
+{
+    std::shared_ptr<SequencerEntryImpl> impl = entry.getImpl();
+
+    ChaseValue chaseValue;
+    chaseValue.port = port;
+    chaseValue.channel = impl->channel;
+    chaseValue.msb = impl->msb;
+    chaseValue.lsb = impl->lsb;
+    chaseValue.controllerType = impl->controllerType;
+    chaseValue.fourteenBit = (false == impl->sevenBit);
+    chaseValue.fineOnLsb = impl->useBothMSBandLSB;
+    chaseValue.value = 0;
+    chaseValue.deadband = impl->outputDeadband;
+
+    return chaseValue;
+}//makeLane
+
+std::shared_ptr<ChaseSnapshot> ChaseEngine::buildSnapshot(double tick)
+{
+    std::shared_ptr<ChaseSnapshot> snapshot(new ChaseSnapshot);
+    snapshot->tick = (int)std::floor(tick);
+
+    sampleValues(tick, snapshot->values, nullptr, false);
+
+    std::stable_sort(snapshot->values.begin(), snapshot->values.end(), chaseValueLess);
+
+    return snapshot;
+}//buildSnapshot
+
+void ChaseEngine::sampleInto(double tick, std::vector<ChaseValue> &values, const std::set<jack_port_t *> *onlyPorts)
+{
+    sampleValues(tick, values, onlyPorts, true);
+}//sampleInto
+
+void ChaseEngine::sampleValues(double tick, std::vector<ChaseValue> &values, const std::set<jack_port_t *> *onlyPorts, bool residentOnly)
+{
+    Globals &globals = Globals::Instance();
+
+    //Counted in before the timing is loaded, so a writer that sees no samplers knows nobody has the old one
+    activeSamplers.fetch_add(1);
+    const ChaseTiming *curTiming = timing.load();
+
+    values.clear();
+
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        const std::vector<jack_port_t *> &entryPorts = entry->getOutputPortList();
+
+        if (onlyPorts != nullptr) {
+            bool playsHere = false;
+            for (jack_port_t *port : entryPorts) {
+                if (onlyPorts->find(port) != onlyPorts->end()) {
+                    playsHere = true;
+                    break;
+                }//if
+            }//foreach
+
+            if (false == playsHere) {
+                continue;
+            }//if
+        }//if
+
+        //Keys that aren't in yet are left to the prefetcher; the port holds what it was last sent until they are
+        auto sampleEntry = [&](double sampleTick, unsigned short &value) -> bool {
+            if (false == residentOnly) {
+                value = entry->sampleOutputValue(sampleTick);
+                return true;
+            }//if
+
+            unsigned int outputValue = 0;
+            if (false == entry->sampleResidentOutputValue(sampleTick, outputValue)) {
+                return false;
+            }//if
+
+            value = outputValue;
+            return true;
+        };
+
+        ChaseValue chaseValue = makeLane(*entry, nullptr);
+        if (false == sampleEntry(tick, chaseValue.value)) {
+            continue;
+        }//if
+
+        unsigned short transportValue = chaseValue.value;
+
+        for (jack_port_t *port : entryPorts) {
+            if ((onlyPorts != nullptr) && (onlyPorts->find(port) == onlyPorts->end())) {
+                continue;
+            }//if
+
+            chaseValue.port = port;
+            chaseValue.value = transportValue;
+
+            //Ports feeding slower gear get what the transport will be at once their latency has passed
+            auto offsetIter = curTiming->portOffsetTicks.find(port);
+            if ((offsetIter != curTiming->portOffsetTicks.end()) && (offsetIter->second > 0)) {
+                double portTick = tick + offsetIter->second;
+
+                int loopLength = curTiming->loopEndTick - curTiming->loopStartTick;
+                if ((true == curTiming->loopEnabled) && (loopLength > 0) && (tick < curTiming->loopEndTick) && (portTick >= curTiming->loopEndTick)) {
+                    portTick = curTiming->loopStartTick + std::fmod(portTick - curTiming->loopEndTick, (double)loopLength);
+                }//if
+
+                if (false == sampleEntry(portTick, chaseValue.value)) {
+                    continue;
+                }//if
+            }//if
+
+            values.push_back(chaseValue);
+        }//foreach
+    }//foreach
+
+    activeSamplers.fetch_sub(1, std::memory_order_release);
+}//sampleInto
+
+std::shared_ptr<ChaseSnapshot> ChaseEngine::getSnapshot(int tick)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto cueIter = cuePoints.find(tick);
+        if (cueIter != cuePoints.end()) {
+            return cueIter->second;
+        }//if
+    }
+
+    return buildSnapshot(tick);
+}//getSnapshot
+
+void ChaseEngine::prepareCuePoint(int tick)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (cuePoints.find(tick) != cuePoints.end()) {
+            return;
+        }//if
+    }
+
+    std::shared_ptr<ChaseSnapshot> snapshot = buildSnapshot(tick);
+    std::vector<std::shared_ptr<ChaseSnapshot> > evicted; //freed once the lock is let go
+    std::vector<std::shared_ptr<const ChaseTiming> > freedTimings;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    collectRetiredTimings(freedTimings);
+
+    //Make room by dropping whichever cue point is farthest from where the user is now working; tick 0 always stays
+    while (cuePoints.size() >= maxCuePoints) {
+        auto farthestIter = cuePoints.end();
+        for (auto cueIter = cuePoints.begin(); cueIter != cuePoints.end(); ++cueIter) {
+            if (0 == cueIter->first) {
+                continue;
+            }//if
+
+            if ((farthestIter == cuePoints.end()) || (std::abs(cueIter->first - tick) > std::abs(farthestIter->first - tick))) {
+                farthestIter = cueIter;
+            }//if
+        }//for
+
+        if (farthestIter == cuePoints.end()) {
+            break;
+        }//if
+
+        evicted.push_back(farthestIter->second);
+        cuePoints.erase(farthestIter);
+    }//while
+
+    cuePoints[tick] = snapshot;
+}//prepareCuePoint
+
+void ChaseEngine::prepareBarCuePoints(int fromTick, unsigned int numBars)
+{
+    Globals &globals = Globals::Instance();
+
+    prepareCuePoint(0);
+
+    auto tempoChanges = globals.projectData.getTempoChanges();
+    if (tempoChanges.first == tempoChanges.second) {
+        return;
+    }//if
+
+    auto tempoMarker = globals.projectData.getTempoChangesLowerBound(fromTick);
+    if ((tempoMarker == tempoChanges.second) || ((tempoMarker->first > fromTick) && (tempoMarker != tempoChanges.first))) {
+        --tempoMarker;
+    }//if
+
+    unsigned int barsPrepared = 0;
+    while ((tempoMarker != tempoChanges.second) && (barsPrepared < numBars)) {
+        auto nextTempoMarker = tempoMarker;
+        ++nextTempoMarker;
+
+        int nextStartTick = std::numeric_limits<int>::max();
+        if (nextTempoMarker != tempoChanges.second) {
+            nextStartTick = nextTempoMarker->first;
+        }//if
+
+        float ticksPerBar = tempoMarker->second->ticksPerBar;
+        if (ticksPerBar < 1.0f) {
+            break;
+        }//if
+
+        int bar = 0;
+        if (fromTick > tempoMarker->first) {
+            bar = (int)((fromTick - tempoMarker->first) / ticksPerBar);
+        }//if
+
+        for (/*nothing*/; barsPrepared < numBars; ++bar) {
+            int barTick = tempoMarker->first + (int)(bar * ticksPerBar);
+            if (barTick >= nextStartTick) {
+                break;
+            }//if
+
+            prepareCuePoint(barTick);
+            barsPrepared++;
+        }//for
+
+        tempoMarker = nextTempoMarker;
+    }//while
+}//prepareBarCuePoints
+
+void ChaseEngine::invalidateCuePoints()
+{
+    //The snapshots are freed after the lock is let go, so getSnapshot never waits on that
+    std::map<int, std::shared_ptr<ChaseSnapshot> > oldCuePoints;
+    std::vector<std::shared_ptr<const ChaseTiming> > freedTimings;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cuePoints.swap(oldCuePoints);
+
+    //Timings a busy process callback kept from being freed at the swap
+    collectRetiredTimings(freedTimings);
+}//invalidateCuePoints
+
+void ChaseEngine::setTiming(std::shared_ptr<const ChaseTiming> newTiming)
+{
+    std::map<int, std::shared_ptr<ChaseSnapshot> > oldCuePoints;
+    std::vector<std::shared_ptr<const ChaseTiming> > freedTimings;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    retiredTimings.push_back(currentTiming);
+    currentTiming = newTiming;
+    timing.store(newTiming.get());
+
+    collectRetiredTimings(freedTimings);
+
+    //Every prepared snapshot was sampled with the old timing
+    cuePoints.swap(oldCuePoints);
+}//setTiming
+
+void ChaseEngine::collectRetiredTimings(std::vector<std::shared_ptr<const ChaseTiming> > &freed)
+{
+    if ((true == retiredTimings.empty()) || (activeSamplers.load() != 0)) {
+        return;
+    }//if
+
+    freed.swap(retiredTimings);
+}//collectRetiredTimings
+
+void ChaseEngine::setPortOffsets(const std::map<jack_port_t *, double> &portOffsetTicks)
+{
+    std::shared_ptr<ChaseTiming> newTiming;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        newTiming.reset(new ChaseTiming(*currentTiming));
+    }
+
+    newTiming->portOffsetTicks = portOffsetTicks;
+    setTiming(newTiming);
+}//setPortOffsets
+
+void ChaseEngine::setLoopRange(bool enabled, int startTick, int endTick)
+{
+    std::shared_ptr<ChaseTiming> newTiming;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ((currentTiming->loopEnabled == enabled) && (currentTiming->loopStartTick == startTick) && (currentTiming->loopEndTick == endTick)) {
+            return;
+        }//if
+
+        newTiming.reset(new ChaseTiming(*currentTiming));
+    }
+
+    newTiming->loopEnabled = enabled;
+    newTiming->loopStartTick = startTick;
+    newTiming->loopEndTick = endTick;
+    setTiming(newTiming);
+}//setLoopRange
+
@@ -0,0 +1,97 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __CHASEENGINE_H
+#define __CHASEENGINE_H
+
+#include <jack/jack.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+enum class ControlType : char;
+class SequencerEntry;
+
+struct ChaseValue
+{
+    jack_port_t *port;
+    unsigned char channel;
+    unsigned char msb;
+    unsigned char lsb; //the parameter's LSB for RPN/NRPN; for CC, only used with fineOnLsb
+    ControlType controllerType;
+    bool fourteenBit;
+    bool fineOnLsb; //14 bit CC sends its fine value on controller lsb rather than msb + 32
+    unsigned short value; //0-127, or 0-16383 for 14 bit lanes
+    unsigned char deadband;
+};//ChaseValue
+
+//Every lane's value at a given tick, sorted by port so the process callback can pace each port's run
+struct ChaseSnapshot
+{
+    int tick;
+    std::vector<ChaseValue> values;
+};//ChaseSnapshot
+
+//Where each output port should be sampled relative to the transport
+struct ChaseTiming
+{
+    std::map<jack_port_t *, double> portOffsetTicks; //latency compensation; ports sample this far ahead
+    bool loopEnabled;
+    int loopStartTick;
+    int loopEndTick;
+};//ChaseTiming
+
+//Builds chase snapshots off the RT thread.  Snapshots for bar-aligned cue points can be built ahead of
+// time so a locate only has to hand over a pointer.
+class ChaseEngine
+{
+    std::mutex mutex; //for cuePoints and the writers of timing; the process callbacks never take it
+    std::map<int, std::shared_ptr<ChaseSnapshot> > cuePoints;
+    std::atomic<const ChaseTiming *> timing;
+    std::shared_ptr<const ChaseTiming> currentTiming; //owns timing
+
+    //Timings that were replaced while something was sampling.  They're only freed by a writer that then sees
+    // no sampler in flight, since a sampler that starts after the swap can't pick them up; so the process
+    // callbacks never free one, however close together the swaps come.
+    std::vector<std::shared_ptr<const ChaseTiming> > retiredTimings;
+    std::atomic<unsigned int> activeSamplers;
+
+    void setTiming(std::shared_ptr<const ChaseTiming> newTiming);
+    void collectRetiredTimings(std::vector<std::shared_ptr<const ChaseTiming> > &freed); //with mutex held
+    void sampleValues(double tick, std::vector<ChaseValue> &values, const std::set<jack_port_t *> *onlyPorts, bool residentOnly);
+
+    static const unsigned int maxCuePoints = 64; //past this, the one farthest from a new cue point makes way for it
+
+public:
+    ChaseEngine();
+    ~ChaseEngine();
+
+    //The lane an entry plays on a port, with its value left at 0
+    static ChaseValue makeLane(SequencerEntry &entry, jack_port_t *port);
+
+    std::shared_ptr<ChaseSnapshot> buildSnapshot(double tick);
+    //For the process callbacks.  Unsorted; doesn't allocate once values has grown.  With onlyPorts, entries that don't
+    // play on any of those ports aren't sampled at all.  Curves whose keys aren't in memory yet are skipped, never
+    // unpacked or faulted in here.
+    void sampleInto(double tick, std::vector<ChaseValue> &values, const std::set<jack_port_t *> *onlyPorts = nullptr);
+    std::shared_ptr<ChaseSnapshot> getSnapshot(int tick); //uses a prepared cue point if there is one
+
+    void prepareCuePoint(int tick);
+    void prepareBarCuePoints(int fromTick, unsigned int numBars);
+    void invalidateCuePoints(); //call whenever the project data changes
+
+    void setPortOffsets(const std::map<jack_port_t *, double> &portOffsetTicks);
+    void setLoopRange(bool enabled, int startTick, int endTick);
+};//ChaseEngine
+
+
+#endif
@@ -14,6 +14,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Animation.h"
 #include "Globals.h"
 #include "FMidiAutomationMainWindow.h"
+#include "ProjectJournal.h"
 
 
 //AddKeyframesCommand
@@ -86,6 +87,13 @@ void AddKeyframesCommand::undoAction()
     }//for
 }//undoAction
 
+void AddKeyframesCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto keyIter : keyframes) {
+        journal.touchKeys(currentlySelectedEntryBlock, keyIter.second->tick);
+    }//foreach
+}//addToJournal
+
 //DeleteKeyframesCommand
 DeleteKeyframesCommand::DeleteKeyframesCommand(std::shared_ptr<SequencerEntryBlock> entryBlock_, 
                                                 std::map<int, std::shared_ptr<Keyframe> > keyframes_,
@@ -116,6 +124,13 @@ void DeleteKeyframesCommand::undoAction()
     }//for
 }//undoAction
 
+void DeleteKeyframesCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto keyIter : keyframes) {
+        journal.touchKeys(entryBlock, keyIter.second->tick);
+    }//foreach
+}//addToJournal
+
 //MoveKeyframesCommand
 MoveKeyframesCommand::MoveKeyframesCommand(std::shared_ptr<SequencerEntryBlock> entryBlock_, 
                                             std::vector<std::shared_ptr<KeyInfo> > &keyframes_,
@@ -147,5 +162,14 @@ void MoveKeyframesCommand::undoAction()
     doAction();
 }//undoAction
 
+//Either way round, the tick it isn't at now is the one it was swapped with
+void MoveKeyframesCommand::addToJournal(ProjectJournal &journal)
+{
+    for (std::shared_ptr<KeyInfo> keyframe : keyframes) {
+        journal.touchKeys(entryBlock, keyframe->keyframe->tick);
+        journal.touchKeys(entryBlock, keyframe->movingKeyOrigTick);
+    }//foreach
+}//addToJournal
+
 
 
@@ -30,6 +30,7 @@ struct AddKeyframesCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<SequencerEntryBlock> currentlySelectedEntryBlock;
@@ -43,6 +44,7 @@ struct DeleteKeyframesCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<SequencerEntryBlock> entryBlock;
@@ -63,6 +65,7 @@ struct MoveKeyframesCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<SequencerEntryBlock> entryBlock;
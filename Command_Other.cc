@@ -16,6 +16,8 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Animation.h"
 #include "Globals.h"
 #include "FMidiAutomationMainWindow.h"
+#include "jack.h"
+#include "ProjectJournal.h"
 
 Command::Command(Glib::ustring commandStr_, FMidiAutomationMainWindow *window_, CommandFilter commandFilter_)
 {
@@ -24,6 +26,11 @@ Command::Command(Glib::ustring commandStr_, FMidiAutomationMainWindow *window_,
     commandFilter = commandFilter_;
 }//constructor
 
+void Command::addToJournal(ProjectJournal &journal)
+{
+    journal.touchProject();
+}//addToJournal
+
 CommandQueue::CommandQueue()
 {
     commandCount = 0;
@@ -205,6 +212,18 @@ void CommandManager::updateUndoRedoMenus()
     }//for
 }//updateUndoRedoMenus
 
+//One journal record per command, written before the next edit can start
+void CommandManager::journalCommand(std::shared_ptr<Command> command)
+{
+    ProjectJournal &journal = ProjectJournal::Instance();
+    if (false == journal.isActive()) {
+        return;
+    }//if
+
+    command->addToJournal(journal);
+    journal.commitRecord();
+}//journalCommand
+
 void CommandManager::doRedo(FMidiAutomationMainWindow *window)
 {
     std::shared_ptr<Command> nextCommand = redoStack.getNextCommand(window);
@@ -215,6 +234,8 @@ void CommandManager::doRedo(FMidiAutomationMainWindow *window)
 
     nextCommand->doAction();
     undoStack.addNewCommand(nextCommand);
+    journalCommand(nextCommand);
+    JackSingleton::Instance().invalidateChaseCuePoints();
 
     for (auto mapIter : undoMenuMap) {
         mapIter.first->queue_draw();
@@ -233,6 +254,8 @@ void CommandManager::doUndo(FMidiAutomationMainWindow *window)
 
     nextCommand->undoAction();
     redoStack.addNewCommand(nextCommand);
+    journalCommand(nextCommand);
+    JackSingleton::Instance().invalidateChaseCuePoints();
 
     for (auto mapIter : undoMenuMap) {
         mapIter.first->queue_draw();
@@ -251,6 +274,9 @@ void CommandManager::setNewCommand(std::shared_ptr<Command> command, bool applyC
         command->doAction();
     }//if
 
+    journalCommand(command);
+    JackSingleton::Instance().invalidateChaseCuePoints();
+
     titleStarFunc();
     updateUndoRedoMenus();
 
@@ -288,6 +314,11 @@ void UpdateTempoChangeCommand::undoAction()
     doAction();
 }//undoAction
 
+void UpdateTempoChangeCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchTempo();
+}//addToJournal
+
 //AddTempoChangeCommand
 AddTempoChangeCommand::AddTempoChangeCommand(std::shared_ptr<Tempo> tempo_, unsigned int tick_,
                                                 std::function<void (void)> updateTempoChangesUIData_, FMidiAutomationMainWindow *window) 
@@ -323,6 +354,11 @@ void AddTempoChangeCommand::undoAction()
     updateTempoChangesUIData();
 }//undoAction
 
+void AddTempoChangeCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchTempo();
+}//addToJournal
+
 //DeleteTempoChangeCommand
 DeleteTempoChangeCommand::DeleteTempoChangeCommand(unsigned int tick_,
                                                     std::function<void (void)> updateTempoChangesUIData_, FMidiAutomationMainWindow *window) 
@@ -358,6 +394,11 @@ void DeleteTempoChangeCommand::undoAction()
     updateTempoChangesUIData();
 }//undoAction
 
+void DeleteTempoChangeCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchTempo();
+}//addToJournal
+
 //ProcessRecordedMidiCommand
 ProcessRecordedMidiCommand::ProcessRecordedMidiCommand(decltype(Sequencer::entries) &origEntryMap_, decltype(Sequencer::entries) &newEntryMap_,
                                                         FMidiAutomationMainWindow *window) : Command("Process Recorded Midi", window, CommandFilter::BothMainWindowOnly)
@@ -400,5 +441,38 @@ void ProcessRecordedMidiCommand::undoAction()
     }//for
 }//undoAction
 
+void ProcessRecordedMidiCommand::addToJournal(ProjectJournal &journal)
+{
+    //The recorded entries are clones of the old ones; blocks the recording didn't change go as clones
+    for (auto entryIter : oldNewMap) {
+        journal.touchClonedEntry(entryIter.second, entryIter.first);
+    }//foreach
+
+    journal.touchEntryOrder();
+}//addToJournal
+
+//SetEngineClientsCommand
+SetEngineClientsCommand::SetEngineClientsCommand(unsigned int numClients, FMidiAutomationMainWindow *window)
+                                                    : Command("Set Engine Clients", window, CommandFilter::BothMainWindowOnly)
+{
+    newNumClients = numClients;
+    oldNumClients = JackSingleton::Instance().getEngineClients();
+}//constructor
+
+SetEngineClientsCommand::~SetEngineClientsCommand()
+{
+    //Nothing
+}//destructor
+
+void SetEngineClientsCommand::doAction()
+{
+    JackSingleton::Instance().setEngineClients(newNumClients);
+}//doAction
+
+void SetEngineClientsCommand::undoAction()
+{
+    JackSingleton::Instance().setEngineClients(oldNumClients);
+}//undoAction
+
 
 
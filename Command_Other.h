@@ -10,6 +10,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __COMMAND_OTHER_H
 #define __COMMAND_OTHER_H
 
+#include <gtkmm.h>
 #include <memory>
 #include <functional>
 #include <map>
@@ -18,6 +19,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 struct Tempo;
 class FMidiAutomationMainWindow;
+class ProjectJournal;
 enum class WindowMode : char;
 
 enum class CommandFilter : char
@@ -40,6 +42,10 @@ struct Command
 
     virtual void doAction() = 0;
     virtual void undoAction() = 0;
+
+    //Tells the journal what doAction or undoAction (whichever just ran) changed.  The default can't say,
+    // so the journal waits for its next snapshot.
+    virtual void addToJournal(ProjectJournal &journal);
 };//Command
 
 struct OrderedCommandPairComparator : public std::binary_function<std::pair<int, std::shared_ptr<Command>> &, 
@@ -80,6 +86,8 @@ class CommandManager
     std::map<FMidiAutomationMainWindow *, Gtk::ImageMenuItem *> redoMenuMap;
     std::function<void (void)> titleStarFunc;
 
+    void journalCommand(std::shared_ptr<Command> command);
+
 public:
     static CommandManager &Instance();
 
@@ -103,6 +111,7 @@ struct AddTempoChangeCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<Tempo> tempo;
@@ -117,6 +126,7 @@ struct DeleteTempoChangeCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<Tempo> tempo;
@@ -132,6 +142,7 @@ struct UpdateTempoChangeCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<Tempo> tempo;
@@ -149,6 +160,7 @@ struct ProcessRecordedMidiCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     decltype(Sequencer::entries) origEntryMap;
@@ -158,4 +170,17 @@ private:
     std::map<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntry>> newOldMap;
 };//ProcessRecordedMidiCommand
 
+struct SetEngineClientsCommand : public Command
+{
+    SetEngineClientsCommand(unsigned int numClients, FMidiAutomationMainWindow *window);
+    virtual ~SetEngineClientsCommand();
+
+    void doAction();
+    void undoAction();
+
+private:
+    unsigned int newNumClients;
+    unsigned int oldNumClients;
+};//SetEngineClientsCommand
+
 #endif
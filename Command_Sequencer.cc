@@ -16,6 +16,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "UI/SequencerEntryUI.h"
 #include "Globals.h"
 #include "FMidiAutomationMainWindow.h"
+#include "ProjectJournal.h"
 
 
 //AddSequencerEntryCommand
@@ -51,6 +52,11 @@ void AddSequencerEntryCommand::undoAction()
     window->getSequencer()->deleteEntry(entry);
 }//undoAction
 
+void AddSequencerEntryCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchEntryOrder();
+}//addToJournal
+
 //DeleteSequencerEntryCommand
 DeleteSequencerEntryCommand::DeleteSequencerEntryCommand(std::shared_ptr<SequencerEntryUI> entry_, FMidiAutomationMainWindow *window) 
                                                             : Command("Delete Sequencer Entry", window, CommandFilter::SequencerOnly)
@@ -80,6 +86,11 @@ void DeleteSequencerEntryCommand::undoAction()
     window->getSequencer()->addEntry(entryIndex, entry);
 }//undoAction
 
+void DeleteSequencerEntryCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchEntryOrder();
+}//addToJournal
+
 //SequencerEntryUpCommand
 SequencerEntryUpCommand::SequencerEntryUpCommand(std::shared_ptr<SequencerEntryUI> entry_, FMidiAutomationMainWindow *window) 
                                                         : Command("Sequencer Entry Up", window, CommandFilter::SequencerOnly)
@@ -105,6 +116,11 @@ void SequencerEntryUpCommand::undoAction()
     window->getSequencer()->addEntry(origIndex, entry);
 }//undoAction
 
+void SequencerEntryUpCommand::addToJournal(ProjectJournal &journal)
+{
+    //Only the lanes move; the project's own entry order is left as it was
+}//addToJournal
+
 //SequencerEntryDownCommand
 SequencerEntryDownCommand::SequencerEntryDownCommand(std::shared_ptr<SequencerEntryUI> entry_, FMidiAutomationMainWindow *window) 
                                                         : Command("Sequencer Entry Down", window, CommandFilter::SequencerOnly)
@@ -130,6 +146,11 @@ void SequencerEntryDownCommand::undoAction()
     window->getSequencer()->addEntry(origIndex, entry);
 }//undoAction
 
+void SequencerEntryDownCommand::addToJournal(ProjectJournal &journal)
+{
+    //Only the lanes move; the project's own entry order is left as it was
+}//addToJournal
+
 #if 0
 //AddSequencerEntryBlockCommand
 AddSequencerEntryBlockCommand::AddSequencerEntryBlockCommand(std::shared_ptr<SequencerEntryUI> entry_, std::shared_ptr<SequencerEntryBlock> entryBlock_,
@@ -189,6 +210,13 @@ void AddSequencerEntryBlocksCommand::undoAction()
     }//foreach
 }//undoAction
 
+void AddSequencerEntryBlocksCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto entryBlockIter : entryBlocks) {
+        journal.touchEntry(entryBlockIter.first->getBaseEntry());
+    }//foreach
+}//addToJournal
+
 #if 0
 //DeleteSequencerEntryBlockCommand
 DeleteSequencerEntryBlockCommand::DeleteSequencerEntryBlockCommand(std::shared_ptr<SequencerEntryBlockUI> entryBlock_, FMidiAutomationMainWindow *window) 
@@ -245,6 +273,13 @@ void DeleteSequencerEntryBlocksCommand::undoAction()
     }//for
 }//undoAction
 
+void DeleteSequencerEntryBlocksCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto entryBlock : entryBlocks) {
+        journal.touchEntry(entryBlock->getOwningEntry()->getBaseEntry());
+    }//foreach
+}//addToJournal
+
 //ChangeSequencerEntryBlockPropertiesCommand
 ChangeSequencerEntryBlockPropertiesCommand::ChangeSequencerEntryBlockPropertiesCommand(std::shared_ptr<SequencerEntryBlock> entryBlock_, Glib::ustring newTitle_,
                                                                                         FMidiAutomationMainWindow *window) : Command("Change Sequencer Entry Block Properties", window, CommandFilter::SequencerOnly)
@@ -270,6 +305,11 @@ void ChangeSequencerEntryBlockPropertiesCommand::undoAction()
     doAction();
 }//undoAction
 
+void ChangeSequencerEntryBlockPropertiesCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchEntry(entryBlock->getOwningEntry());
+}//addToJournal
+
 //MoveSequencerEntryBlockCommand
 MoveSequencerEntryBlockCommand::MoveSequencerEntryBlockCommand(
                                                                 std::multimap<int, std::shared_ptr<SequencerEntryBlockUI> > entryBlocks_,
@@ -319,6 +359,13 @@ void MoveSequencerEntryBlockCommand::undoAction()
     }//for
 }//undoAction
 
+void MoveSequencerEntryBlockCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto blockIter : entryBlocks) {
+        journal.touchEntry(blockIter.second->getBaseEntryBlock()->getOwningEntry());
+    }//foreach
+}//addToJournal
+
 //ChangeSequencerEntryPropertiesCommand
 ChangeSequencerEntryPropertiesCommand::ChangeSequencerEntryPropertiesCommand(std::shared_ptr<SequencerEntry> entry_, std::shared_ptr<SequencerEntryImpl> origImpl_,
                                                                                 std::shared_ptr<SequencerEntryImpl> newImpl_,
@@ -344,6 +391,11 @@ void ChangeSequencerEntryPropertiesCommand::ChangeSequencerEntryPropertiesComman
     entry->setNewDataImpl(origImpl);
 }//undoAction
 
+void ChangeSequencerEntryPropertiesCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchEntry(entry);
+}//addToJournal
+
 MergeSequencerEntryBlocksCommand::MergeSequencerEntryBlocksCommand(
                                         std::vector<std::shared_ptr<SequencerEntryBlockUI> > &origEntryBlocks_,
                                         std::vector<std::shared_ptr<SequencerEntryBlockUI> > &replacementEntryBlocks_,
@@ -387,6 +439,17 @@ void MergeSequencerEntryBlocksCommand::undoAction()
     }//foreach
 }//undoAction
 
+void MergeSequencerEntryBlocksCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto entryBlockIter : origEntryBlocks) {
+        journal.touchEntry(entryBlockIter->getOwningEntry()->getBaseEntry());
+    }//foreach
+
+    for (auto entryBlockIter : replacementEntryBlocks) {
+        journal.touchEntry(entryBlockIter->getOwningEntry()->getBaseEntry());
+    }//foreach
+}//addToJournal
+
 SplitSequencerEntryBlocksCommand::SplitSequencerEntryBlocksCommand(
                                         std::set<std::shared_ptr<SequencerEntryBlockUI> > &origEntryBlocks_,
                                         std::vector<std::shared_ptr<SequencerEntryBlockUI> > &replacementEntryBlocks_,
@@ -428,6 +491,89 @@ void SplitSequencerEntryBlocksCommand::undoAction()
     }//foreach
 }//undoAction
 
+void SplitSequencerEntryBlocksCommand::addToJournal(ProjectJournal &journal)
+{
+    for (auto entryBlockIter : origEntryBlocks) {
+        journal.touchEntry(entryBlockIter->getOwningEntry()->getBaseEntry());
+    }//foreach
 
+    for (auto entryBlockIter : replacementEntryBlocks) {
+        journal.touchEntry(entryBlockIter->getOwningEntry()->getBaseEntry());
+    }//foreach
+}//addToJournal
 
+//ImportSMFCommand
+ImportSMFCommand::ImportSMFCommand(std::vector<std::shared_ptr<SequencerEntry> > &newEntries_,
+                                    std::vector<std::pair<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntryBlock> > > &entryBlocks_,
+                                    FMidiAutomationMainWindow *window) : Command("Import MIDI File", window, CommandFilter::SequencerOnly)
+{
+    newEntries.swap(newEntries_);
+    entryBlocks.swap(entryBlocks_);
+}//constructor
+
+ImportSMFCommand::~ImportSMFCommand()
+{
+    //Nothing
+}//destructor
+
+void ImportSMFCommand::doAction()
+{
+    Globals &globals = Globals::Instance();
+
+    if (newEntryUIs.empty() == true) {
+        for (std::shared_ptr<SequencerEntry> newEntry : newEntries) {
+            globals.projectData.getSequencer()->addEntry(newEntry);
+            newEntryUIs.push_back(window->getSequencer()->addEntry(-1, true, newEntry));
+        }//foreach
+    } else {
+        for (std::shared_ptr<SequencerEntryUI> newEntryUI : newEntryUIs) {
+            globals.projectData.getSequencer()->addEntry(newEntryUI->getBaseEntry());
+            window->getSequencer()->addEntry(-1, newEntryUI);
+        }//foreach
+    }//if
+
+    //The block UIs can only be made once every entry has its UI
+    if (entryBlockUIs.empty() == true) {
+        std::map<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntryUI> > entryUIs;
+        for (auto entryUIIter : window->getSequencer()->getEntryPair()) {
+            entryUIs[entryUIIter.first->getBaseEntry()] = entryUIIter.first;
+        }//foreach
+
+        for (auto entryBlockIter : entryBlocks) {
+            std::shared_ptr<SequencerEntryUI> entryUI = entryUIs[entryBlockIter.first];
+            std::shared_ptr<SequencerEntryBlockUI> entryBlockUI(new SequencerEntryBlockUI(entryBlockIter.second, entryUI));
+            entryBlockUIs.push_back(std::make_pair(entryUI, entryBlockUI));
+        }//foreach
+    }//if
+
+    for (auto entryBlockIter : entryBlockUIs) {
+        entryBlockIter.first->getBaseEntry()->addEntryBlock(entryBlockIter.second->getBaseEntryBlock());
+        entryBlockIter.first->addEntryBlock(entryBlockIter.second);
+    }//foreach
+}//doAction
+
+void ImportSMFCommand::undoAction()
+{
+    Globals &globals = Globals::Instance();
+
+    for (auto entryBlockIter : entryBlockUIs) {
+        entryBlockIter.first->getBaseEntry()->removeEntryBlock(entryBlockIter.second->getBaseEntryBlock());
+        entryBlockIter.first->removeEntryBlock(entryBlockIter.second);
+    }//foreach
+
+    for (std::shared_ptr<SequencerEntryUI> newEntryUI : newEntryUIs) {
+        globals.projectData.getSequencer()->deleteEntry(newEntryUI->getBaseEntry());
+        window->getSequencer()->deleteEntry(newEntryUI);
+    }//foreach
+}//undoAction
+
+void ImportSMFCommand::addToJournal(ProjectJournal &journal)
+{
+    journal.touchEntryOrder();
+
+    //Existing entries can get blocks too; new ones go in whole anyway
+    for (auto entryBlockIter : entryBlocks) {
+        journal.touchEntry(entryBlockIter.first);
+    }//foreach
+}//addToJournal
 
@@ -10,6 +10,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __COMMAND_SEQUENCER_H
 #define __COMMAND_SEQUENCER_H
 
+#include <gtkmm.h>
 #include <memory>
 #include <functional>
 #include <stack>
@@ -30,6 +31,7 @@ struct ChangeSequencerEntryPropertiesCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:    
     std::shared_ptr<SequencerEntry> entry;
@@ -48,6 +50,7 @@ struct MoveSequencerEntryBlockCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::map<std::shared_ptr<SequencerEntryBlockUI>, int> entryOriginalStartTicks;
@@ -63,6 +66,7 @@ struct ChangeSequencerEntryBlockPropertiesCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:    
     std::shared_ptr<SequencerEntryBlock> entryBlock;
@@ -77,6 +81,7 @@ struct AddSequencerEntryBlocksCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::vector<std::pair<std::shared_ptr<SequencerEntryUI>, std::shared_ptr<SequencerEntryBlockUI>>> entryBlocks;
@@ -90,6 +95,7 @@ struct DeleteSequencerEntryBlocksCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private: 
     std::vector<std::shared_ptr<SequencerEntryBlockUI>> entryBlocks;
@@ -102,6 +108,7 @@ struct SequencerEntryUpCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<SequencerEntryUI> entry;
@@ -115,6 +122,7 @@ struct SequencerEntryDownCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private: 
     std::shared_ptr<SequencerEntryUI> entry;
@@ -128,6 +136,7 @@ struct AddSequencerEntryCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<SequencerEntryUI> entry;
@@ -141,6 +150,7 @@ struct DeleteSequencerEntryCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:
     std::shared_ptr<SequencerEntryUI> entry;
@@ -156,6 +166,7 @@ struct MergeSequencerEntryBlocksCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:    
     std::vector<std::shared_ptr<SequencerEntryBlockUI> > origEntryBlocks;
@@ -171,10 +182,30 @@ struct SplitSequencerEntryBlocksCommand : public Command
 
     void doAction();
     void undoAction();
+    void addToJournal(ProjectJournal &journal);
 
 private:    
     std::set<std::shared_ptr<SequencerEntryBlockUI> > origEntryBlocks;
     std::vector<std::shared_ptr<SequencerEntryBlockUI> > replacementEntryBlocks;
 };//SplitSequencerEntryBlocksCommand
 
+struct ImportSMFCommand : public Command
+{
+    //newEntries are added by the command; entryBlocks can be on those or on entries already in the project
+    ImportSMFCommand(std::vector<std::shared_ptr<SequencerEntry> > &newEntries,
+                        std::vector<std::pair<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntryBlock> > > &entryBlocks,
+                        FMidiAutomationMainWindow *window);
+    virtual ~ImportSMFCommand();
+
+    void doAction();
+    void undoAction();
+    void addToJournal(ProjectJournal &journal);
+
+private:
+    std::vector<std::shared_ptr<SequencerEntry> > newEntries;
+    std::vector<std::shared_ptr<SequencerEntryUI> > newEntryUIs;
+    std::vector<std::pair<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntryBlock> > > entryBlocks;
+    std::vector<std::pair<std::shared_ptr<SequencerEntryUI>, std::shared_ptr<SequencerEntryBlockUI> > > entryBlockUIs;
+};//ImportSMFCommand
+
 #endif
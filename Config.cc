@@ -3,7 +3,10 @@
 #include <dirent.h>
 #include <pwd.h>
 #include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#ifndef FMA_HEADLESS
 MRUFileLoadHelper::MRUFileLoadHelper(Glib::ustring &filename_, std::function<void (const Glib::ustring &)> &loadCallback_)
 {
     filename = filename_;
@@ -160,12 +163,13 @@ void MRUList::saveFileList()
         outputArchive & BOOST_SERIALIZATION_NVP(fileStrNarrow);
     }//foreach
 }//saveFileList
+#endif
 
 
 FMidiAutomationConfig::FMidiAutomationConfig()
 {
-    Glib::ustring baseDir = Glib::ustring(getpwuid(getuid())->pw_dir) + Glib::ustring("/.fmidiautomation");
-    std::string baseDirNarrow = Glib::locale_from_utf8(baseDir);
+    fmastring baseDir = fmastring(getpwuid(getuid())->pw_dir) + fmastring("/.fmidiautomation");
+    std::string baseDirNarrow = fmastring_to_locale(baseDir);
 
     DIR *pDir = opendir(baseDirNarrow.c_str());
     if (pDir != nullptr) {
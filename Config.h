@@ -7,9 +7,16 @@
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/access.hpp>
-#include <gtkmm.h>
 #include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#ifndef FMA_HEADLESS
+#include <gtkmm.h>
+#endif
+#include "fmastring.h"
 
+#ifndef FMA_HEADLESS
 class FMidiAutomationMainWindow;
 
 struct MRUFileLoadHelper
@@ -53,6 +60,7 @@ public:
     void unregisterTopMenu(FMidiAutomationMainWindow *window);
     void setLoadCallback(std::function<void (const Glib::ustring &)> loadCallback);
 };//MRUList
+#endif
 
 class FMidiAutomationConfig
 {
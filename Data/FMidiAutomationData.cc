@@ -8,18 +8,22 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 #include <fstream>
 #include "FMidiAutomationData.h"
-#include "FMidiAutomationMainWindow.h"
 #include "boost/serialization/map.hpp" 
+#ifndef FMA_HEADLESS
+#include "FMidiAutomationMainWindow.h"
 #include "GraphState.h"
+#endif
 #include "SerializationHelper.h"
+#include "BinaryArchive.h"
 #include "Tempo.h"
 #include "Sequencer.h"
 #include "fmaipair.h"
 
+#ifndef FMA_HEADLESS
 namespace
 {
 
-Glib::ustring readEntryGlade()
+fmastring readEntryGlade()
 {
     std::ifstream inputStream("FMidiAutomationEntry.glade");
     assert(inputStream.good());
@@ -27,7 +31,7 @@ Glib::ustring readEntryGlade()
         return "";
     }//if
 
-    Glib::ustring retString;
+    fmastring retString;
     std::string line;
     while (std::getline(inputStream,line)) {
         retString += line;
@@ -37,12 +41,15 @@ Glib::ustring readEntryGlade()
 }//readEntryGlade
 
 }//anonymous namespace
+#endif
 
 FMidiAutomationData::FMidiAutomationData()
 {
     sequencer.reset(new Sequencer);
     addTempoChange(0U, std::shared_ptr<Tempo>(new Tempo(12000, 4, 4)));
+#ifndef FMA_HEADLESS
     entryGlade = readEntryGlade();
+#endif
 }//constructor
 
 FMidiAutomationData::~FMidiAutomationData()
@@ -55,10 +62,12 @@ std::shared_ptr<Sequencer> FMidiAutomationData::getSequencer()
     return sequencer;
 }//getSequencer
 
-Glib::ustring &FMidiAutomationData::getEntryGlade()
+#ifndef FMA_HEADLESS
+fmastring &FMidiAutomationData::getEntryGlade()
 {
     return entryGlade;
 }//getEntryGlade
+#endif
 
 void FMidiAutomationData::addTempoChange(int tick, std::shared_ptr<Tempo> tempo)
 {
@@ -123,6 +132,7 @@ void FMidiAutomationData::doSave(boost::archive::xml_oarchive &outputArchive)
     sequencer->doSave(outputArchive);
 }//doSave
 
+#ifndef FMA_HEADLESS
 template<class Archive> 
 void GraphState::serialize(Archive &ar, const unsigned int version)
 {
@@ -164,6 +174,7 @@ template void GraphState::serialize<boost::archive::xml_oarchive>(boost::archive
 //template void FMidiAutomationData::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
 template void GraphState::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
 
-
-
+template void GraphState::serialize<BinaryOArchive>(BinaryOArchive &ar, const unsigned int version);
+template void GraphState::serialize<BinaryIArchive>(BinaryIArchive &ar, const unsigned int version);
+#endif
 
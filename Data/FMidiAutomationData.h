@@ -10,7 +10,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __FMIDIAUTOMATIONDATA_H
 #define __FMIDIAUTOMATIONDATA_H
 
-#include <gtkmm.h>
+#include <map>
 #include <memory>
 #include <vector>
 #include <boost/archive/xml_oarchive.hpp>
@@ -18,13 +18,16 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/access.hpp>
 #include "fmaipair.h"
+#include "fmastring.h"
 
 struct Tempo;
 class Sequencer;
 
 class FMidiAutomationData
 {
-    Glib::ustring entryGlade;
+#ifndef FMA_HEADLESS
+    fmastring entryGlade;
+#endif
     std::map<int, std::shared_ptr<Tempo> > tempoChanges; //int index is tick value (>= 0)
     std::shared_ptr<Sequencer> sequencer;
 
@@ -36,7 +39,9 @@ public:
 
     std::shared_ptr<Sequencer> getSequencer();
 
-    Glib::ustring &getEntryGlade();
+#ifndef FMA_HEADLESS
+    fmastring &getEntryGlade();
+#endif
 
     bool HasTempoChangeAtTick(int tick);
     void addTempoChange(int tick, std::shared_ptr<Tempo> tempo);
@@ -50,6 +55,10 @@ public:
     
     void doLoad(boost::archive::xml_iarchive &inputArchive);
     void doSave(boost::archive::xml_oarchive &outputArchive);
+
+    friend class BinaryProjectWriter;
+    friend class BinaryProjectReader;
+    friend class ProjectJournal;
 };//FMidiAutomationData
 
 BOOST_CLASS_VERSION(FMidiAutomationData, 1);
@@ -11,7 +11,6 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __SEQUENCER_H
 #define __SEQUENCER_H
 
-#include <gtkmm.h>
 #include <vector>
 #include <map>
 #include <memory>
@@ -55,6 +54,7 @@ public:
 //    void deserializeEntryMap(std::shared_ptr<VectorStreambuf> streambuf);
 
     friend struct ProcessRecordedMidiCommand;
+    friend class ProjectJournal;
 };//Sequencer
 
 
@@ -11,6 +11,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Animation.h"
 #include "jack.h"
 #include <iostream>
+#include <cmath>
 #include <boost/lambda/bind.hpp>
 #include <boost/lambda/lambda.hpp>
 #include <boost/lexical_cast.hpp>
@@ -21,6 +22,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include "SerializationHelper.h"
+#include "BinaryArchive.h"
 #include "../Globals.h"
 #include "../ProcessRecordedMidi.h"
 
@@ -147,6 +149,7 @@ SequencerEntryImpl::SequencerEntryImpl()
     maxValue = 127;
     sevenBit = true;
     useBothMSBandLSB = false; //implied true if sevenBit is true
+    outputDeadband = 0;
 
     recordMode = false;
     soloMode = false;
@@ -176,6 +179,7 @@ bool SequencerEntryImpl::operator==(SequencerEntryImpl &other)
     diff |= this->maxValue != other.maxValue;
     diff |= this->sevenBit != other.sevenBit;
     diff |= this->useBothMSBandLSB != other.useBothMSBandLSB;
+    diff |= this->outputDeadband != other.outputDeadband;
     diff |= this->channel != other.channel;
     diff |= this->title != other.title;
     diff |= this->recordMode != other.recordMode;
@@ -221,6 +225,7 @@ std::shared_ptr<SequencerEntry> SequencerEntry::deepClone()
 
     clone->inputPorts = inputPorts;
     clone->outputPorts = outputPorts;
+    clone->outputPortList = outputPortList;
 
     clone->recordTokenBuffer = recordTokenBuffer;
     //for (std::shared_ptr<MidiToken> token : recordTokenBuffer) {
@@ -341,6 +346,8 @@ void SequencerEntry::serialize(Archive &ar, const unsigned int version)
 //        std::cout << "OUT2: " << portStr << " - " << port << std::endl;
     }//foreach
 
+    outputPortList.assign(outputPorts.begin(), outputPorts.end());
+
 //    std::cout << "SE serialize: " << isFullBox << std::endl;
 }//serialize
 
@@ -356,11 +363,15 @@ void SequencerEntryImpl::serialize(Archive &ar, const unsigned int version)
     ar & BOOST_SERIALIZATION_NVP(sevenBit);
     ar & BOOST_SERIALIZATION_NVP(useBothMSBandLSB);
 
+    if (version >= 2) {
+        ar & BOOST_SERIALIZATION_NVP(outputDeadband);
+    }//if
+
     ar & BOOST_SERIALIZATION_NVP(recordMode);
     ar & BOOST_SERIALIZATION_NVP(soloMode);
     ar & BOOST_SERIALIZATION_NVP(muteMode);
 
-    std::string titleStr = Glib::locale_from_utf8(title);
+    std::string titleStr = fmastring_to_locale(title);
     ar & BOOST_SERIALIZATION_NVP(titleStr);
     title = titleStr;
 
@@ -394,6 +405,11 @@ std::set<jack_port_t *> SequencerEntry::getOutputPorts() const
     return outputPorts;
 }//getOutputPorts
 
+const std::vector<jack_port_t *> &SequencerEntry::getOutputPortList() const
+{
+    return outputPortList;
+}//getOutputPortList
+
 void SequencerEntry::setInputPorts(std::set<jack_port_t *> ports)
 {
     inputPorts = ports;
@@ -402,20 +418,32 @@ void SequencerEntry::setInputPorts(std::set<jack_port_t *> ports)
 void SequencerEntry::setOutputPorts(std::set<jack_port_t *> ports)
 {
     outputPorts = ports;
+    outputPortList.assign(outputPorts.begin(), outputPorts.end());
 }//setOutputPorts
 
 double SequencerEntry::sample(int tick)
 {
-    if (entryBlocks.empty() == true) {
-        return 0;
-    }//if
+    return sample((double)tick);
+}//sample
 
-    std::map<int, std::shared_ptr<SequencerEntryBlock> >::iterator entryBlockIter = entryBlocks.upper_bound(tick);
+//The block at or before tick, or the first one if tick's before them all
+std::shared_ptr<SequencerEntryBlock> SequencerEntry::getSampledEntryBlock(double tick)
+{
+    std::map<int, std::shared_ptr<SequencerEntryBlock> >::iterator entryBlockIter = entryBlocks.upper_bound((int)std::floor(tick));
     if (entryBlockIter != entryBlocks.begin()) {
         entryBlockIter--;
     }//if
 
-    double val = entryBlockIter->second->getCurve()->sample(tick);
+    return entryBlockIter->second;
+}//getSampledEntryBlock
+
+double SequencerEntry::sample(double tick)
+{
+    if (entryBlocks.empty() == true) {
+        return 0;
+    }//if
+
+    double val = getSampledEntryBlock(tick)->getCurve()->sample(tick);
 
     val = std::min(val, (double)impl->maxValue);
     val = std::max(val, (double)impl->minValue);
@@ -423,20 +451,52 @@ double SequencerEntry::sample(int tick)
     return val;
 }//sample
 
-unsigned char SequencerEntry::sampleChar(int tick)
+unsigned int SequencerEntry::sampleOutputValue(double tick)
+{
+    return toOutputValue(sample(tick));
+}//sampleOutputValue
+
+bool SequencerEntry::sampleResidentOutputValue(double tick, unsigned int &value)
 {
-    double value = sample(tick);
+    //As sample() does it
+    double sampledValue = 0;
+    if (entryBlocks.empty() == false) {
+        if (getSampledEntryBlock(tick)->getCurve()->sampleResident(tick, sampledValue) == false) {
+            return false;
+        }//if
+
+        sampledValue = std::min(sampledValue, (double)impl->maxValue);
+        sampledValue = std::max(sampledValue, (double)impl->minValue);
+    }//if
+
+    value = toOutputValue(sampledValue);
+    return true;
+}//sampleResidentOutputValue
+
+unsigned int SequencerEntry::toOutputValue(double value)
+{
+    if (impl->maxValue <= impl->minValue) {
+        return 0;
+    }//if
+
     value -= impl->minValue;
     value /= (double)(impl->maxValue - impl->minValue);
 
+    //Seven bit lanes keep the quantization they've always had (spread over 127.5 and truncated), so existing
+    // projects send what they always did; fourteen bit ones round to the nearest step
+    double maxOutputValue = 127.0;
     if (true == impl->sevenBit) {
-        value *= 127.0 + 0.5;
-    } else {        
-        value *= 255.0 + 0.5;
+        value *= 127.5;
+    } else {
+        maxOutputValue = 16383.0;
+        value = value * maxOutputValue + 0.5;
     }//if
 
-    return (unsigned char)value;
-}//sampleChar
+    value = std::min(value, maxOutputValue);
+    value = std::max(value, 0.0);
+
+    return (unsigned int)value;
+}//toOutputValue
 
 void SequencerEntry::clearRecordTokenBuffer()
 {
@@ -536,12 +596,12 @@ std::pair<std::shared_ptr<SequencerEntryBlock>, std::shared_ptr<SequencerEntryBl
     return std::make_pair(firstBlock, secondBlock);
 }//splitEntryBlock
 
-Glib::ustring SequencerEntry::getTitle() const
+fmastring SequencerEntry::getTitle() const
 {
     return impl->title;
 }//getTitle
 
-void SequencerEntry::setTitle(Glib::ustring title)
+void SequencerEntry::setTitle(fmastring title)
 {
     if (title.empty() == false) {
         impl->title = title;
@@ -750,3 +810,6 @@ template void SequencerEntryImpl::serialize<boost::archive::xml_oarchive>(boost:
 template void SequencerEntry::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
 template void SequencerEntryImpl::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
 
+template void SequencerEntryImpl::serialize<BinaryOArchive>(BinaryOArchive &ar, const unsigned int version);
+template void SequencerEntryImpl::serialize<BinaryIArchive>(BinaryIArchive &ar, const unsigned int version);
+
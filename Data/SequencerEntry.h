@@ -9,7 +9,6 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __SEQUENCERENTRY_H
 #define __SEQUENCERENTRY_H
 
-#include <gtkmm.h>
 #include <vector>
 #include <map>
 #include <set>
@@ -23,6 +22,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <jack/jack.h>
 #include "SequencerEntryBlock.h"
 #include "fmaipair.h"
+#include "fmastring.h"
 
 class Sequencer;
 class SequencerEntryBlock;
@@ -33,6 +33,7 @@ enum class ControlType : char
 {
     CC,
     RPN,
+    NRPN,
 };//ControlType
 
 enum class EntryBlockMergePolicy : char
@@ -56,11 +57,12 @@ struct SequencerEntryImpl
     unsigned char channel;
 
     //UI specific
-    Glib::ustring title;    
+    fmastring title;    
     int minValue;
     int maxValue;
     bool sevenBit;
     bool useBothMSBandLSB; //implied true if sevenBit is true
+    unsigned char outputDeadband; //changes this small or smaller (in 7 bit steps) are held back until the value settles
 
     bool recordMode;
     bool soloMode;
@@ -76,8 +78,12 @@ class SequencerEntry : public std::enable_shared_from_this<SequencerEntry>
     std::map<int, std::shared_ptr<SequencerEntryBlock> > entryBlocks;
     std::set<jack_port_t *> inputPorts;
     std::set<jack_port_t *> outputPorts;
+    std::vector<jack_port_t *> outputPortList; //outputPorts again, kept flat for the process callbacks
     std::vector<std::shared_ptr<MidiToken> > recordTokenBuffer;
 
+    std::shared_ptr<SequencerEntryBlock> getSampledEntryBlock(double tick);
+    unsigned int toOutputValue(double value);
+
     void mergeEntryBlockLists(std::shared_ptr<SequencerEntry> entry, std::deque<std::shared_ptr<SequencerEntryBlock> > &newEntryBlocks, 
                               EntryBlockMergePolicy mergePolicy);
 
@@ -89,7 +95,10 @@ public:
     ~SequencerEntry();
 
     double sample(int tick);
-    unsigned char sampleChar(int tick);
+    double sample(double tick);
+    unsigned int sampleOutputValue(double tick); //0-127, or 0-16383 when the entry isn't seven bit
+    //For the process callbacks: false, and value left alone, while the keys at tick are still on their way into memory
+    bool sampleResidentOutputValue(double tick, unsigned int &value);
 
     void setRecordMode(bool mode);
     void setSoloMode(bool mode);
@@ -110,6 +119,7 @@ public:
 
     std::set<jack_port_t *> getInputPorts() const;
     std::set<jack_port_t *> getOutputPorts() const;
+    const std::vector<jack_port_t *> &getOutputPortList() const; //no copy, so the RT thread can walk it
     void setInputPorts(std::set<jack_port_t *> ports);
     void setOutputPorts(std::set<jack_port_t *> ports);
 
@@ -117,8 +127,8 @@ public:
     void addRecordToken(std::shared_ptr<MidiToken> token);
     void commitRecordedTokens();
 
-    Glib::ustring getTitle() const;
-    void setTitle(Glib::ustring);
+    fmastring getTitle() const;
+    void setTitle(fmastring);
 
     std::shared_ptr<SequencerEntry> deepClone();
 
@@ -127,7 +137,7 @@ public:
 };//SequencerEntry
 
 
-BOOST_CLASS_VERSION(SequencerEntryImpl, 1);
+BOOST_CLASS_VERSION(SequencerEntryImpl, 2);
 BOOST_CLASS_VERSION(SequencerEntry, 1);
 
 
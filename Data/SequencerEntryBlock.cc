@@ -164,7 +164,7 @@ void SequencerEntryBlock::cloneCurves(std::shared_ptr<SequencerEntryBlock> entry
     secondaryCurve->absorbCurve(entryBlock->secondaryCurve);
 }//cloneCurves
 
-void SequencerEntryBlock::setTitle(const Glib::ustring &title_)
+void SequencerEntryBlock::setTitle(const fmastring &title_)
 {
     title = title_;
 }//setTitle
@@ -185,20 +185,14 @@ int SequencerEntryBlock::getDuration() const
         int duration = 0;
 
         if (curve != nullptr) {
-            int numKeys = curve->getNumKeyframes();
-            if (numKeys > 0) {
-                std::shared_ptr<Keyframe> lastKey = curve->getKeyframe(numKeys-1);
-
-                duration = std::max(duration, lastKey->tick);
+            if (curve->getNumKeyframes() > 0) {
+                duration = std::max(duration, curve->getLastKeyframeTick());
             }//if
         }//if
 
         if (secondaryCurve != nullptr) {
-            int numKeys = secondaryCurve->getNumKeyframes();
-            if (numKeys > 0) {
-                std::shared_ptr<Keyframe> lastKey = secondaryCurve->getKeyframe(numKeys-1);
-
-                duration = std::max(duration, lastKey->tick);
+            if (secondaryCurve->getNumKeyframes() > 0) {
+                duration = std::max(duration, secondaryCurve->getLastKeyframeTick());
             }//if
         }//if
 
@@ -208,7 +202,12 @@ int SequencerEntryBlock::getDuration() const
     }//if
 }//getDuration
 
-Glib::ustring SequencerEntryBlock::getTitle() const
+bool SequencerEntryBlock::areKeysResident() const
+{
+    return (true == curve->areKeysResident()) && (true == secondaryCurve->areKeysResident());
+}//areKeysResident
+
+fmastring SequencerEntryBlock::getTitle() const
 {
     return title;
 }//getTitle
@@ -241,7 +240,7 @@ void SequencerEntryBlock::serialize(Archive &ar, const unsigned int version)
     ar & BOOST_SERIALIZATION_NVP(instanceOf);
 //    ar & BOOST_SERIALIZATION_NVP(duration);
 
-    std::string titleStr = Glib::locale_from_utf8(title);
+    std::string titleStr = fmastring_to_locale(title);
     ar & BOOST_SERIALIZATION_NVP(titleStr);
     title = titleStr;
 
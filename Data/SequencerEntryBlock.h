@@ -9,13 +9,13 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __SEQUENCERENTRYBLOCK_H
 #define __SEQUENCERENTRYBLOCK_H
 
-#include <gtkmm.h>
 #include <memory>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/access.hpp>
 #include <tuple>
+#include "fmastring.h"
 
 
 struct GraphState;
@@ -28,7 +28,7 @@ struct Keyframe;
 class SequencerEntryBlock : public std::enable_shared_from_this<SequencerEntryBlock>
 {
     std::weak_ptr<SequencerEntry> owningEntry;
-    Glib::ustring title;
+    fmastring title;
     int startTick; //FIXME: Do we need this?
     std::shared_ptr<SequencerEntryBlock> instanceOf;
     std::shared_ptr<Animation> curve;
@@ -45,11 +45,12 @@ public:
     void cloneCurves(std::shared_ptr<SequencerEntryBlock> entryBlock);
 
     void moveBlock(int startTick);
-    void setTitle(const Glib::ustring &title);
+    void setTitle(const fmastring &title);
 
     int getStartTick() const;
     int getDuration() const;
-    Glib::ustring getTitle() const;
+    bool areKeysResident() const;
+    fmastring getTitle() const;
     std::shared_ptr<SequencerEntryBlock> getInstanceOf() const;
 
     std::shared_ptr<SequencerEntry> getOwningEntry() const;
@@ -67,6 +68,9 @@ public:
     template<class Archive> void serialize(Archive &ar, const unsigned int version);
     friend class boost::serialization::access;
     friend class SequencerEntry;
+    friend class BinaryProjectWriter;
+    friend class BinaryProjectReader;
+    friend class ProjectJournal;
 };//SequencerEntryBlock
 
 
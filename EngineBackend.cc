@@ -0,0 +1,149 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "EngineBackend.h"
+
+jack_client_t *JackEngineBackend::openClient(const std::string &clientName)
+{
+    return jack_client_open(clientName.c_str(), JackNullOption, nullptr);
+}//openClient
+
+void JackEngineBackend::closeClient(jack_client_t *client)
+{
+    jack_client_close(client);
+}//closeClient
+
+bool JackEngineBackend::activate(jack_client_t *client)
+{
+    return (jack_activate(client) == 0);
+}//activate
+
+void JackEngineBackend::setProcessCallback(jack_client_t *client, JackProcessCallback callback, void *arg)
+{
+    jack_set_process_callback(client, callback, arg);
+}//setProcessCallback
+
+void JackEngineBackend::setLatencyCallback(jack_client_t *client, JackLatencyCallback callback, void *arg)
+{
+    jack_set_latency_callback(client, callback, arg);
+}//setLatencyCallback
+
+void JackEngineBackend::setShutdownCallback(jack_client_t *client, JackShutdownCallback callback, void *arg)
+{
+    jack_on_shutdown(client, callback, arg);
+}//setShutdownCallback
+
+void JackEngineBackend::setXrunCallback(jack_client_t *client, JackXRunCallback callback, void *arg)
+{
+    jack_set_xrun_callback(client, callback, arg);
+}//setXrunCallback
+
+jack_nframes_t JackEngineBackend::getSampleRate(jack_client_t *client)
+{
+    return jack_get_sample_rate(client);
+}//getSampleRate
+
+jack_nframes_t JackEngineBackend::getBufferSize(jack_client_t *client)
+{
+    return jack_get_buffer_size(client);
+}//getBufferSize
+
+jack_port_t *JackEngineBackend::registerPort(jack_client_t *client, const std::string &portName, unsigned long flags)
+{
+    return jack_port_register(client, portName.c_str(), JACK_DEFAULT_MIDI_TYPE, flags, 0);
+}//registerPort
+
+void JackEngineBackend::unregisterPort(jack_client_t *client, jack_port_t *port)
+{
+    jack_port_unregister(client, port);
+}//unregisterPort
+
+std::string JackEngineBackend::getPortName(jack_port_t *port)
+{
+    return jack_port_name(port);
+}//getPortName
+
+std::vector<std::string> JackEngineBackend::getPortConnections(jack_client_t *client, jack_port_t *port)
+{
+    std::vector<std::string> connections;
+
+    const char **connectedPorts = jack_port_get_all_connections(client, port);
+    if (connectedPorts != nullptr) {
+        for (const char **connectedPort = connectedPorts; *connectedPort != nullptr; ++connectedPort) {
+            connections.push_back(*connectedPort);
+        }//for
+
+        jack_free(connectedPorts);
+    }//if
+
+    return connections;
+}//getPortConnections
+
+void JackEngineBackend::connectPorts(jack_client_t *client, const std::string &sourcePort, const std::string &destinationPort)
+{
+    jack_connect(client, sourcePort.c_str(), destinationPort.c_str());
+}//connectPorts
+
+jack_latency_range_t JackEngineBackend::getPortLatency(jack_port_t *port, jack_latency_callback_mode_t mode)
+{
+    jack_latency_range_t range;
+    jack_port_get_latency_range(port, mode, &range);
+    return range;
+}//getPortLatency
+
+void *JackEngineBackend::getPortBuffer(jack_port_t *port, jack_nframes_t nframes)
+{
+    return jack_port_get_buffer(port, nframes);
+}//getPortBuffer
+
+void JackEngineBackend::clearMidiBuffer(void *portBuffer)
+{
+    jack_midi_clear_buffer(portBuffer);
+}//clearMidiBuffer
+
+unsigned int JackEngineBackend::getMidiEventCount(void *portBuffer)
+{
+    return jack_midi_get_event_count(portBuffer);
+}//getMidiEventCount
+
+bool JackEngineBackend::getMidiEvent(void *portBuffer, unsigned int eventIndex, jack_midi_event_t &event)
+{
+    return (jack_midi_event_get(&event, portBuffer, eventIndex) == 0);
+}//getMidiEvent
+
+bool JackEngineBackend::writeMidiEvent(void *portBuffer, jack_nframes_t frame, const unsigned char *data, size_t size)
+{
+    return (jack_midi_event_write(portBuffer, frame, data, size) == 0);
+}//writeMidiEvent
+
+jack_nframes_t JackEngineBackend::getCycleStartFrame(jack_client_t *client)
+{
+    return jack_last_frame_time(client);
+}//getCycleStartFrame
+
+jack_transport_state_t JackEngineBackend::queryTransport(jack_client_t *client, jack_position_t &pos)
+{
+    return jack_transport_query(client, &pos);
+}//queryTransport
+
+void JackEngineBackend::locateTransport(jack_client_t *client, jack_nframes_t frame)
+{
+    jack_transport_locate(client, frame);
+}//locateTransport
+
+void JackEngineBackend::startTransport(jack_client_t *client)
+{
+    jack_transport_start(client);
+}//startTransport
+
+void JackEngineBackend::stopTransport(jack_client_t *client)
+{
+    jack_transport_stop(client);
+}//stopTransport
+
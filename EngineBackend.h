@@ -0,0 +1,97 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __ENGINEBACKEND_H
+#define __ENGINEBACKEND_H
+
+#include <jack/jack.h>
+#include <jack/transport.h>
+#include <jack/midiport.h>
+#include <string>
+#include <vector>
+
+//Every libjack call the engine makes goes through here, so the process path can be driven by something
+// other than a live server (see MockEngineBackend).  Clients and ports are still passed around as
+// jack_client_t / jack_port_t pointers; other backends hand out their own objects behind them.
+class EngineBackend
+{
+public:
+    virtual ~EngineBackend() {}
+
+    virtual jack_client_t *openClient(const std::string &clientName) = 0; //nullptr if there's no server
+    virtual void closeClient(jack_client_t *client) = 0;
+    virtual bool activate(jack_client_t *client) = 0;
+    virtual void setProcessCallback(jack_client_t *client, JackProcessCallback callback, void *arg) = 0;
+    virtual void setLatencyCallback(jack_client_t *client, JackLatencyCallback callback, void *arg) = 0;
+    virtual void setShutdownCallback(jack_client_t *client, JackShutdownCallback callback, void *arg) = 0;
+    virtual void setXrunCallback(jack_client_t *client, JackXRunCallback callback, void *arg) = 0;
+
+    virtual jack_nframes_t getSampleRate(jack_client_t *client) = 0;
+    virtual jack_nframes_t getBufferSize(jack_client_t *client) = 0;
+
+    //MIDI ports only
+    virtual jack_port_t *registerPort(jack_client_t *client, const std::string &portName, unsigned long flags) = 0;
+    virtual void unregisterPort(jack_client_t *client, jack_port_t *port) = 0;
+    virtual std::string getPortName(jack_port_t *port) = 0; //the full client:port name
+    virtual std::vector<std::string> getPortConnections(jack_client_t *client, jack_port_t *port) = 0;
+    virtual void connectPorts(jack_client_t *client, const std::string &sourcePort, const std::string &destinationPort) = 0;
+    virtual jack_latency_range_t getPortLatency(jack_port_t *port, jack_latency_callback_mode_t mode) = 0;
+
+    //Process callback only
+    virtual void *getPortBuffer(jack_port_t *port, jack_nframes_t nframes) = 0;
+    virtual void clearMidiBuffer(void *portBuffer) = 0;
+    virtual unsigned int getMidiEventCount(void *portBuffer) = 0;
+    virtual bool getMidiEvent(void *portBuffer, unsigned int eventIndex, jack_midi_event_t &event) = 0;
+    virtual bool writeMidiEvent(void *portBuffer, jack_nframes_t frame, const unsigned char *data, size_t size) = 0; //false if the buffer refused it
+    virtual jack_nframes_t getCycleStartFrame(jack_client_t *client) = 0; //the same for every client in a cycle
+
+    virtual jack_transport_state_t queryTransport(jack_client_t *client, jack_position_t &pos) = 0;
+    virtual void locateTransport(jack_client_t *client, jack_nframes_t frame) = 0;
+    virtual void startTransport(jack_client_t *client) = 0;
+    virtual void stopTransport(jack_client_t *client) = 0;
+};//EngineBackend
+
+//Straight through to libjack
+class JackEngineBackend : public EngineBackend
+{
+public:
+    virtual jack_client_t *openClient(const std::string &clientName);
+    virtual void closeClient(jack_client_t *client);
+    virtual bool activate(jack_client_t *client);
+    virtual void setProcessCallback(jack_client_t *client, JackProcessCallback callback, void *arg);
+    virtual void setLatencyCallback(jack_client_t *client, JackLatencyCallback callback, void *arg);
+    virtual void setShutdownCallback(jack_client_t *client, JackShutdownCallback callback, void *arg);
+    virtual void setXrunCallback(jack_client_t *client, JackXRunCallback callback, void *arg);
+
+    virtual jack_nframes_t getSampleRate(jack_client_t *client);
+    virtual jack_nframes_t getBufferSize(jack_client_t *client);
+
+    virtual jack_port_t *registerPort(jack_client_t *client, const std::string &portName, unsigned long flags);
+    virtual void unregisterPort(jack_client_t *client, jack_port_t *port);
+    virtual std::string getPortName(jack_port_t *port);
+    virtual std::vector<std::string> getPortConnections(jack_client_t *client, jack_port_t *port);
+    virtual void connectPorts(jack_client_t *client, const std::string &sourcePort, const std::string &destinationPort);
+    virtual jack_latency_range_t getPortLatency(jack_port_t *port, jack_latency_callback_mode_t mode);
+
+    virtual void *getPortBuffer(jack_port_t *port, jack_nframes_t nframes);
+    virtual void clearMidiBuffer(void *portBuffer);
+    virtual unsigned int getMidiEventCount(void *portBuffer);
+    virtual bool getMidiEvent(void *portBuffer, unsigned int eventIndex, jack_midi_event_t &event);
+    virtual bool writeMidiEvent(void *portBuffer, jack_nframes_t frame, const unsigned char *data, size_t size);
+    virtual jack_nframes_t getCycleStartFrame(jack_client_t *client);
+
+    virtual jack_transport_state_t queryTransport(jack_client_t *client, jack_position_t &pos);
+    virtual void locateTransport(jack_client_t *client, jack_nframes_t frame);
+    virtual void startTransport(jack_client_t *client);
+    virtual void stopTransport(jack_client_t *client);
+};//JackEngineBackend
+
+
+#endif
+
@@ -0,0 +1,98 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "EngineStatusDialog.h"
+#include "jack.h"
+#include <boost/lexical_cast.hpp>
+#include <cmath>
+
+namespace
+{
+
+const char *stageTitles[numTelemetryStages] = { "Transport", "Record", "Sampling", "Encode", "Write" };
+
+Glib::ustring formatMicros(double nanos)
+{
+    return boost::lexical_cast<Glib::ustring>(std::round(nanos / 100.0) / 10.0) + "us";
+}//formatMicros
+
+Glib::ustring formatPercent(double fraction)
+{
+    return boost::lexical_cast<Glib::ustring>(std::round(fraction * 1000.0) / 10.0) + "%";
+}//formatPercent
+
+Glib::ustring formatHistogram(const TelemetryHistogram &histogram)
+{
+    return "mean " + formatMicros(histogram.meanNanos()) + ", p50 " + formatMicros(histogram.percentileNanos(50.0)) +
+           ", p99 " + formatMicros(histogram.percentileNanos(99.0)) + ", max " + formatMicros(histogram.maxNanos);
+}//formatHistogram
+
+}//anonymous namespace
+
+EngineStatusDialog::EngineStatusDialog(Glib::RefPtr<Gtk::Builder> uiXml)
+{
+    Gtk::Dialog *dialog = nullptr;
+    uiXml->get_widget("engineStatusDialog", dialog);
+    uiXml->get_widget("engineStatusLabel", statusLabel);
+
+    refresh();
+    sigc::connection refreshConnection = Glib::signal_timeout().connect(sigc::mem_fun(*this, &EngineStatusDialog::refresh), 500);
+
+    //Reset keeps the dialog up
+    while (dialog->run() == 1) {
+        JackSingleton::Instance().resetTelemetry();
+    }//while
+
+    refreshConnection.disconnect();
+    dialog->hide();
+}//constructor
+
+EngineStatusDialog::~EngineStatusDialog()
+{
+    //Nothing
+}//destructor
+
+bool EngineStatusDialog::refresh()
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    TelemetryStats stats = jackSingleton.getTelemetry();
+
+    Glib::ustring text;
+    if (true == stats.serverShutdown) {
+        text += "The JACK server has shut down\n\n";
+    }//if
+
+    text += "Periods: " + boost::lexical_cast<Glib::ustring>(stats.periods) + "\n";
+    text += "Xruns: " + boost::lexical_cast<Glib::ustring>(stats.xruns) + "\n";
+    text += "DSP load: mean " + formatPercent(stats.load((unsigned long long)stats.callback.meanNanos())) + 
+            ", p99 " + formatPercent(stats.load(stats.callback.percentileNanos(99.0))) + 
+            ", max " + formatPercent(stats.load(stats.callback.maxNanos)) + "\n";
+    text += "Callback: " + formatHistogram(stats.callback) + "\n\n";
+
+    for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+        text += Glib::ustring(stageTitles[stage]) + ": " + formatHistogram(stats.stages[stage]) + "\n";
+    }//for
+
+    text += "\nEvents written: " + boost::lexical_cast<Glib::ustring>(stats.emittedEvents) + 
+            ", refused by full buffers: " + boost::lexical_cast<Glib::ustring>(stats.droppedEvents) + "\n";
+
+    std::map<std::string, unsigned int> portClients = jackSingleton.getOutputPortClients();
+    for (auto portStatsIter : jackSingleton.getOutputSchedulerStats()) {
+        const OutputSchedulerStats &portStats = portStatsIter.second;
+        text += portStatsIter.first + " (client " + boost::lexical_cast<Glib::ustring>(portClients[portStatsIter.first] + 1) + "): " + 
+                boost::lexical_cast<Glib::ustring>(portStats.sentMessages) + " sent, " + 
+                boost::lexical_cast<Glib::ustring>(portStats.droppedMessages) + " dropped, " + 
+                boost::lexical_cast<Glib::ustring>(portStats.deferredMessages) + " deferred\n";
+    }//foreach
+
+    statusLabel->set_text(text);
+
+    return true;
+}//refresh
+
@@ -0,0 +1,30 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __ENGINESTATUSDIALOG_H
+#define __ENGINESTATUSDIALOG_H
+
+#include <gtkmm.h>
+
+//Live view of the engine telemetry: DSP load, xruns, per stage timings and what each output port sent.
+// Refreshes itself while it's open; Reset starts the counts over.
+class EngineStatusDialog
+{
+    Gtk::Label *statusLabel;
+
+    bool refresh();
+
+public:
+    EngineStatusDialog(Glib::RefPtr<Gtk::Builder> uiXml);
+    ~EngineStatusDialog();
+};//EngineStatusDialog
+
+
+#endif
+
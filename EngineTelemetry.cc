@@ -0,0 +1,295 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "EngineTelemetry.h"
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+
+const unsigned int firstBucketShift = 8; //256ns
+const unsigned int bucketsPerDoubling = 4;
+
+const char *stageNames[numTelemetryStages] = { "transport", "record", "sampling", "encode", "write" };
+
+void atomicMax(std::atomic<unsigned long long> &value, unsigned long long candidate)
+{
+    //Single writer, so no compare and swap needed
+    if (candidate > value.load(std::memory_order_relaxed)) {
+        value.store(candidate, std::memory_order_relaxed);
+    }//if
+}//atomicMax
+
+void atomicAdd(std::atomic<unsigned long long> &value, unsigned long long amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}//atomicAdd
+
+}//anonymous namespace
+
+TelemetryHistogram::TelemetryHistogram()
+{
+    for (unsigned int bucket = 0; bucket < numBuckets; ++bucket) {
+        counts[bucket] = 0;
+    }//for
+
+    samples = 0;
+    totalNanos = 0;
+    maxNanos = 0;
+}//constructor
+
+unsigned int TelemetryHistogram::bucketFor(unsigned long long nanos)
+{
+    if (nanos < (1ULL << firstBucketShift)) {
+        return 0;
+    }//if
+
+    unsigned int topBit = 63 - __builtin_clzll(nanos);
+    unsigned int subBucket = (unsigned int)((nanos >> (topBit - 2)) & 3); //the two bits under the top one
+
+    unsigned int bucket = (topBit - firstBucketShift) * bucketsPerDoubling + subBucket;
+    return std::min(bucket, numBuckets - 1);
+}//bucketFor
+
+unsigned long long TelemetryHistogram::bucketUpperNanos(unsigned int bucket)
+{
+    unsigned int topBit = firstBucketShift + bucket / bucketsPerDoubling;
+    unsigned long long subBucket = bucket % bucketsPerDoubling;
+
+    return (1ULL << topBit) + ((subBucket + 1) << (topBit - 2));
+}//bucketUpperNanos
+
+void TelemetryHistogram::merge(const TelemetryHistogram &other)
+{
+    for (unsigned int bucket = 0; bucket < numBuckets; ++bucket) {
+        counts[bucket] += other.counts[bucket];
+    }//for
+
+    samples += other.samples;
+    totalNanos += other.totalNanos;
+    maxNanos = std::max(maxNanos, other.maxNanos);
+}//merge
+
+unsigned long long TelemetryHistogram::percentileNanos(double percentile) const
+{
+    if (0 == samples) {
+        return 0;
+    }//if
+
+    unsigned long long wanted = (unsigned long long)(samples * percentile / 100.0);
+    unsigned long long seen = 0;
+    for (unsigned int bucket = 0; bucket < numBuckets; ++bucket) {
+        seen += counts[bucket];
+        if (seen > wanted) {
+            return std::min(bucketUpperNanos(bucket), maxNanos);
+        }//if
+    }//for
+
+    return maxNanos;
+}//percentileNanos
+
+double TelemetryHistogram::meanNanos() const
+{
+    return (0 == samples) ? 0.0 : ((double)totalNanos / samples);
+}//meanNanos
+
+TelemetryStats::TelemetryStats()
+{
+    periods = 0;
+    xruns = 0;
+    serverShutdown = false;
+    periodNanos = 0;
+    emittedEvents = 0;
+    droppedEvents = 0;
+}//constructor
+
+void TelemetryStats::merge(const TelemetryStats &other)
+{
+    //The clients run the same periods, so the period count and length aren't summed
+    periods = std::max(periods, other.periods);
+    xruns += other.xruns;
+    serverShutdown = serverShutdown || other.serverShutdown;
+    periodNanos = std::max(periodNanos, other.periodNanos);
+    emittedEvents += other.emittedEvents;
+    droppedEvents += other.droppedEvents;
+
+    callback.merge(other.callback);
+    for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+        stages[stage].merge(other.stages[stage]);
+    }//for
+}//merge
+
+double TelemetryStats::load(unsigned long long nanos) const
+{
+    return (0 == periodNanos) ? 0.0 : ((double)nanos / periodNanos);
+}//load
+
+std::string TelemetryStats::format() const
+{
+    std::ostringstream outputStream;
+    outputStream.precision(3);
+
+    outputStream << "periods " << periods << " xruns " << xruns;
+    if (true == serverShutdown) {
+        outputStream << " shutdown";
+    }//if
+
+    outputStream << " load mean " << (load((unsigned long long)callback.meanNanos()) * 100.0) << "% p99 "
+                 << (load(callback.percentileNanos(99.0)) * 100.0) << "% max " << (load(callback.maxNanos) * 100.0) << "%";
+    outputStream << " events " << emittedEvents << " dropped " << droppedEvents;
+
+    outputStream << " callback mean " << (callback.meanNanos() / 1000.0) << "us p50 " << (callback.percentileNanos(50.0) / 1000.0)
+                 << "us p99 " << (callback.percentileNanos(99.0) / 1000.0) << "us max " << (callback.maxNanos / 1000.0) << "us";
+
+    for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+        outputStream << " " << stageNames[stage] << " mean " << (stages[stage].meanNanos() / 1000.0) << "us p99 "
+                     << (stages[stage].percentileNanos(99.0) / 1000.0) << "us max " << (stages[stage].maxNanos / 1000.0) << "us";
+    }//for
+
+    return outputStream.str();
+}//format
+
+void EngineTelemetry::AtomicHistogram::clear()
+{
+    for (unsigned int bucket = 0; bucket < TelemetryHistogram::numBuckets; ++bucket) {
+        counts[bucket].store(0, std::memory_order_relaxed);
+    }//for
+
+    samples.store(0, std::memory_order_relaxed);
+    totalNanos.store(0, std::memory_order_relaxed);
+    maxNanos.store(0, std::memory_order_relaxed);
+}//clear
+
+void EngineTelemetry::AtomicHistogram::add(unsigned long long nanos)
+{
+    atomicAdd(counts[TelemetryHistogram::bucketFor(nanos)], 1);
+    atomicAdd(samples, 1);
+    atomicAdd(totalNanos, nanos);
+    atomicMax(maxNanos, nanos);
+}//add
+
+void EngineTelemetry::AtomicHistogram::read(TelemetryHistogram &histogram) const
+{
+    for (unsigned int bucket = 0; bucket < TelemetryHistogram::numBuckets; ++bucket) {
+        histogram.counts[bucket] = counts[bucket].load(std::memory_order_relaxed);
+    }//for
+
+    histogram.samples = samples.load(std::memory_order_relaxed);
+    histogram.totalNanos = totalNanos.load(std::memory_order_relaxed);
+    histogram.maxNanos = maxNanos.load(std::memory_order_relaxed);
+}//read
+
+EngineTelemetry::EngineTelemetry()
+{
+    sequence.store(0);
+    resetRequested.store(false);
+    xruns.store(0);
+    serverShutdown.store(false);
+
+    clear();
+}//constructor
+
+EngineTelemetry::~EngineTelemetry()
+{
+    //Nothing
+}//destructor
+
+void EngineTelemetry::clear()
+{
+    periods.store(0, std::memory_order_relaxed);
+    periodNanos.store(0, std::memory_order_relaxed);
+    emittedEvents.store(0, std::memory_order_relaxed);
+    droppedEvents.store(0, std::memory_order_relaxed);
+
+    callback.clear();
+    for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+        stages[stage].clear();
+    }//for
+}//clear
+
+void EngineTelemetry::publish(const TelemetryPeriod &period, jack_nframes_t nframes, jack_nframes_t frameRate)
+{
+    unsigned long long endNanos = telemetryNanos();
+
+    unsigned int curSequence = sequence.load(std::memory_order_relaxed);
+    sequence.store(curSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (true == resetRequested.exchange(false, std::memory_order_acq_rel)) {
+        clear();
+    }//if
+
+    atomicAdd(periods, 1);
+    if (frameRate > 0) {
+        periodNanos.store((unsigned long long)nframes * 1000000000ULL / frameRate, std::memory_order_relaxed);
+    }//if
+
+    atomicAdd(emittedEvents, period.emittedEvents);
+    atomicAdd(droppedEvents, period.droppedEvents);
+
+    callback.add(endNanos - period.startNanos);
+    for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+        stages[stage].add(period.stageNanos[stage]);
+    }//for
+
+    sequence.store(curSequence + 2, std::memory_order_release);
+}//publish
+
+void EngineTelemetry::addXrun()
+{
+    xruns.fetch_add(1);
+}//addXrun
+
+void EngineTelemetry::setServerShutdown()
+{
+    serverShutdown.store(true);
+}//setServerShutdown
+
+TelemetryStats EngineTelemetry::read() const
+{
+    TelemetryStats stats;
+
+    while (true) {
+        unsigned int startSequence = sequence.load(std::memory_order_acquire);
+        if (0 != (startSequence & 1)) {
+            std::this_thread::yield();
+            continue;
+        }//if
+
+        stats.periods = periods.load(std::memory_order_relaxed);
+        stats.periodNanos = periodNanos.load(std::memory_order_relaxed);
+        stats.emittedEvents = emittedEvents.load(std::memory_order_relaxed);
+        stats.droppedEvents = droppedEvents.load(std::memory_order_relaxed);
+
+        callback.read(stats.callback);
+        for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+            stages[stage].read(stats.stages[stage]);
+        }//for
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == startSequence) {
+            break;
+        }//if
+    }//while
+
+    //Not part of a period, so not under the sequence
+    stats.xruns = xruns.load();
+    stats.serverShutdown = serverShutdown.load();
+
+    return stats;
+}//read
+
+void EngineTelemetry::reset()
+{
+    xruns.store(0);
+    resetRequested.store(true, std::memory_order_release);
+}//reset
+
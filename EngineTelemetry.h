@@ -0,0 +1,156 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __ENGINETELEMETRY_H
+#define __ENGINETELEMETRY_H
+
+#include <jack/jack.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+enum class TelemetryStage : char
+{
+    Transport, //transport query, loop wrap
+    Record,    //capturing input for record and thru
+    Sampling,  //chase snapshots, look-ahead or sampling the curves, offering to the schedulers
+    Encode,    //turning scheduled values into MIDI messages
+    Write,     //scheduler pacing and writing events to the port buffers
+    Count
+};//TelemetryStage
+
+const unsigned int numTelemetryStages = (unsigned int)TelemetryStage::Count;
+
+inline unsigned long long telemetryNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}//telemetryNanos
+
+//Log scale, four buckets per doubling from 256ns up; anything past the last bucket lands in it
+struct TelemetryHistogram
+{
+    static const unsigned int numBuckets = 80;
+
+    unsigned long long counts[numBuckets];
+    unsigned long long samples;
+    unsigned long long totalNanos;
+    unsigned long long maxNanos;
+
+    TelemetryHistogram();
+
+    static unsigned int bucketFor(unsigned long long nanos);
+    static unsigned long long bucketUpperNanos(unsigned int bucket);
+
+    void merge(const TelemetryHistogram &other);
+    unsigned long long percentileNanos(double percentile) const; //the upper edge of the bucket it falls in
+    double meanNanos() const;
+};//TelemetryHistogram
+
+//One consistent copy of everything below, summed over every engine client
+struct TelemetryStats
+{
+    unsigned long long periods;
+    unsigned long long xruns;
+    bool serverShutdown;
+    unsigned long long periodNanos; //how long the last period was, to turn callback time into load
+    unsigned long long emittedEvents;
+    unsigned long long droppedEvents;
+
+    TelemetryHistogram callback;
+    TelemetryHistogram stages[numTelemetryStages];
+
+    TelemetryStats();
+
+    void merge(const TelemetryStats &other);
+    double load(unsigned long long nanos) const; //fraction of a period
+    std::string format() const;
+};//TelemetryStats
+
+//Stack local to a process callback; marks split the callback into stages as it goes
+struct TelemetryPeriod
+{
+    unsigned long long startNanos;
+    unsigned long long lastNanos;
+    unsigned long long stageNanos[numTelemetryStages];
+    unsigned long long emittedEvents;
+    unsigned long long droppedEvents;
+
+    TelemetryPeriod()
+    {
+        startNanos = telemetryNanos();
+        lastNanos = startNanos;
+
+        for (unsigned int stage = 0; stage < numTelemetryStages; ++stage) {
+            stageNanos[stage] = 0;
+        }//for
+
+        emittedEvents = 0;
+        droppedEvents = 0;
+    }//constructor
+
+    //Everything since the last mark goes to this stage
+    void mark(TelemetryStage stage)
+    {
+        unsigned long long now = telemetryNanos();
+        stageNanos[(unsigned int)stage] += now - lastNanos;
+        lastNanos = now;
+    }//mark
+};//TelemetryPeriod
+
+//Per period timings for one engine client.  The process callback is the only writer and never blocks or
+// allocates; readers take a seqlock style copy, so they never hold it up either and retry on the rare
+// period that overlaps their read.
+class EngineTelemetry
+{
+    struct AtomicHistogram
+    {
+        std::atomic<unsigned long long> counts[TelemetryHistogram::numBuckets];
+        std::atomic<unsigned long long> samples;
+        std::atomic<unsigned long long> totalNanos;
+        std::atomic<unsigned long long> maxNanos;
+
+        void clear();
+        void add(unsigned long long nanos);
+        void read(TelemetryHistogram &histogram) const;
+    };//AtomicHistogram
+
+    std::atomic<unsigned int> sequence; //odd while the callback is publishing
+    std::atomic<bool> resetRequested;
+
+    std::atomic<unsigned long long> periods;
+    std::atomic<unsigned long long> xruns;
+    std::atomic<bool> serverShutdown;
+    std::atomic<unsigned long long> periodNanos;
+    std::atomic<unsigned long long> emittedEvents;
+    std::atomic<unsigned long long> droppedEvents;
+
+    AtomicHistogram callback;
+    AtomicHistogram stages[numTelemetryStages];
+
+    void clear();
+
+public:
+    EngineTelemetry();
+    ~EngineTelemetry();
+
+    //Process callback only
+    void publish(const TelemetryPeriod &period, jack_nframes_t nframes, jack_nframes_t frameRate);
+
+    //Any thread; these are just counters
+    void addXrun();
+    void setServerShutdown();
+
+    //Any thread
+    TelemetryStats read() const;
+    void reset(); //takes effect at the next period
+};//EngineTelemetry
+
+
+#endif
+
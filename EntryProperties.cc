@@ -47,6 +47,9 @@ EntryProperties::EntryProperties(Glib::RefPtr<Gtk::Builder> uiXml_, std::shared_
 
     sigc::connection lsbSpinnerChangedConnection = spinner->signal_value_changed().connect ( sigc::mem_fun(*this, &EntryProperties::lsbValueChanged) );
 
+    uiXml->get_widget("deadbandSpinButton", spinner);
+    spinner->set_value(origImpl->outputDeadband);
+
     Gtk::ComboBox *comboBox;
     uiXml->get_widget("channelComboBox", comboBox);
     int channel = (origImpl->channel+1) % 17;
@@ -60,6 +63,9 @@ EntryProperties::EntryProperties(Glib::RefPtr<Gtk::Builder> uiXml_, std::shared_
         case ControlType::RPN:
             comboBox->set_active(1);
             break;
+        case ControlType::NRPN:
+            comboBox->set_active(2);
+            break;
     }//switch
 
     Gtk::Button *button;
@@ -101,6 +107,9 @@ EntryProperties::EntryProperties(Glib::RefPtr<Gtk::Builder> uiXml_, std::shared_
         uiXml->get_widget("lsbSpinButton", spinner);
         newImpl->lsb = spinner->get_value();
 
+        uiXml->get_widget("deadbandSpinButton", spinner);
+        newImpl->outputDeadband = spinner->get_value();
+
         uiXml->get_widget("useSecondByteCheckButton", checkButton);
         newImpl->useBothMSBandLSB = checkButton->get_active();
 
@@ -118,6 +127,9 @@ EntryProperties::EntryProperties(Glib::RefPtr<Gtk::Builder> uiXml_, std::shared_
             case 1:
                 newImpl->controllerType = ControlType::RPN;
                 break;
+            case 2:
+                newImpl->controllerType = ControlType::NRPN;
+                break;
         }//switch
 
         if (*newImpl == *origImpl) {
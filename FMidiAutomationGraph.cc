@@ -681,10 +681,8 @@ void KeyframeSelectionState::SetCurrentlySelectedKeyframes(std::map<int, std::sh
 
 void Animation::render(Cairo::RefPtr<Cairo::Context> context, GraphState &graphState, unsigned int areaWidth, unsigned int areaHeight, std::shared_ptr<SequencerEntryBlockUI> entryBlock)
 {
-    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &keyframes;
-    if (instanceOf != nullptr) {
-        curKeyframes = &instanceOf->keyframes;
-    }//if
+    //The curve editor keeps where it drew each key for picking, so what it shows has to be editable
+    std::map<int, std::shared_ptr<Keyframe> > *curKeyframes = &getEditableKeyframes();
 
     if (curKeyframes->empty() == true) {
         return;
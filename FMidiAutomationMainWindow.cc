@@ -12,6 +12,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 //#include <libglademm.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include "FMidiAutomationMainWindow.h"
 #include "Data/FMidiAutomationData.h"
 #include "FMidiAutomationCurveEditor.h"
@@ -22,6 +23,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "jack.h"
 #include "Data/Sequencer.h"
 #include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
 #include "UI/SequencerUI.h"
 #include "UI/SequencerEntryUI.h"
 #include "EntryBlockProperties.h"
@@ -35,6 +37,15 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Tempo.h"
 #include "WindowManager.h"
 #include "Command_Other.h"
+#include "OfflineRenderer.h"
+#include "SMFImport.h"
+#include "EngineStatusDialog.h"
+#include "BinaryProject.h"
+#include "ProjectSaver.h"
+#include "ProjectFile.h"
+#include "ProjectJournal.h"
+#include "KeyframePrefetcher.h"
+#include <algorithm>
 
 
 namespace
@@ -55,75 +66,18 @@ std::shared_ptr<SequencerEntryBlockUI> findWrappingEntryBlockUI(std::shared_ptr<
 
 }//anonymous namespace
 
-std::shared_ptr<Globals> Globals::instance;
-std::recursive_mutex Globals::globalsMutex;
-
-Globals::Globals()
-{
-    versionStr = "FMidiAutomation - version 1.0.0 - October 2011";
-    topBarFontSize = 12;
-    topBarFont = "Arial";
-    bottomBarFontSize = 12;
-    bottomBarFont = "Arial";
-    darkTheme = true;
-};//constructor
-
-Globals::~Globals()
-{
-    //Nothing
-}//destructor
-
-Globals &Globals::Instance()
-{
-    std::lock_guard<std::recursive_mutex> lock(globalsMutex);
-
-    if (instance == nullptr) {
-        ResetInstance();
-    }//if
-
-    return *instance;
-}//Instance
-
-void Globals::ResetInstance()
-{
-    std::lock_guard<std::recursive_mutex> lock(globalsMutex);
-    instance.reset(new Globals());
-}//ResetInstance
-
-void Globals::doLoad(boost::archive::xml_iarchive &inputArchive)
-{
-    int globalsVersion = 1; 
-
-    inputArchive & BOOST_SERIALIZATION_NVP(globalsVersion);
-    projectData.doLoad(inputArchive);
-}//doLoad
-
-void Globals::doSave(boost::archive::xml_oarchive &outputArchive)
-{
-    int globalsVersion = 1;
-
-    outputArchive & BOOST_SERIALIZATION_NVP(globalsVersion);
-    projectData.doSave(outputArchive);
-}//doSave
-
-/*
-template<class Archive>
-void Globals::serialize(Archive &ar, const unsigned int version)
-{
-    ar & BOOST_SERIALIZATION_NVP(projectData);
-}//serialize
-
-
-template void Globals::serialize<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &ar, const unsigned int version);
-template void Globals::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
-*/
-
 FMidiAutomationMainWindow::FMidiAutomationMainWindow()
 {
     std::cout << "FMidiAutomationMainWindow::FMidiAutomationMainWindow()" << std::endl;
 
     lastHandledTime = 0;
     isExiting = false;
+    projectSaver.reset(new ProjectSaver);
+    lastSavePercent = 0;
+    autosaver.reset(new ProjectSaver);
+    prefetchFirstTick = 0;
+    prefetchLastTick = 0;
+    prefetchCursorTick = 0;
 
     uiXml = Gtk::Builder::create_from_file("FMidiAutomation.glade");
 
@@ -184,6 +138,14 @@ FMidiAutomationMainWindow::FMidiAutomationMainWindow()
     menuOpen->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuOpen));
     menuSave->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuSave));
     menuSaveAs->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuSaveAs));
+
+    Gtk::MenuItem *menuExportSMF;
+    uiXml->get_widget("menu_exportSMF", menuExportSMF);
+    menuExportSMF->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuExportSMF));
+
+    Gtk::MenuItem *menuImportSMF;
+    uiXml->get_widget("menu_importSMF", menuImportSMF);
+    menuImportSMF->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuImportSMF));
     menuNew->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuNew));
     menuQuit->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuQuit));
 
@@ -327,6 +289,18 @@ FMidiAutomationMainWindow::FMidiAutomationMainWindow()
     menuPorts->add_accelerator("activate", accelGroup, GDK_P, Gdk::CONTROL_MASK, Gtk::ACCEL_VISIBLE);
     menuPorts->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuPorts));
 
+    Gtk::MenuItem *menuEngineStatus;
+    uiXml->get_widget("menu_engineStatus", menuEngineStatus);
+    menuEngineStatus->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuEngineStatus));
+
+    Gtk::MenuItem *menuEngineClients;
+    uiXml->get_widget("menu_engineClients", menuEngineClients);
+    menuEngineClients->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuEngineClients));
+
+    Gtk::MenuItem *menuEngineLookAhead;
+    uiXml->get_widget("menu_engineLookAhead", menuEngineLookAhead);
+    menuEngineLookAhead->signal_activate().connect(sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_menuEngineLookAhead));
+
     recordMidi = false;
 
 //    Glib::signal_idle().connect( sigc::mem_fun(*this, &FMidiAutomationMainWindow::on_idle) );
@@ -340,6 +314,8 @@ FMidiAutomationMainWindow::FMidiAutomationMainWindow()
     button->signal_clicked().connect ( sigc::mem_fun(*this, &FMidiAutomationMainWindow::handlePausePressed) );
     uiXml->get_widget("recButton", button);
     button->signal_clicked().connect ( sigc::mem_fun(*this, &FMidiAutomationMainWindow::handleRecordPressed) );
+    uiXml->get_widget("loopButton", loopButton);
+    loopButton->signal_toggled().connect ( sigc::mem_fun(*this, &FMidiAutomationMainWindow::handleLoopToggled) );
 
     setTitle("Unknown");
 
@@ -372,6 +348,10 @@ FMidiAutomationMainWindow::~FMidiAutomationMainWindow()
     isExiting = true;
     statusTextMutex.unlock();
     statusTextThread.join();
+
+    //Let a save in progress finish rather than leave a half written temp file
+    projectSaver.reset();
+    autosaver.reset();
 }//destructor
  
 std::function<void (void)> FMidiAutomationMainWindow::getTitleStarFunc()
@@ -793,11 +773,63 @@ void FMidiAutomationMainWindow::handlePausePressed()
     jackSingleton.setTransportState(JackTransportStopped);
     jackSingleton.setRecordMidi(false);
 
+    bool recordMidiWasOn = recordMidi;
     if (true == recordMidi) {
         processRecordedMidi();
     }//if
 
     recordMidi = false;
+
+    //Have the bars around where we stopped ready to chase into
+    jackSingleton.prepareChaseCuePoints(getGraphState().curPointerTick);
+
+    //The period right after a resync is always sampled directly; anything past that means the renderer fell behind
+    Glib::ustring statusText;
+    LookAheadStats stats = jackSingleton.getLookAheadStats();
+    if (stats.underruns > stats.resyncs) {
+        statusText = "Look-ahead underruns: " + boost::lexical_cast<Glib::ustring>(stats.underruns - stats.resyncs) + 
+                     " of " + boost::lexical_cast<Glib::ustring>(stats.servedPeriods + stats.underruns) + " periods";
+    }//if
+
+    for (auto portStatsIter : jackSingleton.getOutputSchedulerStats()) {
+        const OutputSchedulerStats &portStats = portStatsIter.second;
+        if ((0 == portStats.deferredMessages) && (0 == portStats.droppedMessages)) {
+            continue;
+        }//if
+
+        if (statusText.empty() == false) {
+            statusText += "; ";
+        }//if
+
+        statusText += portStatsIter.first + ": " + boost::lexical_cast<Glib::ustring>(portStats.deferredMessages) + " deferred, " + 
+                      boost::lexical_cast<Glib::ustring>(portStats.droppedMessages) + " dropped, " + 
+                      boost::lexical_cast<Glib::ustring>(portStats.queueDepth) + " queued";
+    }//foreach
+
+    TelemetryStats telemetry = jackSingleton.getTelemetry();
+    if (telemetry.xruns > 0) {
+        if (statusText.empty() == false) {
+            statusText += "; ";
+        }//if
+
+        statusText += boost::lexical_cast<Glib::ustring>(telemetry.xruns) + " xruns, DSP load peaked at " + 
+                      boost::lexical_cast<Glib::ustring>((int)(telemetry.load(telemetry.callback.maxNanos) * 100.0)) + "%";
+    }//if
+
+    ThruStats thruStats = jackSingleton.getMidiThruStats();
+    if ((true == recordMidiWasOn) && ((thruStats.forwardedMessages > 0) || (thruStats.droppedMessages > 0))) {
+        if (statusText.empty() == false) {
+            statusText += "; ";
+        }//if
+
+        statusText += "Thru: " + boost::lexical_cast<Glib::ustring>(thruStats.forwardedMessages) + " forwarded, " +
+                      boost::lexical_cast<Glib::ustring>(thruStats.droppedMessages) + " dropped, at most " +
+                      boost::lexical_cast<Glib::ustring>(thruStats.maxLatencyFrames) + " frames late";
+    }//if
+
+    if (statusText.empty() == false) {
+        setStatusText(statusText);
+    }//if
 }//handlePausePressed
 
 void FMidiAutomationMainWindow::handleRecordPressed()
@@ -818,6 +850,24 @@ void FMidiAutomationMainWindow::handleRecordPressed()
     recordThread.reset(new std::thread(startRecordFunc));
 }//handleRecordPressed
 
+void FMidiAutomationMainWindow::handleLoopToggled()
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    if (true == loopButton->get_active()) {
+        int leftTick = getGraphState().leftMarkerTick;
+        int rightTick = getGraphState().rightMarkerTick;
+
+        if ((leftTick < 0) || (rightTick <= leftTick)) {
+            setStatusText("Set the left and right markers to loop between them");
+        }//if
+
+        jackSingleton.setLoop(true, leftTick, rightTick);
+    } else {
+        jackSingleton.setLoop(false, 0, 0);
+    }//if
+}//handleLoopToggled
+
 void FMidiAutomationMainWindow::startRecordThread()
 {
     if (false == recordMidi) {
@@ -834,6 +884,7 @@ void FMidiAutomationMainWindow::startRecordThread()
         recordMidi = true;
 
         JackSingleton &jackSingleton = JackSingleton::Instance();
+        jackSingleton.startMidiThru(getGraphState().insertMode);
         jackSingleton.setRecordMidi(true);
         jackSingleton.setTransportState(JackTransportRolling);
 
@@ -1422,6 +1473,76 @@ void FMidiAutomationMainWindow::on_menuPorts()
     this->jackPortDialog.reset(new JackPortDialog(uiXml));
 }//on_menuPorts
 
+void FMidiAutomationMainWindow::on_menuEngineStatus()
+{
+    EngineStatusDialog engineStatusDialog(uiXml);
+}//on_menuEngineStatus
+
+void FMidiAutomationMainWindow::on_menuEngineClients()
+{
+    Gtk::Dialog dialog("Engine Clients", *mainWindow, true);
+
+    Gtk::Label label("JACK clients to spread the output ports over (each one gets its own process callback):");
+    Gtk::SpinButton spinButton;
+    spinButton.set_range(1, 16);
+    spinButton.set_increments(1, 4);
+    spinButton.set_digits(0);
+    spinButton.set_value(JackSingleton::Instance().getEngineClients());
+    spinButton.set_activates_default(true);
+
+    dialog.get_content_area()->pack_start(label, Gtk::PACK_SHRINK);
+    dialog.get_content_area()->pack_start(spinButton, Gtk::PACK_SHRINK);
+    dialog.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    dialog.add_button(Gtk::Stock::OK, Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+    dialog.show_all_children();
+
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }//if
+
+    spinButton.update();
+    unsigned int numClients = spinButton.get_value_as_int();
+    if (numClients == JackSingleton::Instance().getEngineClients()) {
+        return;
+    }//if
+
+    std::shared_ptr<SetEngineClientsCommand> setEngineClientsCommand(new SetEngineClientsCommand(numClients, this));
+    CommandManager::Instance().setNewCommand(setEngineClientsCommand, true);
+}//on_menuEngineClients
+
+void FMidiAutomationMainWindow::on_menuEngineLookAhead()
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    Gtk::Dialog dialog("Engine Look-Ahead", *mainWindow, true);
+
+    Gtk::CheckButton enabledButton("Sample the project ahead of the transport on its own thread");
+    enabledButton.set_active(jackSingleton.getLookAheadEnabled());
+
+    Gtk::Label label("Periods to keep ready (more rides out longer stalls, but edits take longer to be heard):");
+    Gtk::SpinButton spinButton;
+    spinButton.set_range(1, 64);
+    spinButton.set_increments(1, 4);
+    spinButton.set_digits(0);
+    spinButton.set_value(jackSingleton.getLookAheadPeriods());
+    spinButton.set_activates_default(true);
+
+    dialog.get_content_area()->pack_start(enabledButton, Gtk::PACK_SHRINK);
+    dialog.get_content_area()->pack_start(label, Gtk::PACK_SHRINK);
+    dialog.get_content_area()->pack_start(spinButton, Gtk::PACK_SHRINK);
+    dialog.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    dialog.add_button(Gtk::Stock::OK, Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+    dialog.show_all_children();
+
+    if (dialog.run() == Gtk::RESPONSE_OK) {
+        spinButton.update();
+        jackSingleton.setLookAheadPeriods(spinButton.get_value_as_int());
+        jackSingleton.setLookAheadEnabled(enabledButton.get_active());
+    }//if
+}//on_menuEngineLookAhead
+
 void FMidiAutomationMainWindow::on_menuQuit()
 {
     Gtk::Main::quit();
@@ -1608,6 +1729,10 @@ void FMidiAutomationMainWindow::on_menuNew()
     //    return;
     //}//if
 
+    //Nothing to recover until it's been saved somewhere
+    mainAppWindow->finishAutosave();
+    ProjectJournal::Instance().stop();
+
     Globals::ResetInstance();
     Globals &globals = Globals::Instance();
 
@@ -1633,36 +1758,63 @@ void FMidiAutomationMainWindow::on_menuNew()
     windowManager.closeAllWindows();
 }//on_menuNew
 
+//Only the snapshot is taken here; the writing (and fsync, which can take a while) happens on the
+// saver's thread and checkProjectSave() picks up the result
 void FMidiAutomationMainWindow::on_menuSave()
 {
     if (false == currentFilename.empty()) {
-        std::string filename = Glib::locale_from_utf8(currentFilename);
-
-        std::ofstream outputStream(filename.c_str());
-        assert(outputStream.good());
-        if (false == outputStream.good()) {
+        if (true == projectSaver->isBusy()) {
+            setStatusText("Still saving " + savingFilename);
             return;
         }//if
 
-        boost::archive::xml_oarchive outputArchive(outputStream);
+        std::string filename = Glib::locale_from_utf8(currentFilename);
 
-        const unsigned int FMidiAutomationVersion = 1;
-        outputArchive & BOOST_SERIALIZATION_NVP(FMidiAutomationVersion);
+        //One snapshot at a time; the journal restarts from this one
+        finishAutosave();
+        ProjectJournal &journal = ProjectJournal::Instance();
 
-        Globals &globals = Globals::Instance();        
-        //outputArchive & BOOST_SERIALIZATION_NVP(globals);
-        globals.doSave(outputArchive);
+        if (true == isBinaryProjectFilename(filename)) {
+            //Everything goes into the writer's buffers now, keys still in the old file included
+            std::shared_ptr<BinaryProjectWriter> projectWriter(new BinaryProjectWriter);
+            projectWriter->addProject(currentProjectVersion);
 
-        JackSingleton &jackSingleton = JackSingleton::Instance();
-        jackSingleton.doSave(outputArchive);
+            WindowManager &windowManager = WindowManager::Instance();
+            windowManager.doSave(projectWriter->addWindowChunk());
 
-        WindowManager &windowManager = WindowManager::Instance();
-        windowManager.doSave(outputArchive);
+            journal.beginSnapshot();
+            projectSaver->startBinarySave(projectWriter, filename);
+        } else {
+            //The XML archive reads the singletons as it goes, so it can only be built here
+            std::ostringstream outputStream;
 
-        setTitle(currentFilename);
+            {
+                boost::archive::xml_oarchive outputArchive(outputStream);
+
+                const unsigned int FMidiAutomationVersion = currentProjectVersion;
+                outputArchive & BOOST_SERIALIZATION_NVP(FMidiAutomationVersion);
+
+                Globals &globals = Globals::Instance();        
+                //outputArchive & BOOST_SERIALIZATION_NVP(globals);
+                globals.doSave(outputArchive);
+
+                JackSingleton &jackSingleton = JackSingleton::Instance();
+                jackSingleton.doSave(outputArchive);
+
+                WindowManager &windowManager = WindowManager::Instance();
+                windowManager.doSave(outputArchive);
+            }
+
+            journal.beginSnapshot();
+            projectSaver->startXMLSave(outputStream.str(), filename);
+        }//if
 
-        MRUList &mruList = MRUList::Instance();
-        mruList.addFile(currentFilename);
+        savingFilename = currentFilename;
+        lastSavePercent = 0;
+        setStatusText("Saving " + savingFilename);
+
+        //Edits made while it's writing mark the title again
+        setTitle(currentFilename);
     } else {
         on_menuSaveAs();
     }//if
@@ -1670,7 +1822,8 @@ void FMidiAutomationMainWindow::on_menuSave()
     queue_draw();
 }//on_menuSave
 
-void FMidiAutomationMainWindow::doSave(boost::archive::xml_oarchive &outputArchive)
+template<class Archive>
+void FMidiAutomationMainWindow::doSave(Archive &outputArchive)
 {
     outputArchive & BOOST_SERIALIZATION_NVP(graphState);
     sequencer->doSave(outputArchive);
@@ -1686,7 +1839,8 @@ void FMidiAutomationMainWindow::doSave(boost::archive::xml_oarchive &outputArchi
     }//if
 }//doSave
 
-void FMidiAutomationMainWindow::doLoad(boost::archive::xml_iarchive &inputArchive)
+template<class Archive>
+void FMidiAutomationMainWindow::doLoad(Archive &inputArchive)
 {
     inputArchive & BOOST_SERIALIZATION_NVP(graphState);
     sequencer->doLoad(inputArchive);
@@ -1715,8 +1869,9 @@ void FMidiAutomationMainWindow::on_menuSaveAs()
     dialog.add_button(Gtk::Stock::SAVE, Gtk::RESPONSE_OK);
 
     Glib::RefPtr<Gtk::FileFilter> filter_normal = Gtk::FileFilter::create();
-    filter_normal->set_name("Automation files (*.fma)");
+    filter_normal->set_name("Automation files (*.fma, *.fmab)");
     filter_normal->add_pattern("*.fma");
+    filter_normal->add_pattern("*.fmab");
     dialog.add_filter(filter_normal);
 
     Glib::RefPtr<Gtk::FileFilter> filter_any = Gtk::FileFilter::create();
@@ -1742,6 +1897,106 @@ void FMidiAutomationMainWindow::on_menuSaveAs()
     }//switch
 }//on_menuSaveAs
 
+void FMidiAutomationMainWindow::on_menuExportSMF()
+{
+    Gtk::FileChooserDialog dialog("Export MIDI File...", Gtk::FILE_CHOOSER_ACTION_SAVE);
+    dialog.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    dialog.add_button(Gtk::Stock::SAVE, Gtk::RESPONSE_OK);
+
+    Glib::RefPtr<Gtk::FileFilter> filter_midi = Gtk::FileFilter::create();
+    filter_midi->set_name("MIDI files (*.mid)");
+    filter_midi->add_pattern("*.mid");
+    dialog.add_filter(filter_midi);
+
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }//if
+
+    std::string filename = dialog.get_filename();
+    if (filename.find(".mid") == std::string::npos) {
+        filename.append(".mid");
+    }//if
+
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    //Render with the same period and budgets playback uses so the messages come out the same
+    std::map<std::string, OutputSchedulerStats> schedulerStats = jackSingleton.getOutputSchedulerStats();
+    std::vector<OfflineRenderPort> ports;
+    for (const std::string &portName : jackSingleton.getOutputPorts()) {
+        OfflineRenderPort port;
+        port.name = portName;
+        port.port = jackSingleton.getOutputPort(portName);
+        port.messagesPerSecond = schedulerStats[portName].messagesPerSecond;
+        ports.push_back(port);
+    }//foreach
+
+    OfflineRenderer renderer(jackSingleton.getSampleRate(), jackSingleton.getBufferSize());
+    if (renderer.render(ports, 0, OfflineRenderer::getProjectEndTick(), filename) == false) {
+        setStatusText("Couldn't write " + filename);
+        return;
+    }//if
+
+    OfflineRenderStats stats = renderer.getStats();
+    setStatusText("Exported " + boost::lexical_cast<Glib::ustring>(stats.messages) + " messages in " + 
+                  boost::lexical_cast<Glib::ustring>(stats.seconds) + " seconds");
+}//on_menuExportSMF
+
+void FMidiAutomationMainWindow::on_menuImportSMF()
+{
+    Gtk::FileChooserDialog dialog("Import MIDI File...", Gtk::FILE_CHOOSER_ACTION_OPEN);
+    dialog.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    dialog.add_button(Gtk::Stock::OPEN, Gtk::RESPONSE_OK);
+
+    Glib::RefPtr<Gtk::FileFilter> filter_midi = Gtk::FileFilter::create();
+    filter_midi->set_name("MIDI files (*.mid, *.smf)");
+    filter_midi->add_pattern("*.mid");
+    filter_midi->add_pattern("*.midi");
+    filter_midi->add_pattern("*.smf");
+    dialog.add_filter(filter_midi);
+
+    Glib::RefPtr<Gtk::FileFilter> filter_any = Gtk::FileFilter::create();
+    filter_any->set_name("Any files");
+    filter_any->add_pattern("*");
+    dialog.add_filter(filter_any);
+
+    Gtk::CheckButton simplifyButton("Leave out keys that don't change the value");
+    simplifyButton.set_active(true);
+    simplifyButton.show();
+    dialog.set_extra_widget(simplifyButton);
+
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }//if
+
+    SMFImport smfImport;
+    std::string error;
+    if (buildSMFImport(dialog.get_filename(), simplifyButton.get_active(), smfImport, error) == false) {
+        setStatusText(error);
+        return;
+    }//if
+
+    if (smfImport.entryBlocks.empty() == true) {
+        setStatusText("No controllers to import");
+        return;
+    }//if
+
+    unsigned long long controllerEvents = smfImport.controllerEvents;
+    unsigned long long keyframes = smfImport.keyframes;
+    size_t numNewEntries = smfImport.newEntries.size();
+
+    std::shared_ptr<Command> importSMFCommand(new ImportSMFCommand(smfImport.newEntries, smfImport.entryBlocks, this));
+    CommandManager::Instance().setNewCommand(importSMFCommand, true);
+
+    Glib::ustring statusText = "Imported " + boost::lexical_cast<Glib::ustring>(controllerEvents) + " controller messages as " +
+                               boost::lexical_cast<Glib::ustring>(keyframes) + " keys, " + boost::lexical_cast<Glib::ustring>(numNewEntries) + " new entries";
+    if (true == smfImport.truncated) {
+        statusText += " (the file ends early)";
+    }//if
+
+    setStatusText(statusText);
+    queue_draw();
+}//on_menuImportSMF
+
 void FMidiAutomationMainWindow::actuallyLoadFile(const Glib::ustring &currentFilename_)
 {
     WindowManager &windowManager = WindowManager::Instance();
@@ -1754,24 +2009,72 @@ void FMidiAutomationMainWindow::actuallyLoadFile(const Glib::ustring &currentFil
 
     std::string filename = Glib::locale_from_utf8(currentFilename_);
 
-    std::ifstream inputStream(filename.c_str());
+    //A journal left beside it means it wasn't closed cleanly; it's replayed on whatever it was journaling
+    // against (the project or its autosave).  Reopening the project that's open is a revert, though.
+    ProjectJournal &journal = ProjectJournal::Instance();
+    std::string loadFilename = filename;
+    bool recovering = false;
+    if (journal.getProjectFilename() != filename) {
+        std::string error;
+        recovering = ProjectJournal::findRecovery(filename, loadFilename, error);
+        if (false == error.empty()) {
+            setStatusText(error);
+        }//if
+    }//if
+
+    std::ifstream inputStream(loadFilename.c_str());
     if (false == inputStream.good()) {
         //FIXME: We should probably add some sort of message box or something
         return;
     }//if
 
+    //A binary project is read and checked before the current one is thrown away
+    BinaryProjectReader projectReader;
+    bool isBinaryProject = BinaryProjectReader::isBinaryProject(loadFilename);
+    if (true == isBinaryProject) {
+        std::string error;
+        if (false == projectReader.open(loadFilename, error)) {
+            setStatusText(error);
+            return;
+        }//if
+    }//if
+
     windowManager.closeAllWindows();
 
-    Globals::ResetInstance();
+    mainAppWindow->finishAutosave();
+    journal.stop();
 
-    ResetSharedPtrMapSingletonList();
+    Globals::ResetInstance();
 
     currentFilename = currentFilename_;
 
-    boost::archive::xml_iarchive inputArchive(inputStream);
+    if (true == isBinaryProject) {
+        std::string error;
+        if (false == projectReader.loadProject(error)) {
+            on_menuNew();
+            setStatusText(error);
+            return;
+        }//if
+
+        BinaryIArchive *windowArchive = projectReader.getWindowChunk();
+        if (windowArchive != nullptr) {
+            windowManager.doLoad(*windowArchive);
+        } else {
+            mainAppWindow->getGraphState().doInit();
+            mainAppWindow->sequencer->doLoadFromBase(Globals::Instance().projectData.getSequencer());
+        }//if
+    } else {
+        //Projects written by fma-tool end before the window state (see ProjectFile.h).  A failed read leaves the
+        // archive unable to even close, so that's caught once it's gone.
+        bool projectLoaded = false;
+        try {
+            SharedPtrLoadSession loadSession;
+            loadSession.reserveForProject(inputStream);
 
-    unsigned int FMidiAutomationVersion = 0;
-    inputArchive & BOOST_SERIALIZATION_NVP(FMidiAutomationVersion);
+            boost::archive::xml_iarchive inputArchive(inputStream);
+
+            unsigned int FMidiAutomationVersion = 0;
+            inputArchive & BOOST_SERIALIZATION_NVP(FMidiAutomationVersion);
 
 /*    
 //    inputArchive & BOOST_SERIALIZATION_NVP(datas);
@@ -1787,14 +2090,24 @@ jackSingleton.doLoad(inputArchive);
 globals.projectData.getSequencer()->doLoad(inputArchive);
 */
 
-    Globals &globals = Globals::Instance();        
-    //inputArchive & BOOST_SERIALIZATION_NVP(globals);
-    globals.doLoad(inputArchive);
+            Globals &globals = Globals::Instance();        
+            //inputArchive & BOOST_SERIALIZATION_NVP(globals);
+            globals.doLoad(inputArchive);
 
-    JackSingleton &jackSingleton = JackSingleton::Instance();
-    jackSingleton.doLoad(inputArchive);
+            JackSingleton &jackSingleton = JackSingleton::Instance();
+            jackSingleton.doLoad(inputArchive, FMidiAutomationVersion);
+            projectLoaded = true;
 
-    windowManager.doLoad(inputArchive);
+            windowManager.doLoad(inputArchive);
+        } catch (const boost::archive::archive_exception &) {
+            if (false == projectLoaded) {
+                throw;
+            }//if
+
+            mainAppWindow->getGraphState().doInit();
+            mainAppWindow->sequencer->doLoadFromBase(Globals::Instance().projectData.getSequencer());
+        }//try
+    }//if
 
     std::cout << "FINISHED LOADING BITS" << std::endl;
 
@@ -1823,9 +2136,35 @@ globals.projectData.getSequencer()->doLoad(inputArchive);
     PasteManager::Instance().clearCommands();
 
     mainAppWindow = windowManager.getMainWindow(); //might be unnecessary
+
+    unsigned int numEdits = 0;
+    std::string recoverError;
+    if ((true == recovering) && (true == journal.recover(filename, numEdits, recoverError))) {
+        //The lanes were laid out before the replay added or removed any entries
+        if (numEdits > 0) {
+            mainAppWindow->sequencer->doLoadFromBase(Globals::Instance().projectData.getSequencer());
+        }//if
+
+        //Loaded from the autosave, the edits are in even if the journal after it was empty
+        if ((numEdits > 0) || (loadFilename != filename)) {
+            setTitleChanged();
+            setStatusText("Recovered unsaved edits to " + currentFilename_ + " (" + boost::lexical_cast<Glib::ustring>(numEdits) + " since the last autosave)");
+        }//if
+    } else {
+        if (false == recoverError.empty()) {
+            setStatusText("Can't recover " + currentFilename_ + ": " + recoverError);
+        }//if
+
+        journal.start(filename);
+    }//if
+
+    //Nothing the engine cached or laid out for the old project still applies
+    JackSingleton::Instance().invalidateChaseCuePoints();
+
     mainAppWindow->handleSequencerButtonPressedNoGraphStateSelectedEntryBlock();
     mainAppWindow->queue_draw();
 
+    Globals &globals = Globals::Instance();
     std::cout << "actuallyLoadFile sequencer: " << globals.projectData.getSequencer().get() << std::endl;
 }//actuallyLoadFile
 
@@ -1837,8 +2176,9 @@ void FMidiAutomationMainWindow::on_menuOpen()
     dialog.add_button(Gtk::Stock::OPEN, Gtk::RESPONSE_OK);
 
     Glib::RefPtr<Gtk::FileFilter> filter_normal = Gtk::FileFilter::create();
-    filter_normal->set_name("Automation files (*.fma)");
+    filter_normal->set_name("Automation files (*.fma, *.fmab)");
     filter_normal->add_pattern("*.fma");
+    filter_normal->add_pattern("*.fmab");
     dialog.add_filter(filter_normal);
 
     Glib::RefPtr<Gtk::FileFilter> filter_any = Gtk::FileFilter::create();
@@ -2000,6 +2340,19 @@ bool FMidiAutomationMainWindow::on_idle()
         }//if
     }//if
 
+    //Follow the markers; this is a no-op unless they moved or the project changed
+    if (true == loopButton->get_active()) {
+        jackSingleton.setLoop(true, getGraphState().leftMarkerTick, getGraphState().rightMarkerTick);
+    }//if
+
+    checkProjectSave();
+
+    if (WindowManager::Instance().getMainWindow().get() == this) {
+        checkJournalCompaction();
+        prioritizeKeyframePrefetch();
+        freezeIdleKeyframes();
+    }//if
+
     if (true == needsStatusTextUpdate) {
         std::lock_guard<std::mutex> dataLock(statusTextDataMutex);
         statusBar->set_text(currentStatusText);
@@ -2014,6 +2367,256 @@ bool FMidiAutomationMainWindow::on_idle()
     return true;
 }//on_idle
 
+void FMidiAutomationMainWindow::checkProjectSave()
+{
+    if (false == projectSaver->isBusy()) {
+        return;
+    }//if
+
+    if (false == projectSaver->isFinished()) {
+        unsigned int percentDone = projectSaver->getPercentDone();
+        if (percentDone != lastSavePercent) {
+            lastSavePercent = percentDone;
+            setStatusText("Saving " + savingFilename + " (" + boost::lexical_cast<Glib::ustring>(percentDone) + "%)");
+        }//if
+
+        return;
+    }//if
+
+    std::string error;
+    bool succeeded = projectSaver->finish(error);
+
+    std::string filename = Glib::locale_from_utf8(savingFilename);
+    ProjectJournal::Instance().finishSnapshot(filename, filename, succeeded);
+
+    if (false == succeeded) {
+        setStatusText(error);
+        setTitleChanged();
+        return;
+    }//if
+
+    setStatusText("Saved " + savingFilename);
+
+    MRUList &mruList = MRUList::Instance();
+    mruList.addFile(savingFilename);
+}//checkProjectSave
+
+//Folds a journal that's grown long (or old) into a snapshot, on the autosaver's thread so editing and
+// playback carry on while it's written
+void FMidiAutomationMainWindow::checkJournalCompaction()
+{
+    if (true == autosaver->isBusy()) {
+        if (true == autosaver->isFinished()) {
+            finishAutosave();
+        }//if
+
+        return;
+    }//if
+
+    ProjectJournal &journal = ProjectJournal::Instance();
+    if ((true == projectSaver->isBusy()) || (false == journal.wantsCompaction())) {
+        return;
+    }//if
+
+    std::shared_ptr<BinaryProjectWriter> projectWriter(new BinaryProjectWriter);
+    projectWriter->addProject(currentProjectVersion);
+
+    WindowManager &windowManager = WindowManager::Instance();
+    windowManager.doSave(projectWriter->addWindowChunk());
+
+    journal.beginSnapshot();
+    autosaver->startBinarySave(projectWriter, ProjectJournal::getAutosaveFilename(journal.getProjectFilename()));
+}//checkJournalCompaction
+
+//Waits for an autosave still being written and hands the result to the journal
+void FMidiAutomationMainWindow::finishAutosave()
+{
+    if (false == autosaver->isBusy()) {
+        return;
+    }//if
+
+    std::string error;
+    bool succeeded = autosaver->finish(error);
+
+    ProjectJournal &journal = ProjectJournal::Instance();
+    std::string projectFilename = journal.getProjectFilename();
+    journal.finishSnapshot(projectFilename, ProjectJournal::getAutosaveFilename(projectFilename), succeeded);
+
+    if (false == succeeded) {
+        setStatusText("Autosave failed: " + error);
+    }//if
+}//finishAutosave
+
+//Keys of a binary project are still coming in after it opens; what's on screen and what the transport will
+// reach next go first
+void FMidiAutomationMainWindow::prioritizeKeyframePrefetch()
+{
+    //Redraw as the blocks on screen come in, so they lose their placeholder shading
+    if (false == prefetchPendingBlocks.empty()) {
+        auto residentIter = std::remove_if(prefetchPendingBlocks.begin(), prefetchPendingBlocks.end(),
+                                            [](std::shared_ptr<SequencerEntryBlock> entryBlock) { return entryBlock->areKeysResident(); });
+        if (residentIter != prefetchPendingBlocks.end()) {
+            prefetchPendingBlocks.erase(residentIter, prefetchPendingBlocks.end());
+            queue_draw();
+        }//if
+    }//if
+
+    KeyframePrefetcher &prefetcher = KeyframePrefetcher::Instance();
+    GraphState &graphState = getGraphState();
+    if (true == graphState.verticalPixelTickValues.empty()) {
+        return;
+    }//if
+
+    int firstTick = graphState.verticalPixelTickValues.front();
+    int lastTick = graphState.verticalPixelTickValues.back();
+    int cursorTick = graphState.curPointerTick;
+    int screenTicks = std::max(lastTick - firstTick, 1);
+
+    //While playing the cursor moves every time through; a quarter screen is soon enough to look again
+    if ((firstTick == prefetchFirstTick) && (lastTick == prefetchLastTick) && (std::abs(cursorTick - prefetchCursorTick) < screenTicks / 4)) {
+        return;
+    }//if
+
+    prefetchFirstTick = firstTick;
+    prefetchLastTick = lastTick;
+    prefetchCursorTick = cursorTick;
+
+    std::vector<std::shared_ptr<SequencerEntryBlock> > onScreenBlocks;
+    std::vector<std::shared_ptr<SequencerEntryBlock> > aheadBlocks;
+    prefetchPendingBlocks.clear();
+
+    for (std::shared_ptr<SequencerEntry> entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+            if (true == entryBlock->areKeysResident()) {
+                continue;
+            }//if
+
+            int startTick = entryBlock->getStartTick();
+            int endTick = startTick + entryBlock->getDuration();
+
+            if ((startTick <= lastTick) && (endTick >= firstTick)) {
+                onScreenBlocks.push_back(entryBlock);
+                prefetchPendingBlocks.push_back(entryBlock);
+            } else if ((startTick <= cursorTick + screenTicks) && (endTick >= cursorTick)) {
+                aheadBlocks.push_back(entryBlock);
+            }//if
+        }//foreach
+    }//foreach
+
+    if (JackSingleton::Instance().getTransportState() == JackTransportRolling) {
+        aheadBlocks.insert(aheadBlocks.end(), onScreenBlocks.begin(), onScreenBlocks.end());
+        prefetcher.prioritize(aheadBlocks);
+    } else {
+        onScreenBlocks.insert(onScreenBlocks.end(), aheadBlocks.begin(), aheadBlocks.end());
+        prefetcher.prioritize(onScreenBlocks);
+    }//if
+}//prioritizeKeyframePrefetch
+
+//Packs away the keys of blocks that are off screen and not selected or open anywhere, a bounded amount at a
+// time and only while the transport's stopped.  They're unpacked again as they're needed: drawn, played, edited,
+// or ahead of that by the prefetcher once they're close.
+void FMidiAutomationMainWindow::freezeIdleKeyframes()
+{
+    const unsigned int minFrozenKeys = 256; //below this the keyframe map costs too little to bother
+    const unsigned int maxFrozenKeysPerPass = 1000000;
+    const std::chrono::seconds freezeInterval(5);
+
+    GraphState &graphState = getGraphState();
+    if ((true == recordMidi) || (JackSingleton::Instance().getTransportState() != JackTransportStopped) ||
+        (true == graphState.verticalPixelTickValues.empty())) {
+        return;
+    }//if
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - lastFreezeTime < freezeInterval) {
+        return;
+    }//if
+
+    lastFreezeTime = now;
+
+    int firstTick = graphState.verticalPixelTickValues.front();
+    int lastTick = graphState.verticalPixelTickValues.back();
+
+    //Blocks shown through an instance count as on screen too
+    std::set<std::shared_ptr<SequencerEntryBlock> > inUseEntryBlocks = WindowManager::Instance().getOpenEntryBlocks();
+    std::vector<std::shared_ptr<SequencerEntryBlock> > idleEntryBlocks;
+
+    for (std::shared_ptr<SequencerEntry> entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+
+            int startTick = entryBlock->getStartTick();
+            int endTick = startTick + entryBlock->getDuration();
+
+            if ((startTick <= lastTick) && (endTick >= firstTick)) {
+                inUseEntryBlocks.insert(entryBlock);
+                if (entryBlock->getInstanceOf() != nullptr) {
+                    inUseEntryBlocks.insert(entryBlock->getInstanceOf());
+                }//if
+            } else {
+                idleEntryBlocks.push_back(entryBlock);
+            }//if
+        }//foreach
+    }//foreach
+
+    //Packed first, while the engine carries on; only the swaps wait for it to stop sampling
+    std::vector<std::pair<std::shared_ptr<Animation>, std::shared_ptr<const MappedKeyframes> > > frozenCurves;
+    unsigned int numFrozenKeys = 0;
+    for (std::shared_ptr<SequencerEntryBlock> entryBlock : idleEntryBlocks) {
+        if (inUseEntryBlocks.find(entryBlock) != inUseEntryBlocks.end()) {
+            continue;
+        }//if
+
+        for (std::shared_ptr<Animation> curve : { entryBlock->getCurve(), entryBlock->getSecondaryCurve() }) {
+            unsigned int numKeys = curve->getNumKeyframes();
+            if (numKeys < minFrozenKeys) {
+                continue;
+            }//if
+
+            std::shared_ptr<const MappedKeyframes> packedKeyframes = curve->packKeyframes();
+            if (packedKeyframes != nullptr) {
+                frozenCurves.push_back(std::make_pair(curve, packedKeyframes));
+                numFrozenKeys += numKeys;
+            }//if
+        }//foreach
+
+        if (numFrozenKeys >= maxFrozenKeysPerPass) {
+            break;
+        }//if
+    }//foreach
+
+    if (true == frozenCurves.empty()) {
+        return;
+    }//if
+
+    //Nothing can be partway through a sample of what's swapped out once the pause is over, so it's freed here
+    std::vector<std::shared_ptr<const void> > retiredKeyframes;
+    {
+        SamplingPause samplingPause(JackSingleton::Instance());
+
+        for (auto frozenCurve : frozenCurves) {
+            frozenCurve.first->freezeKeyframes(frozenCurve.second, retiredKeyframes);
+        }//foreach
+    }
+}//freezeIdleKeyframes
+
+void FMidiAutomationMainWindow::closeProjectJournal()
+{
+    finishAutosave();
+
+    //If the last save didn't make it the journal is all that has those edits, so it stays
+    if (true == projectSaver->isBusy()) {
+        std::string error;
+        if (false == projectSaver->finish(error)) {
+            std::cerr << error << std::endl;
+            return;
+        }//if
+    }//if
+
+    ProjectJournal::Instance().stop();
+}//closeProjectJournal
+
 void FMidiAutomationMainWindow::handleDeleteKeyframe()
 {
     menuCopy->set_sensitive(false);
@@ -2118,6 +2721,7 @@ std::cout << "editSequencerEntryProperties 1" << std::endl;
         } else {
             //Here is we added a new entry
             entry->setNewDataImpl(entryProperties.newImpl);
+            JackSingleton::Instance().invalidateChaseCuePoints();
         }//if
     }//if
 
@@ -2163,3 +2767,9 @@ void FMidiAutomationMainWindow::doTestInit()
 }//doTestInit
 
 
+template void FMidiAutomationMainWindow::doSave<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &outputArchive);
+template void FMidiAutomationMainWindow::doLoad<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &inputArchive);
+
+template void FMidiAutomationMainWindow::doSave<BinaryOArchive>(BinaryOArchive &outputArchive);
+template void FMidiAutomationMainWindow::doLoad<BinaryIArchive>(BinaryIArchive &inputArchive);
+
@@ -22,6 +22,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <functional>
 #include <jack/transport.h>
 #include <thread>
+#include <chrono>
 
 
 struct FMidiAutomationData;
@@ -30,8 +31,10 @@ class SequencerEntry;
 struct GraphState;
 struct CurveEditor;
 class SequencerEntryBlockUI;
+class SequencerEntryBlock;
 class CommandManager;
 class JackPortDialog;
+class ProjectSaver;
 
 enum class UIThreadOperation : char
 {
@@ -68,6 +71,7 @@ class FMidiAutomationMainWindow : public std::enable_shared_from_this<FMidiAutom
     Gtk::Entry *transportTimeEntry;
     Gtk::ToolButton *sequencerButton;
     Gtk::ToolButton *curveButton;
+    Gtk::ToggleToolButton *loopButton;
     Gtk::Frame *selectedKeyframeFrame;
     Gtk::Entry *positionTickEntry;
     Gtk::Entry *positionValueEntry;
@@ -125,6 +129,20 @@ class FMidiAutomationMainWindow : public std::enable_shared_from_this<FMidiAutom
     bool isExiting;
 
     std::shared_ptr<std::thread> recordThread;
+
+    std::shared_ptr<ProjectSaver> projectSaver;
+    Glib::ustring savingFilename;
+    unsigned int lastSavePercent;
+    std::shared_ptr<ProjectSaver> autosaver; //folds the journal into <project>.autosave.fmab
+
+    //What the keyframe prefetcher was last pointed at
+    int prefetchFirstTick;
+    int prefetchLastTick;
+    int prefetchCursorTick;
+    std::vector<std::shared_ptr<SequencerEntryBlock> > prefetchPendingBlocks; //on screen, keys not in yet
+
+    //Cold storage for the keys of blocks nobody's working on
+    std::chrono::steady_clock::time_point lastFreezeTime;
  
     /* functions */
     void setStatusText(Glib::ustring text);
@@ -138,6 +156,8 @@ class FMidiAutomationMainWindow : public std::enable_shared_from_this<FMidiAutom
     void on_menuOpen();
     void on_menuSave();
     void on_menuSaveAs();
+    void on_menuExportSMF();
+    void on_menuImportSMF();
     void on_menuNew();
     void on_menuQuit();
     void on_menuUndo();
@@ -146,6 +166,9 @@ class FMidiAutomationMainWindow : public std::enable_shared_from_this<FMidiAutom
     void on_menuCut();
     void on_menuPaste();
     void on_menuPorts();
+    void on_menuEngineStatus();
+    void on_menuEngineClients();
+    void on_menuEngineLookAhead();
     void on_menuPasteInstance();
     void on_menuSplitEntryBlocks();
     void on_menuJoinEntryBlocks();
@@ -188,6 +211,7 @@ class FMidiAutomationMainWindow : public std::enable_shared_from_this<FMidiAutom
     void handlePlayPressed();
     void handlePausePressed();
     void handleRecordPressed();
+    void handleLoopToggled();
 
     void handleJackPressed();
     void handleInsertModeChanged();
@@ -209,6 +233,11 @@ class FMidiAutomationMainWindow : public std::enable_shared_from_this<FMidiAutom
     void setThemeColours();
 
     bool on_idle();
+    void checkProjectSave();
+    void checkJournalCompaction();
+    void finishAutosave();
+    void prioritizeKeyframePrefetch();
+    void freezeIdleKeyframes();
 
     void setTitle(Glib::ustring currentFilename);
     void setTitleChanged();
@@ -299,13 +328,14 @@ public:
     Gtk::ImageMenuItem *getMenuRedo();
     std::function<void (void)> getTitleStarFunc();
     void queue_draw();
+    void closeProjectJournal(); //on a clean exit
 
     //For serialization
     bool getCurveEditorOnlyMode();
     std::shared_ptr<SequencerEntryBlockUI> getEditingEntryBlock();
     void forceCurveEditorMode(std::shared_ptr<SequencerEntryBlockUI> selectedEntryBlock);
-    void doSave(boost::archive::xml_oarchive &outputArchive);
-    void doLoad(boost::archive::xml_iarchive &inputArchive);
+    template<class Archive> void doSave(Archive &outputArchive);
+    template<class Archive> void doLoad(Archive &inputArchive);
 };//FMidiAutomationMainWindow
 
 
@@ -0,0 +1,76 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "FrameTime.h"
+#include <atomic>
+
+namespace
+{
+
+const unsigned int maxTickSubdivisions = 64;
+
+std::atomic<unsigned int> tickSubdivisions(1);
+
+//Floor division that also rounds negative positions down
+int64_t floorDivide(int64_t numerator, int64_t denominator)
+{
+    int64_t quotient = numerator / denominator;
+    if (((numerator % denominator) != 0) && ((numerator < 0) != (denominator < 0))) {
+        --quotient;
+    }//if
+
+    return quotient;
+}//floorDivide
+
+}//anonymous namespace
+
+int framesToTicks(FramePosition frame, jack_nframes_t frameRate)
+{
+    if (0 == frameRate) {
+        return 0;
+    }//if
+
+    return (int)floorDivide(frame * 1000, frameRate);
+}//framesToTicks
+
+FramePosition ticksToFrames(int tick, jack_nframes_t frameRate)
+{
+    return -floorDivide(-(int64_t)tick * frameRate, 1000);
+}//ticksToFrames
+
+double framesToSampleTick(FramePosition frame, jack_nframes_t frameRate)
+{
+    if (0 == frameRate) {
+        return 0;
+    }//if
+
+    int64_t subdivisions = tickSubdivisions.load(std::memory_order_relaxed);
+    int64_t step = floorDivide(frame * 1000 * subdivisions, frameRate);
+
+    return (double)step / (double)subdivisions;
+}//framesToSampleTick
+
+void setTickSubdivisions(unsigned int subdivisions)
+{
+    if (subdivisions < 1) {
+        subdivisions = 1;
+    }//if
+
+    if (subdivisions > maxTickSubdivisions) {
+        subdivisions = maxTickSubdivisions;
+    }//if
+
+    tickSubdivisions.store(subdivisions);
+}//setTickSubdivisions
+
+unsigned int getTickSubdivisions()
+{
+    return tickSubdivisions.load();
+}//getTickSubdivisions
+
@@ -0,0 +1,34 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __FRAMETIME_H
+#define __FRAMETIME_H
+
+#include <jack/jack.h>
+#include <cstdint>
+
+//Audio frames are kept as 64 bit integers and only turned into ticks (milliseconds) at the edges.  Floats
+// only hold a frame position exactly up to 2^24 frames, which is under six minutes at 48kHz.
+typedef int64_t FramePosition;
+
+//Exact; rounds down to the tick the frame falls in
+int framesToTicks(FramePosition frame, jack_nframes_t frameRate);
+
+//Exact; the first frame of the tick
+FramePosition ticksToFrames(int tick, jack_nframes_t frameRate);
+
+//Where to sample the curves for a frame: a fractional tick, rounded down to the sampling resolution
+double framesToSampleTick(FramePosition frame, jack_nframes_t frameRate);
+
+//How many steps each tick is sampled in; 1 samples on whole milliseconds
+void setTickSubdivisions(unsigned int subdivisions);
+unsigned int getTickSubdivisions();
+
+
+#endif
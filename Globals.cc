@@ -0,0 +1,67 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie                              
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "Globals.h"
+#include "KeyframePrefetcher.h"
+
+std::shared_ptr<Globals> Globals::instance;
+std::recursive_mutex Globals::globalsMutex;
+
+Globals::Globals()
+{
+    versionStr = "FMidiAutomation - version 1.0.0 - October 2011";
+    topBarFontSize = 12;
+    topBarFont = "Arial";
+    bottomBarFontSize = 12;
+    bottomBarFont = "Arial";
+    darkTheme = true;
+};//constructor
+
+Globals::~Globals()
+{
+    //Nothing
+}//destructor
+
+Globals &Globals::Instance()
+{
+    std::lock_guard<std::recursive_mutex> lock(globalsMutex);
+
+    if (instance == nullptr) {
+        ResetInstance();
+    }//if
+
+    return *instance;
+}//Instance
+
+void Globals::ResetInstance()
+{
+    std::lock_guard<std::recursive_mutex> lock(globalsMutex);
+    instance.reset(new Globals());
+
+    //Nothing of the old project is worth bringing in now
+    KeyframePrefetcher::Instance().clear();
+}//ResetInstance
+
+void Globals::doLoad(boost::archive::xml_iarchive &inputArchive)
+{
+    int globalsVersion = 1; 
+
+    inputArchive & BOOST_SERIALIZATION_NVP(globalsVersion);
+    projectData.doLoad(inputArchive);
+}//doLoad
+
+void Globals::doSave(boost::archive::xml_oarchive &outputArchive)
+{
+    int globalsVersion = 1;
+
+    outputArchive & BOOST_SERIALIZATION_NVP(globalsVersion);
+    projectData.doSave(outputArchive);
+}//doSave
+
+
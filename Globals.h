@@ -15,11 +15,16 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/access.hpp>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 class Sequencer;
 struct GraphState;
 
+//Written as FMidiAutomationVersion at the top of an XML project and in the header of a binary one
+const unsigned int currentProjectVersion = 5;
+
 struct TempoGlobals
 {
     TempoGlobals();
@@ -0,0 +1,247 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "GoldenHarness.h"
+#include "MockEngineBackend.h"
+#include "jack.h"
+#include "Globals.h"
+#include "KeyframePrefetcher.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <time.h>
+
+namespace
+{
+
+const unsigned long long fnvOffsetBasis = 14695981039346656037ULL;
+const unsigned long long fnvPrime = 1099511628211ULL;
+
+void fnvAdd(unsigned long long &hash, const unsigned char *data, size_t size)
+{
+    for (size_t index = 0; index < size; ++index) {
+        hash ^= data[index];
+        hash *= fnvPrime;
+    }//for
+}//fnvAdd
+
+//Byte by byte so the hash doesn't depend on the host's endianness
+void fnvAddNumber(unsigned long long &hash, unsigned long long value, size_t numBytes)
+{
+    for (size_t index = 0; index < numBytes; ++index) {
+        unsigned char byte = (unsigned char)(value >> (index * 8));
+        fnvAdd(hash, &byte, 1);
+    }//for
+}//fnvAddNumber
+
+unsigned long long threadCpuNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}//threadCpuNanos
+
+//The process callbacks skip curves whose keys are still on their way in from a binary project
+void waitForResidentKeys()
+{
+    while (true) {
+        std::vector<std::shared_ptr<SequencerEntryBlock> > waitingEntryBlocks;
+        for (auto entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+            for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+                if (false == entryBlockIter.second->areKeysResident()) {
+                    waitingEntryBlocks.push_back(entryBlockIter.second);
+                }//if
+            }//foreach
+        }//foreach
+
+        if (true == waitingEntryBlocks.empty()) {
+            return;
+        }//if
+
+        KeyframePrefetcher::Instance().prioritize(waitingEntryBlocks);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }//while
+}//waitForResidentKeys
+
+}//anonymous namespace
+
+GoldenHarness::GoldenHarness(std::shared_ptr<MockEngineBackend> backend_) : backend(backend_)
+{
+    //Nothing
+}//constructor
+
+GoldenHarness::~GoldenHarness()
+{
+    //Nothing
+}//destructor
+
+void GoldenHarness::hashEvents(const std::vector<MockOutputEvent> &events, FramePosition startFrame, GoldenRecord &record)
+{
+    for (const MockOutputEvent &event : events) {
+        //Relative to the start of the render so it doesn't matter what the mock ran before
+        fnvAddNumber(record.hash, (unsigned long long)(event.frame - startFrame), 8);
+        fnvAdd(record.hash, (const unsigned char *)event.portName.c_str(), event.portName.size() + 1);
+        fnvAddNumber(record.hash, event.data.size(), 4);
+        fnvAdd(record.hash, event.data.data(), event.data.size());
+
+        record.events++;
+    }//foreach
+}//hashEvents
+
+void GoldenHarness::render(unsigned long long numPeriods, unsigned int lookAheadPeriods, GoldenRecord &record, GoldenTiming &timing)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    if (lookAheadPeriods > 0) {
+        jackSingleton.setLookAheadPeriods(lookAheadPeriods);
+        jackSingleton.setLookAheadEnabled(true, false);
+    } else {
+        jackSingleton.setLookAheadEnabled(false);
+    }//if
+
+    waitForResidentKeys();
+
+    record.sampleRate = jackSingleton.getSampleRate();
+    record.periodSize = jackSingleton.getBufferSize();
+    record.periods = numPeriods;
+    record.lookAheadPeriods = lookAheadPeriods;
+    record.events = 0;
+    record.hash = fnvOffsetBasis;
+
+    //All three land together at the top of the first period we run
+    (void)backend->takeCapturedOutput();
+    jackSingleton.setTransportState(JackTransportStopped);
+    jackSingleton.setTime(0);
+    jackSingleton.setTransportState(JackTransportRolling);
+
+    FramePosition startFrame = (FramePosition)backend->getPeriod() * record.periodSize;
+
+    std::vector<unsigned long long> periodNanos;
+    periodNanos.reserve(numPeriods);
+
+    for (unsigned long long periodNum = 0; periodNum < numPeriods; ++periodNum) {
+        //Not timed; it's the render thread's work
+        if (lookAheadPeriods > 0) {
+            jackSingleton.stepLookAhead();
+        }//if
+
+        unsigned long long startNanos = threadCpuNanos();
+        backend->runPeriods(1);
+        periodNanos.push_back(threadCpuNanos() - startNanos);
+
+        hashEvents(backend->takeCapturedOutput(), startFrame, record);
+    }//for
+
+    jackSingleton.setTransportState(JackTransportStopped);
+    backend->runPeriods(1);
+    (void)backend->takeCapturedOutput();
+
+    jackSingleton.setLookAheadEnabled(true);
+
+    timing.totalSeconds = 0.0;
+    timing.meanMicros = 0.0;
+    timing.medianMicros = 0.0;
+    timing.p99Micros = 0.0;
+    timing.maxMicros = 0.0;
+
+    if (periodNanos.empty() == false) {
+        unsigned long long totalNanos = 0;
+        for (unsigned long long nanos : periodNanos) {
+            totalNanos += nanos;
+        }//foreach
+
+        std::sort(periodNanos.begin(), periodNanos.end());
+
+        timing.totalSeconds = totalNanos / 1e9;
+        timing.meanMicros = (totalNanos / 1e3) / periodNanos.size();
+        timing.medianMicros = periodNanos[periodNanos.size() / 2] / 1e3;
+        timing.p99Micros = periodNanos[std::min(periodNanos.size() - 1, (periodNanos.size() * 99) / 100)] / 1e3;
+        timing.maxMicros = periodNanos.back() / 1e3;
+    }//if
+}//render
+
+bool GoldenHarness::readGolden(const std::string &filename, GoldenRecord &record)
+{
+    std::ifstream inputStream(filename.c_str());
+    if (false == inputStream.good()) {
+        return false;
+    }//if
+
+    record.lookAheadPeriods = 0; //older files don't say
+
+    unsigned int found = 0;
+    std::string key;
+    while (inputStream >> key) {
+        if (key == "rate") {
+            inputStream >> record.sampleRate;
+        } else if (key == "period") {
+            inputStream >> record.periodSize;
+        } else if (key == "periods") {
+            inputStream >> record.periods;
+        } else if (key == "lookahead") {
+            inputStream >> record.lookAheadPeriods;
+        } else if (key == "events") {
+            inputStream >> record.events;
+        } else if (key == "hash") {
+            inputStream >> std::hex >> record.hash >> std::dec;
+        } else {
+            return false;
+        }//if
+
+        if (true == inputStream.fail()) {
+            return false;
+        }//if
+
+        //The look-ahead depth is optional
+        if (key != "lookahead") {
+            found++;
+        }//if
+    }//while
+
+    return (5 == found);
+}//readGolden
+
+bool GoldenHarness::writeGolden(const std::string &filename, const GoldenRecord &record)
+{
+    std::ofstream outputStream(filename.c_str());
+    if (false == outputStream.good()) {
+        return false;
+    }//if
+
+    outputStream << "rate " << record.sampleRate << "\n";
+    outputStream << "period " << record.periodSize << "\n";
+    outputStream << "periods " << record.periods << "\n";
+    if (record.lookAheadPeriods > 0) {
+        outputStream << "lookahead " << record.lookAheadPeriods << "\n";
+    }//if
+    outputStream << "events " << record.events << "\n";
+    outputStream << "hash " << std::hex << record.hash << std::dec << "\n";
+
+    outputStream.close();
+    return (false == outputStream.fail());
+}//writeGolden
+
+std::string GoldenHarness::describe(const GoldenRecord &record)
+{
+    std::ostringstream outputStream;
+    outputStream << "rate " << record.sampleRate << " period " << record.periodSize << " periods " << record.periods;
+    if (record.lookAheadPeriods > 0) {
+        outputStream << " lookahead " << record.lookAheadPeriods;
+    }//if
+
+    outputStream << " events " << record.events << " hash " << std::hex << record.hash;
+
+    return outputStream.str();
+}//describe
+
@@ -0,0 +1,69 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __GOLDENHARNESS_H
+#define __GOLDENHARNESS_H
+
+#include <jack/jack.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FrameTime.h"
+
+class MockEngineBackend;
+struct MockOutputEvent;
+
+//What a render is compared on.  The settings are kept alongside the hash so a golden file made with a
+// different rate or period size is reported as such instead of as changed output.
+struct GoldenRecord
+{
+    jack_nframes_t sampleRate;
+    jack_nframes_t periodSize;
+    unsigned long long periods;
+    unsigned int lookAheadPeriods; //0 is off
+    unsigned long long events;
+    unsigned long long hash; //FNV-1a over every (frame, port, bytes) in the order they were written
+};//GoldenRecord
+
+//CPU time of each runPeriods(1), which is the process callbacks of every engine client plus the mock's own
+// (small) bookkeeping
+struct GoldenTiming
+{
+    double totalSeconds;
+    double meanMicros;
+    double medianMicros;
+    double p99Micros;
+    double maxMicros;
+};//GoldenTiming
+
+//Plays whatever project is loaded from tick 0 through the real process path on a MockEngineBackend and
+// fingerprints the MIDI that comes out.  With look-ahead off every period is sampled in the callback.  With it
+// on, the render thread is stopped and the look-ahead is rendered on this thread between periods instead;
+// with the thread racing the transport the output would depend on timing.  For the same reason it waits
+// until every curve's keys are in memory before it starts.
+class GoldenHarness
+{
+    std::shared_ptr<MockEngineBackend> backend;
+
+    void hashEvents(const std::vector<MockOutputEvent> &events, FramePosition startFrame, GoldenRecord &record);
+
+public:
+    explicit GoldenHarness(std::shared_ptr<MockEngineBackend> backend);
+    ~GoldenHarness();
+
+    void render(unsigned long long numPeriods, unsigned int lookAheadPeriods, GoldenRecord &record, GoldenTiming &timing);
+
+    static bool readGolden(const std::string &filename, GoldenRecord &record);
+    static bool writeGolden(const std::string &filename, const GoldenRecord &record);
+    static std::string describe(const GoldenRecord &record);
+};//GoldenHarness
+
+
+#endif
+
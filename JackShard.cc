@@ -0,0 +1,110 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "JackShard.h"
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include "jack.h"
+#include "EngineBackend.h"
+
+namespace
+{
+
+//A few periods of thru; past that the main client drops what doesn't fit
+const size_t maxThruEvents = 2048;
+
+int shard_process_impl(jack_nframes_t nframes, void *arg)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    return jackSingleton.processShard(*static_cast<JackShard *>(arg), nframes);
+}//shard_process_impl
+
+void shard_latency_impl(jack_latency_callback_mode_t mode, void *arg)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    jackSingleton.latencyChanged(mode);
+}//shard_latency_impl
+
+}//anonymous namespace
+
+JackShard::JackShard(EngineBackend &backend_, unsigned int index_) : thruEvents(maxThruEvents)
+{
+    backend = &backend_;
+    index = index_;
+
+    wasRolling = false;
+    lastFrame = -1;
+    nextFrame = 0;
+    needsChase = true;
+
+    thruForwardedMessages = 0;
+    thruMaxLatencyFrames = 0;
+
+    loopEnabled = false;
+    loopStartTick = 0;
+    loopEndTick = 0;
+    lookAheadEnabled = false;
+
+    loopChaseDue = false;
+    loopLocatePending = false;
+    loopExpectedFrame = 0;
+    loopStaleFrame = 0;
+
+    //Shard 0 is the main client
+    std::string clientName = "FMidiAutomation-" + boost::lexical_cast<std::string>(index + 1);
+    jackClient = backend->openClient(clientName);
+
+    assert(jackClient != nullptr);
+
+    backend->setProcessCallback(jackClient, &shard_process_impl, this);
+    backend->setLatencyCallback(jackClient, &shard_latency_impl, this);
+
+    bool activated = backend->activate(jackClient);
+    assert(true == activated);
+}//constructor
+
+JackShard::~JackShard()
+{
+    backend->closeClient(jackClient);
+}//destructor
+
+jack_client_t *JackShard::getClient()
+{
+    return jackClient;
+}//getClient
+
+unsigned int JackShard::getIndex()
+{
+    return index;
+}//getIndex
+
+void JackShard::addOutputPort(const std::string &portName, jack_port_t *port)
+{
+    outputPorts[portName] = port;
+    outputPortSet.insert(port);
+    midiOutputBuffersRaw[port] = nullptr;
+    outputSchedulers[port] = OutputScheduler();
+    outputEncoders[port] = MidiEncoder(false);
+    needsChase = true;
+}//addOutputPort
+
+void JackShard::removeOutputPort(const std::string &portName)
+{
+    auto portIter = outputPorts.find(portName);
+    if (portIter == outputPorts.end()) {
+        return;
+    }//if
+
+    outputPortSet.erase(portIter->second);
+    midiOutputBuffersRaw.erase(portIter->second);
+    outputSchedulers.erase(portIter->second);
+    outputEncoders.erase(portIter->second);
+    outputPorts.erase(portIter);
+}//removeOutputPort
+
@@ -0,0 +1,87 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __JACKSHARD_H
+#define __JACKSHARD_H
+
+#include <jack/jack.h>
+#include <boost/thread.hpp>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ChaseEngine.h"
+#include "FrameTime.h"
+#include "MidiEncoder.h"
+#include "MidiThru.h"
+#include "OutputScheduler.h"
+#include "SPSCQueue.h"
+
+class EngineBackend;
+
+struct ShardThruEvent
+{
+    ThruEvent event;
+    jack_nframes_t portLatencyFrames; //capture plus playback, as the main client has them
+};//ShardThruEvent
+
+//An extra JACK client that owns a slice of the output ports.  JACK2 runs clients that don't feed each other
+// in parallel, so big templates can spread their ports over several cores.  Everything the callback writes
+// with (schedulers, encoders, loop and thru state) is the shard's own, changed only under its lock.
+class JackShard
+{
+    EngineBackend *backend;
+    jack_client_t *jackClient;
+    unsigned int index;
+
+public:
+    boost::recursive_mutex mutex; //held by our process callback; JackSingleton takes it to change our ports
+
+    std::map<std::string, jack_port_t *> outputPorts;
+    std::set<jack_port_t *> outputPortSet;
+    std::map<jack_port_t *, void *> midiOutputBuffersRaw;
+    std::map<jack_port_t *, OutputScheduler> outputSchedulers;
+    std::map<jack_port_t *, MidiEncoder> outputEncoders;
+    std::vector<ChaseValue> sampledValues;
+
+    //Thru for our ports; the main client reads the inputs and hands us what it routed here
+    SPSCQueue<ShardThruEvent> thruEvents;
+    unsigned long long thruForwardedMessages;
+    jack_nframes_t thruMaxLatencyFrames;
+
+    bool wasRolling;
+    FramePosition lastFrame;
+    FramePosition nextFrame;
+    bool needsChase;
+
+    //The engine's loop and look-ahead settings, copied in under our lock
+    bool loopEnabled;
+    int loopStartTick;
+    int loopEndTick;
+    std::shared_ptr<ChaseSnapshot> loopStartSnapshot;
+    bool lookAheadEnabled;
+
+    //The main client relocates the transport at a wrap; until the locate lands we play on from the loop start
+    bool loopChaseDue;
+    bool loopLocatePending;
+    FramePosition loopExpectedFrame;
+    FramePosition loopStaleFrame;
+
+    JackShard(EngineBackend &backend, unsigned int index);
+    ~JackShard();
+
+    jack_client_t *getClient();
+    unsigned int getIndex();
+
+    void addOutputPort(const std::string &portName, jack_port_t *port);
+    void removeOutputPort(const std::string &portName);
+};//JackShard
+
+
+#endif
@@ -0,0 +1,224 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "KeyframeCodec.h"
+#include "Animation.h"
+#include "BinaryArchive.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+//Past this a double no longer holds every whole number, and differences could overflow a zigzag varint
+const double maxWholeValue = 4503599627370496.0; //2^52
+
+//Ticks are ints, so no gap or change in gap can be bigger than this in a good curve
+const long long maxTickStep = 1LL << 33;
+
+const double unsetTangent = std::numeric_limits<int>::min();
+
+unsigned long long zigzag(long long value)
+{
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}//zigzag
+
+long long unzigzag(unsigned long long value)
+{
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}//unzigzag
+
+bool isWholeValue(double value)
+{
+    return (std::fabs(value) <= maxWholeValue) && (std::floor(value) == value) && ((0 != value) || (false == std::signbit(value)));
+}//isWholeValue
+
+bool hasUnsetTangents(const MappedKeyframes &keys, unsigned int key)
+{
+    return (unsetTangent == keys.inTangents[key * 2]) && (unsetTangent == keys.inTangents[key * 2 + 1]) &&
+           (unsetTangent == keys.outTangents[key * 2]) && (unsetTangent == keys.outTangents[key * 2 + 1]);
+}//hasUnsetTangents
+
+}//anonymous namespace
+
+void KeyframeCodec::pack(BinaryOArchive &archive, const MappedKeyframes &keys)
+{
+    unsigned int numKeys = keys.numKeys;
+
+    unsigned int key = 0;
+    while (key < numKeys) {
+        unsigned int runEnd = key + 1;
+        while ((runEnd < numKeys) && (keys.curveTypes[runEnd] == keys.curveTypes[key])) {
+            ++runEnd;
+        }//while
+
+        archive.saveByte(keys.curveTypes[key]);
+        archive.saveVarint(runEnd - key);
+        key = runEnd;
+    }//while
+
+    long long prevTick = 0;
+    long long prevGap = 0;
+    for (key = 0; key < numKeys; ++key) {
+        long long tick = keys.ticks[key];
+
+        if (0 == key) {
+            archive.saveZigzag(tick);
+        } else {
+            long long gap = tick - prevTick;
+            archive.saveZigzag(gap - prevGap);
+            prevGap = gap;
+        }//if
+
+        prevTick = tick;
+    }//for
+
+    long long prevWhole = 0;
+    for (key = 0; key < numKeys; ++key) {
+        double value = keys.values[key];
+
+        if (true == isWholeValue(value)) {
+            long long whole = (long long)value;
+            archive.saveVarint(zigzag(whole - prevWhole) << 1);
+            prevWhole = whole;
+        } else {
+            archive.saveVarint(1);
+            archive.saveDoubles(&value, 1);
+        }//if
+    }//for
+
+    std::vector<unsigned int> otherTangentKeys;
+    for (key = 0; key < numKeys; ++key) {
+        if ((unsigned char)CurveType::Bezier == keys.curveTypes[key]) {
+            archive.saveDoubles(keys.inTangents + key * 2, 2);
+            archive.saveDoubles(keys.outTangents + key * 2, 2);
+        } else if (false == hasUnsetTangents(keys, key)) {
+            otherTangentKeys.push_back(key);
+        }//if
+    }//for
+
+    archive.saveVarint(otherTangentKeys.size());
+
+    unsigned int prevKey = 0;
+    for (unsigned int otherKey : otherTangentKeys) {
+        archive.saveVarint(otherKey - prevKey);
+        archive.saveDoubles(keys.inTangents + otherKey * 2, 2);
+        archive.saveDoubles(keys.outTangents + otherKey * 2, 2);
+        prevKey = otherKey;
+    }//foreach
+}//pack
+
+bool KeyframeCodec::unpack(const unsigned char *packedKeys, size_t packedSize, unsigned int numKeys, double *values,
+                           double *inTangents, double *outTangents, int *ticks, unsigned char *curveTypes)
+{
+    BinaryProjectContext context;
+    BinaryIArchive archive(context, packedKeys, packedSize);
+
+    //Every key gets something in every array, even once the archive's failed and reads as zero
+    unsigned int key = 0;
+    while (key < numKeys) {
+        unsigned char curveType = archive.loadByte();
+        unsigned long long runLength = archive.loadVarint();
+
+        if ((curveType > (unsigned char)CurveType::Bezier) || (0 == runLength) || (runLength > numKeys - key)) {
+            archive.setFailed();
+            curveType = (unsigned char)CurveType::Init;
+            runLength = numKeys - key;
+        }//if
+
+        memset(curveTypes + key, curveType, runLength);
+        key += runLength;
+    }//while
+
+    long long tick = 0;
+    long long gap = 0;
+    for (key = 0; key < numKeys; ++key) {
+        long long change = archive.loadZigzag();
+
+        if ((change >= -maxTickStep) && (change <= maxTickStep)) {
+            if (0 == key) {
+                tick = change;
+            } else {
+                gap += change;
+                tick += gap;
+            }//if
+        } else {
+            archive.setFailed();
+        }//if
+
+        bool inOrder = (tick >= std::numeric_limits<int>::min()) && (tick <= std::numeric_limits<int>::max()) && ((0 == key) || (tick > ticks[key - 1]));
+        if ((false == inOrder) || (true == archive.hasFailed())) {
+            archive.setFailed();
+            tick = (0 == key) ? 0 : ticks[key - 1];
+            gap = 0;
+        }//if
+
+        ticks[key] = (int)tick;
+    }//for
+
+    long long whole = 0;
+    for (key = 0; key < numKeys; ++key) {
+        unsigned long long code = archive.loadVarint();
+
+        if (0 != (code & 1)) {
+            if (1 != code) {
+                archive.setFailed();
+            }//if
+
+            archive.loadDoubles(values + key, 1);
+            continue;
+        }//if
+
+        long long change = unzigzag(code >> 1);
+        if (((change < -2 * maxWholeValue) || (change > 2 * maxWholeValue)) || (std::fabs((double)(whole + change)) > maxWholeValue)) {
+            archive.setFailed();
+            change = 0;
+        }//if
+
+        whole += change;
+        values[key] = (double)whole;
+    }//for
+
+    for (key = 0; key < numKeys; ++key) {
+        if ((unsigned char)CurveType::Bezier == curveTypes[key]) {
+            archive.loadDoubles(inTangents + key * 2, 2);
+            archive.loadDoubles(outTangents + key * 2, 2);
+        } else {
+            inTangents[key * 2] = unsetTangent;
+            inTangents[key * 2 + 1] = unsetTangent;
+            outTangents[key * 2] = unsetTangent;
+            outTangents[key * 2 + 1] = unsetTangent;
+        }//if
+    }//for
+
+    unsigned long long numOtherTangentKeys = archive.loadVarint();
+    if (numOtherTangentKeys > numKeys) {
+        archive.setFailed();
+        numOtherTangentKeys = 0;
+    }//if
+
+    unsigned long long otherKey = 0;
+    for (unsigned long long index = 0; (index < numOtherTangentKeys) && (false == archive.hasFailed()); ++index) {
+        unsigned long long keyGap = archive.loadVarint();
+        if (((index > 0) && (0 == keyGap)) || (keyGap >= numKeys - otherKey)) {
+            archive.setFailed();
+            break;
+        }//if
+
+        otherKey += keyGap;
+
+        archive.loadDoubles(inTangents + otherKey * 2, 2);
+        archive.loadDoubles(outTangents + otherKey * 2, 2);
+    }//for
+
+    return (false == archive.hasFailed()) && (archive.getPosition() == packedSize);
+}//unpack
+
@@ -0,0 +1,46 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __KEYFRAMECODEC_H
+#define __KEYFRAMECODEC_H
+
+#include <cstddef>
+
+struct MappedKeyframes;
+class BinaryOArchive;
+
+//A curve's keys packed column by column.  Recorded lanes are thousands of keys at a steady rate, a step or
+// two apart in value and all one curve type, and the plain arrays spend 57 bytes a key on them:
+//
+//  curve types  runs: type byte, varint length
+//  ticks        zigzag varints: the first tick, the first gap, then how much each gap differs from the last
+//  values       a varint per key: a whole value is its zigzag difference from the last whole value shifted up
+//               a bit, anything else (fractions, -0, huge values) is a 1 followed by the double
+//  tangents     four doubles per Bezier key, then the other keys whose tangents aren't Keyframe()'s unset
+//               ones: a count, then for each the gap in key index from the last one and its four doubles
+//
+//The number of keys isn't included; whoever stores the packed keys keeps that beside them.  Binary projects
+// store a curve this way when it comes out at most half the size (see BinaryProject.h), and the editor packs
+// the keys of blocks nobody's working on (Animation::freezeKeyframes).  Either way MappedKeyframes::unpack
+// turns them back into the plain arrays the first time the curve's sampled, drawn or edited.
+class KeyframeCodec
+{
+public:
+    //The keys have to be in arrays already, unpacked if they were packed
+    static void pack(BinaryOArchive &archive, const MappedKeyframes &keys);
+
+    //Into arrays laid out as MappedKeyframes has them.  Keys past anything short or corrupt still come out
+    // in tick order with a valid curve type, so a damaged curve samples wrong but safely; false if so.
+    static bool unpack(const unsigned char *packedKeys, size_t packedSize, unsigned int numKeys, double *values,
+                       double *inTangents, double *outTangents, int *ticks, unsigned char *curveTypes);
+};//KeyframeCodec
+
+
+#endif
+
@@ -0,0 +1,161 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "KeyframePrefetcher.h"
+#include "Animation.h"
+#include "Data/SequencerEntryBlock.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+KeyframePrefetcher::KeyframePrefetcher()
+{
+    stopping = false;
+    numFetched = 0;
+}//constructor
+
+KeyframePrefetcher::~KeyframePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+
+    condition.notify_all();
+
+    if (true == thread.joinable()) {
+        thread.join();
+    }//if
+}//destructor
+
+KeyframePrefetcher &KeyframePrefetcher::Instance()
+{
+    static KeyframePrefetcher prefetcher;
+    return prefetcher;
+}//Instance
+
+void KeyframePrefetcher::start(const std::vector<std::shared_ptr<const MappedKeyframes> > &curves)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.assign(curves.begin(), curves.end());
+    }
+
+    if (false == thread.joinable()) {
+        thread = std::thread([=]() { prefetchThreadFunc(); });
+    }//if
+
+    condition.notify_all();
+}//start
+
+void KeyframePrefetcher::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.clear();
+}//clear
+
+void KeyframePrefetcher::prioritize(const std::vector<std::shared_ptr<SequencerEntryBlock> > &entryBlocks)
+{
+    std::vector<std::shared_ptr<const MappedKeyframes> > curves;
+    for (std::shared_ptr<SequencerEntryBlock> entryBlock : entryBlocks) {
+        for (std::shared_ptr<Animation> curve : { entryBlock->getCurve(), entryBlock->getSecondaryCurve() }) {
+            if (curve->instanceOf != nullptr) {
+                curve = curve->instanceOf;
+            }//if
+
+            if ((true == curve->keyframesMapped) && (false == curve->mappedKeyframes->resident)) {
+                curves.push_back(curve->mappedKeyframes);
+            }//if
+        }//foreach
+    }//foreach
+
+    if (true == curves.empty()) {
+        return;
+    }//if
+
+    //Whatever's left further back is skipped when it comes up again, since it'll be resident by then.  The
+    // queue can have run dry: these may be blocks the editor froze since.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.insert(queue.begin(), curves.begin(), curves.end());
+    }
+
+    if (false == thread.joinable()) {
+        thread = std::thread([=]() { prefetchThreadFunc(); });
+    }//if
+
+    condition.notify_all();
+}//prioritize
+
+bool KeyframePrefetcher::isIdle()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.empty();
+}//isIdle
+
+unsigned int KeyframePrefetcher::getNumFetched() const
+{
+    return numFetched;
+}//getNumFetched
+
+void KeyframePrefetcher::prefetchThreadFunc()
+{
+    while (true) {
+        std::shared_ptr<const MappedKeyframes> mappedKeyframes;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return (true == stopping) || (false == queue.empty()); });
+
+            if (true == stopping) {
+                return;
+            }//if
+
+            mappedKeyframes = queue.front();
+            queue.pop_front();
+        }
+
+        if (true == mappedKeyframes->resident) {
+            continue;
+        }//if
+
+        fetch(*mappedKeyframes);
+        mappedKeyframes->resident = true;
+        ++numFetched;
+    }//while
+}//prefetchThreadFunc
+
+//Asks for the pages of all five arrays, which lie together, then locks them in so the process callbacks never
+// fault on them later; clean pages of a mapped file can otherwise be dropped and read back at any time.  Where
+// they can't be locked (RLIMIT_MEMLOCK), the keys are copied out of the mapping instead.  The locks go with the
+// mapping (see BinaryProject.cc).  Packed keys are unpacked instead.
+void KeyframePrefetcher::fetch(const MappedKeyframes &mappedKeyframes)
+{
+    if (mappedKeyframes.packedKeys != nullptr) {
+        mappedKeyframes.unpack();
+        return;
+    }//if
+
+    if (0 == mappedKeyframes.numKeys) {
+        return;
+    }//if
+
+    static const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+    uintptr_t begin = (uintptr_t)mappedKeyframes.values;
+    uintptr_t end = (uintptr_t)(mappedKeyframes.curveTypes + mappedKeyframes.numKeys);
+    begin -= begin % pageSize;
+
+    madvise((void *)begin, end - begin, MADV_WILLNEED);
+
+    if (0 != mlock((void *)begin, end - begin)) {
+        mappedKeyframes.copyOutOfMapping();
+    }//if
+}//fetch
+
@@ -0,0 +1,60 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __KEYFRAMEPREFETCHER_H
+#define __KEYFRAMEPREFETCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct MappedKeyframes;
+class SequencerEntryBlock;
+
+//Brings the keys of a mapped binary project into memory on its own thread once the project is open, so the
+// window is up as soon as the entries and blocks have been read.  Curves go in song order, except that
+// prioritize() moves the blocks asked for (what's on screen, what the transport gets to next) to the front.
+// Nothing ever waits on it: a curve sampled or edited before it gets there faults in its own pages and no more.
+// Packed curves, from the file or frozen by the editor since (Animation::freezeKeyframes), are unpacked here.
+class KeyframePrefetcher
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::shared_ptr<const MappedKeyframes> > queue; //holds the mapping until it's been through
+    bool stopping;
+    std::atomic<unsigned int> numFetched;
+
+    KeyframePrefetcher();
+    ~KeyframePrefetcher();
+
+    void prefetchThreadFunc();
+    static void fetch(const MappedKeyframes &mappedKeyframes);
+
+public:
+    static KeyframePrefetcher &Instance();
+
+    //Replaces whatever was still queued from the last project
+    void start(const std::vector<std::shared_ptr<const MappedKeyframes> > &curves);
+    void clear();
+
+    //The first given is fetched first; starts the thread if a project never did
+    void prioritize(const std::vector<std::shared_ptr<SequencerEntryBlock> > &entryBlocks);
+
+    bool isIdle();
+    unsigned int getNumFetched() const; //goes up as curves come in
+};//KeyframePrefetcher
+
+
+#endif
+
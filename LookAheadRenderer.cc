@@ -0,0 +1,269 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "LookAheadRenderer.h"
+#include "FrameTime.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace
+{
+
+const size_t queueCapacity = 64 * 1024;
+const unsigned int defaultDepthPeriods = 8;
+
+}//anonymous namespace
+
+LookAheadRenderer::LookAheadRenderer(ChaseEngine &chaseEngine_, unsigned int maxClients) : chaseEngine(chaseEngine_)
+{
+    //The other clients' queues are made as they get ports
+    queues.resize(std::max(maxClients, 1U));
+    queues[0].reset(new SPSCQueue<LookAheadEvent>(queueCapacity));
+    portClients.reset(new std::map<jack_port_t *, unsigned int>);
+    numClients = 1;
+
+    running.store(false);
+    generation.store(0);
+    resyncFrame.store(0);
+    consumedFrame.store(0);
+    periodFrames.store(0);
+    frameRate.store(0);
+    rolling.store(false);
+    depthPeriods.store(defaultDepthPeriods);
+
+    renderedPeriods.store(0);
+    servedPeriods.store(0);
+    underruns.store(0);
+    resyncs.store(0);
+
+    renderGeneration = std::numeric_limits<unsigned int>::max();
+    renderFrame = 0;
+}//constructor
+
+LookAheadRenderer::~LookAheadRenderer()
+{
+    stop();
+}//destructor
+
+void LookAheadRenderer::start()
+{
+    if (true == running.exchange(true)) {
+        return;
+    }//if
+
+    thread = std::thread([=]() { renderThreadFunc(); });
+}//start
+
+void LookAheadRenderer::stop()
+{
+    if (false == running.exchange(false)) {
+        return;
+    }//if
+
+    thread.join();
+}//stop
+
+void LookAheadRenderer::renderAhead()
+{
+    while ((true == rolling.load(std::memory_order_acquire)) && (periodFrames.load() > 0) && (frameRate.load() > 0)) {
+        if (false == renderNextPeriod()) {
+            break;
+        }//if
+    }//while
+}//renderAhead
+
+void LookAheadRenderer::setPortClients(const std::map<jack_port_t *, unsigned int> &portClients_, unsigned int numClients_)
+{
+    std::lock_guard<std::mutex> lock(clientsMutex);
+
+    numClients = std::max(1U, std::min(numClients_, (unsigned int)queues.size()));
+    for (unsigned int client = 1; client < numClients; ++client) {
+        if (nullptr == queues[client]) {
+            queues[client].reset(new SPSCQueue<LookAheadEvent>(queueCapacity));
+        }//if
+    }//for
+
+    std::shared_ptr<std::map<jack_port_t *, unsigned int> > newPortClients(new std::map<jack_port_t *, unsigned int>);
+    for (auto portIter : portClients_) {
+        if (portIter.second < numClients) {
+            newPortClients->insert(portIter);
+        }//if
+    }//foreach
+
+    portClients = newPortClients;
+}//setPortClients
+
+void LookAheadRenderer::setDepth(unsigned int periods)
+{
+    if (periods < 1) {
+        periods = 1;
+    }//if
+
+    depthPeriods.store(periods);
+}//setDepth
+
+unsigned int LookAheadRenderer::getDepth()
+{
+    return depthPeriods.load();
+}//getDepth
+
+LookAheadStats LookAheadRenderer::getStats()
+{
+    LookAheadStats stats;
+    stats.renderedPeriods = renderedPeriods.load();
+    stats.servedPeriods = servedPeriods.load();
+    stats.underruns = underruns.load();
+    stats.resyncs = resyncs.load();
+
+    return stats;
+}//getStats
+
+void LookAheadRenderer::invalidate()
+{
+    //Start again from where the jack callback will be next
+    resyncFrame.store(consumedFrame.load(std::memory_order_acquire), std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+}//invalidate
+
+std::unique_lock<std::mutex> LookAheadRenderer::holdRendering()
+{
+    return std::unique_lock<std::mutex>(renderMutex);
+}//holdRendering
+
+void LookAheadRenderer::resync(jack_nframes_t fromFrame, jack_nframes_t nframes, jack_nframes_t rate)
+{
+    periodFrames.store(nframes, std::memory_order_relaxed);
+    frameRate.store(rate, std::memory_order_relaxed);
+    consumedFrame.store(fromFrame, std::memory_order_relaxed);
+    resyncFrame.store(fromFrame, std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+
+    resyncs.fetch_add(1, std::memory_order_relaxed);
+}//resync
+
+void LookAheadRenderer::setRolling(bool isRolling)
+{
+    rolling.store(isRolling, std::memory_order_release);
+}//setRolling
+
+void LookAheadRenderer::renderThreadFunc()
+{
+    while (true == running.load()) {
+        bool rendered = false;
+
+        if ((true == rolling.load(std::memory_order_acquire)) && (periodFrames.load() > 0) && (frameRate.load() > 0)) {
+            rendered = renderNextPeriod();
+        }//if
+
+        if (false == rendered) {
+            //Sleep about half a period; we are either far enough ahead or there is nothing to do
+            jack_nframes_t rate = frameRate.load();
+            long long sleepMicroseconds = 1000;
+            if (rate > 0) {
+                sleepMicroseconds = std::max(250LL, (long long)periodFrames.load() * 500000LL / rate);
+            }//if
+
+            std::this_thread::sleep_for(std::chrono::microseconds(sleepMicroseconds));
+        }//if
+    }//while
+}//renderThreadFunc
+
+bool LookAheadRenderer::renderNextPeriod()
+{
+    unsigned int currentGeneration = generation.load(std::memory_order_acquire);
+    if (currentGeneration != renderGeneration) {
+        renderGeneration = currentGeneration;
+        renderFrame = resyncFrame.load(std::memory_order_acquire);
+        lastRenderedValues.clear();
+    }//if
+
+    jack_nframes_t nframes = periodFrames.load();
+    jack_nframes_t targetFrame = consumedFrame.load(std::memory_order_acquire) + depthPeriods.load() * nframes;
+    if (renderFrame >= targetFrame) {
+        return false;
+    }//if
+
+    std::shared_ptr<ChaseSnapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(renderMutex);
+        snapshot = chaseEngine.buildSnapshot(framesToSampleTick(renderFrame, frameRate.load()));
+    }
+
+    //Which client gets which port, as of this period
+    std::shared_ptr<const std::map<jack_port_t *, unsigned int> > curPortClients;
+    unsigned int curNumClients = 1;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        curPortClients = portClients;
+        curNumClients = numClients;
+    }
+
+    batches.resize(curNumClients);
+    for (std::vector<LookAheadEvent> &batch : batches) {
+        batch.clear();
+        batch.push_back(LookAheadEvent());
+        batch[0].isHeader = true;
+        batch[0].generation = currentGeneration;
+        batch[0].frame = renderFrame;
+    }//foreach
+
+    //Only queue what changed since the previous rendered period; the jack callbacks still check against what was sent
+    for (const ChaseValue &chaseValue : snapshot->values) {
+        auto key = std::make_tuple(chaseValue.port, chaseValue.channel, chaseValue.controllerType, chaseValue.msb, chaseValue.lsb);
+        auto lastIter = lastRenderedValues.find(key);
+        if ((lastIter != lastRenderedValues.end()) && (lastIter->second == chaseValue.value)) {
+            continue;
+        }//if
+
+        unsigned int client = 0;
+        auto clientIter = curPortClients->find(chaseValue.port);
+        if (clientIter != curPortClients->end()) {
+            client = clientIter->second;
+        }//if
+
+        LookAheadEvent event;
+        event.isHeader = false;
+        event.generation = currentGeneration;
+        event.frame = renderFrame;
+        event.count = 0;
+        event.value = chaseValue;
+        batches[client].push_back(event);
+    }//foreach
+
+    //A resync while we were sampling makes this period worthless
+    if (generation.load(std::memory_order_acquire) != currentGeneration) {
+        return true;
+    }//if
+
+    //The main client's queue paces us.  Another client whose queue is full misses this period, so it samples
+    // it itself; what it missed is sent again with the next period we render for it.
+    if (queues[0]->freeSpace() < batches[0].size()) {
+        return false;
+    }//if
+
+    for (unsigned int client = 0; client < curNumClients; ++client) {
+        std::vector<LookAheadEvent> &batch = batches[client];
+        batch[0].count = batch.size() - 1;
+
+        if (queues[client]->push(&batch[0], batch.size()) == false) {
+            continue;
+        }//if
+
+        for (size_t index = 1; index < batch.size(); ++index) {
+            const ChaseValue &chaseValue = batch[index].value;
+            lastRenderedValues[std::make_tuple(chaseValue.port, chaseValue.channel, chaseValue.controllerType, chaseValue.msb, chaseValue.lsb)] = chaseValue.value;
+        }//for
+    }//for
+
+    renderFrame += nframes;
+    renderedPeriods.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}//renderNextPeriod
+
@@ -0,0 +1,163 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __LOOKAHEADRENDERER_H
+#define __LOOKAHEADRENDERER_H
+
+#include <jack/jack.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include "ChaseEngine.h"
+#include "SPSCQueue.h"
+
+//A period header is followed in the queue by 'count' values for that period
+struct LookAheadEvent
+{
+    bool isHeader;
+    unsigned int generation;
+    jack_nframes_t frame;
+    unsigned int count;
+    ChaseValue value;
+};//LookAheadEvent
+
+struct LookAheadStats
+{
+    unsigned long long renderedPeriods;
+    unsigned long long servedPeriods;
+    unsigned long long underruns; //periods that fell back to evaluating the curves in the jack callback
+    unsigned long long resyncs;
+};//LookAheadStats
+
+//Samples the project ahead of the transport on its own thread.  Each engine client consumes whole periods
+// for its own ports from a queue of its own; whenever the transport jumps the main client resyncs, which
+// bumps the generation and discards anything already rendered.
+class LookAheadRenderer
+{
+    ChaseEngine &chaseEngine;
+    std::vector<std::unique_ptr<SPSCQueue<LookAheadEvent> > > queues; //by client; never resized, only filled in
+    std::thread thread;
+    std::atomic<bool> running;
+
+    //Written by the jack callback (or invalidate()), read by the render thread
+    std::atomic<unsigned int> generation;
+    std::atomic<jack_nframes_t> resyncFrame;
+    std::atomic<jack_nframes_t> consumedFrame;
+    std::atomic<jack_nframes_t> periodFrames;
+    std::atomic<jack_nframes_t> frameRate;
+    std::atomic<bool> rolling;
+    std::atomic<unsigned int> depthPeriods;
+
+    std::atomic<unsigned long long> renderedPeriods;
+    std::atomic<unsigned long long> servedPeriods;
+    std::atomic<unsigned long long> underruns;
+    std::atomic<unsigned long long> resyncs;
+
+    std::mutex renderMutex; //held while the render thread samples the project
+
+    std::mutex clientsMutex;
+    std::shared_ptr<const std::map<jack_port_t *, unsigned int> > portClients; //ports not in here are the main client's
+    unsigned int numClients;
+
+    //Only touched by the render thread
+    unsigned int renderGeneration;
+    jack_nframes_t renderFrame;
+    std::map<std::tuple<jack_port_t *, unsigned char, ControlType, unsigned char, unsigned char>, unsigned short> lastRenderedValues;
+    std::vector<std::vector<LookAheadEvent> > batches; //by client
+
+    void renderThreadFunc();
+    bool renderNextPeriod();
+
+public:
+    LookAheadRenderer(ChaseEngine &chaseEngine, unsigned int maxClients);
+    ~LookAheadRenderer();
+
+    void start();
+    void stop();
+
+    //Renders on the calling thread until it's as far ahead as the depth allows.  Only while the render thread
+    // is stopped; the golden harness steps it this way between periods so the output doesn't depend on timing.
+    void renderAhead();
+
+    //Which client's queue each output port's values go to.  Call with the clients' callbacks held off, so a
+    // new client's queue is there before it first looks.
+    void setPortClients(const std::map<jack_port_t *, unsigned int> &portClients, unsigned int numClients);
+
+    void setDepth(unsigned int periods);
+    unsigned int getDepth();
+    LookAheadStats getStats();
+
+    //Call when the project data changes; everything queued is thrown away
+    void invalidate();
+
+    //While the lock's held the render thread isn't sampling; it waits for the period it's on to finish
+    std::unique_lock<std::mutex> holdRendering();
+
+    //The rest is for the jack callbacks only; resync and setRolling are the main client's
+    void resync(jack_nframes_t fromFrame, jack_nframes_t nframes, jack_nframes_t rate);
+    void setRolling(bool isRolling);
+
+    //The stats only count the main client's periods
+    template <typename Func>
+    bool consumePeriod(unsigned int client, jack_nframes_t periodFrame, jack_nframes_t nframes, Func func);
+};//LookAheadRenderer
+
+template <typename Func>
+bool LookAheadRenderer::consumePeriod(unsigned int client, jack_nframes_t periodFrame, jack_nframes_t nframes, Func func)
+{
+    SPSCQueue<LookAheadEvent> *queue = queues[client].get();
+    if (nullptr == queue) {
+        return false;
+    }//if
+
+    unsigned int currentGeneration = generation.load(std::memory_order_acquire);
+    if (0 == client) {
+        consumedFrame.store(periodFrame + nframes, std::memory_order_release);
+    }//if
+
+    while (LookAheadEvent *event = queue->peek()) {
+        //Drop anything from an old generation or a period we have already passed
+        if ((false == event->isHeader) || (event->generation != currentGeneration) || (event->frame < periodFrame)) {
+            queue->pop();
+            continue;
+        }//if
+
+        if (event->frame != periodFrame) {
+            break;
+        }//if
+
+        //The whole period was pushed as one batch, so its values are already there
+        unsigned int count = event->count;
+        queue->pop();
+
+        for (unsigned int index = 0; index < count; ++index) {
+            LookAheadEvent *valueEvent = queue->peek();
+            func(valueEvent->value);
+            queue->pop();
+        }//for
+
+        if (0 == client) {
+            servedPeriods.fetch_add(1, std::memory_order_relaxed);
+        }//if
+
+        return true;
+    }//while
+
+    if (0 == client) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }//if
+
+    return false;
+}//consumePeriod
+
+
+#endif
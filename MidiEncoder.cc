@@ -0,0 +1,153 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "MidiEncoder.h"
+#include "Data/SequencerEntry.h"
+
+MidiEncoder::MidiEncoder(bool useRunningStatus_)
+{
+    useRunningStatus = useRunningStatus_;
+
+    stats.naiveMessages = 0;
+    stats.naiveBytes = 0;
+    stats.encodedMessages = 0;
+    stats.encodedBytes = 0;
+
+    reset();
+}//constructor
+
+MidiEncoder::~MidiEncoder()
+{
+    //Nothing
+}//destructor
+
+void MidiEncoder::reset()
+{
+    for (ChannelState &channelState : channels) {
+        channelState.hasParameter = false;
+        channelState.parameterType = ControlType::CC;
+        channelState.parameterMsb = 0;
+        channelState.parameterLsb = 0;
+    }//foreach
+
+    runningStatus = 0;
+}//reset
+
+void MidiEncoder::breakRunningStatus()
+{
+    runningStatus = 0;
+}//breakRunningStatus
+
+void MidiEncoder::appendMessage(unsigned char channel, unsigned char controller, unsigned char value, unsigned char *buffer, size_t &length)
+{
+    unsigned char status = 0xb0 | (channel & 0x0f);
+
+    if ((false == useRunningStatus) || (status != runningStatus)) {
+        buffer[length++] = status;
+        stats.encodedBytes++;
+    }//if
+
+    buffer[length++] = controller & 0x7f;
+    buffer[length++] = value & 0x7f;
+    stats.encodedBytes += 2;
+    stats.encodedMessages++;
+
+    if (true == useRunningStatus) {
+        runningStatus = status;
+    }//if
+}//appendMessage
+
+unsigned int MidiEncoder::encode(const ChaseValue &chaseValue, int previousValue, unsigned char *buffer, size_t &length)
+{
+    unsigned char channel = chaseValue.channel & 0x0f;
+    ChannelState &channelState = channels[channel];
+
+    unsigned char valueMsb = chaseValue.value & 0x7f;
+    unsigned char valueLsb = 0;
+    if (true == chaseValue.fourteenBit) {
+        valueMsb = (chaseValue.value >> 7) & 0x7f;
+        valueLsb = chaseValue.value & 0x7f;
+    }//if
+
+    bool msbUnchanged = (true == chaseValue.fourteenBit) && (previousValue >= 0) && (((previousValue >> 7) & 0x7f) == valueMsb);
+
+    unsigned long long startMessages = stats.encodedMessages;
+
+    switch (chaseValue.controllerType) {
+        case ControlType::CC:
+            {
+                //Past CC 31 there's no msb + 32 (it'd land on some other controller), so unless the entry names one
+                // only the coarse value goes out
+                int fineController = -1;
+                if (true == chaseValue.fourteenBit) {
+                    if (true == chaseValue.fineOnLsb) {
+                        if ((chaseValue.lsb & 0x7f) != (chaseValue.msb & 0x7f)) {
+                            fineController = chaseValue.lsb & 0x7f;
+                        }//if
+                    } else if (chaseValue.msb < 32) {
+                        fineController = chaseValue.msb + 32;
+                    }//if
+                }//if
+
+                stats.naiveMessages += (fineController >= 0) ? 2 : 1;
+
+                if (false == msbUnchanged) {
+                    appendMessage(channel, chaseValue.msb, valueMsb, buffer, length);
+                }//if
+
+                if (fineController >= 0) {
+                    appendMessage(channel, (unsigned char)fineController, valueLsb, buffer, length);
+                }//if
+            }
+            break;
+
+        case ControlType::RPN:
+        case ControlType::NRPN:
+            {
+                stats.naiveMessages += (true == chaseValue.fourteenBit) ? 4 : 3;
+
+                bool isRPN = (ControlType::RPN == chaseValue.controllerType);
+                bool parameterSelected = (true == channelState.hasParameter) && (previousValue >= 0) && 
+                                         (channelState.parameterType == chaseValue.controllerType) &&
+                                         (channelState.parameterMsb == chaseValue.msb) && (channelState.parameterLsb == chaseValue.lsb);
+
+                if (false == parameterSelected) {
+                    appendMessage(channel, isRPN ? 101 : 99, chaseValue.msb, buffer, length);
+                    appendMessage(channel, isRPN ? 100 : 98, chaseValue.lsb, buffer, length);
+
+                    channelState.hasParameter = true;
+                    channelState.parameterType = chaseValue.controllerType;
+                    channelState.parameterMsb = chaseValue.msb;
+                    channelState.parameterLsb = chaseValue.lsb;
+
+                    //A new selection doesn't tell us the receiver's data entry value
+                    msbUnchanged = false;
+                }//if
+
+                if (false == msbUnchanged) {
+                    appendMessage(channel, 6, valueMsb, buffer, length);
+                }//if
+
+                if (true == chaseValue.fourteenBit) {
+                    appendMessage(channel, 38, valueLsb, buffer, length);
+                }//if
+            }
+            break;
+    }//switch
+
+    stats.naiveBytes = stats.naiveMessages * 3;
+
+    return (unsigned int)(stats.encodedMessages - startMessages);
+}//encode
+
+MidiEncoderStats MidiEncoder::getStats()
+{
+    return stats;
+}//getStats
+
@@ -0,0 +1,69 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __MIDIENCODER_H
+#define __MIDIENCODER_H
+
+#include "ChaseEngine.h"
+
+struct MidiEncoderStats
+{
+    unsigned long long naiveMessages; //what sending every byte of every update would have cost
+    unsigned long long naiveBytes;
+    unsigned long long encodedMessages;
+    unsigned long long encodedBytes;
+};//MidiEncoderStats
+
+//Turns lane values into controller messages for one output.  7 bit CC is a single message; 14 bit CC puts the
+// MSB on the lane's controller and the LSB on controller + 32, or on the entry's LSB controller when it names one
+// ("Use fine adjustment").  Controllers past 31 have no + 32, so without a named one only the MSB is sent.
+// RPN/NRPN select the parameter with CC 101/100 or CC 99/98 and send the value on data entry CC 6 (and CC 38
+// for 14 bit).  To keep traffic down:
+//  - when the MSB hasn't changed since the previous value only the LSB goes out
+//  - the parameter select is skipped while that parameter is still selected on the channel
+//  - with running status enabled (only where the transport allows it, ie: SMF) repeated status bytes are dropped
+class MidiEncoder
+{
+    struct ChannelState
+    {
+        bool hasParameter;
+        ControlType parameterType;
+        unsigned char parameterMsb;
+        unsigned char parameterLsb;
+    };//ChannelState
+
+    ChannelState channels[16];
+    bool useRunningStatus;
+    unsigned char runningStatus; //0 when there is none
+
+    MidiEncoderStats stats;
+
+    void appendMessage(unsigned char channel, unsigned char controller, unsigned char value, unsigned char *buffer, size_t &length);
+
+public:
+    static const size_t maxEncodedLength = 12; //four 3 byte messages
+
+    explicit MidiEncoder(bool useRunningStatus = false);
+    ~MidiEncoder();
+
+    //Appends the messages for one update to buffer.  previousValue is the value last sent on the lane, or -1 if
+    // the receiver's state is unknown (which always sends everything).  Without running status every message is
+    // exactly 3 bytes.  Returns the number of messages appended.
+    unsigned int encode(const ChaseValue &chaseValue, int previousValue, unsigned char *buffer, size_t &length);
+
+    //Forget the receiver state; ie: after a locate or when another source might have touched it
+    void reset();
+    //Running status never carries across a gap (a new JACK event, or an SMF meta event)
+    void breakRunningStatus();
+
+    MidiEncoderStats getStats();
+};//MidiEncoder
+
+
+#endif
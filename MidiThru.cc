@@ -0,0 +1,335 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "MidiThru.h"
+#include <algorithm>
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Animation.h"
+#include "Globals.h"
+
+namespace
+{
+
+bool thruRouteLess(const ThruRoute &a, const ThruRoute &b)
+{
+    if (a.inputPort != b.inputPort) {
+        return a.inputPort < b.inputPort;
+    }//if
+
+    return a.controller < b.controller;
+}//thruRouteLess
+
+bool thruEventLess(const ThruEvent &a, const ThruEvent &b)
+{
+    if (a.value.port != b.value.port) {
+        return a.value.port < b.value.port;
+    }//if
+
+    return a.frame < b.frame;
+}//thruEventLess
+
+}//anonymous namespace
+
+ThruTokenizer::ThruTokenizer()
+{
+    reset();
+}//constructor
+
+void ThruTokenizer::reset()
+{
+    state = State::Idle;
+    runningStatus = 0;
+    channel = 0;
+    controller = 0;
+}//reset
+
+bool ThruTokenizer::feed(unsigned char byte, unsigned char &channelOut, unsigned char &controllerOut, unsigned char &valueOut)
+{
+    //Realtime messages can show up anywhere and don't disturb anything
+    if (byte >= 0xf8) {
+        return false;
+    }//if
+
+    if (byte & 0x80) {
+        if (0xf7 == byte) {
+            state = State::Idle;
+            return false;
+        }//if
+
+        if (byte >= 0xf0) {
+            runningStatus = 0;
+
+            switch (byte) {
+                case 0xf0:
+                    state = State::Sysex;
+                    break;
+                case 0xf2: //song position pointer
+                    state = State::IgnoredTwoData;
+                    break;
+                case 0xf1: //time code quarter frame
+                case 0xf3: //song select
+                    state = State::IgnoredOneData;
+                    break;
+                default:
+                    state = State::Idle;
+                    break;
+            }//switch
+
+            return false;
+        }//if
+
+        runningStatus = byte;
+        switch (byte >> 4) {
+            case 0x0b: //cc
+                channel = byte & 0x0f;
+                state = State::CC_Controller;
+                break;
+            case 0x0c: //prog change +1
+            case 0x0d: //aftertouch +1
+                state = State::IgnoredOneData;
+                break;
+            default:
+                state = State::IgnoredTwoData;
+                break;
+        }//switch
+
+        return false;
+    }//if
+
+    switch (state) {
+        case State::Idle:
+            //Running status: data bytes restart the last channel message
+            if (0xb0 == (runningStatus & 0xf0)) {
+                controller = byte;
+                state = State::CC_Value;
+            } else if ((0xc0 == (runningStatus & 0xf0)) || (0xd0 == (runningStatus & 0xf0))) {
+                state = State::Idle;
+            } else if (0 != runningStatus) {
+                state = State::IgnoredOneData;
+            }//if
+            break;
+
+        case State::CC_Controller:
+            controller = byte;
+            state = State::CC_Value;
+            break;
+
+        case State::CC_Value:
+            channelOut = channel;
+            controllerOut = controller;
+            valueOut = byte;
+            state = State::Idle;
+            return true;
+
+        case State::Sysex:
+            break;
+
+        case State::IgnoredTwoData:
+            state = State::IgnoredOneData;
+            break;
+
+        case State::IgnoredOneData:
+            state = State::Idle;
+            break;
+    }//switch
+
+    return false;
+}//feed
+
+MidiThru::MidiThru()
+{
+    active = false;
+    replacePlayback = false;
+    numEvents = 0;
+    cycleFrame = 0;
+
+    stats.forwardedMessages = 0;
+    stats.droppedMessages = 0;
+    stats.maxLatencyFrames = 0;
+}//constructor
+
+MidiThru::~MidiThru()
+{
+    //Nothing
+}//destructor
+
+std::vector<ThruRoute> MidiThru::buildRoutes()
+{
+    Globals &globals = Globals::Instance();
+
+    std::vector<ThruRoute> routes;
+
+    //Same filtering as SequencerEntry::addRecordToken
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        std::shared_ptr<SequencerEntryImpl> impl = entry->getImpl();
+        if ((false == impl->recordMode) || (ControlType::CC != impl->controllerType)) {
+            continue;
+        }//if
+
+        for (jack_port_t *inputPort : entry->getInputPorts()) {
+            for (jack_port_t *outputPort : entry->getOutputPorts()) {
+                ThruRoute route;
+                route.inputPort = inputPort;
+                route.inputChannel = impl->channel;
+                route.controller = impl->msb;
+                route.minValue = impl->minValue;
+                route.maxValue = impl->maxValue;
+
+                route.output = ChaseEngine::makeLane(*entry, outputPort);
+                route.output.deadband = 0;
+
+                routes.push_back(route);
+            }//foreach
+        }//foreach
+    }//foreach
+
+    return routes;
+}//buildRoutes
+
+void MidiThru::start(const std::vector<ThruRoute> &routes_, InsertMode insertMode)
+{
+    routes = routes_;
+    std::stable_sort(routes.begin(), routes.end(), thruRouteLess);
+
+    tokenizers.clear();
+    armedLanes.clear();
+    for (const ThruRoute &route : routes) {
+        tokenizers[route.inputPort].reset();
+        armedLanes.insert(std::make_tuple(route.output.port, route.output.channel, route.output.controllerType, route.output.msb, route.output.lsb));
+    }//foreach
+
+    replacePlayback = (InsertMode::Replace == insertMode);
+    numEvents = 0;
+
+    stats.forwardedMessages = 0;
+    stats.droppedMessages = 0;
+    stats.maxLatencyFrames = 0;
+
+    active = (routes.empty() == false);
+}//start
+
+void MidiThru::stop()
+{
+    active = false;
+    routes.clear();
+    tokenizers.clear();
+    armedLanes.clear();
+    numEvents = 0;
+}//stop
+
+bool MidiThru::isActive()
+{
+    return active;
+}//isActive
+
+void MidiThru::beginPeriod(jack_nframes_t cycleFrame_)
+{
+    numEvents = 0;
+    cycleFrame = cycleFrame_;
+}//beginPeriod
+
+void MidiThru::addInput(jack_port_t *port, jack_nframes_t frame, const unsigned char *data, size_t length)
+{
+    auto tokenizerIter = tokenizers.find(port);
+    if (tokenizerIter == tokenizers.end()) {
+        return;
+    }//if
+
+    for (size_t index = 0; index < length; ++index) {
+        unsigned char channel;
+        unsigned char controller;
+        unsigned char value;
+        if (tokenizerIter->second.feed(data[index], channel, controller, value) == false) {
+            continue;
+        }//if
+
+        ThruRoute key;
+        key.inputPort = port;
+        key.controller = controller;
+
+        auto routeRange = std::equal_range(routes.begin(), routes.end(), key, thruRouteLess);
+        for (auto routeIter = routeRange.first; routeIter != routeRange.second; ++routeIter) {
+            const ThruRoute &route = *routeIter;
+            if ((route.inputChannel != 16) && (route.inputChannel != channel)) {
+                continue;
+            }//if
+
+            if (numEvents >= maxEventsPerPeriod) {
+                stats.droppedMessages++;
+                continue;
+            }//if
+
+            //Recorded values are stored in the entry's units; scale them the same way playback does
+            double normalized = 0;
+            if (route.maxValue > route.minValue) {
+                normalized = ((double)value - route.minValue) / (double)(route.maxValue - route.minValue);
+                normalized = std::min(1.0, std::max(0.0, normalized));
+            }//if
+
+            ThruEvent &event = events[numEvents++];
+            event.frame = frame;
+            event.cycleFrame = cycleFrame;
+            event.inputPort = port;
+            event.value = route.output;
+            event.value.value = (unsigned short)(normalized * ((true == route.output.fourteenBit) ? 16383.0 : 127.0) + 0.5);
+
+            //An entry on any channel plays back on whatever channel it was fed
+            if (16 == route.output.channel) {
+                event.value.channel = channel;
+            }//if
+        }//for
+    }//for
+}//addInput
+
+void MidiThru::sortEvents()
+{
+    //Insertion sort; events mostly arrive in order and we can't allocate here
+    for (size_t index = 1; index < numEvents; ++index) {
+        ThruEvent event = events[index];
+        size_t position = index;
+        while ((position > 0) && (thruEventLess(event, events[position - 1]) == true)) {
+            events[position] = events[position - 1];
+            --position;
+        }//while
+
+        events[position] = event;
+    }//for
+}//sortEvents
+
+size_t MidiThru::getNumEvents()
+{
+    return numEvents;
+}//getNumEvents
+
+const ThruEvent &MidiThru::getEvent(size_t index)
+{
+    return events[index];
+}//getEvent
+
+void MidiThru::noteLatency(jack_nframes_t latencyFrames)
+{
+    stats.forwardedMessages++;
+    stats.maxLatencyFrames = std::max(stats.maxLatencyFrames, latencyFrames);
+}//noteLatency
+
+bool MidiThru::suppressesPlayback(const ChaseValue &chaseValue)
+{
+    if ((false == active) || (false == replacePlayback)) {
+        return false;
+    }//if
+
+    return armedLanes.find(std::make_tuple(chaseValue.port, chaseValue.channel, chaseValue.controllerType, chaseValue.msb, chaseValue.lsb)) != armedLanes.end();
+}//suppressesPlayback
+
+ThruStats MidiThru::getStats()
+{
+    return stats;
+}//getStats
+
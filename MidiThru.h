@@ -0,0 +1,117 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __MIDITHRU_H
+#define __MIDITHRU_H
+
+#include <jack/jack.h>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+#include "ChaseEngine.h"
+
+enum class InsertMode : char;
+
+//An input controller that lands on a record armed entry, and where the entry plays it out
+struct ThruRoute
+{
+    jack_port_t *inputPort;
+    unsigned char inputChannel; //16 is any channel
+    unsigned char controller;
+    ChaseValue output; //port, channel and controller of the entry; value unused
+    int minValue;
+    int maxValue;
+};//ThruRoute
+
+struct ThruEvent
+{
+    jack_nframes_t frame;      //into the period it came in
+    jack_nframes_t cycleFrame; //JACK's frame time at the start of that period
+    jack_port_t *inputPort;
+    ChaseValue value;
+};//ThruEvent
+
+struct ThruStats
+{
+    unsigned long long forwardedMessages;
+    unsigned long long droppedMessages; //more than fit in a period's event buffer
+    jack_nframes_t maxLatencyFrames;    //from arriving at our input port to leaving our output port, plus both ports' latencies
+};//ThruStats
+
+//Byte at a time controller parser for the RT thread: fixed state, no allocation, handles running status
+class ThruTokenizer
+{
+    enum class State : char
+    {
+        Idle,
+        CC_Controller,
+        CC_Value,
+        Sysex,
+        IgnoredOneData,
+        IgnoredTwoData,
+    };//State
+
+    State state;
+    unsigned char runningStatus;
+    unsigned char channel;
+    unsigned char controller;
+
+public:
+    ThruTokenizer();
+
+    void reset();
+    //True when byte completes a controller message
+    bool feed(unsigned char byte, unsigned char &channelOut, unsigned char &controllerOut, unsigned char &valueOut);
+};//ThruTokenizer
+
+//Forwards controllers from the inputs straight to the record armed entries' outputs while recording.  The
+// routing table is built when recording starts; the RT side only looks things up.
+class MidiThru
+{
+    static const size_t maxEventsPerPeriod = 512;
+
+    std::vector<ThruRoute> routes; //sorted by input port then controller
+    std::map<jack_port_t *, ThruTokenizer> tokenizers;
+    std::set<std::tuple<jack_port_t *, unsigned char, ControlType, unsigned char, unsigned char> > armedLanes;
+    bool active;
+    bool replacePlayback;
+
+    ThruEvent events[maxEventsPerPeriod];
+    size_t numEvents;
+    jack_nframes_t cycleFrame;
+
+    ThruStats stats;
+
+public:
+    MidiThru();
+    ~MidiThru();
+
+    static std::vector<ThruRoute> buildRoutes(); //from the current project; not for the RT thread
+
+    void start(const std::vector<ThruRoute> &routes, InsertMode insertMode);
+    void stop();
+    bool isActive();
+
+    //RT side
+    void beginPeriod(jack_nframes_t cycleFrame);
+    void addInput(jack_port_t *port, jack_nframes_t frame, const unsigned char *data, size_t length);
+    void sortEvents(); //by output port then frame
+    size_t getNumEvents();
+    const ThruEvent &getEvent(size_t index);
+    void noteLatency(jack_nframes_t latencyFrames);
+
+    //In replace mode the armed lanes only carry what is being played in
+    bool suppressesPlayback(const ChaseValue &chaseValue);
+
+    ThruStats getStats();
+};//MidiThru
+
+
+#endif
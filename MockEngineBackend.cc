@@ -0,0 +1,507 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "MockEngineBackend.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+//JACK2 keeps each event in a 12 byte header, with up to four bytes of data inline
+size_t midiEventCost(size_t size)
+{
+    return 12 + ((size > 4) ? size : 0);
+}//midiEventCost
+
+}//anonymous namespace
+
+MockEngineBackend::MockEngineBackend(jack_nframes_t sampleRate_, jack_nframes_t periodSize_)
+{
+    sampleRate = sampleRate_;
+    periodSize = periodSize_;
+    midiBufferBytes = periodSize * sizeof(float);
+    capturing = true;
+
+    period = 0;
+    cycleStartFrame = 0;
+    transportState = JackTransportStopped;
+    transportFrame = 0;
+    cycleTransportState = JackTransportStopped;
+    cycleTransportFrame = 0;
+}//constructor
+
+MockEngineBackend::~MockEngineBackend()
+{
+    //Nothing
+}//destructor
+
+void MockEngineBackend::scheduleTransport(unsigned long long atPeriod, MockTransportAction action, jack_nframes_t frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    transportScript.insert(std::make_pair(atPeriod, std::make_pair(action, frame)));
+}//scheduleTransport
+
+void MockEngineBackend::scheduleInput(const std::string &portName, FramePosition frame, const std::vector<unsigned char> &data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    inputScript.insert(std::make_pair(frame, std::make_pair(portName, data)));
+}//scheduleInput
+
+void MockEngineBackend::setPortLatency(const std::string &portName, jack_latency_callback_mode_t mode, jack_nframes_t minFrames, jack_nframes_t maxFrames)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        jack_latency_range_t range;
+        range.min = minFrames;
+        range.max = maxFrames;
+
+        if (JackPlaybackLatency == mode) {
+            playbackLatencies[portName] = range;
+        } else {
+            captureLatencies[portName] = range;
+        }//if
+    }
+
+    notifyLatencyChanged();
+}//setPortLatency
+
+void MockEngineBackend::setMidiBufferBytes(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    midiBufferBytes = bytes;
+}//setMidiBufferBytes
+
+void MockEngineBackend::setCapturing(bool capturing_)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    capturing = capturing_;
+}//setCapturing
+
+void MockEngineBackend::triggerXrun()
+{
+    std::vector<std::pair<JackXRunCallback, void *> > callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &client : clients) {
+            if ((true == client->active) && (client->xrunCallback != nullptr)) {
+                callbacks.push_back(std::make_pair(client->xrunCallback, client->xrunArg));
+            }//if
+        }//foreach
+    }
+
+    for (auto &callback : callbacks) {
+        (void)callback.first(callback.second);
+    }//foreach
+}//triggerXrun
+
+void MockEngineBackend::notifyLatencyChanged()
+{
+    std::vector<std::pair<JackLatencyCallback, void *> > callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &client : clients) {
+            if ((true == client->active) && (client->latencyCallback != nullptr)) {
+                callbacks.push_back(std::make_pair(client->latencyCallback, client->latencyArg));
+            }//if
+        }//foreach
+    }
+
+    for (auto &callback : callbacks) {
+        callback.first(JackCaptureLatency, callback.second);
+        callback.first(JackPlaybackLatency, callback.second);
+    }//foreach
+}//notifyLatencyChanged
+
+void MockEngineBackend::runPeriods(unsigned long long numPeriods)
+{
+    std::vector<std::pair<JackProcessCallback, void *> > callbacks;
+
+    for (unsigned long long periodNum = 0; periodNum < numPeriods; ++periodNum) {
+        FramePosition periodStartFrame = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            //Nothing from the last period can still be looking at these
+            retiredPorts.clear();
+            retiredClients.clear();
+
+            auto scriptRange = transportScript.equal_range(period);
+            for (auto scriptIter = scriptRange.first; scriptIter != scriptRange.second; ++scriptIter) {
+                transportRequests.push_back(scriptIter->second);
+            }//for
+            transportScript.erase(scriptRange.first, scriptRange.second);
+
+            for (auto &request : transportRequests) {
+                switch (request.first) {
+                    case MockTransportAction::Start:
+                        transportState = JackTransportRolling;
+                        break;
+
+                    case MockTransportAction::Stop:
+                        transportState = JackTransportStopped;
+                        break;
+
+                    case MockTransportAction::Locate:
+                        transportFrame = request.second;
+                        break;
+                }//switch
+            }//foreach
+            transportRequests.clear();
+
+            cycleTransportState = transportState;
+            cycleTransportFrame = transportFrame;
+
+            periodStartFrame = (FramePosition)period * periodSize;
+            cycleStartFrame = periodStartFrame;
+            FramePosition periodEndFrame = periodStartFrame + periodSize;
+
+            for (auto &port : ports) {
+                clearMidiBuffer(&port->buffer);
+            }//foreach
+
+            auto inputEnd = inputScript.lower_bound(periodEndFrame);
+            for (auto inputIter = inputScript.begin(); inputIter != inputEnd; ++inputIter) {
+                for (auto &port : ports) {
+                    if ((port->shortName == inputIter->second.first) && (0 != (port->flags & JackPortIsInput))) {
+                        const std::vector<unsigned char> &data = inputIter->second.second;
+                        jack_nframes_t frame = (jack_nframes_t)std::max((FramePosition)0, inputIter->first - periodStartFrame);
+                        (void)writeMidiEvent(&port->buffer, frame, data.data(), data.size());
+                    }//if
+                }//foreach
+            }//for
+            inputScript.erase(inputScript.begin(), inputEnd);
+
+            callbacks.clear();
+            for (auto &client : clients) {
+                if ((true == client->active) && (client->processCallback != nullptr)) {
+                    callbacks.push_back(std::make_pair(client->processCallback, client->processArg));
+                }//if
+            }//foreach
+        }
+
+        for (auto &callback : callbacks) {
+            callback.first(periodSize, callback.second);
+        }//foreach
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (true == capturing) {
+                for (auto &port : ports) {
+                    if (0 == (port->flags & JackPortIsOutput)) {
+                        continue;
+                    }//if
+
+                    for (const MockMidiEvent &event : port->buffer.events) {
+                        MockOutputEvent outputEvent;
+                        outputEvent.frame = periodStartFrame + event.frame;
+                        outputEvent.portName = port->shortName;
+                        outputEvent.data.assign(port->buffer.data.begin() + event.offset, port->buffer.data.begin() + event.offset + event.size);
+                        capturedOutput.push_back(outputEvent);
+                    }//foreach
+                }//foreach
+            }//if
+
+            if (JackTransportRolling == transportState) {
+                transportFrame += periodSize;
+            }//if
+
+            period++;
+        }
+    }//for
+}//runPeriods
+
+unsigned long long MockEngineBackend::getPeriod()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return period;
+}//getPeriod
+
+std::vector<MockOutputEvent> MockEngineBackend::takeCapturedOutput()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<MockOutputEvent> output;
+    output.swap(capturedOutput);
+    return output;
+}//takeCapturedOutput
+
+MockEngineBackend::MockPort *MockEngineBackend::findPort(const std::string &fullName)
+{
+    for (auto &port : ports) {
+        if (port->fullName == fullName) {
+            return port.get();
+        }//if
+    }//foreach
+
+    return nullptr;
+}//findPort
+
+jack_client_t *MockEngineBackend::openClient(const std::string &clientName)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unique_ptr<MockClient> client(new MockClient);
+    client->name = clientName;
+    client->active = false;
+    client->processCallback = nullptr;
+    client->processArg = nullptr;
+    client->latencyCallback = nullptr;
+    client->latencyArg = nullptr;
+    client->shutdownCallback = nullptr;
+    client->shutdownArg = nullptr;
+    client->xrunCallback = nullptr;
+    client->xrunArg = nullptr;
+
+    clients.push_back(std::move(client));
+    return reinterpret_cast<jack_client_t *>(clients.back().get());
+}//openClient
+
+void MockEngineBackend::closeClient(jack_client_t *client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MockClient *mockClient = reinterpret_cast<MockClient *>(client);
+
+    for (auto portIter = ports.begin(); portIter != ports.end(); /*nothing*/) {
+        if ((*portIter)->client == mockClient) {
+            retiredPorts.push_back(std::move(*portIter));
+            portIter = ports.erase(portIter);
+        } else {
+            ++portIter;
+        }//if
+    }//for
+
+    for (auto clientIter = clients.begin(); clientIter != clients.end(); ++clientIter) {
+        if (clientIter->get() == mockClient) {
+            (*clientIter)->active = false;
+            retiredClients.push_back(std::move(*clientIter));
+            clients.erase(clientIter);
+            break;
+        }//if
+    }//for
+}//closeClient
+
+bool MockEngineBackend::activate(jack_client_t *client)
+{
+    //No latency callback here; JACK makes it from its own thread, and clients read their latencies after
+    // activating anyways
+    std::lock_guard<std::mutex> lock(mutex);
+    reinterpret_cast<MockClient *>(client)->active = true;
+    return true;
+}//activate
+
+void MockEngineBackend::setProcessCallback(jack_client_t *client, JackProcessCallback callback, void *arg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    reinterpret_cast<MockClient *>(client)->processCallback = callback;
+    reinterpret_cast<MockClient *>(client)->processArg = arg;
+}//setProcessCallback
+
+void MockEngineBackend::setLatencyCallback(jack_client_t *client, JackLatencyCallback callback, void *arg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    reinterpret_cast<MockClient *>(client)->latencyCallback = callback;
+    reinterpret_cast<MockClient *>(client)->latencyArg = arg;
+}//setLatencyCallback
+
+void MockEngineBackend::setShutdownCallback(jack_client_t *client, JackShutdownCallback callback, void *arg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    reinterpret_cast<MockClient *>(client)->shutdownCallback = callback;
+    reinterpret_cast<MockClient *>(client)->shutdownArg = arg;
+}//setShutdownCallback
+
+void MockEngineBackend::setXrunCallback(jack_client_t *client, JackXRunCallback callback, void *arg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    reinterpret_cast<MockClient *>(client)->xrunCallback = callback;
+    reinterpret_cast<MockClient *>(client)->xrunArg = arg;
+}//setXrunCallback
+
+jack_nframes_t MockEngineBackend::getSampleRate(jack_client_t *client)
+{
+    return sampleRate;
+}//getSampleRate
+
+jack_nframes_t MockEngineBackend::getBufferSize(jack_client_t *client)
+{
+    return periodSize;
+}//getBufferSize
+
+jack_port_t *MockEngineBackend::registerPort(jack_client_t *client, const std::string &portName, unsigned long flags)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MockClient *mockClient = reinterpret_cast<MockClient *>(client);
+    std::string fullName = mockClient->name + ":" + portName;
+    if (findPort(fullName) != nullptr) {
+        return nullptr;
+    }//if
+
+    std::unique_ptr<MockPort> port(new MockPort);
+    port->client = mockClient;
+    port->shortName = portName;
+    port->fullName = fullName;
+    port->flags = flags;
+    port->buffer.usedBytes = 0;
+
+    ports.push_back(std::move(port));
+    return reinterpret_cast<jack_port_t *>(ports.back().get());
+}//registerPort
+
+void MockEngineBackend::unregisterPort(jack_client_t *client, jack_port_t *port)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto portIter = ports.begin(); portIter != ports.end(); ++portIter) {
+        if (reinterpret_cast<jack_port_t *>(portIter->get()) == port) {
+            retiredPorts.push_back(std::move(*portIter));
+            ports.erase(portIter);
+            break;
+        }//if
+    }//for
+}//unregisterPort
+
+std::string MockEngineBackend::getPortName(jack_port_t *port)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return reinterpret_cast<MockPort *>(port)->fullName;
+}//getPortName
+
+std::vector<std::string> MockEngineBackend::getPortConnections(jack_client_t *client, jack_port_t *port)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return reinterpret_cast<MockPort *>(port)->connections;
+}//getPortConnections
+
+void MockEngineBackend::connectPorts(jack_client_t *client, const std::string &sourcePort, const std::string &destinationPort)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MockPort *source = findPort(sourcePort);
+    if (source != nullptr) {
+        source->connections.push_back(destinationPort);
+    }//if
+
+    MockPort *destination = findPort(destinationPort);
+    if (destination != nullptr) {
+        destination->connections.push_back(sourcePort);
+    }//if
+}//connectPorts
+
+jack_latency_range_t MockEngineBackend::getPortLatency(jack_port_t *port, jack_latency_callback_mode_t mode)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    jack_latency_range_t range;
+    range.min = 0;
+    range.max = 0;
+
+    const std::map<std::string, jack_latency_range_t> &latencies = (JackPlaybackLatency == mode) ? playbackLatencies : captureLatencies;
+    auto latencyIter = latencies.find(reinterpret_cast<MockPort *>(port)->shortName);
+    if (latencyIter != latencies.end()) {
+        range = latencyIter->second;
+    }//if
+
+    return range;
+}//getPortLatency
+
+void *MockEngineBackend::getPortBuffer(jack_port_t *port, jack_nframes_t nframes)
+{
+    return &reinterpret_cast<MockPort *>(port)->buffer;
+}//getPortBuffer
+
+void MockEngineBackend::clearMidiBuffer(void *portBuffer)
+{
+    MockMidiBuffer *buffer = static_cast<MockMidiBuffer *>(portBuffer);
+    buffer->events.clear();
+    buffer->data.clear();
+    buffer->usedBytes = 0;
+}//clearMidiBuffer
+
+unsigned int MockEngineBackend::getMidiEventCount(void *portBuffer)
+{
+    return static_cast<MockMidiBuffer *>(portBuffer)->events.size();
+}//getMidiEventCount
+
+bool MockEngineBackend::getMidiEvent(void *portBuffer, unsigned int eventIndex, jack_midi_event_t &event)
+{
+    MockMidiBuffer *buffer = static_cast<MockMidiBuffer *>(portBuffer);
+    if (eventIndex >= buffer->events.size()) {
+        return false;
+    }//if
+
+    const MockMidiEvent &mockEvent = buffer->events[eventIndex];
+    event.time = mockEvent.frame;
+    event.size = mockEvent.size;
+    event.buffer = buffer->data.data() + mockEvent.offset;
+    return true;
+}//getMidiEvent
+
+bool MockEngineBackend::writeMidiEvent(void *portBuffer, jack_nframes_t frame, const unsigned char *data, size_t size)
+{
+    MockMidiBuffer *buffer = static_cast<MockMidiBuffer *>(portBuffer);
+
+    //Same rules as JACK: inside the period, in order, and only as much as the port buffer holds
+    if ((frame >= periodSize) || ((buffer->events.empty() == false) && (frame < buffer->events.back().frame))) {
+        return false;
+    }//if
+
+    if (buffer->usedBytes + midiEventCost(size) > midiBufferBytes) {
+        return false;
+    }//if
+
+    MockMidiEvent event;
+    event.frame = frame;
+    event.offset = buffer->data.size();
+    event.size = size;
+
+    buffer->events.push_back(event);
+    buffer->data.insert(buffer->data.end(), data, data + size);
+    buffer->usedBytes += midiEventCost(size);
+    return true;
+}//writeMidiEvent
+
+jack_nframes_t MockEngineBackend::getCycleStartFrame(jack_client_t *client)
+{
+    return (jack_nframes_t)cycleStartFrame;
+}//getCycleStartFrame
+
+jack_transport_state_t MockEngineBackend::queryTransport(jack_client_t *client, jack_position_t &pos)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    memset(&pos, 0, sizeof(pos));
+    pos.frame = cycleTransportFrame;
+    pos.frame_rate = sampleRate;
+    return cycleTransportState;
+}//queryTransport
+
+void MockEngineBackend::locateTransport(jack_client_t *client, jack_nframes_t frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    transportRequests.push_back(std::make_pair(MockTransportAction::Locate, frame));
+}//locateTransport
+
+void MockEngineBackend::startTransport(jack_client_t *client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    transportRequests.push_back(std::make_pair(MockTransportAction::Start, 0U));
+}//startTransport
+
+void MockEngineBackend::stopTransport(jack_client_t *client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    transportRequests.push_back(std::make_pair(MockTransportAction::Stop, 0U));
+}//stopTransport
+
@@ -0,0 +1,160 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __MOCKENGINEBACKEND_H
+#define __MOCKENGINEBACKEND_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "EngineBackend.h"
+#include "FrameTime.h"
+
+enum class MockTransportAction : char
+{
+    Start,
+    Stop,
+    Locate
+};//MockTransportAction
+
+struct MockOutputEvent
+{
+    FramePosition frame; //period * period size + offset into the period; wall clock, not transport time
+    std::string portName; //without the client name, so moving a port to another client doesn't change it
+    std::vector<unsigned char> data;
+};//MockOutputEvent
+
+//An in-process stand-in for the JACK server.  Nothing runs until runPeriods() is called; it then plays the
+// transport script and the scripted input into each period and calls every active client's process callback
+// in the order they were opened, on the calling thread.  Whatever the clients wrote to their output ports is
+// captured with its frame.  Like JACK, transport requests made during a period take effect at the start of
+// the next one.
+class MockEngineBackend : public EngineBackend
+{
+    struct MockMidiEvent
+    {
+        jack_nframes_t frame;
+        size_t offset;
+        size_t size;
+    };//MockMidiEvent
+
+    struct MockMidiBuffer
+    {
+        std::vector<MockMidiEvent> events;
+        std::vector<unsigned char> data;
+        size_t usedBytes;
+    };//MockMidiBuffer
+
+    struct MockClient
+    {
+        std::string name;
+        bool active;
+        JackProcessCallback processCallback;
+        void *processArg;
+        JackLatencyCallback latencyCallback;
+        void *latencyArg;
+        JackShutdownCallback shutdownCallback;
+        void *shutdownArg;
+        JackXRunCallback xrunCallback;
+        void *xrunArg;
+    };//MockClient
+
+    struct MockPort
+    {
+        MockClient *client;
+        std::string shortName;
+        std::string fullName;
+        unsigned long flags;
+        MockMidiBuffer buffer;
+        std::vector<std::string> connections;
+    };//MockPort
+
+    std::mutex mutex; //never held across a process callback, so the callbacks can call back in
+    std::vector<std::unique_ptr<MockClient> > clients;
+    std::vector<std::unique_ptr<MockPort> > ports;
+    std::vector<std::unique_ptr<MockClient> > retiredClients; //freed at the top of the next period
+    std::vector<std::unique_ptr<MockPort> > retiredPorts;
+
+    std::map<std::string, jack_latency_range_t> playbackLatencies; //by short port name
+    std::map<std::string, jack_latency_range_t> captureLatencies;
+
+    std::multimap<unsigned long long, std::pair<MockTransportAction, jack_nframes_t> > transportScript; //by period
+    std::multimap<FramePosition, std::pair<std::string, std::vector<unsigned char> > > inputScript;
+    std::vector<std::pair<MockTransportAction, jack_nframes_t> > transportRequests;
+
+    std::vector<MockOutputEvent> capturedOutput;
+    bool capturing;
+
+    jack_nframes_t sampleRate;
+    jack_nframes_t periodSize;
+    size_t midiBufferBytes;
+
+    unsigned long long period;
+    jack_transport_state_t transportState;
+    jack_nframes_t transportFrame;
+    jack_transport_state_t cycleTransportState; //what queries see for the whole period
+    jack_nframes_t cycleTransportFrame;
+    FramePosition cycleStartFrame; //only changed between periods, so the callbacks can read it without the lock
+
+    MockPort *findPort(const std::string &fullName);
+    void notifyLatencyChanged();
+
+public:
+    MockEngineBackend(jack_nframes_t sampleRate, jack_nframes_t periodSize);
+    virtual ~MockEngineBackend();
+
+    //Scripting; frames given to scheduleInput are wall clock frames like MockOutputEvent's
+    void scheduleTransport(unsigned long long atPeriod, MockTransportAction action, jack_nframes_t frame = 0);
+    void scheduleInput(const std::string &portName, FramePosition frame, const std::vector<unsigned char> &data);
+    void setPortLatency(const std::string &portName, jack_latency_callback_mode_t mode, jack_nframes_t minFrames, jack_nframes_t maxFrames);
+    void setMidiBufferBytes(size_t bytes); //per port per period; defaults to what JACK gives a MIDI port
+    void setCapturing(bool capturing); //benchmarks can turn this off so the capture doesn't grow without bound
+    void triggerXrun(); //calls every client's xrun callback, as the server does after a late period
+
+    void runPeriods(unsigned long long numPeriods);
+    unsigned long long getPeriod();
+    std::vector<MockOutputEvent> takeCapturedOutput(); //hands over everything captured so far
+
+    virtual jack_client_t *openClient(const std::string &clientName);
+    virtual void closeClient(jack_client_t *client);
+    virtual bool activate(jack_client_t *client);
+    virtual void setProcessCallback(jack_client_t *client, JackProcessCallback callback, void *arg);
+    virtual void setLatencyCallback(jack_client_t *client, JackLatencyCallback callback, void *arg);
+    virtual void setShutdownCallback(jack_client_t *client, JackShutdownCallback callback, void *arg);
+    virtual void setXrunCallback(jack_client_t *client, JackXRunCallback callback, void *arg);
+
+    virtual jack_nframes_t getSampleRate(jack_client_t *client);
+    virtual jack_nframes_t getBufferSize(jack_client_t *client);
+
+    virtual jack_port_t *registerPort(jack_client_t *client, const std::string &portName, unsigned long flags);
+    virtual void unregisterPort(jack_client_t *client, jack_port_t *port);
+    virtual std::string getPortName(jack_port_t *port);
+    virtual std::vector<std::string> getPortConnections(jack_client_t *client, jack_port_t *port);
+    virtual void connectPorts(jack_client_t *client, const std::string &sourcePort, const std::string &destinationPort);
+    virtual jack_latency_range_t getPortLatency(jack_port_t *port, jack_latency_callback_mode_t mode);
+
+    virtual void *getPortBuffer(jack_port_t *port, jack_nframes_t nframes);
+    virtual void clearMidiBuffer(void *portBuffer);
+    virtual unsigned int getMidiEventCount(void *portBuffer);
+    virtual bool getMidiEvent(void *portBuffer, unsigned int eventIndex, jack_midi_event_t &event);
+    virtual bool writeMidiEvent(void *portBuffer, jack_nframes_t frame, const unsigned char *data, size_t size);
+    virtual jack_nframes_t getCycleStartFrame(jack_client_t *client);
+
+    virtual jack_transport_state_t queryTransport(jack_client_t *client, jack_position_t &pos);
+    virtual void locateTransport(jack_client_t *client, jack_nframes_t frame);
+    virtual void startTransport(jack_client_t *client);
+    virtual void stopTransport(jack_client_t *client);
+};//MockEngineBackend
+
+
+#endif
+
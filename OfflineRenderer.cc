@@ -0,0 +1,273 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "OfflineRenderer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include "ChaseEngine.h"
+#include "OutputScheduler.h"
+#include "MidiEncoder.h"
+#include "SMFWriter.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+#include "Tempo.h"
+#include "Globals.h"
+
+namespace
+{
+
+const unsigned int defaultBpm = 12000; //times 100, like Tempo
+
+double pulsesPerTickForBpm(unsigned int bpm)
+{
+    return ((bpm / 100.0) / 60000.0) * OfflineRenderer::pulsesPerQuarter;
+}//pulsesPerTickForBpm
+
+}//anonymous namespace
+
+OfflineRenderer::OfflineRenderer(jack_nframes_t frameRate_, jack_nframes_t periodFrames_)
+{
+    frameRate = frameRate_;
+    periodFrames = std::max(periodFrames_, (jack_nframes_t)1);
+    startPulse = 0;
+
+    stats.periods = 0;
+    stats.messages = 0;
+    stats.seconds = 0;
+}//constructor
+
+OfflineRenderer::~OfflineRenderer()
+{
+    //Nothing
+}//destructor
+
+int OfflineRenderer::getProjectEndTick()
+{
+    Globals &globals = Globals::Instance();
+
+    int endTick = 0;
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+            endTick = std::max(endTick, entryBlock->getStartTick() + entryBlock->getDuration());
+        }//foreach
+    }//foreach
+
+    return endTick;
+}//getProjectEndTick
+
+void OfflineRenderer::buildTempoMap(SMFWriter &writer, unsigned int track, int startTick)
+{
+    Globals &globals = Globals::Instance();
+
+    tempoMap.clear();
+
+    auto tempoChanges = globals.projectData.getTempoChanges();
+    if ((tempoChanges.first == tempoChanges.second) || (tempoChanges.first->first > 0)) {
+        TempoSegment segment;
+        segment.startTick = 0;
+        segment.startPulse = 0;
+        segment.pulsesPerTick = pulsesPerTickForBpm(defaultBpm);
+        tempoMap.push_back(segment);
+    }//if
+
+    std::vector<std::shared_ptr<Tempo> > tempos;
+    for (auto tempoIter = tempoChanges.first; tempoIter != tempoChanges.second; ++tempoIter) {
+        TempoSegment segment;
+        segment.startTick = tempoIter->first;
+        segment.startPulse = 0;
+        segment.pulsesPerTick = pulsesPerTickForBpm(std::max(tempoIter->second->bpm, 1U));
+
+        if (tempoMap.empty() == false) {
+            const TempoSegment &previous = tempoMap.back();
+            segment.startPulse = previous.startPulse + (segment.startTick - previous.startTick) * previous.pulsesPerTick;
+        }//if
+
+        tempoMap.push_back(segment);
+        tempos.push_back(tempoIter->second);
+    }//for
+
+    startPulse = 0;
+    startPulse = ticksToPulses(startTick);
+
+    //The tempo in effect at the start goes at the top of the file, later changes where they happen
+    size_t tempoOffset = tempoMap.size() - tempos.size();
+    for (size_t index = 0; index < tempoMap.size(); ++index) {
+        bool isLast = (index + 1 == tempoMap.size());
+        if ((false == isLast) && (tempoMap[index + 1].startTick <= startTick)) {
+            continue;
+        }//if
+
+        int segmentTick = std::max(tempoMap[index].startTick, startTick);
+        unsigned int pulse = ticksToPulses(segmentTick);
+
+        unsigned int bpm = defaultBpm;
+        unsigned char numerator = 4;
+        if (index >= tempoOffset) {
+            std::shared_ptr<Tempo> tempo = tempos[index - tempoOffset];
+            bpm = std::max(tempo->bpm, 1U);
+            numerator = std::max(std::min(tempo->beatsPerBar, 255U), 1U);
+        }//if
+
+        //Beats are quarter notes (the bpm is in quarters); barSubDivisions is only the editor's grid
+        unsigned char denominator = 4;
+
+        writer.addTempo(track, pulse, (unsigned int)(6000000000.0 / bpm));
+        writer.addTimeSignature(track, pulse, numerator, denominator);
+    }//for
+}//buildTempoMap
+
+unsigned int OfflineRenderer::ticksToPulses(double tick)
+{
+    auto segmentIter = std::upper_bound(tempoMap.begin(), tempoMap.end(), tick, 
+                                        [](double value, const TempoSegment &segment) { return value < segment.startTick; });
+    if (segmentIter != tempoMap.begin()) {
+        --segmentIter;
+    }//if
+
+    double pulse = segmentIter->startPulse + (tick - segmentIter->startTick) * segmentIter->pulsesPerTick - startPulse;
+    return (unsigned int)std::max(0.0, std::floor(pulse + 0.5));
+}//ticksToPulses
+
+unsigned long long OfflineRenderer::renderPort(const OfflineRenderPort &port, FramePosition startFrame, FramePosition endFrame, SMFWriter &writer, unsigned int track,
+                                              unsigned long long &numPeriods)
+{
+    Globals &globals = Globals::Instance();
+
+    //What ChaseEngine::sampleInto would hand the process callback for this port
+    std::vector<std::pair<std::shared_ptr<SequencerEntry>, ChaseValue> > lanes;
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        std::set<jack_port_t *> entryPorts = entry->getOutputPorts();
+        if (entryPorts.find(port.port) == entryPorts.end()) {
+            continue;
+        }//if
+
+        lanes.push_back(std::make_pair(entry, ChaseEngine::makeLane(*entry, port.port)));
+    }//foreach
+
+    OutputScheduler scheduler;
+    scheduler.setMessagesPerSecond(port.messagesPerSecond);
+    for (auto &lane : lanes) {
+        scheduler.prepareLane(lane.second);
+    }//foreach
+
+    //Files can use running status, so the encoder can leave out repeated status bytes
+    MidiEncoder encoder(true);
+
+    unsigned long long numMessages = 0;
+    numPeriods = 0;
+    bool chase = true;
+    for (FramePosition periodFrame = startFrame; ; periodFrame += periodFrames) {
+        //The period the end falls in is sampled too, so values keyed right at the end make it out
+        if (periodFrame <= endFrame) {
+            double sampleTick = framesToSampleTick(periodFrame, frameRate);
+
+            for (auto &lane : lanes) {
+                lane.second.value = lane.first->sampleOutputValue(sampleTick);
+                scheduler.offer(lane.second, chase);
+            }//foreach
+        }//if
+
+        //Playback starts with a chase; afterwards only changes go out
+        chase = false;
+
+        scheduler.drain(0, periodFrames, frameRate, [&](jack_nframes_t eventFrame, const ChaseValue &chaseValue, int previousValue) -> bool {
+            unsigned char messages[MidiEncoder::maxEncodedLength];
+            size_t length = 0;
+            encoder.encode(chaseValue, previousValue, messages, length);
+
+            unsigned int pulse = ticksToPulses(((periodFrame + eventFrame) * 1000.0) / frameRate);
+
+            //Messages without a status byte are running on from the one before
+            size_t offset = 0;
+            while (offset < length) {
+                size_t messageLength = (messages[offset] & 0x80) ? 3 : 2;
+                writer.addEvent(track, pulse, &messages[offset], messageLength);
+                offset += messageLength;
+                numMessages++;
+            }//while
+
+            return true;
+        });
+
+        numPeriods++;
+
+        //Past the end, keep draining until the budget has caught up
+        if ((periodFrame > endFrame) && (false == scheduler.hasPending())) {
+            break;
+        }//if
+    }//for
+
+    return numMessages;
+}//renderPort
+
+bool OfflineRenderer::render(const std::vector<OfflineRenderPort> &ports, int startTick, int endTick, const std::string &filename)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    SMFWriter writer(pulsesPerQuarter);
+
+    unsigned int tempoTrack = writer.addTrack();
+    buildTempoMap(writer, tempoTrack, startTick);
+
+    std::vector<unsigned int> portTracks;
+    for (const OfflineRenderPort &port : ports) {
+        unsigned int track = writer.addTrack();
+        writer.addTrackName(track, port.name);
+        portTracks.push_back(track);
+    }//foreach
+
+    FramePosition startFrame = ticksToFrames(startTick, frameRate);
+    FramePosition endFrame = std::max(ticksToFrames(endTick, frameRate), startFrame + 1);
+
+    //Ports don't share any state, so each one is rendered start to finish on whichever thread picks it up
+    std::vector<unsigned long long> portMessages(ports.size(), 0);
+    std::vector<unsigned long long> portPeriods(ports.size(), 0);
+    std::atomic<size_t> nextPort(0);
+    auto worker = [&]() {
+        for (size_t index = nextPort++; index < ports.size(); index = nextPort++) {
+            portMessages[index] = renderPort(ports[index], startFrame, endFrame, writer, portTracks[index], portPeriods[index]);
+        }//for
+    };
+
+    unsigned int numThreads = std::max(1U, std::min((unsigned int)ports.size(), std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (unsigned int index = 1; index < numThreads; ++index) {
+        threads.push_back(std::thread(worker));
+    }//for
+
+    worker();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }//foreach
+
+    stats.periods = 0;
+    stats.messages = 0;
+    for (size_t index = 0; index < ports.size(); ++index) {
+        stats.periods = std::max(stats.periods, portPeriods[index]);
+        stats.messages += portMessages[index];
+    }//for
+
+    bool written = writer.write(filename);
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    return written;
+}//render
+
+OfflineRenderStats OfflineRenderer::getStats()
+{
+    return stats;
+}//getStats
+
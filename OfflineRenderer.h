@@ -0,0 +1,72 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __OFFLINERENDERER_H
+#define __OFFLINERENDERER_H
+
+#include <jack/jack.h>
+#include <string>
+#include <vector>
+#include "FrameTime.h"
+
+class SMFWriter;
+
+struct OfflineRenderPort
+{
+    std::string name;
+    jack_port_t *port;
+    unsigned int messagesPerSecond; //the port's output budget, so the pacing matches playback
+};//OfflineRenderPort
+
+struct OfflineRenderStats
+{
+    unsigned long long periods;
+    unsigned long long messages;
+    double seconds;
+};//OfflineRenderStats
+
+//Bounces the automation to a Standard MIDI File without JACK.  Every port is run through the same period
+// by period sampling, OutputScheduler and MidiEncoder as the process callback (with no latency compensation,
+// so the file has what the gear should hear), one track per port.  Ports render in parallel.  The value at the end
+// tick is included, and each port keeps going past the end until its budget has let everything out.
+class OfflineRenderer
+{
+    struct TempoSegment
+    {
+        int startTick;
+        double startPulse;
+        double pulsesPerTick;
+    };//TempoSegment
+
+    jack_nframes_t frameRate;
+    jack_nframes_t periodFrames;
+    std::vector<TempoSegment> tempoMap;
+    double startPulse;
+
+    OfflineRenderStats stats;
+
+    void buildTempoMap(SMFWriter &writer, unsigned int track, int startTick);
+    unsigned int ticksToPulses(double tick);
+    unsigned long long renderPort(const OfflineRenderPort &port, FramePosition startFrame, FramePosition endFrame, SMFWriter &writer, unsigned int track,
+                                  unsigned long long &numPeriods);
+
+public:
+    static const unsigned short pulsesPerQuarter = 960;
+
+    OfflineRenderer(jack_nframes_t frameRate, jack_nframes_t periodFrames);
+    ~OfflineRenderer();
+
+    static int getProjectEndTick();
+
+    bool render(const std::vector<OfflineRenderPort> &ports, int startTick, int endTick, const std::string &filename);
+    OfflineRenderStats getStats();
+};//OfflineRenderer
+
+
+#endif
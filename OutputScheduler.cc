@@ -0,0 +1,259 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "OutputScheduler.h"
+#include <cstdlib>
+
+namespace
+{
+
+//Unlimited; a port feeding a 5-pin DIN link wants about 1000, what one carries in 3 byte controller messages
+const unsigned int defaultMessagesPerSecond = 0;
+const unsigned char defaultJumpThreshold = 16;
+
+}//anonymous namespace
+
+OutputScheduler::OutputScheduler()
+{
+    roundRobinIndex = 0;
+    pendingCount = 0;
+    floorFrame = 0;
+    messagesPerSecond = defaultMessagesPerSecond;
+    jumpThreshold = defaultJumpThreshold;
+    tokens = 0;
+
+    stats.messagesPerSecond = messagesPerSecond;
+    stats.queueDepth = 0;
+    stats.sentMessages = 0;
+    stats.deferredMessages = 0;
+    stats.coalescedMessages = 0;
+    stats.thinnedMessages = 0;
+    stats.droppedMessages = 0;
+}//constructor
+
+OutputScheduler::OutputScheduler(const OutputScheduler &other)
+{
+    *this = other;
+}//copy constructor
+
+OutputScheduler &OutputScheduler::operator=(const OutputScheduler &other)
+{
+    if (this == &other) {
+        return *this;
+    }//if
+
+    lanes = other.lanes;
+    roundRobinIndex = other.roundRobinIndex;
+    pendingCount = other.pendingCount;
+    floorFrame = other.floorFrame;
+    messagesPerSecond = other.messagesPerSecond;
+    jumpThreshold = other.jumpThreshold;
+    tokens = other.tokens;
+    stats = other.stats;
+
+    rebuildLaneOrder();
+    return *this;
+}//operator=
+
+OutputScheduler::~OutputScheduler()
+{
+    //Nothing
+}//destructor
+
+void OutputScheduler::setMessagesPerSecond(unsigned int messagesPerSecond_)
+{
+    messagesPerSecond = messagesPerSecond_;
+    tokens = 0;
+}//setMessagesPerSecond
+
+unsigned int OutputScheduler::getMessagesPerSecond()
+{
+    return messagesPerSecond;
+}//getMessagesPerSecond
+
+void OutputScheduler::setJumpThreshold(unsigned char threshold)
+{
+    jumpThreshold = threshold;
+}//setJumpThreshold
+
+bool OutputScheduler::isPriority(const LaneState &lane)
+{
+    if ((true == lane.forced) || (false == lane.hasSent)) {
+        return true;
+    }//if
+
+    int threshold = jumpThreshold;
+    if (true == lane.value.fourteenBit) {
+        threshold <<= 7;
+    }//if
+
+    return std::abs((int)lane.value.value - (int)lane.lastSent) >= threshold;
+}//isPriority
+
+OutputScheduler::LaneState *OutputScheduler::findLane(const ChaseValue &chaseValue)
+{
+    auto laneIter = lanes.find(std::make_tuple(chaseValue.channel, chaseValue.controllerType, chaseValue.msb, chaseValue.lsb));
+    if (laneIter == lanes.end()) {
+        return nullptr;
+    }//if
+
+    return &laneIter->second;
+}//findLane
+
+void OutputScheduler::offer(const ChaseValue &chaseValue, bool force)
+{
+    //Lanes are only ever made by prepareLane, off the RT thread; until then there's nowhere to put the value
+    LaneState *lanePtr = findLane(chaseValue);
+    if (nullptr == lanePtr) {
+        return;
+    }//if
+
+    LaneState &lane = *lanePtr;
+    unsigned short sampledValue = chaseValue.value;
+
+
+    if (sampledValue != lane.lastSampled) {
+        lane.changedThisPeriod = true;
+    }//if
+    lane.lastSampled = sampledValue;
+
+    bool shouldSend = true;
+    if ((false == force) && (true == lane.hasSent)) {
+        int deadband = chaseValue.deadband;
+        if (true == chaseValue.fourteenBit) {
+            deadband <<= 7;
+        }//if
+
+        int difference = std::abs((int)sampledValue - (int)lane.lastSent);
+        shouldSend = (difference > deadband);
+
+        if ((false == shouldSend) && (difference > 0)) {
+            stats.thinnedMessages++;
+        }//if
+    }//if
+
+    if (true == lane.pending) {
+        //Drifted back to what was last sent before we got to it
+        if ((false == force) && (false == lane.forced) && (true == lane.hasSent) && (sampledValue == lane.lastSent)) {
+            lane.pending = false;
+            lane.deferred = false;
+            pendingCount--;
+            stats.coalescedMessages++;
+            return;
+        }//if
+
+        if ((true == shouldSend) || (true == lane.forced)) {
+            if (lane.value.value != sampledValue) {
+                stats.coalescedMessages++;
+            }//if
+
+            lane.value = chaseValue;
+            lane.forced |= force;
+        }//if
+
+        return;
+    }//if
+
+    if (false == shouldSend) {
+        return;
+    }//if
+
+    lane.value = chaseValue;
+    lane.pending = true;
+    lane.forced = force;
+    pendingCount++;
+}//offer
+
+void OutputScheduler::prepareLane(const ChaseValue &chaseValue)
+{
+    auto laneKey = std::make_tuple(chaseValue.channel, chaseValue.controllerType, chaseValue.msb, chaseValue.lsb);
+    if (lanes.find(laneKey) != lanes.end()) {
+        return;
+    }//if
+
+    LaneState newLane;
+    newLane.value = chaseValue;
+    newLane.lastSent = 0;
+    newLane.lastSampled = chaseValue.value;
+    newLane.hasSent = false;
+    newLane.pending = false;
+    newLane.forced = false;
+    newLane.deferred = false;
+    newLane.changedThisPeriod = true;
+
+    lanes.insert(std::make_pair(laneKey, newLane));
+    rebuildLaneOrder();
+}//prepareLane
+
+void OutputScheduler::rebuildLaneOrder()
+{
+    //Served in channel/controller order, however the lanes happened to be prepared
+    laneOrder.clear();
+    for (auto &laneIter : lanes) {
+        laneOrder.push_back(&laneIter.second);
+    }//foreach
+
+    //Only used inside drain; what's in it points at lanes, so it never survives a rebuild
+    sendList.clear();
+    sendList.reserve(laneOrder.size());
+}//rebuildLaneOrder
+
+int OutputScheduler::noteExternalSend(const ChaseValue &chaseValue)
+{
+    LaneState *lanePtr = findLane(chaseValue);
+    if (nullptr == lanePtr) {
+        return -1;
+    }//if
+
+    LaneState &lane = *lanePtr;
+
+    int previousValue = -1;
+    if (true == lane.hasSent) {
+        previousValue = lane.lastSent;
+    }//if
+
+    lane.lastSent = chaseValue.value;
+    lane.hasSent = true;
+
+    return previousValue;
+}//noteExternalSend
+
+void OutputScheduler::setFloorFrame(jack_nframes_t frame)
+{
+    floorFrame = frame;
+}//setFloorFrame
+
+jack_nframes_t OutputScheduler::getFloorFrame()
+{
+    return floorFrame;
+}//getFloorFrame
+
+bool OutputScheduler::hasPending()
+{
+    return (pendingCount > 0);
+}//hasPending
+
+void OutputScheduler::reset()
+{
+    lanes.clear();
+    laneOrder.clear();
+    sendList.clear();
+    roundRobinIndex = 0;
+    pendingCount = 0;
+    floorFrame = 0;
+    tokens = 0;
+}//reset
+
+OutputSchedulerStats OutputScheduler::getStats()
+{
+    stats.messagesPerSecond = messagesPerSecond;
+    stats.queueDepth = pendingCount;
+    return stats;
+}//getStats
+
@@ -0,0 +1,194 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __OUTPUTSCHEDULER_H
+#define __OUTPUTSCHEDULER_H
+
+#include <jack/jack.h>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "ChaseEngine.h"
+
+struct OutputSchedulerStats
+{
+    unsigned int messagesPerSecond; //0 is unlimited
+    unsigned int queueDepth;        //lanes waiting on the budget right now
+    unsigned long long sentMessages;
+    unsigned long long deferredMessages;  //had to wait at least one period for budget
+    unsigned long long coalescedMessages; //replaced by a newer value before they were sent
+    unsigned long long thinnedMessages;   //held back by a lane's deadband
+    unsigned long long droppedMessages;   //refused by a full port buffer; retried the next period
+};//OutputSchedulerStats
+
+//Paces the controller messages for one output port.  Each lane (channel/controller) holds at most one
+// pending value, so a lane that changes faster than the port can carry just sends its latest value.
+// Pending lanes are served round robin within a token bucket budget, with large jumps going first.
+class OutputScheduler
+{
+    struct LaneState
+    {
+        ChaseValue value; //what to send when pending
+        unsigned short lastSent;
+        unsigned short lastSampled;
+        bool hasSent;
+        bool pending;
+        bool forced;
+        bool deferred;
+        bool changedThisPeriod;
+    };//LaneState
+
+    std::map<std::tuple<unsigned char, ControlType, unsigned char, unsigned char>, LaneState> lanes;
+    std::vector<LaneState *> laneOrder;
+    std::vector<LaneState *> sendList;
+    size_t roundRobinIndex;
+    unsigned int pendingCount;
+
+    jack_nframes_t floorFrame; //something else already wrote up to here this period
+
+    unsigned int messagesPerSecond;
+    unsigned char jumpThreshold; //7 bit steps, like the lane deadbands
+    double tokens;
+
+    OutputSchedulerStats stats;
+
+    bool isPriority(const LaneState &lane);
+    LaneState *findLane(const ChaseValue &chaseValue);
+    void rebuildLaneOrder();
+
+public:
+    OutputScheduler();
+    //laneOrder points into lanes, so a copy has to point into its own
+    OutputScheduler(const OutputScheduler &other);
+    OutputScheduler &operator=(const OutputScheduler &other);
+    ~OutputScheduler();
+
+    void setMessagesPerSecond(unsigned int messagesPerSecond);
+    unsigned int getMessagesPerSecond();
+    void setJumpThreshold(unsigned char threshold);
+
+    //Makes the lane for a channel/controller.  Allocates, so it's done off the RT thread before anything is
+    // offered on the lane; offer and noteExternalSend only ever look lanes up.
+    void prepareLane(const ChaseValue &chaseValue);
+
+    //Offer a freshly sampled value.  Forced values skip the deadband and are always sent (chase and loop starts)
+    void offer(const ChaseValue &chaseValue, bool force);
+
+    //For values written to the port outside the scheduler (midi thru).  Returns what was last on the lane, like
+    // drain's previousValue.
+    int noteExternalSend(const ChaseValue &chaseValue);
+    void setFloorFrame(jack_nframes_t frame); //drain won't write before this; cleared by resetting to 0
+    jack_nframes_t getFloorFrame();
+
+    //Whether anything is still waiting on the budget or a full buffer.  Lanes that stopped inside their
+    // deadband only land in the drain after they were last offered.
+    bool hasPending();
+
+    //Send what the budget allows for [startFrame, endFrame) of this period, spaced evenly.  func gets the value
+    // last sent on the lane (-1 if the receiver has to be told everything) and returns false if the port buffer
+    // is full, in which case the rest wait for the next period.
+    template <typename Func>
+    void drain(jack_nframes_t startFrame, jack_nframes_t endFrame, jack_nframes_t frameRate, Func func);
+
+    void reset();
+    OutputSchedulerStats getStats();
+};//OutputScheduler
+
+template <typename Func>
+void OutputScheduler::drain(jack_nframes_t startFrame, jack_nframes_t endFrame, jack_nframes_t frameRate, Func func)
+{
+    //A lane that stopped moving inside its deadband still has to land on its final value
+    for (LaneState *lane : laneOrder) {
+        if ((false == lane->pending) && (true == lane->hasSent) && (false == lane->changedThisPeriod) && (lane->lastSampled != lane->lastSent)) {
+            lane->value.value = lane->lastSampled;
+            lane->pending = true;
+            pendingCount++;
+        }//if
+
+        lane->changedThisPeriod = false;
+    }//foreach
+
+    startFrame = std::max(startFrame, floorFrame);
+    if ((0 == pendingCount) || (startFrame >= endFrame)) {
+        return;
+    }//if
+
+    size_t budget = pendingCount;
+    if (messagesPerSecond > 0) {
+        double periodAllowance = ((double)messagesPerSecond * (endFrame - startFrame)) / frameRate;
+        double maxTokens = std::max(periodAllowance, messagesPerSecond / 100.0) + 1.0;
+        tokens = std::min(tokens + periodAllowance, maxTokens);
+
+        budget = std::min(budget, (size_t)tokens);
+    }//if
+
+    //Large jumps first, then everything else, both in round robin order
+    sendList.clear();
+    size_t numLanes = laneOrder.size();
+    for (unsigned int pass = 0; (pass < 2) && (sendList.size() < budget); ++pass) {
+        for (size_t offset = 0; (offset < numLanes) && (sendList.size() < budget); ++offset) {
+            LaneState *lane = laneOrder[(roundRobinIndex + offset) % numLanes];
+            if ((false == lane->pending) || (isPriority(*lane) != (0 == pass))) {
+                continue;
+            }//if
+
+            sendList.push_back(lane);
+        }//for
+    }//for
+
+    size_t numSent = 0;
+    jack_nframes_t spanFrames = endFrame - startFrame;
+    for (LaneState *lane : sendList) {
+        int previousValue = -1;
+        if ((true == lane->hasSent) && (false == lane->forced)) {
+            previousValue = lane->lastSent;
+        }//if
+
+        if (func(startFrame + (jack_nframes_t)((numSent * spanFrames) / sendList.size()), lane->value, previousValue) == false) {
+            stats.droppedMessages++;
+            break;
+        }//if
+
+        lane->lastSent = lane->value.value;
+        lane->hasSent = true;
+        lane->pending = false;
+        lane->forced = false;
+        lane->deferred = false;
+        numSent++;
+    }//foreach
+
+    if (numSent > 0) {
+        pendingCount -= numSent;
+        stats.sentMessages += numSent;
+
+        if (messagesPerSecond > 0) {
+            tokens -= numSent;
+        }//if
+
+        //Pick up after the last lane served
+        for (size_t index = 0; index < numLanes; ++index) {
+            if (laneOrder[index] == sendList[numSent - 1]) {
+                roundRobinIndex = (index + 1) % numLanes;
+                break;
+            }//if
+        }//for
+    }//if
+
+    //Whatever is left waits for the next period
+    for (LaneState *lane : laneOrder) {
+        if ((true == lane->pending) && (false == lane->deferred)) {
+            lane->deferred = true;
+            stats.deferredMessages++;
+        }//if
+    }//foreach
+}//drain
+
+
+#endif
@@ -225,7 +225,7 @@ void FMidiAutomationMainWindow::processRecordedMidi()
                 if (curPair.second->isTokenAvailable() == true) {
                     hadToken = true;
                     std::shared_ptr<MidiToken> token = curPair.second->getNextToken();
-                    token->curFrame = header.curFrame;
+                    token->curFrame = framesToTicks(header.curFrame, header.frameRate);
 
                     for (EntryMapPair entryMapPair : fmaipair<decltype(entryMap.begin()), decltype(entryMap.end())>(entryMap.equal_range(header.port))) {
                         entryMapPair.second->addRecordToken(token);
@@ -0,0 +1,126 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "ProjectFile.h"
+#include <fstream>
+#include <sstream>
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/archive/xml_oarchive.hpp>
+#include "jack.h"
+#include "Globals.h"
+#include "SerializationHelper.h"
+#include "BinaryProject.h"
+#include "ProjectSaver.h"
+
+namespace
+{
+
+bool loadBinaryProjectData(const std::string &filename, std::string &error)
+{
+    BinaryProjectReader projectReader;
+    if (false == projectReader.open(filename, error)) {
+        return false;
+    }//if
+
+    Globals::ResetInstance();
+
+    //The editor's window state is a chunk of its own, which is never read here
+    if (false == projectReader.loadProject(error)) {
+        Globals::ResetInstance();
+        error = "can't load " + filename + ": " + error;
+        return false;
+    }//if
+
+    return true;
+}//loadBinaryProjectData
+
+}//anonymous namespace
+
+bool isBinaryProjectFilename(const std::string &filename)
+{
+    const std::string extension = ".fmab";
+    return (filename.size() >= extension.size()) && (0 == filename.compare(filename.size() - extension.size(), extension.size(), extension));
+}//isBinaryProjectFilename
+
+bool loadProjectData(const std::string &filename, std::string &error)
+{
+    std::ifstream inputStream(filename.c_str());
+    if (false == inputStream.good()) {
+        error = "can't open " + filename;
+        return false;
+    }//if
+
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    jackSingleton.setTransportState(JackTransportStopped);
+
+    if (true == BinaryProjectReader::isBinaryProject(filename)) {
+        return loadBinaryProjectData(filename, error);
+    }//if
+
+    Globals::ResetInstance();
+
+    try {
+        SharedPtrLoadSession loadSession;
+        loadSession.reserveForProject(inputStream);
+
+        boost::archive::xml_iarchive inputArchive(inputStream);
+
+        unsigned int FMidiAutomationVersion = 0;
+        inputArchive & BOOST_SERIALIZATION_NVP(FMidiAutomationVersion);
+
+        Globals &globals = Globals::Instance();
+        globals.doLoad(inputArchive);
+
+        jackSingleton.doLoad(inputArchive, FMidiAutomationVersion);
+
+        //The editor's window state follows; there's no use for it here
+    } catch (const std::exception &e) {
+        Globals::ResetInstance();
+        error = std::string("can't load ") + filename + ": " + e.what();
+        return false;
+    }//try
+
+    return true;
+}//loadProjectData
+
+bool saveProjectData(const std::string &filename, std::string &error)
+{
+    if (true == isBinaryProjectFilename(filename)) {
+        BinaryProjectWriter projectWriter;
+        projectWriter.addProject(currentProjectVersion);
+
+        return projectWriter.save(filename, error);
+    }//if
+
+    std::ostringstream outputStream;
+
+    try {
+        boost::archive::xml_oarchive outputArchive(outputStream);
+
+        const unsigned int FMidiAutomationVersion = currentProjectVersion;
+        outputArchive & BOOST_SERIALIZATION_NVP(FMidiAutomationVersion);
+
+        Globals &globals = Globals::Instance();
+        globals.doSave(outputArchive);
+
+        JackSingleton &jackSingleton = JackSingleton::Instance();
+        jackSingleton.doSave(outputArchive);
+    } catch (const std::exception &e) {
+        error = std::string("can't save ") + filename + ": " + e.what();
+        return false;
+    }//try
+
+    std::string xmlProject = outputStream.str();
+
+    std::vector<std::pair<const void *, size_t> > pieces;
+    pieces.push_back(std::make_pair((const void *)xmlProject.data(), xmlProject.size()));
+
+    return writeFileAtomically(filename, pieces, error);
+}//saveProjectData
+
@@ -0,0 +1,26 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __PROJECTFILE_H
+#define __PROJECTFILE_H
+
+#include <string>
+
+//Saving picks the format by extension; loading goes by what's in the file
+bool isBinaryProjectFilename(const std::string &filename);
+
+//A project's data (Globals and the jack settings) without the editor, for the engine and fma-tool.  The
+// editor's window state is skipped on load and left out on save; the editor lays such a project out with
+// one lane per entry.  A failed load leaves an empty project.
+bool loadProjectData(const std::string &filename, std::string &error);
+bool saveProjectData(const std::string &filename, std::string &error);
+
+
+#endif
+
@@ -0,0 +1,177 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "ProjectGenerator.h"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <boost/lexical_cast.hpp>
+#include "jack.h"
+#include "Globals.h"
+#include "Animation.h"
+#include "Tempo.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+
+namespace
+{
+
+//What std::mt19937 turns out is fixed by the standard, unlike what the distributions make of it, so these are our own
+class ProjectRandom
+{
+    std::mt19937 engine;
+
+public:
+    ProjectRandom(unsigned int seed) : engine(seed) {}
+
+    unsigned int next(unsigned int range) //0 to range - 1
+    {
+        return (0 == range) ? 0 : (engine() % range);
+    }//next
+
+    double nextUnit() //0 to just under 1
+    {
+        return engine() / 4294967296.0;
+    }//nextUnit
+};//ProjectRandom
+
+CurveType pickCurveType(const ProjectGeneratorParams &params, ProjectRandom &random)
+{
+    unsigned int totalWeight = params.stepWeight + params.linearWeight + params.bezierWeight;
+    if (0 == totalWeight) {
+        return CurveType::Step;
+    }//if
+
+    unsigned int pick = random.next(totalWeight);
+    if (pick < params.stepWeight) {
+        return CurveType::Step;
+    }//if
+
+    if (pick < params.stepWeight + params.linearWeight) {
+        return CurveType::Linear;
+    }//if
+
+    return CurveType::Bezier;
+}//pickCurveType
+
+void generateKeys(const ProjectGeneratorParams &params, ProjectRandom &random, std::shared_ptr<Animation> curve)
+{
+    unsigned int keyGap = std::max(params.keyGap, 1U);
+
+    int tick = 0;
+    int value = random.next(128);
+    unsigned int prevGap = keyGap;
+    for (unsigned int keyIndex = 0; keyIndex < params.keysPerBlock; ++keyIndex) {
+        unsigned int nextGap = 1 + random.next(2 * keyGap - 1);
+
+        std::shared_ptr<Keyframe> keyframe(new Keyframe);
+        keyframe->tick = tick;
+        keyframe->value = value;
+        keyframe->curveType = pickCurveType(params, random);
+
+        if (CurveType::Bezier == keyframe->curveType) {
+            keyframe->inTangent[0] = prevGap / 3;
+            keyframe->inTangent[1] = 0;
+            keyframe->outTangent[0] = nextGap / 3;
+            keyframe->outTangent[1] = 0;
+        }//if
+
+        curve->addKey(keyframe);
+
+        tick += nextGap;
+        prevGap = nextGap;
+        value = std::min(std::max(value + (int)random.next(7) - 3, 0), 127);
+    }//for
+}//generateKeys
+
+}//anonymous namespace
+
+ProjectGeneratorParams::ProjectGeneratorParams()
+{
+    numEntries = 16;
+    blocksPerEntry = 8;
+    keysPerBlock = 1000;
+    keyGap = 12;
+
+    stepWeight = 1;
+    linearWeight = 0;
+    bezierWeight = 0;
+
+    controllerType = ControlType::CC;
+
+    instanceRatio = 0;
+    numTempoChanges = 0;
+    seed = 1;
+}//constructor
+
+void generateProject(const ProjectGeneratorParams &params)
+{
+    Globals::ResetInstance();
+    Globals &globals = Globals::Instance();
+
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    std::vector<std::string> outputPortNames = jackSingleton.getOutputPorts();
+    std::set<jack_port_t *> outputPorts;
+    if (false == outputPortNames.empty()) {
+        outputPorts.insert(jackSingleton.getOutputPort(outputPortNames.front()));
+    }//if
+
+    ProjectRandom random(params.seed);
+
+    int endTick = 0;
+    for (unsigned int entryIndex = 0; entryIndex < params.numEntries; ++entryIndex) {
+        std::shared_ptr<SequencerEntry> entry(new SequencerEntry);
+
+        std::shared_ptr<SequencerEntryImpl> impl = entry->getImplClone();
+        impl->controllerType = params.controllerType;
+        if (ControlType::CC == params.controllerType) {
+            impl->channel = entryIndex % 16;
+            impl->msb = (entryIndex / 16) % 128;
+        } else {
+            impl->channel = (entryIndex / 128) % 16;
+            impl->msb = 0;
+            impl->lsb = entryIndex % 128;
+        }//if
+        impl->title = "Entry " + boost::lexical_cast<std::string>(entryIndex + 1);
+        entry->setNewDataImpl(impl);
+        entry->setOutputPorts(outputPorts);
+
+        globals.projectData.getSequencer()->addEntry(entry);
+
+        std::vector<std::shared_ptr<SequencerEntryBlock> > sourceBlocks;
+        int startTick = 0;
+        for (unsigned int blockIndex = 0; blockIndex < params.blocksPerEntry; ++blockIndex) {
+            std::shared_ptr<SequencerEntryBlock> instanceOf;
+            if ((false == sourceBlocks.empty()) && (random.nextUnit() < params.instanceRatio)) {
+                instanceOf = sourceBlocks[random.next(sourceBlocks.size())];
+            }//if
+
+            std::shared_ptr<SequencerEntryBlock> entryBlock(new SequencerEntryBlock(entry, startTick, instanceOf));
+            if (nullptr == instanceOf) {
+                generateKeys(params, random, entryBlock->getCurve());
+                sourceBlocks.push_back(entryBlock);
+            }//if
+
+            entry->addEntryBlock(entryBlock);
+
+            startTick += entryBlock->getDuration() + std::max(params.keyGap, 1U);
+        }//for
+
+        endTick = std::max(endTick, startTick);
+    }//for
+
+    for (unsigned int tempoIndex = 1; tempoIndex <= params.numTempoChanges; ++tempoIndex) {
+        int tick = (int)(((long long)endTick * tempoIndex) / (params.numTempoChanges + 1));
+        unsigned int bpm = 6000 + random.next(12001); //60 to 180
+
+        globals.projectData.addTempoChange(std::max(tick, (int)tempoIndex), std::shared_ptr<Tempo>(new Tempo(bpm, 4, 4)));
+    }//for
+}//generateProject
+
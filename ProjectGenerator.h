@@ -0,0 +1,44 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __PROJECTGENERATOR_H
+#define __PROJECTGENERATOR_H
+
+enum class ControlType : char;
+
+//The shape of a made up project, for measuring how the model scales (see fma_bench.cc)
+struct ProjectGeneratorParams
+{
+    ProjectGeneratorParams(); //a small project of recorded-looking step lanes
+
+    unsigned int numEntries;
+    unsigned int blocksPerEntry;
+    unsigned int keysPerBlock;
+    unsigned int keyGap; //average ticks between keys; blocks are a key gap's worth of ticks apart
+
+    //How often each curve type comes up, key by key
+    unsigned int stepWeight;
+    unsigned int linearWeight;
+    unsigned int bezierWeight;
+
+    ControlType controllerType; //for RPN and NRPN, entries share a channel and parameter MSB 128 at a time
+
+    double instanceRatio; //of the blocks after an entry's first, the share that are instances of an earlier one there
+    unsigned int numTempoChanges; //besides the one at tick 0 every project has, spread over the project
+    unsigned int seed;
+};//ProjectGeneratorParams
+
+//Replaces the project in Globals.  The same parameters always make the same project, on any machine.  Every
+// entry is a controller on the first output port, if there is one; values wander a few steps at a time as a recording's
+// do, and Bezier keys get the tangents the curve editor would give them.
+void generateProject(const ProjectGeneratorParams &params);
+
+
+#endif
+
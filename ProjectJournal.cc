@@ -0,0 +1,1357 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "ProjectJournal.h"
+#include "BinaryArchive.h"
+#include "ProjectSaver.h"
+#include "Globals.h"
+#include "Tempo.h"
+#include "Animation.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+#include "jack.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace
+{
+
+const char journalMagic[4] = { 'F', 'M', 'A', 'J' };
+const unsigned int journalFormatVersion = 1;
+const size_t fileHeaderSize = 8;
+const size_t recordHeaderSize = 8;
+
+//Past either of these the journal is folded into a snapshot
+const unsigned long long compactJournalBytes = 4 * 1024 * 1024;
+const time_t compactionInterval = 5 * 60;
+
+//So a snapshot that keeps failing (a full disk) isn't retried on every idle
+const time_t minSnapshotSpacing = 30;
+
+//What a keyframe takes at the least: the tick, five doubles and the curve type
+const size_t minKeyframeBytes = 1 + 5 * sizeof(double) + 1;
+
+enum class JournalOp : unsigned char
+{
+    Base = 1,
+    Renumber,
+    Tempo,
+    Entry,
+    EntryOrder,
+    Keys
+};//JournalOp
+
+enum class BlockSource : unsigned char
+{
+    Known,
+    New,    //keys follow
+    Cloned  //a deep clone of a known block
+};//BlockSource
+
+enum BlockFlags
+{
+    CurveIsInstance = 1,
+    SecondaryCurveIsInstance = 2
+};//BlockFlags
+
+struct FileIdentity
+{
+    unsigned long long size;
+    unsigned long long modifiedSeconds;
+    unsigned int modifiedNanoseconds;
+};//FileIdentity
+
+bool getFileIdentity(const std::string &filename, FileIdentity &identity)
+{
+    struct stat fileStat;
+    if (0 != stat(filename.c_str(), &fileStat)) {
+        return false;
+    }//if
+
+    identity.size = fileStat.st_size;
+    identity.modifiedSeconds = fileStat.st_mtim.tv_sec;
+    identity.modifiedNanoseconds = fileStat.st_mtim.tv_nsec;
+
+    return true;
+}//getFileIdentity
+
+unsigned int crc32(const unsigned char *data, size_t size)
+{
+    static const std::vector<unsigned int> table = []() {
+        std::vector<unsigned int> crcTable(256);
+        for (unsigned int index = 0; index < 256; ++index) {
+            unsigned int crc = index;
+            for (unsigned int bit = 0; bit < 8; ++bit) {
+                crc = (0 != (crc & 1)) ? (0xedb88320 ^ (crc >> 1)) : (crc >> 1);
+            }//for
+            crcTable[index] = crc;
+        }//for
+        return crcTable;
+    }();
+
+    unsigned int crc = 0xffffffff;
+    for (size_t index = 0; index < size; ++index) {
+        crc = table[(crc ^ data[index]) & 0xff] ^ (crc >> 8);
+    }//for
+
+    return crc ^ 0xffffffff;
+}//crc32
+
+void appendFixed32(std::vector<unsigned char> &buffer, unsigned int value)
+{
+    for (unsigned int byte = 0; byte < 4; ++byte) {
+        buffer.push_back((unsigned char)(value >> (byte * 8)));
+    }//for
+}//appendFixed32
+
+unsigned int readFixed32(const unsigned char *data)
+{
+    unsigned int value = 0;
+    for (unsigned int byte = 0; byte < 4; ++byte) {
+        value |= (unsigned int)data[byte] << (byte * 8);
+    }//for
+
+    return value;
+}//readFixed32
+
+std::vector<unsigned char> getFileHeader()
+{
+    std::vector<unsigned char> header(journalMagic, journalMagic + sizeof(journalMagic));
+    appendFixed32(header, journalFormatVersion);
+    return header;
+}//getFileHeader
+
+//The string table the operations used, then the operations, framed with their size and CRC
+std::vector<unsigned char> makeRecord(BinaryProjectContext &context, const BinaryOArchive &opArchive)
+{
+    BinaryOArchive stringArchive(context);
+    stringArchive.saveVarint(context.strings.size());
+    for (const std::string &str : context.strings) {
+        stringArchive.saveVarint(str.size());
+        stringArchive.saveRaw(str.data(), str.size());
+    }//foreach
+
+    const std::vector<unsigned char> &strings = stringArchive.getBuffer();
+    const std::vector<unsigned char> &ops = opArchive.getBuffer();
+
+    std::vector<unsigned char> payload;
+    payload.reserve(strings.size() + ops.size());
+    payload.insert(payload.end(), strings.begin(), strings.end());
+    payload.insert(payload.end(), ops.begin(), ops.end());
+
+    std::vector<unsigned char> record;
+    record.reserve(recordHeaderSize + payload.size());
+    appendFixed32(record, payload.size());
+    appendFixed32(record, crc32(payload.data(), payload.size()));
+    record.insert(record.end(), payload.begin(), payload.end());
+
+    return record;
+}//makeRecord
+
+//How long the record at offset is, or zero if it's torn or corrupt
+size_t checkRecord(const std::vector<unsigned char> &data, size_t offset)
+{
+    if (data.size() - offset < recordHeaderSize) {
+        return 0;
+    }//if
+
+    size_t payloadSize = readFixed32(&data[offset]);
+    unsigned int crc = readFixed32(&data[offset + 4]);
+
+    if (payloadSize > data.size() - offset - recordHeaderSize) {
+        return 0;
+    }//if
+
+    if (crc != crc32(&data[offset + recordHeaderSize], payloadSize)) {
+        return 0;
+    }//if
+
+    return recordHeaderSize + payloadSize;
+}//checkRecord
+
+bool loadStrings(BinaryIArchive &archive, const unsigned char *payload)
+{
+    BinaryProjectContext &context = archive.getContext();
+
+    unsigned long long numStrings = archive.loadVarint();
+    for (unsigned long long stringIndex = 0; (stringIndex < numStrings) && (false == archive.hasFailed()); ++stringIndex) {
+        unsigned long long length = archive.loadVarint();
+        size_t position = archive.getPosition();
+        archive.seek(position + length);
+
+        if (false == archive.hasFailed()) {
+            context.strings.push_back(std::string((const char *)payload + position, length));
+        }//if
+    }//for
+
+    return (false == archive.hasFailed());
+}//loadStrings
+
+bool parseBaseRecord(const unsigned char *payload, size_t size, std::string &baseFilename, FileIdentity &identity)
+{
+    BinaryProjectContext context;
+    BinaryIArchive archive(context, payload, size);
+
+    if (false == loadStrings(archive, payload)) {
+        return false;
+    }//if
+
+    if ((unsigned char)JournalOp::Base != archive.loadByte()) {
+        return false;
+    }//if
+
+    archive.load(baseFilename);
+    identity.size = archive.loadFixed64();
+    identity.modifiedSeconds = archive.loadFixed64();
+    identity.modifiedNanoseconds = archive.loadFixed32();
+
+    return (false == archive.hasFailed());
+}//parseBaseRecord
+
+bool readJournal(const std::string &journalFilename, std::vector<unsigned char> &data)
+{
+    std::ifstream inputStream(journalFilename.c_str(), std::ios::in | std::ios::binary);
+    if (false == inputStream.good()) {
+        return false;
+    }//if
+
+    data.assign(std::istreambuf_iterator<char>(inputStream), std::istreambuf_iterator<char>());
+    return true;
+}//readJournal
+
+//The base record, checked against the file it names; returns its length or zero
+size_t checkBase(const std::vector<unsigned char> &data, std::string &baseFilename, std::string &error)
+{
+    if ((data.size() < fileHeaderSize) || (0 != memcmp(data.data(), journalMagic, sizeof(journalMagic)))) {
+        error = "the journal isn't one";
+        return 0;
+    }//if
+
+    if (readFixed32(&data[sizeof(journalMagic)]) > journalFormatVersion) {
+        error = "the journal was written by a newer version of FMidiAutomation";
+        return 0;
+    }//if
+
+    size_t baseRecordSize = checkRecord(data, fileHeaderSize);
+    FileIdentity journalIdentity;
+    if ((0 == baseRecordSize) ||
+        (false == parseBaseRecord(&data[fileHeaderSize + recordHeaderSize], baseRecordSize - recordHeaderSize, baseFilename, journalIdentity))) {
+        error = "the journal is corrupt";
+        return 0;
+    }//if
+
+    FileIdentity baseIdentity;
+    if ((false == getFileIdentity(baseFilename, baseIdentity)) || (baseIdentity.size != journalIdentity.size) ||
+        (baseIdentity.modifiedSeconds != journalIdentity.modifiedSeconds) || (baseIdentity.modifiedNanoseconds != journalIdentity.modifiedNanoseconds)) {
+        error = baseFilename + " has changed since the journal was started";
+        return 0;
+    }//if
+
+    return baseRecordSize;
+}//checkBase
+
+}//anonymous namespace
+
+ProjectJournal::ProjectJournal()
+{
+    fileDescriptor = -1;
+    journalSize = 0;
+    numRecords = 0;
+    baseTime = 0;
+    lastSnapshotTime = 0;
+    fileBroken = false;
+    capturing = false;
+    captureBroken = false;
+    tempoTouched = false;
+    entryOrderTouched = false;
+}//constructor
+
+ProjectJournal::~ProjectJournal()
+{
+    closeJournalFile();
+}//destructor
+
+ProjectJournal &ProjectJournal::Instance()
+{
+    static ProjectJournal journal;
+    return journal;
+}//Instance
+
+std::string ProjectJournal::getJournalFilename(const std::string &projectFilename)
+{
+    return projectFilename + ".journal";
+}//getJournalFilename
+
+std::string ProjectJournal::getAutosaveFilename(const std::string &projectFilename)
+{
+    return projectFilename + ".autosave.fmab";
+}//getAutosaveFilename
+
+void ProjectJournal::start(const std::string &projectFilename_)
+{
+    stop();
+
+    projectFilename = projectFilename_;
+    baseFilename = projectFilename_;
+    baseRecord = makeBaseRecord(baseFilename);
+    baseTime = time(nullptr);
+
+    //Whatever was left here is for a project the user chose to open as it was saved
+    remove(getJournalFilename(projectFilename).c_str());
+    remove(getAutosaveFilename(projectFilename).c_str());
+
+    numberProject();
+}//start
+
+void ProjectJournal::stop()
+{
+    closeJournalFile();
+
+    if (false == projectFilename.empty()) {
+        remove(getJournalFilename(projectFilename).c_str());
+        remove(getAutosaveFilename(projectFilename).c_str());
+    }//if
+
+    projectFilename.clear();
+    baseFilename.clear();
+    baseRecord.clear();
+    journalSize = 0;
+    numRecords = 0;
+    fileBroken = false;
+
+    capturing = false;
+    captureBroken = false;
+    capturedRecords.clear();
+
+    entries.clear();
+    entryBlocks.clear();
+    entryIds.clear();
+    entryBlockIds.clear();
+
+    clearTouches();
+}//stop
+
+bool ProjectJournal::isActive() const
+{
+    return (false == projectFilename.empty()) || (true == capturing);
+}//isActive
+
+const std::string &ProjectJournal::getProjectFilename() const
+{
+    return projectFilename;
+}//getProjectFilename
+
+void ProjectJournal::clearTouches()
+{
+    tempoTouched = false;
+    entryOrderTouched = false;
+    touchedEntries.clear();
+    touchedEntrySet.clear();
+    touchedKeys.clear();
+    cloneSources.clear();
+}//clearTouches
+
+//Same order as BinaryProjectWriter::addProject, which is also the order any project loads in
+void ProjectJournal::numberProject()
+{
+    entries.clear();
+    entryBlocks.clear();
+    entryIds.clear();
+    entryBlockIds.clear();
+
+    Globals &globals = Globals::Instance();
+    for (std::shared_ptr<SequencerEntry> entry : globals.projectData.getSequencer()->getEntryPair()) {
+        getEntryId(entry);
+
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            getEntryBlockId(entryBlockIter.second);
+        }//foreach
+    }//foreach
+}//numberProject
+
+unsigned int ProjectJournal::getEntryId(std::shared_ptr<SequencerEntry> entry)
+{
+    auto idIter = entryIds.find(entry.get());
+    if (idIter != entryIds.end()) {
+        return idIter->second;
+    }//if
+
+    entries.push_back(entry);
+    entryIds[entry.get()] = entries.size();
+    return entries.size();
+}//getEntryId
+
+unsigned int ProjectJournal::getEntryBlockId(std::shared_ptr<SequencerEntryBlock> entryBlock)
+{
+    auto idIter = entryBlockIds.find(entryBlock.get());
+    if (idIter != entryBlockIds.end()) {
+        return idIter->second;
+    }//if
+
+    entryBlocks.push_back(entryBlock);
+    entryBlockIds[entryBlock.get()] = entryBlocks.size();
+    return entryBlocks.size();
+}//getEntryBlockId
+
+bool ProjectJournal::isKnown(const SequencerEntryBlock *entryBlock) const
+{
+    return (entryBlockIds.find(entryBlock) != entryBlockIds.end());
+}//isKnown
+
+std::vector<unsigned char> ProjectJournal::makeBaseRecord(const std::string &baseFilename_) const
+{
+    FileIdentity identity = { 0, 0, 0 };
+    getFileIdentity(baseFilename_, identity);
+
+    BinaryProjectContext context;
+    BinaryOArchive opArchive(context);
+    opArchive.saveByte((unsigned char)JournalOp::Base);
+    opArchive.save(baseFilename_);
+    opArchive.saveFixed64(identity.size);
+    opArchive.saveFixed64(identity.modifiedSeconds);
+    opArchive.saveFixed32(identity.modifiedNanoseconds);
+
+    return makeRecord(context, opArchive);
+}//makeBaseRecord
+
+void ProjectJournal::touchTempo()
+{
+    tempoTouched = true;
+}//touchTempo
+
+void ProjectJournal::touchEntryOrder()
+{
+    entryOrderTouched = true;
+}//touchEntryOrder
+
+void ProjectJournal::touchEntry(std::shared_ptr<SequencerEntry> entry)
+{
+    if (entry == nullptr) {
+        return;
+    }//if
+
+    if (true == touchedEntrySet.insert(entry.get()).second) {
+        touchedEntries.push_back(entry);
+    }//if
+}//touchEntry
+
+void ProjectJournal::touchClonedEntry(std::shared_ptr<SequencerEntry> entry, std::shared_ptr<SequencerEntry> origEntry)
+{
+    if ((entry == nullptr) || (origEntry == nullptr) || (entryIds.find(entry.get()) != entryIds.end())) {
+        return;
+    }//if
+
+    std::map<int, std::shared_ptr<SequencerEntryBlock> > origEntryBlocks;
+    for (auto entryBlockIter : origEntry->getEntryBlocksPair()) {
+        origEntryBlocks[entryBlockIter.second->startTick] = entryBlockIter.second;
+    }//foreach
+
+    //Blocks that came through the clone unchanged are written as clones rather than with all their keys
+    for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+        std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+
+        auto origIter = origEntryBlocks.find(entryBlock->startTick);
+        if (origIter == origEntryBlocks.end()) {
+            continue;
+        }//if
+
+        std::shared_ptr<SequencerEntryBlock> origEntryBlock = origIter->second;
+        if ((entryBlock->title == origEntryBlock->title) && (true == curvesMatch(entryBlock->curve, origEntryBlock->curve)) &&
+            (true == curvesMatch(entryBlock->secondaryCurve, origEntryBlock->secondaryCurve))) {
+            cloneSources[entryBlock.get()] = origEntryBlock;
+        }//if
+    }//foreach
+}//touchClonedEntry
+
+void ProjectJournal::touchKeys(std::shared_ptr<SequencerEntryBlock> entryBlock, int tick)
+{
+    if (entryBlock == nullptr) {
+        return;
+    }//if
+
+    //An instance's edits go to the keys of the block it's an instance of
+    std::shared_ptr<SequencerEntryBlock> keysBlock = entryBlock;
+    if (entryBlock->curve->instanceOf != nullptr) {
+        keysBlock = entryBlock->instanceOf;
+
+        if ((keysBlock == nullptr) || (keysBlock->curve != entryBlock->curve->instanceOf)) {
+            touchProject();
+            return;
+        }//if
+    }//if
+
+    touchedKeys[keysBlock].insert(tick);
+}//touchKeys
+
+void ProjectJournal::touchProject()
+{
+    closeJournalFile();
+    fileBroken = true;
+
+    if (true == capturing) {
+        captureBroken = true;
+    }//if
+}//touchProject
+
+void ProjectJournal::commitRecord()
+{
+    if ((false == isActive()) || ((true == fileBroken) && ((false == capturing) || (true == captureBroken)))) {
+        clearTouches();
+        return;
+    }//if
+
+    std::vector<unsigned char> record;
+    bool hasOps = buildRecord(record);
+    clearTouches();
+
+    if (false == hasOps) {
+        return;
+    }//if
+
+    if ((true == capturing) && (false == captureBroken)) {
+        capturedRecords.push_back(record);
+    }//if
+
+    if ((false == projectFilename.empty()) && (false == fileBroken)) {
+        appendRecord(record);
+    }//if
+}//commitRecord
+
+bool ProjectJournal::buildRecord(std::vector<unsigned char> &record)
+{
+    Globals &globals = Globals::Instance();
+    std::shared_ptr<Sequencer> sequencer = globals.projectData.getSequencer();
+
+    //Anything the journal hasn't seen yet goes in whole
+    if (true == entryOrderTouched) {
+        for (std::shared_ptr<SequencerEntry> entry : sequencer->getEntryPair()) {
+            if (entryIds.find(entry.get()) == entryIds.end()) {
+                touchEntry(entry);
+            }//if
+        }//foreach
+    }//if
+
+    for (auto keysIter : touchedKeys) {
+        if (false == isKnown(keysIter.first.get())) {
+            std::shared_ptr<SequencerEntry> owningEntry = keysIter.first->getOwningEntry();
+            if (owningEntry == nullptr) {
+                touchProject();
+                return false;
+            }//if
+
+            touchEntry(owningEntry);
+        }//if
+    }//foreach
+
+    //A new instance of a block that's also new needs that block's entry too
+    for (size_t entryIndex = 0; entryIndex < touchedEntries.size(); ++entryIndex) {
+        for (auto entryBlockIter : touchedEntries[entryIndex]->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> instanceOf = entryBlockIter.second->instanceOf;
+            if ((instanceOf != nullptr) && (false == isKnown(instanceOf.get())) && (false == isKnown(entryBlockIter.second.get()))) {
+                touchEntry(instanceOf->getOwningEntry());
+            }//if
+        }//foreach
+    }//for
+
+    //Numbered now, in the order the replay will make them, so instances can refer forward
+    std::set<const SequencerEntryBlock *> newEntryBlocks;
+    for (std::shared_ptr<SequencerEntry> entry : touchedEntries) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            if (false == isKnown(entryBlockIter.second.get())) {
+                newEntryBlocks.insert(entryBlockIter.second.get());
+                getEntryBlockId(entryBlockIter.second);
+            }//if
+        }//foreach
+    }//foreach
+
+    BinaryProjectContext context;
+    BinaryOArchive opArchive(context);
+
+    if (true == tempoTouched) {
+        opArchive.saveByte((unsigned char)JournalOp::Tempo);
+        opArchive.save(globals.projectData.tempoChanges);
+    }//if
+
+    for (std::shared_ptr<SequencerEntry> entry : touchedEntries) {
+        opArchive.saveByte((unsigned char)JournalOp::Entry);
+        saveEntry(opArchive, entry, newEntryBlocks);
+    }//foreach
+
+    if (true == entryOrderTouched) {
+        auto entryPair = sequencer->getEntryPair();
+
+        opArchive.saveByte((unsigned char)JournalOp::EntryOrder);
+        opArchive.saveVarint(std::distance(entryPair.begin(), entryPair.end()));
+        for (std::shared_ptr<SequencerEntry> entry : entryPair) {
+            opArchive.saveVarint(getEntryId(entry));
+        }//foreach
+    }//if
+
+    for (auto keysIter : touchedKeys) {
+        std::shared_ptr<SequencerEntryBlock> entryBlock = keysIter.first;
+        if (newEntryBlocks.find(entryBlock.get()) != newEntryBlocks.end()) {
+            continue; //all its keys went with its entry
+        }//if
+
+        std::shared_ptr<Animation> curve = entryBlock->curve;
+        curve->materializeKeyframes();
+        const std::map<int, std::shared_ptr<Keyframe> > &keyframes = curve->keyframes;
+
+        //Adding a key can set the tangents of the keys either side
+        std::set<int> ticks;
+        for (int tick : keysIter.second) {
+            ticks.insert(tick);
+
+            auto nextIter = keyframes.upper_bound(tick);
+            if (nextIter != keyframes.end()) {
+                ticks.insert(nextIter->first);
+            }//if
+
+            auto prevIter = keyframes.lower_bound(tick);
+            if (prevIter != keyframes.begin()) {
+                --prevIter;
+                ticks.insert(prevIter->first);
+            }//if
+        }//foreach
+
+        opArchive.saveByte((unsigned char)JournalOp::Keys);
+        opArchive.saveVarint(getEntryBlockId(entryBlock));
+        opArchive.saveVarint(ticks.size());
+
+        for (int tick : ticks) {
+            opArchive.saveZigzag(tick);
+
+            auto keyIter = keyframes.find(tick);
+            if (keyIter == keyframes.end()) {
+                opArchive.saveByte(0);
+                continue;
+            }//if
+
+            const Keyframe &keyframe = *keyIter->second;
+            opArchive.saveByte(1);
+            opArchive.save(keyframe.value);
+            opArchive.save(keyframe.inTangent[0]);
+            opArchive.save(keyframe.inTangent[1]);
+            opArchive.save(keyframe.outTangent[0]);
+            opArchive.save(keyframe.outTangent[1]);
+            opArchive.saveByte((unsigned char)keyframe.curveType);
+        }//foreach
+    }//foreach
+
+    if (true == opArchive.getBuffer().empty()) {
+        return false;
+    }//if
+
+    record = makeRecord(context, opArchive);
+    return true;
+}//buildRecord
+
+void ProjectJournal::saveEntry(BinaryOArchive &archive, std::shared_ptr<SequencerEntry> entry, const std::set<const SequencerEntryBlock *> &newEntryBlocks)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    archive.saveVarint(getEntryId(entry));
+    archive.save(*entry->getImpl());
+
+    std::vector<std::string> inputPortNames;
+    std::vector<std::string> outputPortNames;
+
+    for (jack_port_t *port : entry->getInputPorts()) {
+        inputPortNames.push_back(jackSingleton.getInputPortName(port));
+    }//foreach
+
+    for (jack_port_t *port : entry->getOutputPorts()) {
+        outputPortNames.push_back(jackSingleton.getOutputPortName(port));
+    }//foreach
+
+    archive.save(inputPortNames);
+    archive.save(outputPortNames);
+
+    auto entryBlocksPair = entry->getEntryBlocksPair();
+    archive.saveVarint(std::distance(entryBlocksPair.begin(), entryBlocksPair.end()));
+
+    for (auto entryBlockIter : entryBlocksPair) {
+        std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+        bool isNew = (newEntryBlocks.find(entryBlock.get()) != newEntryBlocks.end());
+
+        archive.saveVarint(getEntryBlockId(entryBlock));
+
+        BlockSource source = BlockSource::Known;
+        if (true == isNew) {
+            source = BlockSource::New;
+
+            auto cloneIter = cloneSources.find(entryBlock.get());
+            if ((cloneIter != cloneSources.end()) && (true == isKnown(cloneIter->second.get())) &&
+                (newEntryBlocks.find(cloneIter->second.get()) == newEntryBlocks.end())) {
+                source = BlockSource::Cloned;
+            }//if
+        }//if
+
+        archive.saveByte((unsigned char)source);
+        if (BlockSource::Cloned == source) {
+            archive.saveVarint(getEntryBlockId(cloneSources[entryBlock.get()]));
+        }//if
+
+        unsigned int instanceOfId = 0;
+        if ((entryBlock->instanceOf != nullptr) && (true == isKnown(entryBlock->instanceOf.get()))) {
+            instanceOfId = getEntryBlockId(entryBlock->instanceOf);
+        }//if
+
+        unsigned char flags = 0;
+        if (entryBlock->curve->instanceOf != nullptr) {
+            flags |= CurveIsInstance;
+        }//if
+        if (entryBlock->secondaryCurve->instanceOf != nullptr) {
+            flags |= SecondaryCurveIsInstance;
+        }//if
+
+        archive.saveZigzag(entryBlock->startTick);
+        archive.save(fmastring_to_locale(entryBlock->title));
+        archive.saveVarint(instanceOfId);
+        archive.saveByte(flags);
+
+        if (BlockSource::New == source) {
+            saveCurve(archive, entryBlock->curve);
+            saveCurve(archive, entryBlock->secondaryCurve);
+        }//if
+    }//foreach
+}//saveEntry
+
+void ProjectJournal::saveCurve(BinaryOArchive &archive, std::shared_ptr<Animation> curve)
+{
+    int prevTick = 0;
+    auto saveKeyframe = [&](const Keyframe &keyframe) {
+        archive.saveZigzag((long long)keyframe.tick - prevTick);
+        archive.save(keyframe.value);
+        archive.save(keyframe.inTangent[0]);
+        archive.save(keyframe.inTangent[1]);
+        archive.save(keyframe.outTangent[0]);
+        archive.save(keyframe.outTangent[1]);
+        archive.saveByte((unsigned char)keyframe.curveType);
+        prevTick = keyframe.tick;
+    };
+
+    //Straight from the mapped file when it hasn't been edited
+    if (true == curve->keyframesMapped) {
+        const MappedKeyframes &mappedKeyframes = *curve->mappedKeyframes;
+        mappedKeyframes.unpack();
+
+        archive.saveVarint(mappedKeyframes.numKeys);
+        for (unsigned int key = 0; key < mappedKeyframes.numKeys; ++key) {
+            saveKeyframe(mappedKeyframes.getKeyframe(key));
+        }//for
+        return;
+    }//if
+
+    archive.saveVarint(curve->keyframes.size());
+    for (auto keyIter : curve->keyframes) {
+        saveKeyframe(*keyIter.second);
+    }//foreach
+}//saveCurve
+
+bool ProjectJournal::loadCurve(BinaryIArchive &archive, std::shared_ptr<Animation> curve)
+{
+    unsigned long long numKeys = archive.loadVarint();
+    if (numKeys > (archive.getSize() - archive.getPosition()) / minKeyframeBytes) {
+        archive.setFailed();
+        return false;
+    }//if
+
+    curve->materializeKeyframes();
+    curve->keyframes.clear();
+
+    long long tick = 0;
+    for (unsigned long long key = 0; (key < numKeys) && (false == archive.hasFailed()); ++key) {
+        tick += archive.loadZigzag();
+
+        std::shared_ptr<Keyframe> keyframe = std::make_shared<Keyframe>();
+        keyframe->tick = (int)tick;
+        archive.load(keyframe->value);
+        archive.load(keyframe->inTangent[0]);
+        archive.load(keyframe->inTangent[1]);
+        archive.load(keyframe->outTangent[0]);
+        archive.load(keyframe->outTangent[1]);
+
+        unsigned char curveType = archive.loadByte();
+        if (curveType > (unsigned char)CurveType::Bezier) {
+            archive.setFailed();
+        }//if
+        keyframe->curveType = (CurveType)curveType;
+
+        curve->keyframes.insert(curve->keyframes.end(), std::make_pair(keyframe->tick, keyframe));
+    }//for
+
+    return (false == archive.hasFailed());
+}//loadCurve
+
+bool ProjectJournal::curvesMatch(std::shared_ptr<Animation> curve, std::shared_ptr<Animation> otherCurve)
+{
+    if ((true == curve->keyframesMapped) && (true == otherCurve->keyframesMapped) && (curve->mappedKeyframes == otherCurve->mappedKeyframes)) {
+        return true;
+    }//if
+
+    if (curve->getNumKeyframes() != otherCurve->getNumKeyframes()) {
+        return false;
+    }//if
+
+    auto getStoredKeyframes = [](std::shared_ptr<Animation> fromCurve) {
+        std::vector<Keyframe> keyframes;
+        if (true == fromCurve->keyframesMapped) {
+            fromCurve->mappedKeyframes->unpack();
+            for (unsigned int key = 0; key < fromCurve->mappedKeyframes->numKeys; ++key) {
+                keyframes.push_back(fromCurve->mappedKeyframes->getKeyframe(key));
+            }//for
+        } else {
+            for (auto keyIter : fromCurve->keyframes) {
+                keyframes.push_back(*keyIter.second);
+            }//foreach
+        }//if
+        return keyframes;
+    };
+
+    std::vector<Keyframe> keyframes = getStoredKeyframes(curve);
+    std::vector<Keyframe> otherKeyframes = getStoredKeyframes(otherCurve);
+
+    if (keyframes.size() != otherKeyframes.size()) {
+        return false;
+    }//if
+
+    for (size_t key = 0; key < keyframes.size(); ++key) {
+        const Keyframe &keyframe = keyframes[key];
+        const Keyframe &otherKeyframe = otherKeyframes[key];
+
+        if ((keyframe.tick != otherKeyframe.tick) || (keyframe.value != otherKeyframe.value) || (keyframe.curveType != otherKeyframe.curveType) ||
+            (keyframe.inTangent[0] != otherKeyframe.inTangent[0]) || (keyframe.inTangent[1] != otherKeyframe.inTangent[1]) ||
+            (keyframe.outTangent[0] != otherKeyframe.outTangent[0]) || (keyframe.outTangent[1] != otherKeyframe.outTangent[1])) {
+            return false;
+        }//if
+    }//for
+
+    return true;
+}//curvesMatch
+
+void ProjectJournal::appendRecord(const std::vector<unsigned char> &record)
+{
+    if (fileDescriptor < 0) {
+        if (false == writeJournalFile(std::vector<std::vector<unsigned char> >())) {
+            fileBroken = true;
+            return;
+        }//if
+    }//if
+
+    //Written through before the edit is considered safe; records are small, so this is one write
+    const unsigned char *data = record.data();
+    size_t size = record.size();
+    while (size > 0) {
+        ssize_t written = write(fileDescriptor, data, size);
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }//if
+
+            closeJournalFile();
+            fileBroken = true;
+            return;
+        }//if
+
+        data += written;
+        size -= written;
+    }//while
+
+    if (0 != fdatasync(fileDescriptor)) {
+        closeJournalFile();
+        fileBroken = true;
+        return;
+    }//if
+
+    journalSize += record.size();
+    ++numRecords;
+}//appendRecord
+
+//A fresh journal: the header, the base record and the given records, then opened to append to
+bool ProjectJournal::writeJournalFile(const std::vector<std::vector<unsigned char> > &records)
+{
+    closeJournalFile();
+
+    std::vector<unsigned char> fileHeader = getFileHeader();
+
+    std::vector<std::pair<const void *, size_t> > pieces;
+    pieces.push_back(std::make_pair((const void *)fileHeader.data(), fileHeader.size()));
+    pieces.push_back(std::make_pair((const void *)baseRecord.data(), baseRecord.size()));
+
+    unsigned long long size = fileHeader.size() + baseRecord.size();
+    for (const std::vector<unsigned char> &record : records) {
+        pieces.push_back(std::make_pair((const void *)record.data(), record.size()));
+        size += record.size();
+    }//foreach
+
+    std::string journalFilename = getJournalFilename(projectFilename);
+
+    std::string error;
+    if (false == writeFileAtomically(journalFilename, pieces, error)) {
+        return false;
+    }//if
+
+    fileDescriptor = open(journalFilename.c_str(), O_WRONLY | O_APPEND);
+    if (fileDescriptor < 0) {
+        return false;
+    }//if
+
+    journalSize = size;
+    numRecords = records.size();
+
+    return true;
+}//writeJournalFile
+
+void ProjectJournal::closeJournalFile()
+{
+    if (fileDescriptor >= 0) {
+        close(fileDescriptor);
+        fileDescriptor = -1;
+    }//if
+}//closeJournalFile
+
+bool ProjectJournal::wantsCompaction() const
+{
+    if ((true == projectFilename.empty()) || (true == capturing)) {
+        return false;
+    }//if
+
+    time_t now = time(nullptr);
+    if (now - lastSnapshotTime < minSnapshotSpacing) {
+        return false;
+    }//if
+
+    if (true == fileBroken) {
+        return true;
+    }//if
+
+    if (0 == numRecords) {
+        return false;
+    }//if
+
+    return (journalSize >= compactJournalBytes) || (now - baseTime >= compactionInterval);
+}//wantsCompaction
+
+void ProjectJournal::beginSnapshot()
+{
+    //Edits from here on are numbered from the snapshot; the old journal has to know that too, since it's
+    // what gets replayed if this snapshot never makes it
+    if ((fileDescriptor >= 0) && (false == fileBroken)) {
+        BinaryProjectContext context;
+        BinaryOArchive opArchive(context);
+        opArchive.saveByte((unsigned char)JournalOp::Renumber);
+        appendRecord(makeRecord(context, opArchive));
+    }//if
+
+    numberProject();
+
+    capturing = true;
+    captureBroken = false;
+    capturedRecords.clear();
+    lastSnapshotTime = time(nullptr);
+}//beginSnapshot
+
+void ProjectJournal::finishSnapshot(const std::string &projectFilename_, const std::string &baseFilename_, bool succeeded)
+{
+    //Stopped, or started on another project, while it was saving
+    if (false == capturing) {
+        return;
+    }//if
+
+    capturing = false;
+
+    std::vector<std::vector<unsigned char> > records;
+    records.swap(capturedRecords);
+
+    if (false == succeeded) {
+        return;
+    }//if
+
+    closeJournalFile();
+
+    //Saved under a new name: the old name's journal is for a project that's no longer open
+    if ((false == projectFilename.empty()) && (projectFilename != projectFilename_)) {
+        remove(getJournalFilename(projectFilename).c_str());
+        remove(getAutosaveFilename(projectFilename).c_str());
+    }//if
+
+    projectFilename = projectFilename_;
+    baseFilename = baseFilename_;
+    baseRecord = makeBaseRecord(baseFilename);
+    baseTime = time(nullptr);
+    journalSize = 0;
+    numRecords = 0;
+
+    if (baseFilename == projectFilename) {
+        remove(getAutosaveFilename(projectFilename).c_str());
+    }//if
+
+    if (true == captureBroken) {
+        remove(getJournalFilename(projectFilename).c_str());
+        fileBroken = true;
+        return;
+    }//if
+
+    fileBroken = false;
+
+    //Saved with nothing since: the project file is all there is to recover
+    if ((true == records.empty()) && (baseFilename == projectFilename)) {
+        remove(getJournalFilename(projectFilename).c_str());
+        return;
+    }//if
+
+    if (false == writeJournalFile(records)) {
+        fileBroken = true;
+    }//if
+}//finishSnapshot
+
+bool ProjectJournal::findRecovery(const std::string &projectFilename, std::string &baseFilename, std::string &error)
+{
+    error.clear();
+
+    std::vector<unsigned char> data;
+    if (false == readJournal(getJournalFilename(projectFilename), data)) {
+        return false;
+    }//if
+
+    if (0 == checkBase(data, baseFilename, error)) {
+        error = "Can't recover " + projectFilename + ": " + error;
+        return false;
+    }//if
+
+    return true;
+}//findRecovery
+
+bool ProjectJournal::recover(const std::string &projectFilename_, unsigned int &numEdits, std::string &error)
+{
+    numEdits = 0;
+
+    //Read before stop(), which removes the journal if this project was the one open
+    std::vector<unsigned char> data;
+    if (false == readJournal(getJournalFilename(projectFilename_), data)) {
+        error = "can't read " + getJournalFilename(projectFilename_);
+        return false;
+    }//if
+
+    std::string baseFilename_;
+    size_t baseRecordSize = checkBase(data, baseFilename_, error);
+    if (0 == baseRecordSize) {
+        return false;
+    }//if
+
+    stop();
+
+    projectFilename = projectFilename_;
+    baseFilename = baseFilename_;
+    baseRecord.assign(data.begin() + fileHeaderSize, data.begin() + fileHeaderSize + baseRecordSize);
+
+    numberProject();
+
+    //Up to the first record that didn't make it to the disk whole
+    size_t offset = fileHeaderSize + baseRecordSize;
+    std::vector<std::vector<unsigned char> > records;
+
+    while (offset < data.size()) {
+        size_t recordSize = checkRecord(data, offset);
+        if (0 == recordSize) {
+            break;
+        }//if
+
+        bool isEdit = false;
+        if (false == replayRecord(&data[offset + recordHeaderSize], recordSize - recordHeaderSize, isEdit)) {
+            break;
+        }//if
+
+        if (true == isEdit) {
+            ++numEdits;
+        }//if
+
+        records.push_back(std::vector<unsigned char>(data.begin() + offset, data.begin() + offset + recordSize));
+        offset += recordSize;
+    }//while
+
+    //Carries on from here; the torn end, if any, is dropped.  Left old, so the next idle folds it in.
+    baseTime = 0;
+    if (false == writeJournalFile(records)) {
+        fileBroken = true;
+    }//if
+
+    return true;
+}//recover
+
+bool ProjectJournal::replayRecord(const unsigned char *payload, size_t size, bool &isEdit)
+{
+    Globals &globals = Globals::Instance();
+
+    BinaryProjectContext context;
+    BinaryIArchive archive(context, payload, size);
+
+    isEdit = false;
+    pendingInstances.clear();
+
+    if (false == loadStrings(archive, payload)) {
+        return false;
+    }//if
+
+    while ((archive.getPosition() < archive.getSize()) && (false == archive.hasFailed())) {
+        JournalOp op = (JournalOp)archive.loadByte();
+
+        switch (op) {
+            case JournalOp::Renumber:
+                numberProject();
+                break;
+
+            case JournalOp::Tempo:
+                archive.load(globals.projectData.tempoChanges);
+                isEdit = true;
+                break;
+
+            case JournalOp::Entry:
+                replayEntry(archive);
+                isEdit = true;
+                break;
+
+            case JournalOp::EntryOrder:
+            {
+                unsigned long long numEntries = archive.loadVarint();
+                if (numEntries > archive.getSize() - archive.getPosition()) {
+                    archive.setFailed();
+                    break;
+                }//if
+
+                Sequencer::SequencerEntriesType entryOrder;
+                for (unsigned long long entryIndex = 0; (entryIndex < numEntries) && (false == archive.hasFailed()); ++entryIndex) {
+                    unsigned long long id = archive.loadVarint();
+
+                    if (id == entries.size() + 1) {
+                        getEntryId(std::shared_ptr<SequencerEntry>(new SequencerEntry));
+                    } else if ((0 == id) || (id > entries.size())) {
+                        archive.setFailed();
+                        break;
+                    }//if
+
+                    entryOrder.push_back(entries[id - 1]);
+                }//for
+
+                if (false == archive.hasFailed()) {
+                    globals.projectData.getSequencer()->setEntryMap(entryOrder);
+                }//if
+
+                isEdit = true;
+                break;
+            }
+
+            case JournalOp::Keys:
+                replayKeys(archive);
+                isEdit = true;
+                break;
+
+            default:
+                archive.setFailed();
+                break;
+        }//switch
+    }//while
+
+    for (auto instanceIter : pendingInstances) {
+        std::shared_ptr<SequencerEntryBlock> entryBlock = instanceIter.first;
+        unsigned int instanceOfId = instanceIter.second.first;
+        unsigned char flags = instanceIter.second.second;
+
+        if (instanceOfId > entryBlocks.size()) {
+            archive.setFailed();
+            break;
+        }//if
+
+        std::shared_ptr<SequencerEntryBlock> instanceOf = (0 == instanceOfId) ? std::shared_ptr<SequencerEntryBlock>() : entryBlocks[instanceOfId - 1];
+        entryBlock->instanceOf = instanceOf;
+        entryBlock->curve->instanceOf = ((instanceOf != nullptr) && (0 != (flags & CurveIsInstance))) ? instanceOf->curve : std::shared_ptr<Animation>();
+        entryBlock->secondaryCurve->instanceOf = ((instanceOf != nullptr) && (0 != (flags & SecondaryCurveIsInstance))) ?
+                                                    instanceOf->secondaryCurve : std::shared_ptr<Animation>();
+    }//foreach
+
+    pendingInstances.clear();
+
+    return (false == archive.hasFailed());
+}//replayRecord
+
+bool ProjectJournal::replayEntry(BinaryIArchive &archive)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    unsigned long long id = archive.loadVarint();
+    if (id == entries.size() + 1) {
+        getEntryId(std::shared_ptr<SequencerEntry>(new SequencerEntry));
+    } else if ((0 == id) || (id > entries.size())) {
+        archive.setFailed();
+        return false;
+    }//if
+
+    std::shared_ptr<SequencerEntry> entry = entries[id - 1];
+
+    std::shared_ptr<SequencerEntryImpl> impl(new SequencerEntryImpl);
+    archive.load(*impl);
+
+    std::vector<std::string> inputPortNames;
+    std::vector<std::string> outputPortNames;
+    archive.load(inputPortNames);
+    archive.load(outputPortNames);
+
+    if (true == archive.hasFailed()) {
+        return false;
+    }//if
+
+    entry->setNewDataImpl(impl);
+
+    std::set<jack_port_t *> inputPorts;
+    std::set<jack_port_t *> outputPorts;
+
+    for (const std::string &portName : inputPortNames) {
+        inputPorts.insert(jackSingleton.getInputPort(portName));
+    }//foreach
+
+    for (const std::string &portName : outputPortNames) {
+        outputPorts.insert(jackSingleton.getOutputPort(portName));
+    }//foreach
+
+    entry->setInputPorts(inputPorts);
+    entry->setOutputPorts(outputPorts);
+
+    //The block list is replaced outright
+    std::vector<std::shared_ptr<SequencerEntryBlock> > oldEntryBlocks;
+    for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+        oldEntryBlocks.push_back(entryBlockIter.second);
+    }//foreach
+
+    for (std::shared_ptr<SequencerEntryBlock> entryBlock : oldEntryBlocks) {
+        entry->removeEntryBlock(entryBlock);
+    }//foreach
+
+    unsigned long long numEntryBlocks = archive.loadVarint();
+    for (unsigned long long entryBlockIndex = 0; (entryBlockIndex < numEntryBlocks) && (false == archive.hasFailed()); ++entryBlockIndex) {
+        unsigned long long entryBlockId = archive.loadVarint();
+        BlockSource source = (BlockSource)archive.loadByte();
+
+        unsigned long long cloneSourceId = 0;
+        if (BlockSource::Cloned == source) {
+            cloneSourceId = archive.loadVarint();
+        }//if
+
+        int startTick = (int)archive.loadZigzag();
+        std::string title;
+        archive.load(title);
+        unsigned int instanceOfId = (unsigned int)archive.loadVarint();
+        unsigned char flags = archive.loadByte();
+
+        if (true == archive.hasFailed()) {
+            return false;
+        }//if
+
+        std::shared_ptr<SequencerEntryBlock> entryBlock;
+
+        switch (source) {
+            case BlockSource::Known:
+                if ((0 == entryBlockId) || (entryBlockId > entryBlocks.size())) {
+                    archive.setFailed();
+                    return false;
+                }//if
+
+                entryBlock = entryBlocks[entryBlockId - 1];
+                break;
+
+            case BlockSource::New:
+                if (entryBlockId != entryBlocks.size() + 1) {
+                    archive.setFailed();
+                    return false;
+                }//if
+
+                entryBlock.reset(new SequencerEntryBlock(entry, startTick, std::shared_ptr<SequencerEntryBlock>()));
+                if ((false == loadCurve(archive, entryBlock->curve)) || (false == loadCurve(archive, entryBlock->secondaryCurve))) {
+                    return false;
+                }//if
+
+                getEntryBlockId(entryBlock);
+                break;
+
+            case BlockSource::Cloned:
+                if ((entryBlockId != entryBlocks.size() + 1) || (0 == cloneSourceId) || (cloneSourceId > entryBlocks.size())) {
+                    archive.setFailed();
+                    return false;
+                }//if
+
+                entryBlock = entryBlocks[cloneSourceId - 1]->deepClone(entry, startTick);
+                getEntryBlockId(entryBlock);
+                break;
+
+            default:
+                archive.setFailed();
+                return false;
+        }//switch
+
+        entryBlock->owningEntry = entry;
+        entryBlock->startTick = startTick;
+        entryBlock->title = title;
+
+        pendingInstances.push_back(std::make_pair(entryBlock, std::make_pair(instanceOfId, flags)));
+        entry->addEntryBlock(entryBlock);
+    }//for
+
+    return (false == archive.hasFailed());
+}//replayEntry
+
+bool ProjectJournal::replayKeys(BinaryIArchive &archive)
+{
+    unsigned long long entryBlockId = archive.loadVarint();
+    if ((0 == entryBlockId) || (entryBlockId > entryBlocks.size())) {
+        archive.setFailed();
+        return false;
+    }//if
+
+    std::shared_ptr<Animation> curve = entryBlocks[entryBlockId - 1]->curve;
+    curve->materializeKeyframes();
+
+    unsigned long long numTicks = archive.loadVarint();
+    for (unsigned long long tickIndex = 0; (tickIndex < numTicks) && (false == archive.hasFailed()); ++tickIndex) {
+        int tick = (int)archive.loadZigzag();
+
+        if (0 == archive.loadByte()) {
+            curve->keyframes.erase(tick);
+            continue;
+        }//if
+
+        std::shared_ptr<Keyframe> keyframe = std::make_shared<Keyframe>();
+        keyframe->tick = tick;
+        archive.load(keyframe->value);
+        archive.load(keyframe->inTangent[0]);
+        archive.load(keyframe->inTangent[1]);
+        archive.load(keyframe->outTangent[0]);
+        archive.load(keyframe->outTangent[1]);
+
+        unsigned char curveType = archive.loadByte();
+        if (curveType > (unsigned char)CurveType::Bezier) {
+            archive.setFailed();
+            break;
+        }//if
+        keyframe->curveType = (CurveType)curveType;
+
+        if (false == archive.hasFailed()) {
+            curve->keyframes[tick] = keyframe;
+        }//if
+    }//for
+
+    return (false == archive.hasFailed());
+}//replayKeys
+
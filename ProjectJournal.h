@@ -0,0 +1,137 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __PROJECTJOURNAL_H
+#define __PROJECTJOURNAL_H
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class SequencerEntry;
+class SequencerEntryBlock;
+class Animation;
+class BinaryOArchive;
+class BinaryIArchive;
+
+//The edits made since the project was last written out in full, appended to <project>.journal as they're
+// made, so a crash loses nothing.  Every command that goes through the CommandManager (done, undone or
+// redone) calls touch* for what it changed and the journal writes one record per command with just that:
+// the keys at the ticks it touched, the block list of an entry it changed, the tempo map.  Keys only go in
+// whole for blocks the journal hasn't seen yet (pasted, split, imported or recorded ones).
+//
+//  file     "FMAJ", format version, then records
+//  record   payload size, CRC-32 of the payload, payload: its own string table, then operations
+//
+//The first record names the base, the full project the rest apply to, by filename, size and modification
+// time.  Entries and blocks are referred to by number: the base's in the order the binary project writes
+// them, then new ones numbered as they first appear.  A torn record at the end (the crash) is dropped.
+//
+//The journal is folded into a snapshot from time to time (the editor writes <project>.autosave.fmab on the
+// saver's thread and starts a new journal on it) and on every save.  Edits made while a snapshot is being
+// written go in both the old journal and the new one.  Changes made outside commands (port assignments,
+// window layout) only reach the journal with the next snapshot.
+class ProjectJournal
+{
+    std::string projectFilename; //empty until the project has a file
+    std::string baseFilename;
+    std::vector<unsigned char> baseRecord;
+    int fileDescriptor; //opened on the first record after the base
+    unsigned long long journalSize;
+    unsigned int numRecords;
+    time_t baseTime;
+    time_t lastSnapshotTime;
+    bool fileBroken; //something went in that it couldn't describe; nothing more is added until a snapshot
+
+    bool capturing; //a snapshot is being written
+    bool captureBroken;
+    std::vector<std::vector<unsigned char> > capturedRecords;
+
+    //Kept alive so the numbers can't be reused by new objects at the same address
+    std::vector<std::shared_ptr<SequencerEntry> > entries;
+    std::vector<std::shared_ptr<SequencerEntryBlock> > entryBlocks;
+    std::unordered_map<const SequencerEntry *, unsigned int> entryIds;
+    std::unordered_map<const SequencerEntryBlock *, unsigned int> entryBlockIds;
+
+    //What the current command touched
+    bool tempoTouched;
+    bool entryOrderTouched;
+    std::vector<std::shared_ptr<SequencerEntry> > touchedEntries;
+    std::set<const SequencerEntry *> touchedEntrySet;
+    std::map<std::shared_ptr<SequencerEntryBlock>, std::set<int> > touchedKeys;
+    std::unordered_map<const SequencerEntryBlock *, std::shared_ptr<SequencerEntryBlock> > cloneSources;
+
+    //While replaying: instance links, set once the whole record is in
+    std::vector<std::pair<std::shared_ptr<SequencerEntryBlock>, std::pair<unsigned int, unsigned char> > > pendingInstances;
+
+    ProjectJournal();
+    ~ProjectJournal();
+
+    void clearTouches();
+    void numberProject();
+    unsigned int getEntryId(std::shared_ptr<SequencerEntry> entry);
+    unsigned int getEntryBlockId(std::shared_ptr<SequencerEntryBlock> entryBlock);
+    bool isKnown(const SequencerEntryBlock *entryBlock) const;
+
+    std::vector<unsigned char> makeBaseRecord(const std::string &baseFilename) const;
+    bool buildRecord(std::vector<unsigned char> &record);
+    void saveEntry(BinaryOArchive &archive, std::shared_ptr<SequencerEntry> entry, const std::set<const SequencerEntryBlock *> &newEntryBlocks);
+    void appendRecord(const std::vector<unsigned char> &record);
+    bool writeJournalFile(const std::vector<std::vector<unsigned char> > &records);
+    void closeJournalFile();
+
+    static void saveCurve(BinaryOArchive &archive, std::shared_ptr<Animation> curve);
+    static bool loadCurve(BinaryIArchive &archive, std::shared_ptr<Animation> curve);
+    static bool curvesMatch(std::shared_ptr<Animation> curve, std::shared_ptr<Animation> otherCurve);
+
+    bool replayRecord(const unsigned char *payload, size_t size, bool &isEdit);
+    bool replayEntry(BinaryIArchive &archive);
+    bool replayKeys(BinaryIArchive &archive);
+
+public:
+    static ProjectJournal &Instance();
+
+    static std::string getJournalFilename(const std::string &projectFilename);
+    static std::string getAutosaveFilename(const std::string &projectFilename);
+
+    //The project was just loaded from projectFilename; a journal left beside it is thrown out
+    void start(const std::string &projectFilename);
+    //Closed cleanly: the journal and autosave go
+    void stop();
+
+    bool isActive() const;
+    const std::string &getProjectFilename() const;
+
+    //Called from Command::addToJournal, after the command has done (or undone) its change
+    void touchTempo();
+    void touchEntryOrder();
+    void touchEntry(std::shared_ptr<SequencerEntry> entry);
+    void touchClonedEntry(std::shared_ptr<SequencerEntry> entry, std::shared_ptr<SequencerEntry> origEntry); //entry is a (changed) deep clone
+    void touchKeys(std::shared_ptr<SequencerEntryBlock> entryBlock, int tick); //tick is relative to the block, as the keyframes have it
+    void touchProject(); //a change it can't describe; the next snapshot picks it up
+    void commitRecord();
+
+    //Snapshots: begin when the project is handed to a saver, finish with where it went once the save is done
+    bool wantsCompaction() const;
+    void beginSnapshot();
+    void finishSnapshot(const std::string &projectFilename, const std::string &baseFilename, bool succeeded);
+
+    //After a crash.  findRecovery says which file to load; once that's loaded into a fresh Globals, recover
+    // applies the journal to it and carries on appending to it.
+    static bool findRecovery(const std::string &projectFilename, std::string &baseFilename, std::string &error);
+    bool recover(const std::string &projectFilename, unsigned int &numEdits, std::string &error);
+};//ProjectJournal
+
+
+#endif
+
@@ -0,0 +1,216 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "ProjectSaver.h"
+#include "BinaryProject.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+//Written in pieces this size so progress moves on big files
+const size_t writeBlockSize = 1024 * 1024;
+
+bool writeAll(int fileDescriptor, const unsigned char *data, size_t size, SaveProgress *progress)
+{
+    while (size > 0) {
+        ssize_t written = write(fileDescriptor, data, std::min(size, writeBlockSize));
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }//if
+
+            return false;
+        }//if
+
+        data += written;
+        size -= written;
+
+        if (progress != nullptr) {
+            progress->bytesWritten += written;
+        }//if
+    }//while
+
+    return true;
+}//writeAll
+
+//So the rename itself survives a crash
+void syncDirectoryOf(const std::string &filename)
+{
+    size_t slashPos = filename.rfind('/');
+    std::string directory = (slashPos == std::string::npos) ? std::string(".") : filename.substr(0, std::max(slashPos, (size_t)1));
+
+    int directoryDescriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryDescriptor >= 0) {
+        fsync(directoryDescriptor);
+        close(directoryDescriptor);
+    }//if
+}//syncDirectoryOf
+
+}//anonymous namespace
+
+bool writeFileAtomically(const std::string &filename, const std::vector<std::pair<const void *, size_t> > &pieces, std::string &error,
+                            SaveProgress *progress)
+{
+    if (progress != nullptr) {
+        unsigned long long bytesTotal = 0;
+        for (auto piece : pieces) {
+            bytesTotal += piece.second;
+        }//foreach
+
+        progress->bytesWritten = 0;
+        progress->bytesTotal = bytesTotal;
+    }//if
+
+    std::string tempFilename = filename + ".tmp";
+
+    int fileDescriptor = open(tempFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fileDescriptor < 0) {
+        error = "can't write " + tempFilename + ": " + strerror(errno);
+        return false;
+    }//if
+
+    //The rename would otherwise leave the project with our umask's permissions and owned by us.  Ownership
+    // only carries over where we're allowed to give it; the mode goes on after, since a chown can clear bits.
+    struct stat existingStat;
+    if (0 == stat(filename.c_str(), &existingStat)) {
+        int chownResult = fchown(fileDescriptor, existingStat.st_uid, existingStat.st_gid);
+        (void)chownResult;
+
+        fchmod(fileDescriptor, existingStat.st_mode & 07777);
+    }//if
+
+    bool written = true;
+    for (auto piece : pieces) {
+        if (false == writeAll(fileDescriptor, (const unsigned char *)piece.first, piece.second, progress)) {
+            written = false;
+            break;
+        }//if
+    }//foreach
+
+    if ((true == written) && (0 != fsync(fileDescriptor))) {
+        written = false;
+    }//if
+
+    int writeErrno = errno;
+    if ((0 != close(fileDescriptor)) && (true == written)) {
+        written = false;
+        writeErrno = errno;
+    }//if
+
+    if (false == written) {
+        remove(tempFilename.c_str());
+        error = "error writing " + tempFilename + ": " + strerror(writeErrno);
+        return false;
+    }//if
+
+    if (0 != rename(tempFilename.c_str(), filename.c_str())) {
+        error = "can't replace " + filename + ": " + strerror(errno);
+        remove(tempFilename.c_str());
+        return false;
+    }//if
+
+    syncDirectoryOf(filename);
+
+    return true;
+}//writeFileAtomically
+
+ProjectSaver::ProjectSaver()
+{
+    finished = false;
+    progress.bytesWritten = 0;
+    progress.bytesTotal = 0;
+    succeeded = false;
+}//constructor
+
+ProjectSaver::~ProjectSaver()
+{
+    if (true == thread.joinable()) {
+        thread.join();
+    }//if
+}//destructor
+
+void ProjectSaver::start(const std::string &filename_)
+{
+    filename = filename_;
+    error.clear();
+    succeeded = false;
+    finished = false;
+    progress.bytesWritten = 0;
+    progress.bytesTotal = 0;
+
+    thread = std::thread([=]() { saveThreadFunc(); });
+}//start
+
+void ProjectSaver::startBinarySave(std::shared_ptr<BinaryProjectWriter> projectWriter, const std::string &filename_)
+{
+    binaryProject = projectWriter;
+    xmlProject.clear();
+    start(filename_);
+}//startBinarySave
+
+void ProjectSaver::startXMLSave(std::string xmlProject_, const std::string &filename_)
+{
+    binaryProject.reset();
+    xmlProject.swap(xmlProject_);
+    start(filename_);
+}//startXMLSave
+
+void ProjectSaver::saveThreadFunc()
+{
+    if (binaryProject != nullptr) {
+        succeeded = binaryProject->save(filename, error, &progress);
+    } else {
+        std::vector<std::pair<const void *, size_t> > pieces;
+        pieces.push_back(std::make_pair((const void *)xmlProject.data(), xmlProject.size()));
+        succeeded = writeFileAtomically(filename, pieces, error, &progress);
+    }//if
+
+    finished = true;
+}//saveThreadFunc
+
+bool ProjectSaver::isBusy() const
+{
+    return thread.joinable();
+}//isBusy
+
+bool ProjectSaver::isFinished() const
+{
+    return finished;
+}//isFinished
+
+unsigned int ProjectSaver::getPercentDone() const
+{
+    unsigned long long bytesTotal = progress.bytesTotal;
+    if (0 == bytesTotal) {
+        return 0;
+    }//if
+
+    return (unsigned int)((progress.bytesWritten * 100) / bytesTotal);
+}//getPercentDone
+
+bool ProjectSaver::finish(std::string &error_)
+{
+    if (true == thread.joinable()) {
+        thread.join();
+    }//if
+
+    binaryProject.reset();
+    std::string().swap(xmlProject);
+
+    error_ = error;
+    return succeeded;
+}//finish
+
@@ -0,0 +1,68 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __PROJECTSAVER_H
+#define __PROJECTSAVER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class BinaryProjectWriter;
+
+struct SaveProgress
+{
+    std::atomic<unsigned long long> bytesWritten;
+    std::atomic<unsigned long long> bytesTotal;
+};//SaveProgress
+
+//Writes the pieces, in order, to filename.tmp, fsyncs it and renames it over filename, so a crash or a full
+// disk part way through leaves the old file as it was
+bool writeFileAtomically(const std::string &filename, const std::vector<std::pair<const void *, size_t> > &pieces, std::string &error,
+                            SaveProgress *progress = nullptr);
+
+//Saves a project on its own thread.  The caller takes the snapshot (a BinaryProjectWriter that has had
+// addProject, or the XML already serialized), which owns everything it needs, so the model can be edited and
+// played while this writes it out.  One save at a time; poll isFinished() and collect the result with finish().
+class ProjectSaver
+{
+    std::thread thread;
+    std::atomic<bool> finished;
+    SaveProgress progress;
+
+    //Only touched by the save thread until finished is set
+    std::shared_ptr<BinaryProjectWriter> binaryProject;
+    std::string xmlProject;
+    std::string filename;
+    std::string error;
+    bool succeeded;
+
+    void saveThreadFunc();
+    void start(const std::string &filename);
+
+public:
+    ProjectSaver();
+    ~ProjectSaver(); //waits for a save in progress
+
+    void startBinarySave(std::shared_ptr<BinaryProjectWriter> projectWriter, const std::string &filename);
+    void startXMLSave(std::string xmlProject, const std::string &filename);
+
+    bool isBusy() const; //started and not yet collected with finish()
+    bool isFinished() const;
+    unsigned int getPercentDone() const;
+
+    //Waits for the thread and drops the snapshot here rather than on the save thread
+    bool finish(std::string &error);
+};//ProjectSaver
+
+
+#endif
+
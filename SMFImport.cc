@@ -0,0 +1,305 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "SMFImport.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <boost/lexical_cast.hpp>
+#include "SMFReader.h"
+#include "Animation.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+#include "Globals.h"
+
+namespace
+{
+
+//Same as SequencerEntry::commitRecordedTokens
+const int separationTickTime = 2000;
+
+struct LaneKey
+{
+    int tick;
+    unsigned short value; //always 14 bit here; a lane that never got a fine value only uses the top 7
+};//LaneKey
+
+bool laneKeyLess(const LaneKey &a, const LaneKey &b)
+{
+    return a.tick < b.tick;
+}//laneKeyLess
+
+//What the controller messages on a channel end up driving: a plain or 14 bit CC, or an RPN/NRPN parameter
+struct Lane
+{
+    Lane() : fourteenBit(false), coarse(0) {}
+
+    std::vector<LaneKey> keys;
+    bool fourteenBit; //saw a fine value (CC n + 32, or data entry LSB)
+    unsigned char coarse; //the last coarse value, for fine values to land under
+};//Lane
+
+//CC lanes sort by channel and controller, with every RPN and then every NRPN parameter after them
+unsigned int laneId(ControlType controllerType, unsigned char channel, unsigned char msb, unsigned char lsb)
+{
+    return ((((unsigned int)controllerType * 16) + channel) * 128 + msb) * 128 + lsb;
+}//laneId
+
+struct ChannelEvent
+{
+    int tick;
+    unsigned int pulse;
+    unsigned char controller;
+    unsigned char value;
+};//ChannelEvent
+
+bool channelEventLess(const ChannelEvent &a, const ChannelEvent &b)
+{
+    return a.pulse < b.pulse;
+}//channelEventLess
+
+//Plays a channel's controller messages through the state a receiver would keep: CC n / n + 32 pairs become one
+// 14 bit lane, and data entry (6 / 38) lands on whichever RPN or NRPN parameter 101/100 or 99/98 last selected
+void gatherChannelLanes(unsigned char channel, const std::vector<ChannelEvent> &events, std::map<unsigned int, Lane> &lanes)
+{
+    bool seen[128] = {false};
+    for (const ChannelEvent &event : events) {
+        seen[event.controller] = true;
+    }//foreach
+
+    ControlType parameterType = ControlType::CC; //CC here means no parameter is selected
+    unsigned char rpnMsb = 127;
+    unsigned char rpnLsb = 127;
+    unsigned char nrpnMsb = 127;
+    unsigned char nrpnLsb = 127;
+
+    for (const ChannelEvent &event : events) {
+        unsigned char controller = event.controller;
+
+        //Parameter selection; 127/127 is the null RPN, after which data entry is just CC 6 and 38 again
+        if ((101 == controller) || (100 == controller)) {
+            if (101 == controller) {
+                rpnMsb = event.value;
+            } else {
+                rpnLsb = event.value;
+            }//if
+
+            parameterType = ((127 == rpnMsb) && (127 == rpnLsb)) ? ControlType::CC : ControlType::RPN;
+            continue;
+        }//if
+
+        if ((99 == controller) || (98 == controller)) {
+            if (99 == controller) {
+                nrpnMsb = event.value;
+            } else {
+                nrpnLsb = event.value;
+            }//if
+
+            parameterType = ControlType::NRPN;
+            continue;
+        }//if
+
+        LaneKey key;
+        key.tick = event.tick;
+
+        bool isFine = false;
+        unsigned int id = 0;
+        if (((6 == controller) || (38 == controller)) && (parameterType != ControlType::CC)) {
+            bool isRPN = (ControlType::RPN == parameterType);
+            id = laneId(parameterType, channel, isRPN ? rpnMsb : nrpnMsb, isRPN ? rpnLsb : nrpnLsb);
+            isFine = (38 == controller);
+        } else if ((controller < 32) && (true == seen[controller + 32])) {
+            id = laneId(ControlType::CC, channel, controller, 0);
+        } else if ((controller >= 32) && (controller < 64) && (true == seen[controller - 32])) {
+            id = laneId(ControlType::CC, channel, controller - 32, 0);
+            isFine = true;
+        } else {
+            id = laneId(ControlType::CC, channel, controller, 0);
+        }//if
+
+        //A coarse value clears the fine one, as it does on a receiver
+        Lane &lane = lanes[id];
+        if (true == isFine) {
+            lane.fourteenBit = true;
+            key.value = (lane.coarse << 7) | event.value;
+        } else {
+            lane.coarse = event.value;
+            key.value = event.value << 7;
+        }//if
+
+        lane.keys.push_back(key);
+    }//foreach
+}//gatherChannelLanes
+
+std::shared_ptr<SequencerEntry> findListeningEntry(ControlType controllerType, unsigned char channel, unsigned char msb, unsigned char lsb)
+{
+    Globals &globals = Globals::Instance();
+
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        std::shared_ptr<SequencerEntryImpl> impl = entry->getImpl();
+        if ((impl->controllerType != controllerType) || (impl->channel != channel) || (impl->msb != msb)) {
+            continue;
+        }//if
+
+        if ((ControlType::CC == controllerType) || (impl->lsb == lsb)) {
+            return entry;
+        }//if
+    }//foreach
+
+    return std::shared_ptr<SequencerEntry>();
+}//findListeningEntry
+
+bool overlapsExistingBlocks(std::shared_ptr<SequencerEntry> entry, int startTick, int endTick)
+{
+    for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+        std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+        int blockEndTick = entryBlock->getStartTick() + entryBlock->getDuration();
+        if ((entryBlock->getStartTick() <= endTick) && (blockEndTick >= startTick)) {
+            return true;
+        }//if
+    }//foreach
+
+    return false;
+}//overlapsExistingBlocks
+
+}//anonymous namespace
+
+bool buildSMFImport(const std::string &filename, bool simplify, SMFImport &smfImport, std::string &error)
+{
+    smfImport.newEntries.clear();
+    smfImport.entryBlocks.clear();
+    smfImport.controllerEvents = 0;
+    smfImport.keyframes = 0;
+    smfImport.truncated = false;
+
+    SMFReader reader;
+    if (reader.open(filename) == false) {
+        error = reader.getError();
+        return false;
+    }//if
+
+    reader.tokenizeTracks();
+
+    //Each channel's messages, in file order across every track; RPN and NRPN selections only mean anything in order
+    std::vector<std::vector<ChannelEvent> > channelEvents(16);
+    for (const SMFTrack &track : reader.getTracks()) {
+        smfImport.truncated |= track.truncated;
+        smfImport.controllerEvents += track.controllers.size();
+
+        for (const SMFControllerEvent &event : track.controllers) {
+            ChannelEvent channelEvent;
+            channelEvent.tick = (int)std::floor(reader.pulsesToTicks(event.pulse) + 0.5);
+            channelEvent.pulse = event.pulse;
+            channelEvent.controller = event.controller;
+            channelEvent.value = event.value;
+            channelEvents[event.channel].push_back(channelEvent);
+        }//foreach
+    }//foreach
+
+    std::map<unsigned int, Lane> lanes;
+    for (unsigned char channel = 0; channel < 16; ++channel) {
+        std::stable_sort(channelEvents[channel].begin(), channelEvents[channel].end(), channelEventLess);
+        gatherChannelLanes(channel, channelEvents[channel], lanes);
+    }//for
+
+    for (auto &laneIter : lanes) {
+        std::vector<LaneKey> &laneKeys = laneIter.second.keys;
+        bool fourteenBit = laneIter.second.fourteenBit;
+
+        ControlType controllerType = (ControlType)(laneIter.first / (16 * 128 * 128));
+        unsigned char channel = (laneIter.first / (128 * 128)) % 16;
+        unsigned char msb = (laneIter.first / 128) % 128;
+        unsigned char lsb = laneIter.first % 128;
+
+        std::stable_sort(laneKeys.begin(), laneKeys.end(), laneKeyLess);
+
+        //Split into runs, keeping the last value where several land on the same tick
+        std::vector<std::vector<LaneKey> > runs;
+        for (const LaneKey &key : laneKeys) {
+            if ((runs.empty() == true) || ((key.tick - runs.back().back().tick) > separationTickTime)) {
+                runs.push_back(std::vector<LaneKey>());
+            }//if
+
+            std::vector<LaneKey> &run = runs.back();
+            if ((run.empty() == false) && (run.back().tick == key.tick)) {
+                run.back().value = key.value;
+                continue;
+            }//if
+
+            run.push_back(key);
+        }//foreach
+
+        if (true == simplify) {
+            for (std::vector<LaneKey> &run : runs) {
+                auto newEnd = std::unique(run.begin(), run.end(), [](const LaneKey &a, const LaneKey &b) { return a.value == b.value; });
+                run.erase(newEnd, run.end());
+            }//foreach
+        }//if
+
+        std::shared_ptr<SequencerEntry> entry = findListeningEntry(controllerType, channel, msb, lsb);
+        if (entry != nullptr) {
+            for (const std::vector<LaneKey> &run : runs) {
+                if (true == overlapsExistingBlocks(entry, run.front().tick, run.back().tick)) {
+                    entry.reset();
+                    break;
+                }//if
+            }//foreach
+        }//if
+
+        if (nullptr == entry) {
+            entry.reset(new SequencerEntry);
+
+            std::shared_ptr<SequencerEntryImpl> impl = entry->getImplClone();
+            impl->controllerType = controllerType;
+            impl->channel = channel;
+            impl->msb = msb;
+            impl->lsb = lsb;
+            impl->sevenBit = (false == fourteenBit);
+
+            impl->title = "Ch " + boost::lexical_cast<std::string>(channel + 1);
+            if (ControlType::CC == controllerType) {
+                impl->title += " CC " + boost::lexical_cast<std::string>((int)msb);
+            } else {
+                unsigned int parameter = msb * 128 + lsb;
+                impl->title += ((ControlType::RPN == controllerType) ? " RPN " : " NRPN ") + boost::lexical_cast<std::string>(parameter);
+            }//if
+
+            entry->setNewDataImpl(impl);
+
+            smfImport.newEntries.push_back(entry);
+        }//if
+
+        //The file has raw controller values; keys are in the entry's units, whatever its own resolution
+        std::shared_ptr<SequencerEntryImpl> impl = entry->getImpl();
+        double valueScale = (impl->maxValue - impl->minValue) / ((true == fourteenBit) ? 16383.0 : 127.0);
+        unsigned int valueShift = (true == fourteenBit) ? 0 : 7;
+
+        for (const std::vector<LaneKey> &run : runs) {
+            int startTick = run.front().tick;
+            std::shared_ptr<SequencerEntryBlock> entryBlock(new SequencerEntryBlock(entry, startTick, std::shared_ptr<SequencerEntryBlock>()));
+            std::shared_ptr<Animation> curve = entryBlock->getCurve();
+
+            for (const LaneKey &key : run) {
+                std::shared_ptr<Keyframe> keyframe(new Keyframe);
+                keyframe->tick = key.tick - startTick;
+                keyframe->value = impl->minValue + (key.value >> valueShift) * valueScale;
+                keyframe->curveType = CurveType::Step;
+
+                curve->addKey(keyframe);
+            }//foreach
+
+            smfImport.keyframes += run.size();
+            smfImport.entryBlocks.push_back(std::make_pair(entry, entryBlock));
+        }//foreach
+    }//for
+
+    return true;
+}//buildSMFImport
+
@@ -0,0 +1,39 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __SMFIMPORT_H
+#define __SMFIMPORT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class SequencerEntry;
+class SequencerEntryBlock;
+
+//What an import adds to the project; handed to ImportSMFCommand so it's a single undo step
+struct SMFImport
+{
+    std::vector<std::shared_ptr<SequencerEntry> > newEntries;
+    std::vector<std::pair<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntryBlock> > > entryBlocks;
+
+    unsigned long long controllerEvents; //read from the file
+    unsigned long long keyframes;        //what's left after simplifying
+    bool truncated;                      //at least one track ended early
+};//SMFImport
+
+//Maps each (channel, controller) in the file to the entry already listening to it, or a new entry when there
+// isn't one (or the imported data would land on top of what's there).  A controller under 32 whose n + 32 is also
+// in the file becomes one 14 bit entry, and data entry after an RPN or NRPN selection goes to that parameter's
+// entry.  Runs of controller messages become entry blocks of step keys, split like recordings where the file goes
+// quiet.  With simplify, keys that don't change the value are left out.
+bool buildSMFImport(const std::string &filename, bool simplify, SMFImport &smfImport, std::string &error);
+
+
+#endif
@@ -0,0 +1,328 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "SMFReader.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+const unsigned int defaultMicrosecondsPerQuarter = 500000; //120 bpm
+
+unsigned int readBigEndian(const unsigned char *data, unsigned int numBytes)
+{
+    unsigned int value = 0;
+    for (unsigned int index = 0; index < numBytes; ++index) {
+        value = (value << 8) | data[index];
+    }//for
+
+    return value;
+}//readBigEndian
+
+//False if the value runs past the end, or is longer than the four bytes a quantity can take
+bool readVariableLength(const unsigned char *&pos, const unsigned char *end, unsigned int &value)
+{
+    value = 0;
+    for (unsigned int index = 0; index < 4; ++index) {
+        if (pos >= end) {
+            return false;
+        }//if
+
+        unsigned char byte = *pos++;
+        value = (value << 7) | (byte & 0x7f);
+        if (0 == (byte & 0x80)) {
+            return true;
+        }//if
+    }//for
+
+    return false;
+}//readVariableLength
+
+bool tempoEventLess(const SMFTempoEvent &a, const SMFTempoEvent &b)
+{
+    return a.pulse < b.pulse;
+}//tempoEventLess
+
+}//anonymous namespace
+
+SMFReader::SMFReader()
+{
+    fd = -1;
+    mapped = nullptr;
+    mappedLength = 0;
+    format = 0;
+    division = 0;
+}//constructor
+
+SMFReader::~SMFReader()
+{
+    close();
+}//destructor
+
+void SMFReader::close()
+{
+    if (mapped != nullptr) {
+        munmap((void *)mapped, mappedLength);
+        mapped = nullptr;
+        mappedLength = 0;
+    }//if
+
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }//if
+
+    tracks.clear();
+    tempoMap.clear();
+    tempoMapTicks.clear();
+}//close
+
+bool SMFReader::open(const std::string &filename)
+{
+    close();
+
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Couldn't open " + filename;
+        return false;
+    }//if
+
+    struct stat fileStat;
+    if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size < 14)) {
+        error = filename + " is too short to be a MIDI file";
+        return false;
+    }//if
+
+    void *mappedData = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == mappedData) {
+        error = "Couldn't map " + filename;
+        return false;
+    }//if
+
+    mapped = (const unsigned char *)mappedData;
+    mappedLength = fileStat.st_size;
+    madvise(mappedData, mappedLength, MADV_SEQUENTIAL);
+
+    size_t headerLength = readBigEndian(mapped + 4, 4);
+    if ((std::equal(mapped, mapped + 4, "MThd") == false) || (headerLength < 6)) {
+        error = filename + " isn't a MIDI file";
+        return false;
+    }//if
+
+    if (headerLength > mappedLength - 8) {
+        error = filename + " has a header that runs past the end of the file";
+        return false;
+    }//if
+
+    format = readBigEndian(mapped + 8, 2);
+    unsigned int numTracks = readBigEndian(mapped + 10, 2);
+    division = readBigEndian(mapped + 12, 2);
+
+    //An SMPTE division needs its pulses per frame as much as a metrical one needs pulses per quarter
+    if ((0 == division) || ((division & 0x8000) && (0 == (division & 0xff)))) {
+        error = filename + " has no time division";
+        return false;
+    }//if
+
+    //Only the chunk headers are walked here; the tracks themselves are read in parallel later.  Lengths come from
+    // the file, so every step is checked against what's left rather than added to pos first.
+    const unsigned char *pos = mapped + 8 + headerLength;
+    const unsigned char *end = mapped + mappedLength;
+    while (((size_t)(end - pos) >= 8) && (tracks.size() < numTracks)) {
+        size_t chunkLength = readBigEndian(pos + 4, 4);
+        const unsigned char *chunkData = pos + 8;
+        bool isTrack = std::equal(pos, pos + 4, "MTrk");
+
+        SMFTrack track;
+        track.data = chunkData;
+        track.length = std::min(chunkLength, (size_t)(end - chunkData));
+        track.truncated = (track.length < chunkLength);
+
+        if (true == isTrack) {
+            tracks.push_back(track);
+        }//if
+
+        pos = chunkData + track.length;
+    }//while
+
+    return true;
+}//open
+
+void SMFReader::tokenizeTrack(SMFTrack &track)
+{
+    const unsigned char *pos = track.data;
+    const unsigned char *end = track.data + track.length;
+
+    //Most events in automation are controllers, so this is usually close
+    track.controllers.reserve(track.length / 3);
+
+    unsigned int pulse = 0;
+    unsigned char runningStatus = 0;
+
+    while (pos < end) {
+        unsigned int delta;
+        if (readVariableLength(pos, end, delta) == false) {
+            track.truncated = true;
+            return;
+        }//if
+
+        pulse += delta;
+        if (pos >= end) {
+            track.truncated = true;
+            return;
+        }//if
+
+        unsigned char status = *pos;
+        if (status & 0x80) {
+            pos++;
+        } else if (0 != runningStatus) {
+            status = runningStatus;
+        } else {
+            //A data byte with nothing to run on; the rest of the track can't be trusted
+            track.truncated = true;
+            return;
+        }//if
+
+        if ((0xff == status) || (0xf0 == status) || (0xf7 == status)) {
+            unsigned char metaType = 0;
+            if (0xff == status) {
+                if (pos >= end) {
+                    track.truncated = true;
+                    return;
+                }//if
+
+                metaType = *pos++;
+            }//if
+
+            unsigned int length;
+            if ((readVariableLength(pos, end, length) == false) || ((size_t)(end - pos) < length)) {
+                track.truncated = true;
+                return;
+            }//if
+
+            if ((0xff == status) && (0x51 == metaType) && (3 == length)) {
+                SMFTempoEvent tempo;
+                tempo.pulse = pulse;
+                tempo.microsecondsPerQuarter = readBigEndian(pos, 3);
+                track.tempos.push_back(tempo);
+            }//if
+
+            if ((0xff == status) && (0x2f == metaType)) {
+                return;
+            }//if
+
+            pos += length;
+            runningStatus = 0;
+            continue;
+        }//if
+
+        runningStatus = status;
+
+        unsigned int dataLength = 2;
+        if ((0xc0 == (status & 0xf0)) || (0xd0 == (status & 0xf0))) {
+            dataLength = 1;
+        }//if
+
+        if ((size_t)(end - pos) < dataLength) {
+            track.truncated = true;
+            return;
+        }//if
+
+        if (0xb0 == (status & 0xf0)) {
+            SMFControllerEvent event;
+            event.pulse = pulse;
+            event.channel = status & 0x0f;
+            event.controller = pos[0] & 0x7f;
+            event.value = pos[1] & 0x7f;
+            track.controllers.push_back(event);
+        }//if
+
+        pos += dataLength;
+    }//while
+}//tokenizeTrack
+
+void SMFReader::tokenizeTracks()
+{
+    std::atomic<size_t> nextTrack(0);
+    auto worker = [&]() {
+        for (size_t index = nextTrack++; index < tracks.size(); index = nextTrack++) {
+            tokenizeTrack(tracks[index]);
+        }//for
+    };
+
+    unsigned int numThreads = std::max(1U, std::min((unsigned int)tracks.size(), std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (unsigned int index = 1; index < numThreads; ++index) {
+        threads.push_back(std::thread(worker));
+    }//for
+
+    worker();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }//foreach
+
+    //Format 1 keeps the tempo map in the first track, but nothing stops other tracks having some
+    tempoMap.clear();
+    for (const SMFTrack &track : tracks) {
+        tempoMap.insert(tempoMap.end(), track.tempos.begin(), track.tempos.end());
+    }//foreach
+
+    std::stable_sort(tempoMap.begin(), tempoMap.end(), tempoEventLess);
+
+    tempoMapTicks.clear();
+    double ticks = 0;
+    unsigned int lastPulse = 0;
+    unsigned int microsecondsPerQuarter = defaultMicrosecondsPerQuarter;
+    for (const SMFTempoEvent &tempo : tempoMap) {
+        ticks += ((double)(tempo.pulse - lastPulse) * microsecondsPerQuarter) / (division * 1000.0);
+        tempoMapTicks.push_back(ticks);
+
+        lastPulse = tempo.pulse;
+        microsecondsPerQuarter = tempo.microsecondsPerQuarter;
+    }//foreach
+}//tokenizeTracks
+
+std::vector<SMFTrack> &SMFReader::getTracks()
+{
+    return tracks;
+}//getTracks
+
+double SMFReader::pulsesToTicks(unsigned int pulse)
+{
+    //SMPTE time: frames per second (negated in the high byte) and pulses per frame
+    if (division & 0x8000) {
+        int framesPerSecond = -(signed char)(division >> 8);
+        double pulsesPerSecond = ((29 == framesPerSecond) ? 29.97 : framesPerSecond) * (division & 0xff);
+        return (pulse * 1000.0) / pulsesPerSecond;
+    }//if
+
+    SMFTempoEvent key;
+    key.pulse = pulse;
+    auto tempoIter = std::upper_bound(tempoMap.begin(), tempoMap.end(), key, tempoEventLess);
+    if (tempoIter == tempoMap.begin()) {
+        return ((double)pulse * defaultMicrosecondsPerQuarter) / (division * 1000.0);
+    }//if
+
+    --tempoIter;
+    double tempoTicks = tempoMapTicks[tempoIter - tempoMap.begin()];
+    return tempoTicks + ((double)(pulse - tempoIter->pulse) * tempoIter->microsecondsPerQuarter) / (division * 1000.0);
+}//pulsesToTicks
+
+std::string SMFReader::getError()
+{
+    return error;
+}//getError
+
@@ -0,0 +1,71 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __SMFREADER_H
+#define __SMFREADER_H
+
+#include <string>
+#include <vector>
+
+struct SMFControllerEvent
+{
+    unsigned int pulse;
+    unsigned char channel;
+    unsigned char controller;
+    unsigned char value;
+};//SMFControllerEvent
+
+struct SMFTempoEvent
+{
+    unsigned int pulse;
+    unsigned int microsecondsPerQuarter;
+};//SMFTempoEvent
+
+struct SMFTrack
+{
+    const unsigned char *data;
+    size_t length;
+
+    std::vector<SMFControllerEvent> controllers;
+    std::vector<SMFTempoEvent> tempos;
+    bool truncated;
+};//SMFTrack
+
+//Reads the controllers out of a Standard MIDI File.  The file is memory mapped and each track is tokenized
+// on its own thread; only controller and tempo events are kept.
+class SMFReader
+{
+    int fd;
+    const unsigned char *mapped;
+    size_t mappedLength;
+
+    unsigned short format;
+    unsigned short division;
+    std::vector<SMFTrack> tracks;
+    std::vector<SMFTempoEvent> tempoMap;
+    std::vector<double> tempoMapTicks; //where each tempo change lands, in ticks
+    std::string error;
+
+    static void tokenizeTrack(SMFTrack &track);
+    void close();
+
+public:
+    SMFReader();
+    ~SMFReader();
+
+    bool open(const std::string &filename);
+    void tokenizeTracks(); //parallel over the tracks; builds the tempo map
+
+    std::vector<SMFTrack> &getTracks();
+    double pulsesToTicks(unsigned int pulse); //ticks are ms, like everywhere else
+    std::string getError();
+};//SMFReader
+
+
+#endif
@@ -0,0 +1,155 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#include "SMFWriter.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+
+void appendBigEndian(std::vector<unsigned char> &data, unsigned int value, unsigned int numBytes)
+{
+    for (int shift = (numBytes - 1) * 8; shift >= 0; shift -= 8) {
+        data.push_back((value >> shift) & 0xff);
+    }//for
+}//appendBigEndian
+
+}//anonymous namespace
+
+SMFWriter::SMFWriter(unsigned short division_)
+{
+    division = division_;
+}//constructor
+
+SMFWriter::~SMFWriter()
+{
+    //Nothing
+}//destructor
+
+void SMFWriter::appendVariableLength(std::vector<unsigned char> &data, unsigned int value)
+{
+    unsigned char bytes[5];
+    int numBytes = 0;
+
+    bytes[numBytes++] = value & 0x7f;
+    value >>= 7;
+    while (value > 0) {
+        bytes[numBytes++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }//while
+
+    while (numBytes > 0) {
+        data.push_back(bytes[--numBytes]);
+    }//while
+}//appendVariableLength
+
+void SMFWriter::appendDelta(Track &track, unsigned int tick)
+{
+    tick = std::max(tick, track.lastTick);
+    appendVariableLength(track.data, tick - track.lastTick);
+    track.lastTick = tick;
+}//appendDelta
+
+unsigned int SMFWriter::addTrack()
+{
+    Track track;
+    track.lastTick = 0;
+    tracks.push_back(track);
+
+    return tracks.size() - 1;
+}//addTrack
+
+void SMFWriter::reserve(unsigned int track, size_t bytes)
+{
+    tracks[track].data.reserve(bytes);
+}//reserve
+
+void SMFWriter::addEvent(unsigned int track, unsigned int tick, const unsigned char *data, size_t length)
+{
+    Track &curTrack = tracks[track];
+
+    appendDelta(curTrack, tick);
+    curTrack.data.insert(curTrack.data.end(), data, data + length);
+}//addEvent
+
+void SMFWriter::addMetaEvent(unsigned int track, unsigned int tick, unsigned char type, const unsigned char *data, size_t length)
+{
+    Track &curTrack = tracks[track];
+
+    appendDelta(curTrack, tick);
+    curTrack.data.push_back(0xff);
+    curTrack.data.push_back(type);
+    appendVariableLength(curTrack.data, length);
+    curTrack.data.insert(curTrack.data.end(), data, data + length);
+}//addMetaEvent
+
+void SMFWriter::addTrackName(unsigned int track, const std::string &name)
+{
+    addMetaEvent(track, 0, 0x03, (const unsigned char *)name.data(), name.size());
+}//addTrackName
+
+void SMFWriter::addTempo(unsigned int track, unsigned int tick, unsigned int microsecondsPerQuarter)
+{
+    unsigned char data[3];
+    data[0] = (microsecondsPerQuarter >> 16) & 0xff;
+    data[1] = (microsecondsPerQuarter >> 8) & 0xff;
+    data[2] = microsecondsPerQuarter & 0xff;
+
+    addMetaEvent(track, tick, 0x51, data, 3);
+}//addTempo
+
+void SMFWriter::addTimeSignature(unsigned int track, unsigned int tick, unsigned char numerator, unsigned char denominator)
+{
+    unsigned char denominatorPower = 0;
+    while ((denominatorPower < 7) && ((1U << denominatorPower) < denominator)) {
+        denominatorPower++;
+    }//while
+
+    unsigned char data[4];
+    data[0] = numerator;
+    data[1] = denominatorPower;
+    data[2] = 24; //clocks per metronome click
+    data[3] = 8;  //32nds per quarter
+
+    addMetaEvent(track, tick, 0x58, data, 4);
+}//addTimeSignature
+
+bool SMFWriter::write(const std::string &filename)
+{
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (nullptr == file) {
+        return false;
+    }//if
+
+    std::vector<unsigned char> header;
+    header.push_back('M'); header.push_back('T'); header.push_back('h'); header.push_back('d');
+    appendBigEndian(header, 6, 4);
+    appendBigEndian(header, 1, 2); //format 1
+    appendBigEndian(header, tracks.size(), 2);
+    appendBigEndian(header, division, 2);
+
+    bool ok = (fwrite(&header[0], 1, header.size(), file) == header.size());
+
+    for (Track &track : tracks) {
+        std::vector<unsigned char> trackHeader;
+        trackHeader.push_back('M'); trackHeader.push_back('T'); trackHeader.push_back('r'); trackHeader.push_back('k');
+        appendBigEndian(trackHeader, track.data.size() + 4, 4);
+
+        const unsigned char endOfTrack[4] = {0x00, 0xff, 0x2f, 0x00};
+
+        ok = ok && (fwrite(&trackHeader[0], 1, trackHeader.size(), file) == trackHeader.size());
+        ok = ok && ((track.data.empty() == true) || (fwrite(&track.data[0], 1, track.data.size(), file) == track.data.size()));
+        ok = ok && (fwrite(endOfTrack, 1, 4, file) == 4);
+    }//foreach
+
+    ok = (0 == fclose(file)) && ok;
+    return ok;
+}//write
+
@@ -0,0 +1,51 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __SMFWRITER_H
+#define __SMFWRITER_H
+
+#include <string>
+#include <vector>
+
+//Builds a format 1 Standard MIDI File in memory.  Events are added in time order per track; delta times and
+// the end of track events are filled in here.
+class SMFWriter
+{
+    struct Track
+    {
+        std::vector<unsigned char> data;
+        unsigned int lastTick;
+    };//Track
+
+    unsigned short division;
+    std::vector<Track> tracks;
+
+    static void appendVariableLength(std::vector<unsigned char> &data, unsigned int value);
+    void appendDelta(Track &track, unsigned int tick);
+
+public:
+    explicit SMFWriter(unsigned short division);
+    ~SMFWriter();
+
+    unsigned int addTrack();
+    void reserve(unsigned int track, size_t bytes);
+
+    //One channel message; data may start with a data byte if the previous event's status is still running
+    void addEvent(unsigned int track, unsigned int tick, const unsigned char *data, size_t length);
+    void addMetaEvent(unsigned int track, unsigned int tick, unsigned char type, const unsigned char *data, size_t length);
+
+    void addTrackName(unsigned int track, const std::string &name);
+    void addTempo(unsigned int track, unsigned int tick, unsigned int microsecondsPerQuarter);
+    void addTimeSignature(unsigned int track, unsigned int tick, unsigned char numerator, unsigned char denominator);
+
+    bool write(const std::string &filename);
+};//SMFWriter
+
+
+#endif
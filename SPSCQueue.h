@@ -0,0 +1,90 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+#ifndef __SPSCQUEUE_H
+#define __SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+
+//Fixed size, wait-free queue for exactly one producer thread and one consumer thread.  Nothing here
+// allocates or locks after construction, so the consumer side is safe to use from the jack callback.
+template <typename T>
+class SPSCQueue
+{
+    std::vector<T> items;
+    size_t capacity;
+    std::atomic<size_t> head; //next slot to read; only the consumer moves it
+    std::atomic<size_t> tail; //next slot to write; only the producer moves it
+
+public:
+    explicit SPSCQueue(size_t capacity_)
+    {
+        capacity = capacity_ + 1; //one slot is always left empty to tell full from empty
+        items.resize(capacity);
+        head.store(0);
+        tail.store(0);
+    }//constructor
+
+    //Producer: the whole batch becomes visible to the consumer at once, or none of it is pushed
+    bool push(const T *batch, size_t count)
+    {
+        size_t curTail = tail.load(std::memory_order_relaxed);
+        size_t curHead = head.load(std::memory_order_acquire);
+
+        size_t used = (curTail + capacity - curHead) % capacity;
+        if (used + count >= capacity) {
+            return false;
+        }//if
+
+        for (size_t index = 0; index < count; ++index) {
+            items[(curTail + index) % capacity] = batch[index];
+        }//for
+
+        tail.store((curTail + count) % capacity, std::memory_order_release);
+        return true;
+    }//push
+
+    bool push(const T &item)
+    {
+        return push(&item, 1);
+    }//push
+
+    //Producer: how many items could be pushed right now
+    size_t freeSpace() const
+    {
+        size_t used = (tail.load(std::memory_order_relaxed) + capacity - head.load(std::memory_order_acquire)) % capacity;
+        return capacity - 1 - used;
+    }//freeSpace
+
+    //Consumer: nullptr when empty
+    T *peek()
+    {
+        size_t curHead = head.load(std::memory_order_relaxed);
+        if (curHead == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }//if
+
+        return &items[curHead];
+    }//peek
+
+    //Consumer
+    void pop()
+    {
+        size_t curHead = head.load(std::memory_order_relaxed);
+        if (curHead == tail.load(std::memory_order_acquire)) {
+            return;
+        }//if
+
+        head.store((curHead + 1) % capacity, std::memory_order_release);
+    }//pop
+};//SPSCQueue
+
+
+#endif
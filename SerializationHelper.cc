@@ -9,9 +9,52 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 #include <list>
 #include "SerializationHelper.h"
-#include <boost/any.hpp>
+#include "Animation.h"
 
-std::map<void *, boost::any> sharedPtrMapSingletonList;
+namespace
+{
+
+//A keyframe with its tracking attributes and tangents, as xml_oarchive writes it
+const std::streamoff xmlBytesPerKeyframe = 700;
+
+}//anonymous namespace
+
+SharedPtrLoadSession *SharedPtrLoadSession::currentSession = nullptr;
+std::atomic<unsigned int> SharedPtrLoadSession::numTypes(0);
+
+SharedPtrLoadSession::SharedPtrLoadSession()
+{
+    previousSession = currentSession;
+    currentSession = this;
+}//constructor
+
+SharedPtrLoadSession::~SharedPtrLoadSession()
+{
+    currentSession = previousSession;
+}//destructor
+
+SharedPtrLoadSession &SharedPtrLoadSession::Current()
+{
+    if (currentSession != nullptr) {
+        return *currentSession;
+    }//if
+
+    //Opening it makes it the bottom of the stack from here on; never closed, like the map this replaced
+    static SharedPtrLoadSession *outsideSession = new SharedPtrLoadSession;
+    return *outsideSession;
+}//Current
+
+void SharedPtrLoadSession::reserveForProject(std::istream &inputStream)
+{
+    std::streampos startPos = inputStream.tellg();
+    inputStream.seekg(0, std::ios::end);
+    std::streamoff remaining = inputStream.tellg() - startPos;
+    inputStream.seekg(startPos);
+
+    if (remaining > 0) {
+        reserve<Keyframe>(remaining / xmlBytesPerKeyframe);
+    }//if
+}//reserveForProject
 
 /*
 namespace
@@ -10,14 +10,17 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __SERIALIZATIONHELPER_H
 #define __SERIALIZATIONHELPER_H
 
+#include <atomic>
+#include <istream>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/serialization/split_free.hpp>
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/tracking.hpp>
-#include <boost/any.hpp>
 
 #include <iostream>
 
@@ -66,37 +69,90 @@ private:
 };//SharedPtrMapSingleton
 */
 
-extern std::map<void *, boost::any> sharedPtrMapSingletonList;
-
-inline void ResetSharedPtrMapSingletonList()
+//Boost hands back a raw pointer for each tracked object it loads, the same one every time the object is
+// referred to; this gives each of them the one shared_ptr that owns it.  A session lasts for one load: open
+// one on the stack around it, and its registries (and the references they hold) go when it does.
+class SharedPtrLoadSession
 {
-    sharedPtrMapSingletonList.clear();
-}//ResetSharedPtrMapSingletonList
+    struct RegistryBase
+    {
+        virtual ~RegistryBase() {}
+    };//RegistryBase
 
-template <typename T>
-struct SharedPtrMapSingleton
-{
-    static std::shared_ptr<T> GetSharedPtr(T *raw)
+    template <typename T>
+    struct Registry : public RegistryBase
     {
-        if (raw == NULL) {
+        std::unordered_map<const T *, std::shared_ptr<T> > ptrMap;
+    };//Registry
+
+    std::vector<std::unique_ptr<RegistryBase> > registries; //indexed by getTypeIndex<T>()
+    SharedPtrLoadSession *previousSession;
+
+    static SharedPtrLoadSession *currentSession;
+    static std::atomic<unsigned int> numTypes;
+
+    template <typename T>
+    static unsigned int getTypeIndex()
+    {
+        static const unsigned int typeIndex = numTypes++;
+        return typeIndex;
+    }//getTypeIndex
+
+    template <typename T>
+    std::unordered_map<const T *, std::shared_ptr<T> > &getPtrMap()
+    {
+        unsigned int typeIndex = getTypeIndex<T>();
+        if (typeIndex >= registries.size()) {
+            registries.resize(typeIndex + 1);
+        }//if
+
+        if (registries[typeIndex] == nullptr) {
+            registries[typeIndex].reset(new Registry<T>);
+        }//if
+
+        return static_cast<Registry<T> *>(registries[typeIndex].get())->ptrMap;
+    }//getPtrMap
+
+public:
+    SharedPtrLoadSession();
+    ~SharedPtrLoadSession();
+
+    SharedPtrLoadSession(const SharedPtrLoadSession &) = delete;
+    SharedPtrLoadSession &operator=(const SharedPtrLoadSession &) = delete;
+
+    //The innermost open session; loads made outside any share one that lives as long as the program
+    static SharedPtrLoadSession &Current();
+
+    //For types there are a lot of, so the map isn't rehashed all the way up
+    template <typename T>
+    void reserve(size_t count)
+    {
+        getPtrMap<T>().reserve(count);
+    }//reserve
+
+    //The XML archive doesn't say how many of anything there are until it gets to them, but nearly all of
+    // a big project is keyframes, so the rest of the stream gives a fair guess
+    void reserveForProject(std::istream &inputStream);
+
+    template <typename T>
+    std::shared_ptr<T> getSharedPtr(T *raw)
+    {
+        if (raw == nullptr) {
             return std::shared_ptr<T>();
         }//if
 
-        auto ptrMapIter = sharedPtrMapSingletonList.find(raw);    
-        if (ptrMapIter != sharedPtrMapSingletonList.end()) {
-            boost::any anyVal = ptrMapIter->second;
-            std::shared_ptr<T> retPtr = boost::any_cast<std::shared_ptr<T> >(anyVal);
-//            std::cout << "here1: " << sharedPtrMapSingletonList.size() << " - " << raw << std::endl;           
-            return retPtr;
-        } else {
-//            std::cout << "here2: " << sharedPtrMapSingletonList.size() << "-" << raw << std::endl;
-            
-            std::shared_ptr<T> newPtr(raw);
-            sharedPtrMapSingletonList[raw] = newPtr;
-            return newPtr;
+        std::unordered_map<const T *, std::shared_ptr<T> > &ptrMap = getPtrMap<T>();
+
+        auto ptrMapIter = ptrMap.find(raw);
+        if (ptrMapIter != ptrMap.end()) {
+            return ptrMapIter->second;
         }//if
-    }//GetSharedPtr
-};//SharedPtrMapSingleton
+
+        std::shared_ptr<T> newPtr(raw);
+        ptrMap.emplace(raw, newPtr);
+        return newPtr;
+    }//getSharedPtr
+};//SharedPtrLoadSession
 
 
 
@@ -121,7 +177,7 @@ inline void load(Archive & ar, std::shared_ptr<T> &t, const unsigned int file_ve
 
     T *ptr;
     ar & BOOST_SERIALIZATION_NVP(ptr);
-    t = SharedPtrMapSingleton<T>::GetSharedPtr(ptr);
+    t = SharedPtrLoadSession::Current().getSharedPtr(ptr);
 }//load
 
 template<class Archive, class T>
@@ -9,10 +9,13 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 #include "Tempo.h"
 #include <boost/lexical_cast.hpp>
+#include <limits>
 #include "Data/FMidiAutomationData.h"
 #include "GraphState.h"
 #include "Globals.h"
+#include "BinaryArchive.h"
 
+#ifndef FMA_HEADLESS
 namespace
 {
 
@@ -176,6 +179,7 @@ void drawTimeSignatureTicks(int firstPixelTick, int lastPixelTick, FMidiAutomati
 }//drawTimeSignatureTicks
 
 }//anonymous namespace
+#endif
 
 Tempo::Tempo(unsigned int bpm_, unsigned int beatsPerBar_, unsigned int barSubDivisions_)
 {
@@ -191,6 +195,7 @@ TempoGlobals::TempoGlobals()
     tempoDataSelected = false;
 }//constructor
 
+#ifndef FMA_HEADLESS
 void drawTempoBar(Cairo::RefPtr<Cairo::Context> context, GraphState &graphState, FMidiAutomationData &datas, 
                     unsigned int drawingAreaWidth, unsigned int drawingAreaHeight, std::vector<int> &verticalPixelTickValues, int ticksPerPixel)
 {
@@ -262,6 +267,7 @@ void updateTempoBox(GraphState &graphState, FMidiAutomationData &datas, Gtk::Ent
     beatsPerBarEntry->set_text(boost::lexical_cast<std::string>(firstTempoMarker->second->beatsPerBar));
     barSubdivisionsEntry->set_text(boost::lexical_cast<std::string>(firstTempoMarker->second->barSubDivisions));
 }//updateTempoBox
+#endif
 
 bool checkForTempoSelection(int xPos, fmaipair<FMidiAutomationData::TempoChangesIter, FMidiAutomationData::TempoChangesIter> tempoChanges)
 {
@@ -345,3 +351,6 @@ void Tempo::serialize(Archive &ar, const unsigned int version)
 template void Tempo::serialize<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &ar, const unsigned int version);
 template void Tempo::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
 
+template void Tempo::serialize<BinaryOArchive>(BinaryOArchive &ar, const unsigned int version);
+template void Tempo::serialize<BinaryIArchive>(BinaryIArchive &ar, const unsigned int version);
+
@@ -10,7 +10,9 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #ifndef __TEMPO_H
 #define __TEMPO_H
 
+#ifndef FMA_HEADLESS
 #include <gtkmm.h>
+#endif
 #include <memory>
 #include <vector>
 #include <boost/archive/xml_oarchive.hpp>
@@ -42,9 +44,11 @@ struct Tempo
     friend class boost::serialization::access;
 };//Tempo
 
+#ifndef FMA_HEADLESS
 void drawTempoBar(Cairo::RefPtr<Cairo::Context> context, GraphState &graphState, FMidiAutomationData &datas, 
                     unsigned int drawingAreaWidth, unsigned int drawingAreaHeight, std::vector<int> &verticalPixelTickValues, int ticksPerPixel);
 void updateTempoBox(GraphState &graphState, FMidiAutomationData &datas, Gtk::Entry *bpmEntry, Gtk::Entry *beatsPerBarEntry, Gtk::Entry *barSubdivisionsEntry);
+#endif
 bool checkForTempoSelection(int xPos, fmaipair<FMidiAutomationData::TempoChangesIter, FMidiAutomationData::TempoChangesIter> tempoChanges);
 void updateTempoChangesUIData(fmaipair<FMidiAutomationData::TempoChangesIter, FMidiAutomationData::TempoChangesIter> tempoChanges);
 
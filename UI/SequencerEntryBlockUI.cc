@@ -19,6 +19,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Data/SequencerEntry.h"
 #include "Animation.h"
 #include "SequencerEntryBlockUI.h"
+#include "BinaryArchive.h"
 
 
 SequencerEntryBlockUI::SequencerEntryBlockUI(std::shared_ptr<SequencerEntryBlock> baseEntryBlock_, std::shared_ptr<SequencerEntryUI> owningEntry_)
@@ -142,7 +143,8 @@ void SequencerEntryBlockUI::setSelectedState(std::shared_ptr<Keyframe> keyframe,
     keyframeSelectionStates[keyframe] = state;
 }//setSelectedState
 
-void SequencerEntryBlockUI::doSave(boost::archive::xml_oarchive &outputArchive)
+template<class Archive>
+void SequencerEntryBlockUI::doSave(Archive &outputArchive)
 {
     int SequencerEntryBlockUIVersion = 1;
     outputArchive & BOOST_SERIALIZATION_NVP(SequencerEntryBlockUIVersion);
@@ -154,7 +156,8 @@ void SequencerEntryBlockUI::doSave(boost::archive::xml_oarchive &outputArchive)
     outputArchive & BOOST_SERIALIZATION_NVP(rightMarkerTick);
 }//doSave
 
-void SequencerEntryBlockUI::doLoad(boost::archive::xml_iarchive &inputArchive)
+template<class Archive>
+void SequencerEntryBlockUI::doLoad(Archive &inputArchive)
 {
     int SequencerEntryBlockUIVersion = -1;
     inputArchive & BOOST_SERIALIZATION_NVP(SequencerEntryBlockUIVersion);
@@ -229,3 +232,9 @@ template void SequencerEntryBlockSelectionInfo::serialize<boost::archive::xml_oa
 template void SequencerEntryBlockSelectionInfo::serialize<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &ar, const unsigned int version);
 
 
+template void SequencerEntryBlockUI::doSave<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &outputArchive);
+template void SequencerEntryBlockUI::doLoad<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &inputArchive);
+
+template void SequencerEntryBlockUI::doSave<BinaryOArchive>(BinaryOArchive &outputArchive);
+template void SequencerEntryBlockUI::doLoad<BinaryIArchive>(BinaryIArchive &inputArchive);
+
@@ -72,8 +72,8 @@ public:
 
     void renderCurves(Cairo::RefPtr<Cairo::Context> context, GraphState &graphState, unsigned int areaWidth, unsigned int areaHeight);
 
-    void doSave(boost::archive::xml_oarchive &outputArchive);
-    void doLoad(boost::archive::xml_iarchive &inputArchive);
+    template<class Archive> void doSave(Archive &outputArchive);
+    template<class Archive> void doLoad(Archive &inputArchive);
 
 //    template<class Archive> void serialize(Archive &ar, const unsigned int version);
 //    friend class boost::serialization::access;
@@ -23,6 +23,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Globals.h"
 #include "GraphState.h"
 #include "SerializationHelper.h"
+#include "BinaryArchive.h"
 
 namespace
 {
@@ -643,7 +644,8 @@ std::pair<unsigned int, unsigned int> SequencerEntryUI::getUIBounds()
     return std::make_pair(relativeStartY, relativeEndY);
 }//getUIBounds
 
-void SequencerEntryUI::doSave(boost::archive::xml_oarchive &outputArchive)
+template<class Archive>
+void SequencerEntryUI::doSave(Archive &outputArchive)
 {
     int SequencerEntryUIVersion = 1;
     outputArchive & BOOST_SERIALIZATION_NVP(SequencerEntryUIVersion);
@@ -664,7 +666,8 @@ void SequencerEntryUI::doSave(boost::archive::xml_oarchive &outputArchive)
     }//for
 }//doSave
 
-void SequencerEntryUI::doLoad(boost::archive::xml_iarchive &inputArchive)
+template<class Archive>
+void SequencerEntryUI::doLoad(Archive &inputArchive)
 {
     int SequencerEntryUIVersion = -1;
     inputArchive & BOOST_SERIALIZATION_NVP(SequencerEntryUIVersion);
@@ -809,17 +812,23 @@ void SequencerEntryUI::drawEntryBoxes(Cairo::RefPtr<Cairo::Context> context, std
         context->rectangle(relativeStartX, relativeStartY + 10, relativeEndX - relativeStartX, relativeEndY - relativeStartY - 10);
         context->clip();
 
+        //Fainter while its keys are still coming in from a project that was just opened
+        double alpha = 0.3;
+        if (false == entryBlockIter.second->getBaseEntryBlock()->areKeysResident()) {
+            alpha = 0.12;
+        }//if
+
         if (entryBlockIter.second->getBaseEntryBlock()->getInstanceOf() == nullptr) {
             if (false == wasCutOff) {
-                context->set_source_rgba(1.0, 0.0, 0.0, 0.3);
+                context->set_source_rgba(1.0, 0.0, 0.0, alpha);
             } else {
-                context->set_source_rgba(0.7, 0.0, 0.0, 0.3);
+                context->set_source_rgba(0.7, 0.0, 0.0, alpha);
             }//if
         } else {
             if (false == wasCutOff) {
-                context->set_source_rgba(1.0, 0.4, 0.0, 0.3);
+                context->set_source_rgba(1.0, 0.4, 0.0, alpha);
             } else {
-                context->set_source_rgba(0.7, 0.2, 0.0, 0.3);
+                context->set_source_rgba(0.7, 0.2, 0.0, alpha);
             }//if
         }//if
 
@@ -864,4 +873,9 @@ void SequencerEntryUI::drawEntryBoxes(Cairo::RefPtr<Cairo::Context> context, std
 }//drawEntryBoxes
 
 
+template void SequencerEntryUI::doSave<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &outputArchive);
+template void SequencerEntryUI::doLoad<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &inputArchive);
+
+template void SequencerEntryUI::doSave<BinaryOArchive>(BinaryOArchive &outputArchive);
+template void SequencerEntryUI::doLoad<BinaryIArchive>(BinaryIArchive &inputArchive);
 
@@ -107,8 +107,8 @@ public:
                             std::vector<SequencerEntryBlockSelectionInfo> &selectionInfo, 
                             EntryBlockSelectionState &entryBlockSelectionState);
 
-    void doSave(boost::archive::xml_oarchive &outputArchive);
-    void doLoad(boost::archive::xml_iarchive &inputArchive);
+    template<class Archive> void doSave(Archive &outputArchive);
+    template<class Archive> void doLoad(Archive &inputArchive);
 
     friend struct ProcessRecordedMidiCommand;
     friend class SequencerUI;
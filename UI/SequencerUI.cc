@@ -9,6 +9,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 #include "SequencerUI.h"
 #include "SequencerEntryUI.h"
+#include "Data/Sequencer.h"
 #include "Data/SequencerEntry.h"
 #include "Animation.h"
 #include "jack.h"
@@ -26,6 +27,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "Globals.h"
 #include "GraphState.h"
 #include "FMidiAutomationMainWindow.h"
+#include "BinaryArchive.h"
 
 static const unsigned int entryWindowHeight = 138 + 6; //size plus padding
 static const unsigned int smallEntryWindowHeight = 46 + 4; //size plus padding
@@ -429,7 +431,8 @@ void SequencerUI::setEntryMap(std::map<std::shared_ptr<SequencerEntryUI>, int >
     selectedEntry = nullptr;
 }//setEntryMap
 
-void SequencerUI::doSave(boost::archive::xml_oarchive &outputArchive)
+template<class Archive>
+void SequencerUI::doSave(Archive &outputArchive)
 {
     int SequencerUIVersion = 1;
     outputArchive & BOOST_SERIALIZATION_NVP(SequencerUIVersion);
@@ -449,7 +452,8 @@ void SequencerUI::doSave(boost::archive::xml_oarchive &outputArchive)
     }//for
 }//doSave
 
-void SequencerUI::doLoad(boost::archive::xml_iarchive &inputArchive)
+template<class Archive>
+void SequencerUI::doLoad(Archive &inputArchive)
 {
     selectedEntry.reset();
     selectedEntryBlock.reset();
@@ -499,6 +503,37 @@ void SequencerUI::doLoad(boost::archive::xml_iarchive &inputArchive)
     notifyOnScroll(-1);
 }//doLoad
 
+void SequencerUI::doLoadFromBase(std::shared_ptr<Sequencer> baseSequencer)
+{
+    selectedEntry.reset();
+    selectedEntryBlock.reset();
+    selectionInfos.clear();
+
+    entries.clear();
+
+    std::vector<Gtk::Widget *> parentWidgetChildren = parentWidget->get_children();
+    for (Gtk::Widget *widget : parentWidgetChildren) {
+        parentWidget->remove(*widget);
+    }//foreach
+
+    //One lane per entry, in the order the sequencer has them
+    int index = 0;
+    for (std::shared_ptr<SequencerEntry> baseEntry : baseSequencer->getEntryPair()) {
+        std::shared_ptr<SequencerEntryUI> entryUI(new SequencerEntryUI(entryGlade, index, baseEntry, shared_from_this()));
+        entryUI->setBaseEntry(baseEntry);
+        entries[entryUI] = index;
+
+        parentWidget->add(*entryUI->getHookWidget());
+        ++index;
+    }//foreach
+
+    parentWidget->add(tmpLabel);
+
+    adjustFillerHeight();
+    adjustEntryIndices();
+    notifyOnScroll(-1);
+}//doLoadFromBase
+
 /*
 std::map<std::shared_ptr<SequencerEntry>, int > SequencerUI::getEntryMap()
 {
@@ -615,4 +650,9 @@ void SequencerUI::drawEntryBoxes(Gtk::DrawingArea *graphDrawingArea, Cairo::RefP
 }//drawEntryBoxes
 
 
+template void SequencerUI::doSave<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &outputArchive);
+template void SequencerUI::doLoad<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &inputArchive);
+
+template void SequencerUI::doSave<BinaryOArchive>(BinaryOArchive &outputArchive);
+template void SequencerUI::doLoad<BinaryIArchive>(BinaryIArchive &inputArchive);
 
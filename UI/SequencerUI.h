@@ -91,8 +91,9 @@ public:
     void cloneEntryMap(std::map<std::shared_ptr<SequencerEntry>, std::shared_ptr<SequencerEntry>> &oldNewEntryMap);
 //    std::map<std::shared_ptr<SequencerEntry>, int > getEntryMap();    
 
-    void doSave(boost::archive::xml_oarchive &outputArchive);
-    void doLoad(boost::archive::xml_iarchive &inputArchive);
+    template<class Archive> void doSave(Archive &outputArchive);
+    template<class Archive> void doLoad(Archive &inputArchive);
+    void doLoadFromBase(std::shared_ptr<Sequencer> baseSequencer); //for projects saved without the editor's state
 };//SequencerUI
 
 
@@ -13,10 +13,12 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include "UI/SequencerEntryUI.h"
 #include "UI/SequencerEntryBlockUI.h"
 #include "Data/SequencerEntryBlock.h"
+#include "GraphState.h"
 #include "SerializationHelper.h"
 #include "Globals.h"
 #include "Command_Other.h"
 #include "PasteManager.h"
+#include "BinaryArchive.h"
 
 namespace
 {
@@ -115,7 +117,29 @@ void WindowManager::closeAllWindows()
     windows.clear();
 }//closeAllWindows
 
-void WindowManager::doLoad(boost::archive::xml_iarchive &inputArchive)
+std::set<std::shared_ptr<SequencerEntryBlock> > WindowManager::getOpenEntryBlocks()
+{
+    std::set<std::shared_ptr<FMidiAutomationMainWindow> > allWindows = windows;
+    if (mainWindow != nullptr) {
+        allWindows.insert(mainWindow);
+    }//if
+
+    std::set<std::shared_ptr<SequencerEntryBlock> > openEntryBlocks;
+    for (std::shared_ptr<FMidiAutomationMainWindow> window : allWindows) {
+        if (window->getEditingEntryBlock() != nullptr) {
+            openEntryBlocks.insert(window->getEditingEntryBlock()->getBaseEntryBlock());
+        }//if
+
+        for (auto selectedIter : window->getGraphState().entryBlockSelectionState.GetCurrentlySelectedEntryBlocks()) {
+            openEntryBlocks.insert(selectedIter.second->getBaseEntryBlock());
+        }//foreach
+    }//foreach
+
+    return openEntryBlocks;
+}//getOpenEntryBlocks
+
+template<class Archive>
+void WindowManager::doLoad(Archive &inputArchive)
 {
     mainWindow->doLoad(inputArchive);
 
@@ -147,7 +171,8 @@ void WindowManager::doLoad(boost::archive::xml_iarchive &inputArchive)
     }//for
 }//doLoad
 
-void WindowManager::doSave(boost::archive::xml_oarchive &outputArchive)
+template<class Archive>
+void WindowManager::doSave(Archive &outputArchive)
 {
     mainWindow->doSave(outputArchive);
 
@@ -166,3 +191,9 @@ void WindowManager::doSave(boost::archive::xml_oarchive &outputArchive)
 }//doSave
 
 
+template void WindowManager::doSave<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &outputArchive);
+template void WindowManager::doLoad<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &inputArchive);
+
+template void WindowManager::doSave<BinaryOArchive>(BinaryOArchive &outputArchive);
+template void WindowManager::doLoad<BinaryIArchive>(BinaryIArchive &inputArchive);
+
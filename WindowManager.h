@@ -15,6 +15,7 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 
 class FMidiAutomationMainWindow;
 class SequencerEntryBlockUI;
+class SequencerEntryBlock;
 
 class WindowManager
 {
@@ -30,8 +31,9 @@ public:
 
     std::shared_ptr<FMidiAutomationMainWindow> getMainWindow();
     void closeAllWindows(); //except mainWindow
-    void doLoad(boost::archive::xml_iarchive &inputArchive);
-    void doSave(boost::archive::xml_oarchive &outputArchive);
+    std::set<std::shared_ptr<SequencerEntryBlock> > getOpenEntryBlocks(); //selected in, or being edited by, any window
+    template<class Archive> void doLoad(Archive &inputArchive);
+    template<class Archive> void doSave(Archive &outputArchive);
 };//WindowManager
 
 
@@ -0,0 +1,435 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+//Headless playback engine: loads a project and plays it through jack without the editor.  Built with
+// FMA_HEADLESS so nothing here (or in the model) pulls in gtkmm.  Commands are read a line at a time from stdin
+// and each one is answered with a single "ok ..." or "error ..." line on stdout.  Nothing else goes to stdout;
+// whatever the model prints along the way goes to stderr.
+//
+// With --mock <sample rate> <period size> there's no JACK server at all; the engine runs against
+// MockEngineBackend and only advances when told to with "run <periods>" ("xrun" fakes a late period).
+//
+// --golden <sample rate> <period size> <periods> [--update] [--look-ahead <periods>] project.fma... is the
+// regression harness: each project is played from tick 0 on the mock (in its own process, so nothing carries over
+// between them) and the MIDI it produced is checked against project.fma.golden (project.fma.lookahead.golden with
+// --look-ahead), or written there with --update.  "make check" runs it both ways over golden/.  Every project gets
+// one line with the result and its per-period CPU time; the exit status is nonzero if any of them didn't match.
+//
+// Projects can be XML (.fma) or binary (.fmab); "save <file>" always writes binary, without the editor's window
+// state, which the editor then opens with one lane per entry.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "jack.h"
+#include "Globals.h"
+#include "MockEngineBackend.h"
+#include "GoldenHarness.h"
+#include "BinaryProject.h"
+#include "ProjectFile.h"
+
+namespace
+{
+
+volatile std::sig_atomic_t quitRequested = 0;
+
+//The real stdout, which only ever gets replies; what the model prints along the way goes to stderr
+int replyFd = STDOUT_FILENO;
+
+std::shared_ptr<MockEngineBackend> mockBackend;
+
+void handleQuitSignal(int)
+{
+    quitRequested = 1;
+}//handleQuitSignal
+
+void sendReply(std::ostringstream &replyStream)
+{
+    std::string reply = replyStream.str();
+    if (write(replyFd, reply.data(), reply.size()) != (ssize_t)reply.size()) {
+        std::cerr << "can't write the reply" << std::endl;
+    }//if
+
+    replyStream.str("");
+}//sendReply
+
+bool loadProject(const std::string &filename, std::string &error)
+{
+    if (false == loadProjectData(filename, error)) {
+        return false;
+    }//if
+
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    jackSingleton.invalidateChaseCuePoints();
+    jackSingleton.prepareChaseCuePoints(0);
+
+    return true;
+}//loadProject
+
+std::string formatStats()
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    std::ostringstream outputStream;
+    outputStream << "tick " << jackSingleton.getTransportFrame();
+    outputStream << " rolling " << ((jackSingleton.getTransportState() == JackTransportRolling) ? 1 : 0);
+
+    LookAheadStats lookAheadStats = jackSingleton.getLookAheadStats();
+    outputStream << " periods " << (lookAheadStats.servedPeriods + lookAheadStats.underruns);
+    outputStream << " underruns " << lookAheadStats.underruns;
+
+    for (auto portStatsIter : jackSingleton.getOutputSchedulerStats()) {
+        const OutputSchedulerStats &portStats = portStatsIter.second;
+        outputStream << " " << portStatsIter.first << " sent=" << portStats.sentMessages << " deferred=" << portStats.deferredMessages
+                     << " dropped=" << portStats.droppedMessages;
+    }//foreach
+
+    return outputStream.str();
+}//formatStats
+
+//Returns false once the engine should exit
+bool handleCommand(const std::string &line, std::ostringstream &replyStream)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    std::istringstream inputStream(line);
+    std::string command;
+    inputStream >> command;
+
+    if (command.empty() == true) {
+        return true;
+    }//if
+
+    if (command == "quit") {
+        replyStream << "ok" << std::endl;
+        return false;
+    }//if
+
+    if (command == "load") {
+        std::string filename;
+        std::getline(inputStream >> std::ws, filename);
+
+        std::string error;
+        if (loadProject(filename, error) == true) {
+            replyStream << "ok" << std::endl;
+        } else {
+            replyStream << "error " << error << std::endl;
+        }//if
+    } else if (command == "save") {
+        std::string filename;
+        std::getline(inputStream >> std::ws, filename);
+
+        BinaryProjectWriter projectWriter;
+        projectWriter.addProject(currentProjectVersion);
+
+        std::string error;
+        if (projectWriter.save(filename, error) == true) {
+            replyStream << "ok" << std::endl;
+        } else {
+            replyStream << "error " << error << std::endl;
+        }//if
+    } else if (command == "play") {
+        jackSingleton.setTransportState(JackTransportRolling);
+        replyStream << "ok" << std::endl;
+    } else if (command == "stop") {
+        jackSingleton.setTransportState(JackTransportStopped);
+        jackSingleton.prepareChaseCuePoints(jackSingleton.getTransportFrame());
+        replyStream << "ok" << std::endl;
+    } else if (command == "locate") {
+        int tick = -1;
+        inputStream >> tick;
+        if ((true == inputStream.fail()) || (tick < 0)) {
+            replyStream << "error locate needs a tick" << std::endl;
+        } else {
+            jackSingleton.setTime(tick);
+            replyStream << "ok" << std::endl;
+        }//if
+    } else if (command == "loop") {
+        std::string firstArg;
+        inputStream >> firstArg;
+
+        int startTick = -1;
+        int endTick = -1;
+        std::istringstream(firstArg) >> startTick;
+        inputStream >> endTick;
+
+        if (firstArg == "off") {
+            jackSingleton.setLoop(false, 0, 0);
+            replyStream << "ok" << std::endl;
+        } else if ((startTick < 0) || (endTick <= startTick)) {
+            replyStream << "error loop needs a start and end tick, or off" << std::endl;
+        } else {
+            jackSingleton.setLoop(true, startTick, endTick);
+            replyStream << "ok" << std::endl;
+        }//if
+    } else if (command == "run") {
+        unsigned long long numPeriods = 0;
+        inputStream >> numPeriods;
+        if (nullptr == mockBackend) {
+            replyStream << "error run needs --mock" << std::endl;
+        } else if ((true == inputStream.fail()) || (0 == numPeriods)) {
+            replyStream << "error run needs a number of periods" << std::endl;
+        } else {
+            auto startTime = std::chrono::steady_clock::now();
+            mockBackend->runPeriods(numPeriods);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+            replyStream << "ok periods " << numPeriods << " events " << mockBackend->takeCapturedOutput().size()
+                      << " seconds " << seconds << " periodsPerSecond " << ((seconds > 0.0) ? (numPeriods / seconds) : 0.0) << std::endl;
+        }//if
+    } else if (command == "xrun") {
+        if (nullptr == mockBackend) {
+            replyStream << "error xrun needs --mock" << std::endl;
+        } else {
+            mockBackend->triggerXrun();
+            replyStream << "ok" << std::endl;
+        }//if
+    } else if (command == "lookahead") {
+        std::string argument;
+        inputStream >> argument;
+
+        unsigned int numPeriods = 0;
+        std::istringstream(argument) >> numPeriods;
+
+        if (argument == "off") {
+            jackSingleton.setLookAheadEnabled(false);
+        } else if (numPeriods > 0) {
+            jackSingleton.setLookAheadPeriods(numPeriods);
+            jackSingleton.setLookAheadEnabled(true);
+        } else if (argument.empty() == false) {
+            replyStream << "error lookahead needs a number of periods, or off" << std::endl;
+            return true;
+        }//if
+
+        if (true == jackSingleton.getLookAheadEnabled()) {
+            replyStream << "ok " << jackSingleton.getLookAheadPeriods() << std::endl;
+        } else {
+            replyStream << "ok off" << std::endl;
+        }//if
+    } else if (command == "clients") {
+        unsigned int numClients = 0;
+        inputStream >> numClients;
+        if ((true == inputStream.fail()) || (0 == numClients)) {
+            replyStream << "ok " << jackSingleton.getEngineClients() << std::endl;
+        } else {
+            jackSingleton.setEngineClients(numClients);
+            replyStream << "ok " << jackSingleton.getEngineClients() << std::endl;
+        }//if
+    } else if (command == "stats") {
+        replyStream << "ok " << formatStats() << std::endl;
+    } else if (command == "telemetry") {
+        std::string argument;
+        inputStream >> argument;
+
+        if (argument == "reset") {
+            jackSingleton.resetTelemetry();
+            replyStream << "ok" << std::endl;
+        } else {
+            replyStream << "ok " << jackSingleton.getTelemetry().format() << std::endl;
+        }//if
+    } else {
+        replyStream << "error unknown command " << command << " (load, save, play, stop, locate, loop, run, xrun, lookahead, clients, stats, telemetry, quit)" << std::endl;
+    }//if
+
+    return true;
+}//handleCommand
+
+//Runs in the child; the exit status is 0 for a match (or a written golden file), 1 for a mismatch and 2 for an error
+int runGoldenProject(jack_nframes_t sampleRate, jack_nframes_t periodSize, unsigned long long numPeriods, unsigned int lookAheadPeriods, bool update,
+                     const std::string &filename, std::ostringstream &replyStream)
+{
+    mockBackend.reset(new MockEngineBackend(sampleRate, periodSize));
+    JackSingleton::SetBackend(mockBackend);
+    (void)JackSingleton::Instance();
+
+    int result = 0;
+
+    std::string error;
+    if (loadProject(filename, error) == false) {
+        replyStream << "error " << error << std::endl;
+        result = 2;
+    } else {
+        GoldenHarness harness(mockBackend);
+
+        GoldenRecord record;
+        GoldenTiming timing;
+        harness.render(numPeriods, lookAheadPeriods, record, timing);
+
+        std::ostringstream timingStream;
+        timingStream << " cpu mean " << timing.meanMicros << "us p50 " << timing.medianMicros << "us p99 " << timing.p99Micros
+                     << "us max " << timing.maxMicros << "us total " << timing.totalSeconds << "s";
+
+        //Each mode has its own file, so a change that only shows up in one of them is pinned to it
+        std::string goldenFilename = filename + ((lookAheadPeriods > 0) ? ".lookahead.golden" : ".golden");
+        GoldenRecord golden;
+
+        if (true == update) {
+            if (GoldenHarness::writeGolden(goldenFilename, record) == true) {
+                replyStream << "updated " << filename << " " << GoldenHarness::describe(record) << timingStream.str() << std::endl;
+            } else {
+                replyStream << "error can't write " << goldenFilename << std::endl;
+                result = 2;
+            }//if
+        } else if (GoldenHarness::readGolden(goldenFilename, golden) == false) {
+            replyStream << "error can't read " << goldenFilename << std::endl;
+            result = 2;
+        } else if ((golden.sampleRate != record.sampleRate) || (golden.periodSize != record.periodSize) || (golden.periods != record.periods) ||
+                   (golden.lookAheadPeriods != record.lookAheadPeriods)) {
+            replyStream << "error " << goldenFilename << " was made with " << GoldenHarness::describe(golden) << std::endl;
+            result = 2;
+        } else if ((golden.events != record.events) || (golden.hash != record.hash)) {
+            replyStream << "mismatch " << filename << " got " << GoldenHarness::describe(record) << " expected "
+                        << GoldenHarness::describe(golden) << timingStream.str() << std::endl;
+            result = 1;
+        } else {
+            replyStream << "ok " << filename << " " << GoldenHarness::describe(record) << timingStream.str() << std::endl;
+        }//if
+    }//if
+
+    JackSingleton::Instance().stopClient();
+
+    return result;
+}//runGoldenProject
+
+int runGolden(int argc, char** argv)
+{
+    jack_nframes_t sampleRate = (argc > 2) ? (jack_nframes_t)std::atoi(argv[2]) : 0;
+    jack_nframes_t periodSize = (argc > 3) ? (jack_nframes_t)std::atoi(argv[3]) : 0;
+    unsigned long long numPeriods = (argc > 4) ? std::strtoull(argv[4], nullptr, 10) : 0;
+
+    int argIndex = 5;
+    bool update = false;
+    unsigned int lookAheadPeriods = 0;
+    bool badOption = false;
+    while ((argIndex < argc) && (argv[argIndex][0] == '-')) {
+        std::string option = argv[argIndex];
+        if (option == "--update") {
+            update = true;
+            argIndex++;
+        } else if ((option == "--look-ahead") && (argIndex + 1 < argc)) {
+            lookAheadPeriods = (unsigned int)std::atoi(argv[argIndex + 1]);
+            badOption = badOption || (0 == lookAheadPeriods);
+            argIndex += 2;
+        } else {
+            badOption = true;
+            break;
+        }//if
+    }//while
+
+    if ((0 == sampleRate) || (0 == periodSize) || (0 == numPeriods) || (true == badOption) || (argIndex >= argc)) {
+        std::cerr << "usage: " << argv[0] << " --golden <sample rate> <period size> <periods> [--update] [--look-ahead <periods>] project.fma..." << std::endl;
+        return 2;
+    }//if
+
+    std::ostringstream replyStream;
+    unsigned int failures = 0;
+    for (; argIndex < argc; ++argIndex) {
+        std::cout.flush();
+
+        pid_t child = fork();
+        if (child < 0) {
+            replyStream << "error can't fork for " << argv[argIndex] << std::endl;
+            sendReply(replyStream);
+            failures++;
+            continue;
+        }//if
+
+        if (0 == child) {
+            int result = runGoldenProject(sampleRate, periodSize, numPeriods, lookAheadPeriods, update, argv[argIndex], replyStream);
+            sendReply(replyStream);
+            std::cout.flush();
+            _exit(result);
+        }//if
+
+        int status = 0;
+        if ((waitpid(child, &status, 0) != child) || (WIFEXITED(status) == false)) {
+            replyStream << "error " << argv[argIndex] << " crashed" << std::endl;
+            sendReply(replyStream);
+            failures++;
+        } else if (WEXITSTATUS(status) != 0) {
+            failures++;
+        }//if
+    }//for
+
+    return (0 == failures) ? 0 : 1;
+}//runGolden
+
+}//anonymous namespace
+
+int main(int argc, char** argv)
+{
+    //No SA_RESTART, so a signal also breaks us out of a blocked read on stdin
+    struct sigaction quitAction;
+    quitAction.sa_handler = &handleQuitSignal;
+    sigemptyset(&quitAction.sa_mask);
+    quitAction.sa_flags = 0;
+    sigaction(SIGINT, &quitAction, nullptr);
+    sigaction(SIGTERM, &quitAction, nullptr);
+
+    replyFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    if ((argc > 1) && (std::string(argv[1]) == "--golden")) {
+        return runGolden(argc, argv);
+    }//if
+
+    int argIndex = 1;
+    if ((argc > 3) && (std::string(argv[1]) == "--mock")) {
+        jack_nframes_t sampleRate = (jack_nframes_t)std::atoi(argv[2]);
+        jack_nframes_t periodSize = (jack_nframes_t)std::atoi(argv[3]);
+        if ((0 == sampleRate) || (0 == periodSize)) {
+            std::cerr << "usage: " << argv[0] << " [--mock <sample rate> <period size>] [project.fma]" << std::endl;
+            return 1;
+        }//if
+
+        mockBackend.reset(new MockEngineBackend(sampleRate, periodSize));
+        JackSingleton::SetBackend(mockBackend);
+        argIndex = 4;
+    }//if
+
+    (void)JackSingleton::Instance();
+    Globals::ResetInstance();
+
+    if (argc > argIndex) {
+        std::string error;
+        if (loadProject(argv[argIndex], error) == false) {
+            std::cerr << error << std::endl;
+            JackSingleton::Instance().stopClient();
+            return 1;
+        }//if
+    }//if
+
+    std::string line;
+    std::ostringstream replyStream;
+    bool keepRunning = true;
+    while ((true == keepRunning) && (0 == quitRequested) && (std::getline(std::cin, line))) {
+        keepRunning = handleCommand(line, replyStream);
+
+        //Anything the model printed goes out before the reply that follows it
+        std::cout.flush();
+        sendReply(replyStream);
+    }//while
+
+    //With stdin closed (ie: started from a service manager) keep playing until we're signalled
+    while ((true == keepRunning) && (0 == quitRequested)) {
+        pause();
+    }//while
+
+    JackSingleton::Instance().stopClient();
+
+    return 0;
+}//main
+
@@ -0,0 +1,435 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+//Measures how the model scales, on made up projects (see ProjectGenerator.h), headless like fma-tool:
+//
+//  fma-bench run [options]              generates a project and times the model on it, as JSON on stdout
+//  fma-bench generate [options] project  just writes the project, XML or binary by extension
+//
+//  -e <entries> -b <blocks per entry> -k <keys per block> -g <ticks between keys>
+//  -m <step>:<linear>:<bezier>  the curve type mix, as weights (default 1:0:0)
+//  -i <instance ratio>          0 to 1, the share of each entry's later blocks that are instances
+//  -c cc|rpn|nrpn               what the entries control (default cc)
+//  -t <tempo changes> -s <seed>
+//  -n <repeats>                 for run, how many times each is timed (default 3)
+//  -d <directory>               for run, where the project is saved and loaded from (default .)
+//
+//run times, in order: generating the project, deep cloning every entry, splitting every block in half and
+// merging each entry's first two blocks (as the editor's split and join do), Sequencer::cloneEntryMap, then
+// saving and loading it as XML and as binary.  Binary load is timed twice: until the project's open, and until
+// the prefetcher has every key in memory.  Each gets its min, median, mean and max in seconds.  The project
+// files are removed afterwards.  Whatever the model prints along the way goes to stderr.
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "jack.h"
+#include "Globals.h"
+#include "Animation.h"
+#include "MockEngineBackend.h"
+#include "ProjectFile.h"
+#include "ProjectGenerator.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+
+namespace
+{
+
+struct BenchTiming
+{
+    std::string name;
+    std::vector<double> seconds;
+};//BenchTiming
+
+struct ProjectCounts
+{
+    unsigned long long numEntries;
+    unsigned long long numBlocks;
+    unsigned long long numInstances;
+    unsigned long long numKeys;
+};//ProjectCounts
+
+template<class Operation>
+bool timeOperation(const std::string &name, unsigned int numRepeats, std::vector<BenchTiming> &timings, Operation operation)
+{
+    BenchTiming timing;
+    timing.name = name;
+
+    for (unsigned int repeat = 0; repeat < numRepeats; ++repeat) {
+        auto startTime = std::chrono::steady_clock::now();
+        if (false == operation()) {
+            return false;
+        }//if
+
+        timing.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    }//for
+
+    timings.push_back(timing);
+    return true;
+}//timeOperation
+
+ProjectCounts countProject()
+{
+    ProjectCounts counts;
+    counts.numEntries = 0;
+    counts.numBlocks = 0;
+    counts.numInstances = 0;
+    counts.numKeys = 0;
+
+    for (auto entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        counts.numEntries++;
+
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+            counts.numBlocks++;
+
+            if (entryBlock->getInstanceOf() != nullptr) {
+                counts.numInstances++;
+            } else {
+                counts.numKeys += entryBlock->getCurve()->getNumKeyframes() + entryBlock->getSecondaryCurve()->getNumKeyframes();
+            }//if
+        }//foreach
+    }//foreach
+
+    return counts;
+}//countProject
+
+bool areAllKeysResident()
+{
+    for (auto entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            if (false == entryBlockIter.second->areKeysResident()) {
+                return false;
+            }//if
+        }//foreach
+    }//foreach
+
+    return true;
+}//areAllKeysResident
+
+unsigned long long getFileSize(const std::string &filename)
+{
+    struct stat fileStat;
+    if (stat(filename.c_str(), &fileStat) != 0) {
+        return 0;
+    }//if
+
+    return fileStat.st_size;
+}//getFileSize
+
+//Throwing out the project that's there isn't part of it
+bool timeLoad(const std::string &name, const std::string &filename, bool waitForKeys, unsigned int numRepeats, std::vector<BenchTiming> &timings,
+                std::string &error)
+{
+    BenchTiming timing;
+    timing.name = name;
+
+    for (unsigned int repeat = 0; repeat < numRepeats; ++repeat) {
+        Globals::ResetInstance();
+
+        auto startTime = std::chrono::steady_clock::now();
+        if (false == loadProjectData(filename, error)) {
+            return false;
+        }//if
+
+        while ((true == waitForKeys) && (false == areAllKeysResident())) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }//while
+
+        timing.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    }//for
+
+    timings.push_back(timing);
+    return true;
+}//timeLoad
+
+void deepCloneEntries()
+{
+    std::vector<std::shared_ptr<SequencerEntry> > clones;
+    for (auto entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        clones.push_back(entry->deepClone());
+    }//foreach
+}//deepCloneEntries
+
+void splitBlocks()
+{
+    std::vector<std::pair<std::shared_ptr<SequencerEntryBlock>, std::shared_ptr<SequencerEntryBlock> > > splits;
+    for (auto entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+            if ((entryBlock->getInstanceOf() == nullptr) && (entryBlock->getDuration() > 1)) {
+                splits.push_back(entryBlock->deepCloneSplit(entryBlock->getStartTick() + entryBlock->getDuration() / 2));
+            }//if
+        }//foreach
+    }//foreach
+}//splitBlocks
+
+void mergeBlocks()
+{
+    std::vector<std::shared_ptr<SequencerEntryBlock> > merged;
+    for (auto entry : Globals::Instance().projectData.getSequencer()->getEntryPair()) {
+        std::vector<std::shared_ptr<SequencerEntryBlock> > entryBlocks;
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            if (entryBlockIter.second->getInstanceOf() == nullptr) {
+                entryBlocks.push_back(entryBlockIter.second);
+            }//if
+        }//foreach
+
+        if (entryBlocks.size() < 2) {
+            continue;
+        }//if
+
+        std::shared_ptr<SequencerEntryBlock> replacementBlock = entryBlocks[0]->deepClone(entry, entryBlocks[0]->getStartTick());
+        replacementBlock->getCurve()->mergeOtherAnimation(entryBlocks[1]->getCurve(), InsertMode::Merge);
+        replacementBlock->getSecondaryCurve()->mergeOtherAnimation(entryBlocks[1]->getSecondaryCurve(), InsertMode::Merge);
+        merged.push_back(replacementBlock);
+    }//foreach
+}//mergeBlocks
+
+void writeTimingJSON(std::ostream &outputStream, const BenchTiming &timing)
+{
+    std::vector<double> sorted = timing.seconds;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0;
+    for (double seconds : sorted) {
+        total += seconds;
+    }//foreach
+
+    outputStream << "    \"" << timing.name << "\": { \"runs\": " << sorted.size() << ", \"min\": " << sorted.front()
+                 << ", \"median\": " << sorted[sorted.size() / 2] << ", \"mean\": " << (total / sorted.size()) << ", \"max\": " << sorted.back() << " }";
+}//writeTimingJSON
+
+int runBench(const ProjectGeneratorParams &params, unsigned int numRepeats, const std::string &directory, std::ostream &outputStream)
+{
+    std::vector<BenchTiming> timings;
+    std::string error;
+
+    std::string xmlFilename = directory + "/fma-bench.fma";
+    std::string binaryFilename = directory + "/fma-bench.fmab";
+
+    bool succeeded = timeOperation("generate", numRepeats, timings, [&]() { generateProject(params); return true; });
+
+    ProjectCounts counts = countProject();
+
+    //cloneEntryMap swaps the clones in, and those lose their instances (SequencerEntry::deepClone doesn't carry
+    // them over), so it goes last and the project is made again before it's saved
+    succeeded = succeeded &&
+        timeOperation("deepClone", numRepeats, timings, [&]() { deepCloneEntries(); return true; }) &&
+        timeOperation("split", numRepeats, timings, [&]() { splitBlocks(); return true; }) &&
+        timeOperation("merge", numRepeats, timings, [&]() { mergeBlocks(); return true; }) &&
+        timeOperation("cloneEntryMap", numRepeats, timings, [&]() { Globals::Instance().projectData.getSequencer()->cloneEntryMap(); return true; });
+
+    generateProject(params);
+
+    succeeded = succeeded &&
+        timeOperation("saveXML", numRepeats, timings, [&]() { return saveProjectData(xmlFilename, error); }) &&
+        timeOperation("saveBinary", numRepeats, timings, [&]() { return saveProjectData(binaryFilename, error); }) &&
+        timeLoad("loadXML", xmlFilename, false, numRepeats, timings, error) &&
+        timeLoad("loadBinary", binaryFilename, false, numRepeats, timings, error) &&
+        timeLoad("loadBinaryResident", binaryFilename, true, numRepeats, timings, error);
+
+    unsigned long long xmlBytes = getFileSize(xmlFilename);
+    unsigned long long binaryBytes = getFileSize(binaryFilename);
+
+    //Nothing may still point into the mapping once it's gone
+    Globals::ResetInstance();
+    std::remove(xmlFilename.c_str());
+    std::remove(binaryFilename.c_str());
+
+    if (false == succeeded) {
+        std::cerr << "error " << error << std::endl;
+        return 1;
+    }//if
+
+    outputStream << std::setprecision(6);
+    outputStream << "{\n";
+    outputStream << "  \"parameters\": { \"entries\": " << params.numEntries << ", \"blocksPerEntry\": " << params.blocksPerEntry
+                 << ", \"keysPerBlock\": " << params.keysPerBlock << ", \"keyGap\": " << params.keyGap << ", \"curveMix\": { \"step\": "
+                 << params.stepWeight << ", \"linear\": " << params.linearWeight << ", \"bezier\": " << params.bezierWeight
+                 << " }, \"instanceRatio\": " << params.instanceRatio << ", \"tempoChanges\": " << params.numTempoChanges
+                 << ", \"seed\": " << params.seed << ", \"repeats\": " << numRepeats << " },\n";
+    outputStream << "  \"project\": { \"entries\": " << counts.numEntries << ", \"blocks\": " << counts.numBlocks << ", \"instances\": "
+                 << counts.numInstances << ", \"keys\": " << counts.numKeys << ", \"xmlBytes\": " << xmlBytes << ", \"binaryBytes\": "
+                 << binaryBytes << " },\n";
+    outputStream << "  \"seconds\": {\n";
+
+    for (size_t index = 0; index < timings.size(); ++index) {
+        writeTimingJSON(outputStream, timings[index]);
+        outputStream << ((index + 1 < timings.size()) ? ",\n" : "\n");
+    }//for
+
+    outputStream << "  }\n";
+    outputStream << "}\n";
+
+    return 0;
+}//runBench
+
+bool parseUnsigned(const std::string &value, unsigned int &result)
+{
+    char *valueEnd = nullptr;
+    long parsed = std::strtol(value.c_str(), &valueEnd, 10);
+    if ((true == value.empty()) || (*valueEnd != 0) || (parsed < 0)) {
+        return false;
+    }//if
+
+    result = parsed;
+    return true;
+}//parseUnsigned
+
+//step:linear:bezier
+bool parseCurveMix(const std::string &value, ProjectGeneratorParams &params)
+{
+    std::istringstream inputStream(value);
+    std::string stepWeight, linearWeight, bezierWeight;
+    std::getline(inputStream, stepWeight, ':');
+    std::getline(inputStream, linearWeight, ':');
+    std::getline(inputStream, bezierWeight);
+
+    return (true == parseUnsigned(stepWeight, params.stepWeight)) && (true == parseUnsigned(linearWeight, params.linearWeight)) &&
+           (true == parseUnsigned(bezierWeight, params.bezierWeight));
+}//parseCurveMix
+
+int usage(const char *programName)
+{
+    std::cerr << "usage: " << programName << " run|generate [-e entries] [-b blocks per entry] [-k keys per block] [-g key gap] [-m step:linear:bezier]"
+              << " [-i instance ratio] [-c cc|rpn|nrpn] [-t tempo changes] [-s seed] [-n repeats] [-d directory] [project]" << std::endl;
+    return 2;
+}//usage
+
+}//anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        return usage(argv[0]);
+    }//if
+
+    std::string command = argv[1];
+    if ((command != "run") && (command != "generate")) {
+        return usage(argv[0]);
+    }//if
+
+    ProjectGeneratorParams params;
+    unsigned int numRepeats = 3;
+    std::string directory = ".";
+    std::string filename;
+
+    for (int argIndex = 2; argIndex < argc; ++argIndex) {
+        std::string arg = argv[argIndex];
+
+        if ((arg.size() != 2) || ('-' != arg[0])) {
+            if ((command != "generate") || (false == filename.empty())) {
+                return usage(argv[0]);
+            }//if
+
+            filename = arg;
+            continue;
+        }//if
+
+        if (argIndex + 1 >= argc) {
+            return usage(argv[0]);
+        }//if
+
+        std::string value = argv[++argIndex];
+        bool valid = true;
+
+        if (arg == "-e") {
+            valid = parseUnsigned(value, params.numEntries);
+        } else if (arg == "-b") {
+            valid = parseUnsigned(value, params.blocksPerEntry);
+        } else if (arg == "-k") {
+            valid = parseUnsigned(value, params.keysPerBlock);
+        } else if (arg == "-g") {
+            valid = (true == parseUnsigned(value, params.keyGap)) && (params.keyGap > 0);
+        } else if (arg == "-m") {
+            valid = parseCurveMix(value, params);
+        } else if (arg == "-i") {
+            char *valueEnd = nullptr;
+            params.instanceRatio = std::strtod(value.c_str(), &valueEnd);
+            valid = (*valueEnd == 0) && (params.instanceRatio >= 0) && (params.instanceRatio <= 1);
+        } else if (arg == "-c") {
+            if (value == "cc") {
+                params.controllerType = ControlType::CC;
+            } else if (value == "rpn") {
+                params.controllerType = ControlType::RPN;
+            } else if (value == "nrpn") {
+                params.controllerType = ControlType::NRPN;
+            } else {
+                valid = false;
+            }//if
+        } else if (arg == "-t") {
+            valid = parseUnsigned(value, params.numTempoChanges);
+        } else if (arg == "-s") {
+            valid = parseUnsigned(value, params.seed);
+        } else if (arg == "-n") {
+            valid = (true == parseUnsigned(value, numRepeats)) && (numRepeats > 0);
+        } else if (arg == "-d") {
+            directory = value;
+        } else {
+            valid = false;
+        }//if
+
+        if (false == valid) {
+            return usage(argv[0]);
+        }//if
+    }//for
+
+    if ((command == "generate") && (true == filename.empty())) {
+        return usage(argv[0]);
+    }//if
+
+    //The results go to the real stdout; anything else printed there goes to stderr
+    int resultFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    JackSingleton::SetBackend(std::shared_ptr<MockEngineBackend>(new MockEngineBackend(48000, 256)));
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    int result = 0;
+    std::ostringstream outputStream;
+
+    if (command == "generate") {
+        generateProject(params);
+
+        std::string error;
+        if (true == saveProjectData(filename, error)) {
+            ProjectCounts counts = countProject();
+            outputStream << "ok " << filename << " entries " << counts.numEntries << " blocks " << counts.numBlocks << " instances "
+                         << counts.numInstances << " keys " << counts.numKeys << "\n";
+        } else {
+            outputStream << "error " << error << "\n";
+            result = 1;
+        }//if
+    } else {
+        result = runBench(params, numRepeats, directory, outputStream);
+    }//if
+
+    std::cout.flush();
+
+    std::string output = outputStream.str();
+    if (write(resultFd, output.data(), output.size()) != (ssize_t)output.size()) {
+        result = 1;
+    }//if
+
+    jackSingleton.stopClient();
+
+    return result;
+}//main
+
@@ -0,0 +1,499 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+
+//Batch tool for projects, built with FMA_HEADLESS on the same model as the engine and never touching JACK:
+//
+//  fma-tool convert  [options] project...  XML to binary and binary to XML (.fma <-> .fmab)
+//  fma-tool simplify [options] project...  drops keys that don't move a curve by more than -t (Animation::simplify)
+//  fma-tool stats    [options] project...  entries, blocks, curves, keys and roughly what the keys take once editable
+//  fma-tool render   [options] project...  bounces the automation to a .mid, as File > Export MIDI does
+//
+//  -j <jobs>       projects handled at once (default: one per core)
+//  -o <directory>  where output goes (default: beside each project; simplify rewrites it)
+//  -t <tolerance>  for simplify, in each entry's own units (default 0, which only drops keys that change nothing)
+//  -r <rate> -p <period>  the sample rate and period render paces the ports with (default 48000 and 256)
+//
+//The model lives in singletons, so every project is handled in a process of its own, forked from here.  Each
+// worker takes the next project as soon as it's free, so a few big projects don't hold up the rest.  Every
+// project gets one line on stdout, "ok <project> ..." or "error <project> ...", in the order they were given
+// whatever order they finished in.  The exit status is 0 if they all succeeded, 1 if any didn't and 2 for bad
+// usage.  Projects are written without the editor's window state (see ProjectFile.h).
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <cerrno>
+#include <cstdlib>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "jack.h"
+#include "Globals.h"
+#include "Animation.h"
+#include "Tempo.h"
+#include "MockEngineBackend.h"
+#include "OfflineRenderer.h"
+#include "BinaryProject.h"
+#include "ProjectFile.h"
+#include "Data/Sequencer.h"
+#include "Data/SequencerEntry.h"
+#include "Data/SequencerEntryBlock.h"
+
+namespace
+{
+
+enum class ToolCommand : char
+{
+    Convert,
+    Simplify,
+    Stats,
+    Render
+};//ToolCommand
+
+struct ToolOptions
+{
+    ToolCommand command;
+    unsigned int numJobs;
+    std::string outputDirectory;
+    double tolerance;
+    jack_nframes_t sampleRate;
+    jack_nframes_t periodSize;
+};//ToolOptions
+
+struct ProjectJob
+{
+    std::string filename;
+    pid_t child;
+    int outputFd;
+    std::string output;
+    bool finished;
+    bool succeeded;
+};//ProjectJob
+
+//What a key costs once it's editable: the Keyframe, the control block of its shared_ptr and the map node holding it
+const unsigned long long editableKeyBytes = sizeof(Keyframe) + 3 * sizeof(void *) + sizeof(std::pair<const int, std::shared_ptr<Keyframe> >) + 4 * sizeof(void *);
+
+//With the extension, if there is one, replaced
+std::string getOutputFilename(const ToolOptions &options, const std::string &filename, const std::string &extension)
+{
+    std::string outputFilename = filename;
+
+    if (false == options.outputDirectory.empty()) {
+        std::string::size_type slashPos = filename.rfind('/');
+        outputFilename = options.outputDirectory + "/" + ((std::string::npos == slashPos) ? filename : filename.substr(slashPos + 1));
+    }//if
+
+    std::string::size_type dotPos = outputFilename.rfind('.');
+    std::string::size_type slashPos = outputFilename.rfind('/');
+    if ((std::string::npos != dotPos) && ((std::string::npos == slashPos) || (dotPos > slashPos))) {
+        outputFilename.erase(dotPos);
+    }//if
+
+    return outputFilename + extension;
+}//getOutputFilename
+
+std::string getExtension(const std::string &filename)
+{
+    std::string::size_type dotPos = filename.rfind('.');
+    std::string::size_type slashPos = filename.rfind('/');
+    if ((std::string::npos == dotPos) || ((std::string::npos != slashPos) && (dotPos < slashPos))) {
+        return std::string();
+    }//if
+
+    return filename.substr(dotPos);
+}//getExtension
+
+bool convertProject(const ToolOptions &options, const std::string &filename, std::ostream &result, std::string &error)
+{
+    //Goes by what's in the file, as loading does
+    std::string extension = (true == BinaryProjectReader::isBinaryProject(filename)) ? ".fma" : ".fmab";
+    std::string outputFilename = getOutputFilename(options, filename, extension);
+
+    if (false == saveProjectData(outputFilename, error)) {
+        return false;
+    }//if
+
+    result << " -> " << outputFilename;
+    return true;
+}//convertProject
+
+bool simplifyProject(const ToolOptions &options, const std::string &filename, std::ostream &result, std::string &error)
+{
+    Globals &globals = Globals::Instance();
+
+    unsigned long long numKeys = 0;
+    unsigned long long numRemoved = 0;
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+            if (entryBlock->getInstanceOf() != nullptr) {
+                continue;
+            }//if
+
+            for (std::shared_ptr<Animation> curve : { entryBlock->getCurve(), entryBlock->getSecondaryCurve() }) {
+                numKeys += curve->getNumKeyframes();
+                numRemoved += curve->simplify(options.tolerance);
+            }//foreach
+        }//foreach
+    }//foreach
+
+    std::string outputFilename = getOutputFilename(options, filename, getExtension(filename));
+    if (false == saveProjectData(outputFilename, error)) {
+        return false;
+    }//if
+
+    result << " keys " << numKeys << " -> " << (numKeys - numRemoved) << " -> " << outputFilename;
+    return true;
+}//simplifyProject
+
+bool describeProject(std::ostream &result)
+{
+    Globals &globals = Globals::Instance();
+
+    unsigned long long numBlocks = 0;
+    unsigned long long numInstances = 0;
+    unsigned long long numCurves = 0;
+    unsigned long long numKeys = 0;
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        for (auto entryBlockIter : entry->getEntryBlocksPair()) {
+            std::shared_ptr<SequencerEntryBlock> entryBlock = entryBlockIter.second;
+            numBlocks++;
+
+            //An instance's keys are its source's
+            if (entryBlock->getInstanceOf() != nullptr) {
+                numInstances++;
+                continue;
+            }//if
+
+            for (std::shared_ptr<Animation> curve : { entryBlock->getCurve(), entryBlock->getSecondaryCurve() }) {
+                numCurves++;
+                numKeys += curve->getNumKeyframes();
+            }//foreach
+        }//foreach
+    }//foreach
+
+    unsigned int numTempoChanges = 0;
+    auto tempoChanges = globals.projectData.getTempoChanges();
+    for (auto tempoIter = tempoChanges.first; tempoIter != tempoChanges.second; ++tempoIter) {
+        numTempoChanges++;
+    }//for
+
+    result << " entries " << globals.projectData.getSequencer()->getNumEntries() << " blocks " << numBlocks << " instances " << numInstances
+           << " curves " << numCurves << " keys " << numKeys << " tempoChanges " << numTempoChanges << " endTick " << OfflineRenderer::getProjectEndTick()
+           << " keyBytes " << (numKeys * editableKeyBytes);
+    return true;
+}//describeProject
+
+bool renderProject(const ToolOptions &options, const std::string &filename, std::ostream &result, std::string &error)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    //The same ports and budgets as playback, as in the editor's export
+    std::map<std::string, OutputSchedulerStats> schedulerStats = jackSingleton.getOutputSchedulerStats();
+    std::vector<OfflineRenderPort> ports;
+    for (const std::string &portName : jackSingleton.getOutputPorts()) {
+        OfflineRenderPort port;
+        port.name = portName;
+        port.port = jackSingleton.getOutputPort(portName);
+        port.messagesPerSecond = schedulerStats[portName].messagesPerSecond;
+        ports.push_back(port);
+    }//foreach
+
+    std::string outputFilename = getOutputFilename(options, filename, ".mid");
+
+    OfflineRenderer renderer(jackSingleton.getSampleRate(), jackSingleton.getBufferSize());
+    if (renderer.render(ports, 0, OfflineRenderer::getProjectEndTick(), outputFilename) == false) {
+        error = "can't write " + outputFilename;
+        return false;
+    }//if
+
+    result << " messages " << renderer.getStats().messages << " -> " << outputFilename;
+    return true;
+}//renderProject
+
+//Runs in the child; the line goes back to the parent through outputFd
+bool runProject(const ToolOptions &options, const std::string &filename, int outputFd)
+{
+    JackSingleton::SetBackend(std::shared_ptr<MockEngineBackend>(new MockEngineBackend(options.sampleRate, options.periodSize)));
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    std::ostringstream result;
+    std::string error;
+    bool succeeded = false;
+
+    try {
+        if (true == loadProjectData(filename, error)) {
+            switch (options.command) {
+                case ToolCommand::Convert:
+                    succeeded = convertProject(options, filename, result, error);
+                    break;
+
+                case ToolCommand::Simplify:
+                    succeeded = simplifyProject(options, filename, result, error);
+                    break;
+
+                case ToolCommand::Stats:
+                    succeeded = describeProject(result);
+                    break;
+
+                case ToolCommand::Render:
+                    succeeded = renderProject(options, filename, result, error);
+                    break;
+            }//switch
+        }//if
+    } catch (const std::exception &e) {
+        succeeded = false;
+        error = e.what();
+    }//try
+
+    std::string line = (true == succeeded) ? ("ok " + filename + result.str() + "\n") : ("error " + filename + ": " + error + "\n");
+
+    size_t written = 0;
+    while (written < line.size()) {
+        ssize_t count = write(outputFd, line.data() + written, line.size() - written);
+        if ((count < 0) && (EINTR == errno)) {
+            continue;
+        }//if
+
+        if (count <= 0) {
+            break;
+        }//if
+
+        written += count;
+    }//while
+
+    jackSingleton.stopClient();
+
+    return succeeded;
+}//runProject
+
+bool startJob(const ToolOptions &options, ProjectJob &job)
+{
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+        return false;
+    }//if
+
+    std::cout.flush();
+
+    pid_t child = fork();
+    if (child < 0) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        return false;
+    }//if
+
+    if (0 == child) {
+        close(pipeFds[0]);
+
+        //Whatever the model prints along the way goes to stderr, so stdout only has the results
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+
+        bool succeeded = runProject(options, job.filename, pipeFds[1]);
+        std::cout.flush();
+        _exit((true == succeeded) ? 0 : 1);
+    }//if
+
+    close(pipeFds[1]);
+
+    job.child = child;
+    job.outputFd = pipeFds[0];
+    return true;
+}//startJob
+
+void finishJob(ProjectJob &job)
+{
+    close(job.outputFd);
+    job.outputFd = -1;
+
+    int status = 0;
+    while ((waitpid(job.child, &status, 0) < 0) && (EINTR == errno)) {
+    }//while
+
+    job.finished = true;
+    job.succeeded = (true == WIFEXITED(status)) && (0 == WEXITSTATUS(status));
+
+    if ((false == WIFEXITED(status)) || (true == job.output.empty())) {
+        job.output = "error " + job.filename + ": crashed\n";
+    }//if
+}//finishJob
+
+int runJobs(const ToolOptions &options, std::vector<ProjectJob> &jobs)
+{
+    std::vector<size_t> running;
+    size_t nextJob = 0;
+    size_t nextToPrint = 0;
+    unsigned int failures = 0;
+
+    while (nextToPrint < jobs.size()) {
+        while ((running.size() < options.numJobs) && (nextJob < jobs.size())) {
+            ProjectJob &job = jobs[nextJob];
+            if (true == startJob(options, job)) {
+                running.push_back(nextJob);
+            } else {
+                job.finished = true;
+                job.output = "error " + job.filename + ": can't start a process for it\n";
+            }//if
+
+            nextJob++;
+        }//while
+
+        while ((nextToPrint < jobs.size()) && (true == jobs[nextToPrint].finished)) {
+            ProjectJob &job = jobs[nextToPrint];
+            std::cout << job.output << std::flush;
+
+            if (false == job.succeeded) {
+                failures++;
+            }//if
+
+            nextToPrint++;
+        }//while
+
+        if (true == running.empty()) {
+            continue;
+        }//if
+
+        std::vector<pollfd> pollFds(running.size());
+        for (size_t index = 0; index < running.size(); ++index) {
+            pollFds[index].fd = jobs[running[index]].outputFd;
+            pollFds[index].events = POLLIN;
+            pollFds[index].revents = 0;
+        }//for
+
+        if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+            if (EINTR == errno) {
+                continue;
+            }//if
+
+            //Nothing sensible to do but wait on them one at a time
+            for (pollfd &pollFd : pollFds) {
+                pollFd.revents = POLLHUP;
+            }//foreach
+        }//if
+
+        std::vector<size_t> stillRunning;
+        for (size_t index = 0; index < running.size(); ++index) {
+            ProjectJob &job = jobs[running[index]];
+
+            if (0 == pollFds[index].revents) {
+                stillRunning.push_back(running[index]);
+                continue;
+            }//if
+
+            char buffer[4096];
+            ssize_t count = read(job.outputFd, buffer, sizeof(buffer));
+            if (count > 0) {
+                job.output.append(buffer, count);
+                stillRunning.push_back(running[index]);
+            } else if ((count < 0) && (EINTR == errno)) {
+                stillRunning.push_back(running[index]);
+            } else {
+                finishJob(job);
+            }//if
+        }//for
+
+        running.swap(stillRunning);
+    }//while
+
+    return (0 == failures) ? 0 : 1;
+}//runJobs
+
+int usage(const char *programName)
+{
+    std::cerr << "usage: " << programName << " convert|simplify|stats|render [-j jobs] [-o directory] [-t tolerance] [-r rate] [-p period] project..." << std::endl;
+    return 2;
+}//usage
+
+}//anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        return usage(argv[0]);
+    }//if
+
+    ToolOptions options;
+    options.numJobs = std::max(std::thread::hardware_concurrency(), 1U);
+    options.tolerance = 0;
+    options.sampleRate = 48000;
+    options.periodSize = 256;
+
+    std::string command = argv[1];
+    if (command == "convert") {
+        options.command = ToolCommand::Convert;
+    } else if (command == "simplify") {
+        options.command = ToolCommand::Simplify;
+    } else if (command == "stats") {
+        options.command = ToolCommand::Stats;
+    } else if (command == "render") {
+        options.command = ToolCommand::Render;
+    } else {
+        return usage(argv[0]);
+    }//if
+
+    std::vector<ProjectJob> jobs;
+    for (int argIndex = 2; argIndex < argc; ++argIndex) {
+        std::string arg = argv[argIndex];
+
+        if ((arg.size() == 2) && ('-' == arg[0])) {
+            if (argIndex + 1 >= argc) {
+                return usage(argv[0]);
+            }//if
+
+            std::string value = argv[++argIndex];
+            char *valueEnd = nullptr;
+
+            if (arg == "-j") {
+                long numJobs = std::strtol(value.c_str(), &valueEnd, 10);
+                if ((*valueEnd != 0) || (numJobs < 1)) {
+                    return usage(argv[0]);
+                }//if
+
+                options.numJobs = numJobs;
+            } else if (arg == "-o") {
+                options.outputDirectory = value;
+            } else if (arg == "-t") {
+                options.tolerance = std::strtod(value.c_str(), &valueEnd);
+                if ((*valueEnd != 0) || (options.tolerance < 0)) {
+                    return usage(argv[0]);
+                }//if
+            } else if ((arg == "-r") || (arg == "-p")) {
+                long frames = std::strtol(value.c_str(), &valueEnd, 10);
+                if ((*valueEnd != 0) || (frames < 1)) {
+                    return usage(argv[0]);
+                }//if
+
+                ((arg == "-r") ? options.sampleRate : options.periodSize) = frames;
+            } else {
+                return usage(argv[0]);
+            }//if
+
+            continue;
+        }//if
+
+        ProjectJob job;
+        job.filename = arg;
+        job.child = -1;
+        job.outputFd = -1;
+        job.finished = false;
+        job.succeeded = false;
+        jobs.push_back(job);
+    }//for
+
+    if (true == jobs.empty()) {
+        return usage(argv[0]);
+    }//if
+
+    return runJobs(options, jobs);
+}//main
+
@@ -0,0 +1,40 @@
+/*
+FMidiAutomation -- A midi automation editor for jack / Linux
+Written by Chris Mennie (chris at chrismennie.ca or cmennie at rogers.com)
+Copyright (C) 2011 Chris A. Mennie                              
+
+License: Released under the GPL version 3 license. See the included LICENSE.
+*/
+
+#ifndef __FMASTRING_H
+#define __FMASTRING_H
+
+#include <string>
+
+//Text held by the data model.  The editor keeps it as Glib::ustring so titles go straight into widgets; the
+// headless engine (FMA_HEADLESS) never shows them and builds without glibmm.
+#ifdef FMA_HEADLESS
+
+typedef std::string fmastring;
+
+inline std::string fmastring_to_locale(const fmastring &str)
+{
+    return str;
+}//fmastring_to_locale
+
+#else
+
+#include <glibmm/ustring.h>
+#include <glibmm/convert.h>
+
+typedef Glib::ustring fmastring;
+
+inline std::string fmastring_to_locale(const fmastring &str)
+{
+    return Glib::locale_from_utf8(str);
+}//fmastring_to_locale
+
+#endif
+
+
+#endif
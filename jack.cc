@@ -14,8 +14,29 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <iostream>
 #include "Data/Sequencer.h"
 #include "Data/SequencerEntry.h"
+#include "Animation.h"
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/map.hpp>
 #include "Globals.h"
+#include "FrameTime.h"
+#include "BinaryArchive.h"
+
+namespace
+{
+
+//If the transport never reports the located frame (ie: another client owns it), send the chase anyways
+const unsigned int maxChaseWaitPeriods = 8;
+
+const unsigned int maxEngineClients = 16;
+
+//Whatever SetBackend was given before the singleton was built
+std::shared_ptr<EngineBackend> &nextBackend()
+{
+    static std::shared_ptr<EngineBackend> backend;
+    return backend;
+}//nextBackend
+
+}//anonymous namespace
 
 //extern FMidiAutomationMainWindow *mainWindow;
 
@@ -66,21 +87,45 @@ void jack_shutdown_impl(void *arg)
     jackSingleton.jack_shutdown(arg);
 }//jack_shutdown
 
+int xrun_impl(void *arg)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    jackSingleton.xrun();
+    return 0;
+}//xrun_impl
+
+void latency_impl(jack_latency_callback_mode_t mode, void *arg)
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    jackSingleton.latencyChanged(mode);
+}//latency_impl
+
 
 }//anonymous namespace
 
-JackSingleton::JackSingleton()
+JackSingleton::JackSingleton() : lookAheadRenderer(chaseEngine, maxEngineClients)
 {
 //    std::function<void (void)> threadFunc = boost::lambda::bind(&notifyJackUpdate, boost::lambda::var(condition));
 //    thread.reset(new boost::thread(threadFunc));
 
-    jackClient = jack_client_open("FMidiAutomation", JackNullOption, nullptr);
+    backend = nextBackend();
+    if (nullptr == backend) {
+        backend.reset(new JackEngineBackend);
+    }//if
+
+    jackClient = backend->openClient("FMidiAutomation");
 
     assert(jackClient != nullptr);
 
 //    jack_set_error_function(&error_impl); -- causes reentrant issues
-    jack_set_process_callback(jackClient, &process_impl, this);
-    jack_on_shutdown(jackClient, &jack_shutdown_impl, this);
+    backend->setProcessCallback(jackClient, &process_impl, this);
+    backend->setShutdownCallback(jackClient, &jack_shutdown_impl, this);
+    backend->setLatencyCallback(jackClient, &latency_impl, this);
+    backend->setXrunCallback(jackClient, &xrun_impl, this);
+
+    for (unsigned int client = 0; client < maxEngineClients; ++client) {
+        clientTelemetry.emplace_back(new EngineTelemetry);
+    }//for
 
     //input_port = jack_port_register (jackClient, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
     //output_port = jack_port_register (jackClient, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
@@ -93,21 +138,51 @@ JackSingleton::JackSingleton()
     setInputPorts(inputPort);
     setOutputPorts(outputPort);
 
-    bool activated = (jack_activate(jackClient) == 0);
+    bool activated = backend->activate(jackClient);
     assert(true == activated);    
 
+    //Ports only have real latencies once we're in the graph
+    updatePortLatencies();
+
     recordMidi = false;
     processingMidi = true;
+
+    pendingChaseFrame = 0;
+    pendingChaseWaitPeriods = 0;
+
+    loopEnabled = false;
+    loopStartTick = 0;
+    loopEndTick = 0;
+    loopSnapshotStale = false;
+    loopChaseDue = false;
+    loopLocatePending = false;
+    loopExpectedFrame = 0;
+    loopStaleFrame = 0;
+
+    lookAheadEnabled = true;
+    lookAheadRolling = false;
+    lookAheadNextFrame = 0;
+    lookAheadRenderer.start();
+
+    //Curves swapping out their key storage hold us still through this
+    Animation::pauseSampling = [this]() { return std::shared_ptr<void>(new SamplingPause(*this)); };
 }//constuctor
 
 JackSingleton::~JackSingleton()
 {
-    //Nothing
+    Animation::pauseSampling = nullptr;
 }//destructor
 
 void JackSingleton::stopClient()
 {
-    jack_client_close(jackClient);
+    lookAheadRenderer.stop();
+
+    {
+        boost::recursive_mutex::scoped_lock lock(mutex);
+        shards.clear();
+    }
+
+    backend->closeClient(jackClient);
 }//stopClient
 
 
@@ -118,6 +193,16 @@ JackSingleton &JackSingleton::Instance()
     return jackSingleton;
 }//Instance
 
+void JackSingleton::SetBackend(std::shared_ptr<EngineBackend> backend)
+{
+    nextBackend() = backend;
+}//SetBackend
+
+EngineBackend &JackSingleton::getBackend()
+{
+    return *backend;
+}//getBackend
+
 bool JackSingleton::areProcessingMidi()
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
@@ -189,14 +274,17 @@ void JackSingleton::setInputPorts(std::vector<std::string> ports)
 
     for (std::string portName : removedPorts) {
         jack_port_t *port = inputPorts[portName];
-        jack_port_unregister(jackClient, port);
+        backend->unregisterPort(jackClient, port);
         inputPorts.erase(inputPorts.find(portName));
+        inputLatencies.erase(port);
     }//foreach
 
     for (std::string portName : newPorts) {
-        jack_port_t *newInputPort = jack_port_register(jackClient, portName.c_str(), JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+        jack_port_t *newInputPort = backend->registerPort(jackClient, portName, JackPortIsInput);
         inputPorts[portName] = newInputPort;
     }//foreach
+
+    updatePortLatencies();
 }//setInputPorts
 
 std::vector<std::string> JackSingleton::getOutputPorts()
@@ -216,6 +304,9 @@ void JackSingleton::setOutputPorts(std::vector<std::string> ports)
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
 
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
     std::vector<std::string> outputPortsVec;
 
     for (std::map<std::string, jack_port_t *>::const_iterator iter = outputPorts.begin(); iter != outputPorts.end(); ++iter) {
@@ -230,14 +321,39 @@ void JackSingleton::setOutputPorts(std::vector<std::string> ports)
 
     for (std::string portName : removedPorts) {
         jack_port_t *port = outputPorts[portName];
-        jack_port_unregister(jackClient, port);
+        unsigned int owner = outputPortOwners[portName];
+        backend->unregisterPort(getOutputPortClient(owner), port);
+        if (owner > 0) {
+            shards[owner - 1]->removeOutputPort(portName);
+        }//if
+
         outputPorts.erase(outputPorts.find(portName));
+        outputPortOwners.erase(portName);
+        mainOutputPorts.erase(port);
+        shardOutputPorts.erase(port);
+        outputSchedulers.erase(port);
+        outputEncoders.erase(port);
+        outputLatencies.erase(port);
+        midiOutputBuffersRaw.erase(port);
     }//foreach
 
     for (std::string portName : newPorts) {
-        jack_port_t *newOutputPort = jack_port_register(jackClient, portName.c_str(), JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+        jack_port_t *newOutputPort = backend->registerPort(jackClient, portName, JackPortIsOutput);
         outputPorts[portName] = newOutputPort;
+        outputPortOwners[portName] = 0;
+        mainOutputPorts.insert(newOutputPort);
+        midiOutputBuffersRaw[newOutputPort] = nullptr;
+        outputSchedulers[newOutputPort] = OutputScheduler();
+        outputEncoders[newOutputPort] = MidiEncoder(false);
     }//foreach
+
+    if (shards.empty() == false) {
+        balanceOutputPorts(shards.size() + 1);
+    }//if
+
+    routeLookAhead();
+    prepareOutputLanes();
+    updatePortLatencies();
 }//setOutputPorts
 
 jack_port_t *JackSingleton::getOutputPort(const std::string &portName)
@@ -272,57 +388,82 @@ void JackSingleton::setRecordMidi(bool record)
 
         midiRecordBufferHeaders.clear();
         midiRecordBufferHeaders.reserve(10000);
+    } else {
+        //The other clients check the armed lanes too
+        std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+        lockShards(shardLocks);
+
+        midiThru.stop();
     }//if
 
     recordMidi = record;
 }//setRecordMidi
 
-std::vector<unsigned char> &JackSingleton::getRecordBuffer()
+void JackSingleton::startMidiThru(InsertMode insertMode)
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
 
-    return midiRecordBuffer;
-}//getRecordBuffer
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
 
-std::vector<MidiInputInfoHeader> &JackSingleton::getMidiRecordBufferHeaders()
+    std::vector<ThruRoute> routes = MidiThru::buildRoutes();
+
+    //Make the lanes now so the RT threads only ever look them up
+    for (const ThruRoute &route : routes) {
+        OutputScheduler *scheduler = findOutputScheduler(route.output.port);
+        if (scheduler != nullptr) {
+            scheduler->prepareLane(route.output);
+        }//if
+    }//foreach
+
+    for (auto shard : shards) {
+        shard->thruForwardedMessages = 0;
+        shard->thruMaxLatencyFrames = 0;
+    }//foreach
+
+    midiThru.start(routes, insertMode);
+}//startMidiThru
+
+ThruStats JackSingleton::getMidiThruStats()
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
 
-    return midiRecordBufferHeaders;
-}//getMidiRecordBufferHeaders
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    //The other clients count what they forwarded for us
+    ThruStats stats = midiThru.getStats();
+    for (auto shard : shards) {
+        stats.forwardedMessages += shard->thruForwardedMessages;
+        stats.maxLatencyFrames = std::max(stats.maxLatencyFrames, shard->thruMaxLatencyFrames);
+    }//foreach
+
+    return stats;
+}//getMidiThruStats
 
-bool JackSingleton::hasValueChanged(jack_port_t *port, unsigned int channel, unsigned int msb, unsigned int lsb, 
-                                    ControlType controllerType, unsigned int sampledValue)
+std::vector<unsigned char> &JackSingleton::getRecordBuffer()
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
 
-    if (ControlType::CC == controllerType) {
-        std::map<unsigned int /*channel*/, std::map<unsigned int /*controller*/, unsigned char /*value*/> > &ccValueCache_ChannelControllerValueMap = ccValueCache[port];
-
-        std::map<unsigned int /*controller*/, unsigned char /*value*/> &ccValueCache_ControllerValueMap = ccValueCache_ChannelControllerValueMap[channel];
+    return midiRecordBuffer;
+}//getRecordBuffer
 
-        if (ccValueCache_ControllerValueMap.find(lsb) == ccValueCache_ControllerValueMap.end()) {
-            ccValueCache_ControllerValueMap[lsb] = sampledValue;
-            return true;
-        } else {
-            if (ccValueCache_ControllerValueMap[lsb] != sampledValue) {
-                ccValueCache_ControllerValueMap[lsb] = sampledValue;
-                return true;
-            } else {
-                return false;
-            }//if
-        }//if
-    }//if
+std::vector<MidiInputInfoHeader> &JackSingleton::getMidiRecordBufferHeaders()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
 
-    return false;
-}//hasValueChanged
+    return midiRecordBufferHeaders;
+}//getMidiRecordBufferHeaders
 
 int JackSingleton::process(jack_nframes_t nframes, void *arg)
 {
+    //Started before the lock so time spent waiting on the UI shows up too
+    TelemetryPeriod telemetryPeriod;
+
     boost::recursive_mutex::scoped_lock lock(mutex);
 
     jack_position_t pos;
-    jack_transport_state_t newTransportState = jack_transport_query(jackClient, &pos);
+    jack_transport_state_t newTransportState = backend->queryTransport(jackClient, pos);
 
 //    void* port_buf = jack_port_get_buffer(input_port, nframes);
 //    void* port_buf_out = jack_port_get_buffer(output_port, nframes);
@@ -332,7 +473,24 @@ int JackSingleton::process(jack_nframes_t nframes, void *arg)
 //    jack_midi_clear_buffer(port_buf_out);
 
     jack_nframes_t frameRate = pos.frame_rate;
-    int newFrame = (int)(((float)pos.frame) / ((float)frameRate) * 1000.0f);
+    jack_nframes_t periodFrame = pos.frame;
+
+    //After a loop wrap the transport may take a period or more to pick up our locate; until it does, keep
+    // playing from where the loop says we are rather than from where the transport says we are
+    if (true == loopLocatePending) {
+        if ((JackTransportRolling == newTransportState) && (pos.frame == loopStaleFrame)) {
+            periodFrame = loopExpectedFrame;
+
+            loopExpectedFrame += nframes;
+            loopStaleFrame += nframes;
+            backend->locateTransport(jackClient, loopExpectedFrame);
+        } else {
+            loopLocatePending = false;
+        }//if
+    }//if
+
+    int newFrame = framesToTicks(periodFrame, frameRate);
+    double sampleTick = framesToSampleTick(periodFrame, frameRate);
 
     //Transport
     {
@@ -350,25 +508,75 @@ int JackSingleton::process(jack_nframes_t nframes, void *arg)
         }//if
     }//Transport
 
+    //Loop
+    jack_nframes_t loopWrapOffset = nframes; //the frame in this period where playback continues from the loop start
+    jack_nframes_t loopStartFrame = 0;
+    bool loopWrapped = false;
+    {
+        if ((true == loopEnabled) && (JackTransportRolling == newTransportState) && (loopStartSnapshot != nullptr)) {
+            loopStartFrame = (jack_nframes_t)ticksToFrames(loopStartTick, frameRate);
+            jack_nframes_t loopEndFrame = (jack_nframes_t)ticksToFrames(loopEndTick, frameRate);
+
+            if ((periodFrame < loopEndFrame) && (periodFrame + nframes >= loopEndFrame) && (loopStartFrame < loopEndFrame)) {
+                loopWrapOffset = loopEndFrame - periodFrame;
+
+                //Put the transport where the next period picks up after the wrap
+                loopExpectedFrame = loopStartFrame + (nframes - loopWrapOffset);
+                loopStaleFrame = pos.frame + nframes;
+                loopLocatePending = true;
+                backend->locateTransport(jackClient, loopExpectedFrame);
+
+                //Wrapping on the period boundary means the loop start is written at the top of the next period
+                if (loopWrapOffset == nframes) {
+                    loopChaseDue = true;
+                }//if
+
+                loopWrapped = true;
+            }//if
+        }//if
+    }//Loop
+
+    telemetryPeriod.mark(TelemetryStage::Transport);
+
     //Record
     {
+        midiThru.beginPeriod(backend->getCycleStartFrame(jackClient));
+
         if ((true == recordMidi) && (true == processingMidi)) {
+            bool thruActive = midiThru.isActive();
+
             jack_midi_event_t in_event;
             for (std::map<std::string, jack_port_t *>::const_iterator portIter = inputPorts.begin(); portIter != inputPorts.end(); ++portIter) {
-                void *port_buf = jack_port_get_buffer(portIter->second, nframes);
-                jack_nframes_t event_count = jack_midi_get_event_count(port_buf);
+                void *port_buf = backend->getPortBuffer(portIter->second, nframes);
+                jack_nframes_t event_count = backend->getMidiEventCount(port_buf);
 
                 if (0 < event_count) {
                     for(unsigned int i=0; i<event_count; i++) {
-                        jack_midi_event_get(&in_event, port_buf, i);
+                        if (backend->getMidiEvent(port_buf, i, in_event) == false) {
+                            continue;
+                        }//if
+
+                        if (true == thruActive) {
+                            midiThru.addInput(portIter->second, in_event.time, (const unsigned char *)in_event.buffer, in_event.size);
+                        }//if
 
                         //Copy all but footer and checksum
                         if (in_event.size > 2) {
-                            int eventFrame = (int)(((float)in_event.time) / ((float)frameRate) * 1000.0f);
+                            FramePosition eventJackFrame = (FramePosition)periodFrame + in_event.time;
+                            if (in_event.time >= loopWrapOffset) {
+                                eventJackFrame = loopStartFrame + (in_event.time - loopWrapOffset);
+                            }//if
+
+                            //The event was played before it got to us
+                            auto latencyIter = inputLatencies.find(portIter->second);
+                            if (latencyIter != inputLatencies.end()) {
+                                eventJackFrame = std::max((FramePosition)0, eventJackFrame - latencyIter->second);
+                            }//if
 
                             MidiInputInfoHeader header;
                             header.port = portIter->second;
-                            header.curFrame = eventFrame + newFrame;
+                            header.curFrame = eventJackFrame;
+                            header.frameRate = frameRate;
                             header.bufferPos = midiRecordBuffer.size();
                             header.length = in_event.size;
 
@@ -381,75 +589,764 @@ int JackSingleton::process(jack_nframes_t nframes, void *arg)
         }//if
     }//Record
 
+    telemetryPeriod.mark(TelemetryStage::Record);
+
     // remember processingMidi for midi out
     {
         if (true == processingMidi) {
-            Globals &globals = Globals::Instance();
-
-            size_t maxPortSize = std::numeric_limits<size_t>::max();
-
             for (std::map<std::string, jack_port_t *>::const_iterator outPortIter = outputPorts.begin(); outPortIter != outputPorts.end(); ++outPortIter) {
-                void* port_buf_out = jack_port_get_buffer(outPortIter->second, nframes);
-                jack_midi_clear_buffer(port_buf_out);
+                if (mainOutputPorts.find(outPortIter->second) == mainOutputPorts.end()) {
+                    continue;
+                }//if
 
-                maxPortSize = std::min(jack_midi_max_event_size(port_buf_out), maxPortSize);
+                void* port_buf_out = backend->getPortBuffer(outPortIter->second, nframes);
+                backend->clearMidiBuffer(port_buf_out);
 
                 midiOutputBuffersRaw[outPortIter->second] = port_buf_out;
-                std::vector<unsigned char> &portVec = midiOutputBuffers[outPortIter->second];
-                portVec.clear();
-                portVec.reserve(maxPortSize);
             }//for
 
-            for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+            writeThruEvents();
+            telemetryPeriod.mark(TelemetryStage::Write);
+
+            //Look-ahead: anything but a straight continuation of the last period resyncs the renderer
+            bool isRolling = (JackTransportRolling == newTransportState);
+            bool useLookAhead = false;
+            if ((true == isRolling) && (true == lookAheadEnabled)) {
+                if ((false == lookAheadRolling) || (periodFrame != lookAheadNextFrame)) {
+                    lookAheadRenderer.resync(periodFrame + nframes, nframes, frameRate);
+                } else {
+                    useLookAhead = true;
+                }//if
+
+                lookAheadNextFrame = periodFrame + nframes;
+            }//if
+
+            if (isRolling != lookAheadRolling) {
+                lookAheadRenderer.setRolling(isRolling);
+                lookAheadRolling = isRolling;
+            }//if
+
+            bool chaseReady = false;
+            if (pendingChaseSnapshot != nullptr) {
+                pendingChaseWaitPeriods++;
+
+                if ((pos.frame == pendingChaseFrame) || (pendingChaseWaitPeriods > maxChaseWaitPeriods)) {
+                    chaseReady = true;
+                }//if
+            }//if
+
+            if (true == chaseReady) {
+                offerChaseSnapshot(pendingChaseSnapshot);
+
+                //Released from setTime() so we never free memory on the RT thread
+                retiredChaseSnapshot.swap(pendingChaseSnapshot);
+                loopChaseDue = false;
+            } else if ((true == loopChaseDue) && (loopWrapOffset == nframes)) {
+                if (loopStartSnapshot != nullptr) {
+                    offerChaseSnapshot(loopStartSnapshot);
+                }//if
+
+                loopChaseDue = false;
+            } else {
+                bool rendered = false;
+                if (true == useLookAhead) {
+                    rendered = lookAheadRenderer.consumePeriod(0, periodFrame, nframes, 
+                                                                [&](const ChaseValue &chaseValue) { offerSampledValue(chaseValue); });
+                }//if
+
+                //Nothing rendered for this period (just started, jumped, or the renderer fell behind), so sample here
+                if (false == rendered) {
 ////////// CHECK TO SEE IF WE SHOULD SAMPLE THIS ENTRY                
-                unsigned char sampledValue = entry->sampleChar(curFrame);
-
-                unsigned char channel = entry->getImpl()->channel;
-                unsigned char msb = entry->getImpl()->msb;
-                unsigned char lsb = entry->getImpl()->lsb;
-
-                ControlType controllerType = entry->getImpl()->controllerType;
-
-                std::set<jack_port_t *> ports = entry->getOutputPorts();
-                for (jack_port_t *port : ports) {
-                    if (hasValueChanged(port, channel, msb, lsb, controllerType, sampledValue) == false) {                        
-                        continue;
-                    }//if
-
-                    std::vector<unsigned char> &portVec = midiOutputBuffers[port];
-                    if (portVec.size() >= maxPortSize - 3) {
-                        std::cout << "jack out 2" << std::endl;
-                        continue;
-                    }//if
-
-                    if (ControlType::CC == controllerType) {
-                        portVec.push_back(0xb0 | (channel & 0x0f));
-                        portVec.push_back(msb);
-                        portVec.push_back(sampledValue);
-                    }//if
-
-                    if (ControlType::RPN == controllerType) {
-                        //Not impl yet...
-                    }//if
-                }//foreach
-            }//foreach
+                    chaseEngine.sampleInto(sampleTick, directSampledValues, (true == shards.empty()) ? nullptr : &mainOutputPorts);
 
-            for (std::map<std::string, jack_port_t *>::const_iterator outPortIter = outputPorts.begin(); outPortIter != outputPorts.end(); ++outPortIter) {
-                std::vector<unsigned char> &portVec = midiOutputBuffers[outPortIter->second];
-                if (portVec.empty() == true) {
-                    continue;
+                    for (const ChaseValue &chaseValue : directSampledValues) {
+                        offerSampledValue(chaseValue);
+                    }//foreach
                 }//if
 
-                //int result = 
-                (void)jack_midi_event_write(midiOutputBuffersRaw[outPortIter->second], 0, &portVec[0], portVec.size());                
-            }//for
+            }//if
+
+            telemetryPeriod.mark(TelemetryStage::Sampling);
+
+            //The rest of the period plays from the loop start
+            if (loopWrapOffset < nframes) {
+                drainOutputSchedulers(midiOutputBuffersRaw, outputSchedulers, outputEncoders, 0, loopWrapOffset, frameRate, telemetryPeriod);
+
+                telemetryPeriod.mark(TelemetryStage::Write);
+                offerChaseSnapshot(loopStartSnapshot);
+                telemetryPeriod.mark(TelemetryStage::Sampling);
+
+                drainOutputSchedulers(midiOutputBuffersRaw, outputSchedulers, outputEncoders, loopWrapOffset, nframes, frameRate, telemetryPeriod);
+            } else {
+                drainOutputSchedulers(midiOutputBuffersRaw, outputSchedulers, outputEncoders, 0, nframes, frameRate, telemetryPeriod);
+            }//if
+
+            telemetryPeriod.mark(TelemetryStage::Write);
+
+            //Let the renderer get going on the far side of the loop now
+            if (true == loopWrapped) {
+                lookAheadRenderer.resync(loopExpectedFrame, nframes, frameRate);
+                lookAheadNextFrame = loopExpectedFrame;
+            }//if
 
         }//if (true == processingMidi) {
     }//Midi out
 
+    clientTelemetry[0]->publish(telemetryPeriod, nframes, frameRate);
+
     return 0;
 }//process
 
+void JackSingleton::offerSampledValue(const ChaseValue &chaseValue)
+{
+    if ((isMainOutputPort(chaseValue.port) == false) || (true == midiThru.suppressesPlayback(chaseValue))) {
+        return;
+    }//if
+
+    auto schedulerIter = outputSchedulers.find(chaseValue.port);
+    if (schedulerIter != outputSchedulers.end()) {
+        schedulerIter->second.offer(chaseValue, false);
+    }//if
+}//offerSampledValue
+
+void JackSingleton::offerChaseSnapshot(const std::shared_ptr<ChaseSnapshot> &snapshot)
+{
+    //Every value goes out regardless of what was last sent; the schedulers still pace them to each port's budget
+    for (const ChaseValue &chaseValue : snapshot->values) {
+        if ((isMainOutputPort(chaseValue.port) == false) || (true == midiThru.suppressesPlayback(chaseValue))) {
+            continue;
+        }//if
+
+        auto schedulerIter = outputSchedulers.find(chaseValue.port);
+        if (schedulerIter != outputSchedulers.end()) {
+            schedulerIter->second.offer(chaseValue, true);
+        }//if
+    }//foreach
+}//offerChaseSnapshot
+
+void JackSingleton::drainOutputSchedulers(std::map<jack_port_t *, void *> &portBuffers, std::map<jack_port_t *, OutputScheduler> &schedulers,
+                                          std::map<jack_port_t *, MidiEncoder> &encoders, jack_nframes_t startFrame, jack_nframes_t endFrame,
+                                          jack_nframes_t frameRate, TelemetryPeriod &telemetryPeriod)
+{
+    for (auto &portBufferIter : portBuffers) {
+        auto schedulerIter = schedulers.find(portBufferIter.first);
+        auto encoderIter = encoders.find(portBufferIter.first);
+        if ((schedulerIter == schedulers.end()) || (encoderIter == encoders.end())) {
+            continue;
+        }//if
+
+        drainOutputScheduler(schedulerIter->second, encoderIter->second, portBufferIter.second, startFrame, endFrame, frameRate, telemetryPeriod);
+    }//foreach
+}//drainOutputSchedulers
+
+void JackSingleton::drainOutputScheduler(OutputScheduler &scheduler, MidiEncoder &encoder, void *portBuffer, jack_nframes_t startFrame, jack_nframes_t endFrame,
+                                         jack_nframes_t frameRate, TelemetryPeriod &telemetryPeriod)
+{
+    scheduler.drain(startFrame, endFrame, frameRate, [&](jack_nframes_t eventFrame, const ChaseValue &chaseValue, int previousValue) -> bool {
+        unsigned char messages[MidiEncoder::maxEncodedLength];
+        size_t length = 0;
+
+        telemetryPeriod.mark(TelemetryStage::Write);
+        encoder.encode(chaseValue, previousValue, messages, length);
+        telemetryPeriod.mark(TelemetryStage::Encode);
+
+        //JACK wants one complete message per event, so no running status here
+        for (size_t offset = 0; offset < length; offset += 3) {
+            if (backend->writeMidiEvent(portBuffer, eventFrame, &messages[offset], 3) == false) {
+                //We can't tell what the receiver ended up with, so select the parameter again next time
+                encoder.reset();
+                telemetryPeriod.droppedEvents++;
+                return false;
+            }//if
+
+            telemetryPeriod.emittedEvents++;
+        }//for
+
+        return true;
+    });
+}//drainOutputScheduler
+
+bool JackSingleton::isMainOutputPort(jack_port_t *port)
+{
+    return (true == shards.empty()) || (mainOutputPorts.find(port) != mainOutputPorts.end());
+}//isMainOutputPort
+
+int JackSingleton::processShard(JackShard &shard, jack_nframes_t nframes)
+{
+    TelemetryPeriod telemetryPeriod;
+
+    boost::recursive_mutex::scoped_lock lock(shard.mutex);
+
+    for (auto &rawBufferIter : shard.midiOutputBuffersRaw) {
+        rawBufferIter.second = backend->getPortBuffer(rawBufferIter.first, nframes);
+        backend->clearMidiBuffer(rawBufferIter.second);
+    }//foreach
+
+    if (false == processingMidi) {
+        return 0;
+    }//if
+
+    jack_position_t pos;
+    jack_transport_state_t transportState = backend->queryTransport(shard.getClient(), pos);
+    FramePosition periodFrame = pos.frame;
+    jack_nframes_t frameRate = pos.frame_rate;
+    bool isRolling = (JackTransportRolling == transportState);
+
+    //Until the main client's locate after a loop wrap lands, play on from where the loop says we are, as it does
+    if (true == shard.loopLocatePending) {
+        if ((true == isRolling) && (periodFrame == shard.loopStaleFrame)) {
+            periodFrame = shard.loopExpectedFrame;
+
+            shard.loopExpectedFrame += nframes;
+            shard.loopStaleFrame += nframes;
+        } else {
+            shard.loopLocatePending = false;
+        }//if
+    }//if
+
+    //We only see where the main client's other locates (chases) ended up, so anything but a straight
+    // continuation resends everything on our ports
+    bool chase = shard.needsChase;
+    if (true == isRolling) {
+        if ((false == shard.wasRolling) || (periodFrame != shard.nextFrame)) {
+            chase = true;
+        }//if
+
+        shard.nextFrame = periodFrame + nframes;
+    } else if (periodFrame != shard.lastFrame) {
+        chase = true;
+    }//if
+
+    shard.wasRolling = isRolling;
+    shard.lastFrame = periodFrame;
+    shard.needsChase = false;
+
+    //Loop; the wrap lands on the same frame the main client's does
+    jack_nframes_t loopWrapOffset = nframes;
+    if ((true == shard.loopEnabled) && (true == isRolling) && (shard.loopStartSnapshot != nullptr)) {
+        FramePosition loopStartFrame = ticksToFrames(shard.loopStartTick, frameRate);
+        FramePosition loopEndFrame = ticksToFrames(shard.loopEndTick, frameRate);
+
+        if ((periodFrame < loopEndFrame) && (periodFrame + nframes >= loopEndFrame) && (loopStartFrame < loopEndFrame)) {
+            loopWrapOffset = loopEndFrame - periodFrame;
+
+            shard.loopExpectedFrame = loopStartFrame + (nframes - loopWrapOffset);
+            shard.loopStaleFrame = pos.frame + nframes;
+            shard.loopLocatePending = true;
+
+            //Playing on from the loop start isn't a jump
+            shard.nextFrame = shard.loopExpectedFrame;
+
+            if (loopWrapOffset == nframes) {
+                shard.loopChaseDue = true;
+            }//if
+        }//if
+    }//if
+
+    telemetryPeriod.mark(TelemetryStage::Transport);
+
+    //Thru the main client routed to us; a period behind it if we ran before it did
+    for (auto &schedulerIter : shard.outputSchedulers) {
+        schedulerIter.second.setFloorFrame(0);
+    }//foreach
+
+    jack_nframes_t cycleFrame = backend->getCycleStartFrame(shard.getClient());
+    while (ShardThruEvent *shardEvent = shard.thruEvents.peek()) {
+        const ThruEvent &event = shardEvent->event;
+        auto schedulerIter = shard.outputSchedulers.find(event.value.port);
+        auto encoderIter = shard.outputEncoders.find(event.value.port);
+        auto rawBufferIter = shard.midiOutputBuffersRaw.find(event.value.port);
+        jack_nframes_t eventFrame = 0;
+        if ((schedulerIter != shard.outputSchedulers.end()) && (encoderIter != shard.outputEncoders.end()) && (rawBufferIter != shard.midiOutputBuffersRaw.end()) &&
+            (true == writeThruEvent(event, schedulerIter->second, encoderIter->second, rawBufferIter->second, eventFrame))) {
+
+            jack_nframes_t latencyFrames = (cycleFrame + eventFrame) - (event.cycleFrame + event.frame) + shardEvent->portLatencyFrames;
+            shard.thruForwardedMessages++;
+            shard.thruMaxLatencyFrames = std::max(shard.thruMaxLatencyFrames, latencyFrames);
+        }//if
+
+        shard.thruEvents.pop();
+    }//while
+
+    telemetryPeriod.mark(TelemetryStage::Write);
+
+    if (true == chase) {
+        chaseEngine.sampleInto(framesToSampleTick(periodFrame, frameRate), shard.sampledValues, &shard.outputPortSet);
+
+        for (const ChaseValue &chaseValue : shard.sampledValues) {
+            offerShardValue(shard, chaseValue, true);
+        }//foreach
+
+        shard.loopChaseDue = false;
+    } else if ((true == shard.loopChaseDue) && (loopWrapOffset == nframes) && (shard.loopStartSnapshot != nullptr)) {
+        for (const ChaseValue &chaseValue : shard.loopStartSnapshot->values) {
+            offerShardValue(shard, chaseValue, true);
+        }//foreach
+
+        shard.loopChaseDue = false;
+    } else {
+        //The main client keeps the renderer in step with the transport; we only read our own queue
+        bool rendered = false;
+        if ((true == isRolling) && (true == shard.lookAheadEnabled)) {
+            rendered = lookAheadRenderer.consumePeriod(shard.getIndex(), periodFrame, nframes,
+                                                       [&](const ChaseValue &chaseValue) { offerShardValue(shard, chaseValue, false); });
+        }//if
+
+        if (false == rendered) {
+            chaseEngine.sampleInto(framesToSampleTick(periodFrame, frameRate), shard.sampledValues, &shard.outputPortSet);
+
+            for (const ChaseValue &chaseValue : shard.sampledValues) {
+                offerShardValue(shard, chaseValue, false);
+            }//foreach
+        }//if
+    }//if
+
+    telemetryPeriod.mark(TelemetryStage::Sampling);
+
+    //The rest of the period plays from the loop start
+    if (loopWrapOffset < nframes) {
+        drainOutputSchedulers(shard.midiOutputBuffersRaw, shard.outputSchedulers, shard.outputEncoders, 0, loopWrapOffset, frameRate, telemetryPeriod);
+
+        telemetryPeriod.mark(TelemetryStage::Write);
+        for (const ChaseValue &chaseValue : shard.loopStartSnapshot->values) {
+            offerShardValue(shard, chaseValue, true);
+        }//foreach
+        telemetryPeriod.mark(TelemetryStage::Sampling);
+
+        drainOutputSchedulers(shard.midiOutputBuffersRaw, shard.outputSchedulers, shard.outputEncoders, loopWrapOffset, nframes, frameRate, telemetryPeriod);
+    } else {
+        drainOutputSchedulers(shard.midiOutputBuffersRaw, shard.outputSchedulers, shard.outputEncoders, 0, nframes, frameRate, telemetryPeriod);
+    }//if
+
+    telemetryPeriod.mark(TelemetryStage::Write);
+    clientTelemetry[shard.getIndex()]->publish(telemetryPeriod, nframes, frameRate);
+
+    return 0;
+}//processShard
+
+void JackSingleton::offerShardValue(JackShard &shard, const ChaseValue &chaseValue, bool force)
+{
+    if (true == midiThru.suppressesPlayback(chaseValue)) {
+        return;
+    }//if
+
+    //Snapshots cover every port; only ours are in here
+    auto schedulerIter = shard.outputSchedulers.find(chaseValue.port);
+    if (schedulerIter != shard.outputSchedulers.end()) {
+        schedulerIter->second.offer(chaseValue, force);
+    }//if
+}//offerShardValue
+
+void JackSingleton::lockShards(std::vector<boost::unique_lock<boost::recursive_mutex> > &locks)
+{
+    //Always after our own lock; shard callbacks never take it, so this can't deadlock
+    for (auto shard : shards) {
+        locks.emplace_back(shard->mutex);
+    }//foreach
+}//lockShards
+
+void JackSingleton::shareEngineState(JackShard &shard)
+{
+    //Under our lock and the shard's.  The shard's old snapshot is released here, off the RT thread.
+    shard.loopEnabled = loopEnabled;
+    shard.loopStartTick = loopStartTick;
+    shard.loopEndTick = loopEndTick;
+    shard.loopStartSnapshot = loopStartSnapshot;
+    shard.lookAheadEnabled = lookAheadEnabled;
+
+    if (false == loopEnabled) {
+        shard.loopChaseDue = false;
+        shard.loopLocatePending = false;
+    }//if
+}//shareEngineState
+
+//The renderer goes first so the callbacks aren't held up while it finishes a period
+SamplingPause::SamplingPause(JackSingleton &jackSingleton) : renderLock(jackSingleton.lookAheadRenderer.holdRendering()), lock(jackSingleton.mutex)
+{
+    jackSingleton.lockShards(shardLocks);
+}//constructor
+
+jack_client_t *JackSingleton::getOutputPortClient(unsigned int owner)
+{
+    if (0 == owner) {
+        return jackClient;
+    }//if
+
+    return shards[owner - 1]->getClient();
+}//getOutputPortClient
+
+void JackSingleton::moveOutputPort(const std::string &portName, unsigned int newOwner)
+{
+    unsigned int oldOwner = outputPortOwners[portName];
+    if (oldOwner == newOwner) {
+        return;
+    }//if
+
+    jack_port_t *oldPort = outputPorts[portName];
+    jack_client_t *oldClient = getOutputPortClient(oldOwner);
+    jack_client_t *newClient = getOutputPortClient(newOwner);
+
+    //Carry the connections across so the move can't be seen from the outside
+    std::vector<std::string> connections = backend->getPortConnections(oldClient, oldPort);
+
+    jack_port_t *newPort = backend->registerPort(newClient, portName, JackPortIsOutput);
+    if (nullptr == newPort) {
+        std::cerr << "Couldn't move output port " << portName << " to another client" << std::endl;
+        return;
+    }//if
+
+    for (const std::string &connection : connections) {
+        backend->connectPorts(newClient, backend->getPortName(newPort), connection);
+    }//foreach
+
+    backend->unregisterPort(oldClient, oldPort);
+
+    //Lane state is tied to what the old port sent; the new one starts fresh and resends everything
+    unsigned int messagesPerSecond = 0;
+    if (findOutputScheduler(oldPort) != nullptr) {
+        messagesPerSecond = findOutputScheduler(oldPort)->getMessagesPerSecond();
+    }//if
+
+    if (0 == oldOwner) {
+        mainOutputPorts.erase(oldPort);
+        midiOutputBuffersRaw.erase(oldPort);
+        outputSchedulers.erase(oldPort);
+        outputEncoders.erase(oldPort);
+    } else {
+        shards[oldOwner - 1]->removeOutputPort(portName);
+        shardOutputPorts.erase(oldPort);
+    }//if
+
+    if (0 == newOwner) {
+        mainOutputPorts.insert(newPort);
+        midiOutputBuffersRaw[newPort] = nullptr;
+        outputSchedulers[newPort] = OutputScheduler();
+        outputEncoders[newPort] = MidiEncoder(false);
+    } else {
+        shards[newOwner - 1]->addOutputPort(portName, newPort);
+        shardOutputPorts[newPort] = shards[newOwner - 1].get();
+    }//if
+
+    outputPorts[portName] = newPort;
+    outputPortOwners[portName] = newOwner;
+    outputLatencies.erase(oldPort);
+
+    findOutputScheduler(newPort)->setMessagesPerSecond(messagesPerSecond);
+
+    //Entries refer to their ports directly
+    Globals &globals = Globals::Instance();
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        std::set<jack_port_t *> entryPorts = entry->getOutputPorts();
+        if (entryPorts.erase(oldPort) > 0) {
+            entryPorts.insert(newPort);
+            entry->setOutputPorts(entryPorts);
+        }//if
+    }//foreach
+}//moveOutputPort
+
+void JackSingleton::balanceOutputPorts(unsigned int numClients)
+{
+    std::vector<std::string> portNames;
+    for (std::map<std::string, jack_port_t *>::const_iterator iter = outputPorts.begin(); iter != outputPorts.end(); ++iter) {
+        portNames.push_back(iter->first);
+    }//for
+
+    for (size_t index = 0; index < portNames.size(); ++index) {
+        moveOutputPort(portNames[index], index % numClients);
+    }//for
+
+    //Moved ports start with empty schedulers
+    routeLookAhead();
+    prepareOutputLanes();
+}//balanceOutputPorts
+
+void JackSingleton::routeLookAhead()
+{
+    std::map<jack_port_t *, unsigned int> portClients;
+    for (auto ownerIter : outputPortOwners) {
+        portClients[outputPorts[ownerIter.first]] = ownerIter.second;
+    }//foreach
+
+    lookAheadRenderer.setPortClients(portClients, shards.size() + 1);
+}//routeLookAhead
+
+OutputScheduler *JackSingleton::findOutputScheduler(jack_port_t *port)
+{
+    auto schedulerIter = outputSchedulers.find(port);
+    if (schedulerIter != outputSchedulers.end()) {
+        return &schedulerIter->second;
+    }//if
+
+    auto shardIter = shardOutputPorts.find(port);
+    if (shardIter != shardOutputPorts.end()) {
+        auto shardSchedulerIter = shardIter->second->outputSchedulers.find(port);
+        if (shardSchedulerIter != shardIter->second->outputSchedulers.end()) {
+            return &shardSchedulerIter->second;
+        }//if
+    }//if
+
+    return nullptr;
+}//findOutputScheduler
+
+MidiEncoder *JackSingleton::findOutputEncoder(jack_port_t *port)
+{
+    auto encoderIter = outputEncoders.find(port);
+    if (encoderIter != outputEncoders.end()) {
+        return &encoderIter->second;
+    }//if
+
+    auto shardIter = shardOutputPorts.find(port);
+    if (shardIter != shardOutputPorts.end()) {
+        auto shardEncoderIter = shardIter->second->outputEncoders.find(port);
+        if (shardEncoderIter != shardIter->second->outputEncoders.end()) {
+            return &shardEncoderIter->second;
+        }//if
+    }//if
+
+    return nullptr;
+}//findOutputEncoder
+
+void JackSingleton::prepareOutputLanes()
+{
+    //Every lane an entry can offer on, made here so the process callbacks only ever look them up
+    Globals &globals = Globals::Instance();
+    for (auto entry : globals.projectData.getSequencer()->getEntryPair()) {
+        for (jack_port_t *port : entry->getOutputPorts()) {
+            OutputScheduler *scheduler = findOutputScheduler(port);
+            if (scheduler != nullptr) {
+                scheduler->prepareLane(ChaseEngine::makeLane(*entry, port));
+            }//if
+        }//foreach
+    }//foreach
+}//prepareOutputLanes
+
+void JackSingleton::setEngineClients(unsigned int numClients)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    numClients = std::max(1U, std::min(numClients, maxEngineClients));
+    if (numClients == shards.size() + 1) {
+        return;
+    }//if
+
+    while (shards.size() + 1 < numClients) {
+        shards.push_back(std::shared_ptr<JackShard>(new JackShard(*backend, shards.size() + 1)));
+    }//while
+
+    {
+        std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+        lockShards(shardLocks);
+
+        for (auto shard : shards) {
+            shareEngineState(*shard);
+        }//foreach
+
+        balanceOutputPorts(numClients);
+    }
+
+    //Emptied by the balance above; closing a client waits for its callback to finish
+    while (shards.size() + 1 > numClients) {
+        shards.pop_back();
+    }//while
+
+    //Every cached snapshot still refers to the old ports
+    updatePortLatencies();
+}//setEngineClients
+
+unsigned int JackSingleton::getEngineClients()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    return shards.size() + 1;
+}//getEngineClients
+
+std::map<std::string, unsigned int> JackSingleton::getOutputPortClients()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    return outputPortOwners;
+}//getOutputPortClients
+
+void JackSingleton::writeThruEvents()
+{
+    for (auto &schedulerIter : outputSchedulers) {
+        schedulerIter.second.setFloorFrame(0);
+    }//foreach
+
+    //Each event goes out at the same offset it came in at, one period later
+    midiThru.sortEvents();
+    for (size_t index = 0; index < midiThru.getNumEvents(); ++index) {
+        const ThruEvent &event = midiThru.getEvent(index);
+
+        auto rawBufferIter = midiOutputBuffersRaw.find(event.value.port);
+        if (rawBufferIter == midiOutputBuffersRaw.end()) {
+            //Another client writes this port; it picks the event up in its next callback
+            auto shardIter = shardOutputPorts.find(event.value.port);
+            if (shardIter != shardOutputPorts.end()) {
+                ShardThruEvent shardEvent;
+                shardEvent.event = event;
+                shardEvent.portLatencyFrames = getThruPortLatency(event);
+                (void)shardIter->second->thruEvents.push(shardEvent);
+            }//if
+
+            continue;
+        }//if
+
+        auto schedulerIter = outputSchedulers.find(event.value.port);
+        auto encoderIter = outputEncoders.find(event.value.port);
+        if ((schedulerIter == outputSchedulers.end()) || (encoderIter == outputEncoders.end())) {
+            continue;
+        }//if
+
+        //The port latencies already cover the periods JACK buffers on either side, so all we add is any nudge
+        // to keep the port's events in order
+        jack_nframes_t eventFrame = 0;
+        if (true == writeThruEvent(event, schedulerIter->second, encoderIter->second, rawBufferIter->second, eventFrame)) {
+            midiThru.noteLatency((eventFrame - event.frame) + getThruPortLatency(event));
+        }//if
+    }//for
+}//writeThruEvents
+
+jack_nframes_t JackSingleton::getThruPortLatency(const ThruEvent &event)
+{
+    jack_nframes_t latencyFrames = 0;
+
+    auto inputLatencyIter = inputLatencies.find(event.inputPort);
+    if (inputLatencyIter != inputLatencies.end()) {
+        latencyFrames += inputLatencyIter->second;
+    }//if
+
+    auto outputLatencyIter = outputLatencies.find(event.value.port);
+    if (outputLatencyIter != outputLatencies.end()) {
+        latencyFrames += outputLatencyIter->second;
+    }//if
+
+    return latencyFrames;
+}//getThruPortLatency
+
+bool JackSingleton::writeThruEvent(const ThruEvent &event, OutputScheduler &scheduler, MidiEncoder &encoder, void *portBuffer, jack_nframes_t &eventFrame)
+{
+    //JACK needs each port's events in order, and a shard can be handed two periods' worth at once
+    eventFrame = std::max(event.frame, scheduler.getFloorFrame());
+
+    int previousValue = scheduler.noteExternalSend(event.value);
+
+    unsigned char messages[MidiEncoder::maxEncodedLength];
+    size_t length = 0;
+    encoder.encode(event.value, previousValue, messages, length);
+
+    bool written = true;
+    for (size_t offset = 0; offset < length; offset += 3) {
+        if (backend->writeMidiEvent(portBuffer, eventFrame, &messages[offset], 3) == false) {
+            encoder.reset();
+            written = false;
+            break;
+        }//if
+    }//for
+
+    //Keep the scheduler's events after ours
+    scheduler.setFloorFrame(eventFrame);
+
+    return written;
+}//writeThruEvent
+
+void JackSingleton::latencyChanged(jack_latency_callback_mode_t mode)
+{
+    updatePortLatencies();
+}//latencyChanged
+
+void JackSingleton::updatePortLatencies()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    long long sampleRate = backend->getSampleRate(jackClient);
+    if (sampleRate <= 0) {
+        return;
+    }//if
+
+    std::map<jack_port_t *, double> portOffsetTicks;
+
+    for (std::map<std::string, jack_port_t *>::const_iterator iter = outputPorts.begin(); iter != outputPorts.end(); ++iter) {
+        jack_latency_range_t range = backend->getPortLatency(iter->second, JackPlaybackLatency);
+
+        long long trimFrames = 0;
+        auto trimIter = outputLatencyTrims.find(iter->first);
+        if (trimIter != outputLatencyTrims.end()) {
+            trimFrames = (trimIter->second * sampleRate) / 1000;
+        }//if
+
+        //Use the worst case so nothing downstream ever plays late
+        long long compensation = std::max(0LL, (long long)range.max + trimFrames);
+        outputLatencies[iter->second] = (jack_nframes_t)compensation;
+        portOffsetTicks[iter->second] = (compensation * 1000.0) / sampleRate;
+    }//for
+
+    for (std::map<std::string, jack_port_t *>::const_iterator iter = inputPorts.begin(); iter != inputPorts.end(); ++iter) {
+        jack_latency_range_t range = backend->getPortLatency(iter->second, JackCaptureLatency);
+
+        long long trimFrames = 0;
+        auto trimIter = inputLatencyTrims.find(iter->first);
+        if (trimIter != inputLatencyTrims.end()) {
+            trimFrames = (trimIter->second * sampleRate) / 1000;
+        }//if
+
+        inputLatencies[iter->second] = (jack_nframes_t)std::max(0LL, (long long)range.max + trimFrames);
+    }//for
+
+    chaseEngine.setPortOffsets(portOffsetTicks);
+    lookAheadRenderer.invalidate();
+    loopSnapshotStale = true;
+}//updatePortLatencies
+
+void JackSingleton::setOutputLatencyTrim(const std::string &portName, int trimMs)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    outputLatencyTrims[portName] = trimMs;
+    updatePortLatencies();
+}//setOutputLatencyTrim
+
+void JackSingleton::setInputLatencyTrim(const std::string &portName, int trimMs)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    inputLatencyTrims[portName] = trimMs;
+    updatePortLatencies();
+}//setInputLatencyTrim
+
+int JackSingleton::getOutputLatencyTrim(const std::string &portName)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    auto trimIter = outputLatencyTrims.find(portName);
+    return (trimIter != outputLatencyTrims.end()) ? trimIter->second : 0;
+}//getOutputLatencyTrim
+
+int JackSingleton::getInputLatencyTrim(const std::string &portName)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    auto trimIter = inputLatencyTrims.find(portName);
+    return (trimIter != inputLatencyTrims.end()) ? trimIter->second : 0;
+}//getInputLatencyTrim
+
+jack_nframes_t JackSingleton::getOutputLatency(const std::string &portName)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    auto portIter = outputPorts.find(portName);
+    if (portIter == outputPorts.end()) {
+        return 0;
+    }//if
+
+    auto latencyIter = outputLatencies.find(portIter->second);
+    if (latencyIter == outputLatencies.end()) {
+        return 0;
+    }//if
+
+    return latencyIter->second;
+}//getOutputLatency
+
 void JackSingleton::error(const char *desc)
 {
     //Nothing
@@ -457,15 +1354,33 @@ void JackSingleton::error(const char *desc)
 
 void JackSingleton::jack_shutdown(void *arg)
 {
-    //Nothing
+    //Called on a thread of the server's; nothing to do but let the UI know
+    clientTelemetry[0]->setServerShutdown();
 }//jack_shutdown
 
+void JackSingleton::xrun()
+{
+    clientTelemetry[0]->addXrun();
+}//xrun
+
 jack_transport_state_t JackSingleton::getTransportState()
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
     return curTransportState;
 }//getTransportState
 
+jack_nframes_t JackSingleton::getSampleRate()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+    return backend->getSampleRate(jackClient);
+}//getSampleRate
+
+jack_nframes_t JackSingleton::getBufferSize()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+    return backend->getBufferSize(jackClient);
+}//getBufferSize
+
 int JackSingleton::getTransportFrame()
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
@@ -481,30 +1396,219 @@ void JackSingleton::setTransportState(jack_transport_state_t state)
     }//if
 
     if (state == JackTransportRolling) {
-        jack_transport_start(jackClient);
+        backend->startTransport(jackClient);
     }//if
 
     else if (state == JackTransportStopped) {
-        jack_transport_stop(jackClient);
+        backend->stopTransport(jackClient);
     }//if
 }//setTransportState
 
 void JackSingleton::setTime(int frame)
 {
-    boost::recursive_mutex::scoped_lock lock(mutex);
-
-    if (false == processingMidi) {
+    if (false == areProcessingMidi()) {
         return;
     }//if
 
+    //Sample every lane here so the process callback only has to write the snapshot out
+    std::shared_ptr<ChaseSnapshot> chaseSnapshot = chaseEngine.getSnapshot(frame);
+
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
     jack_position_t pos;
-    (void)jack_transport_query(jackClient, &pos);
+    (void)backend->queryTransport(jackClient, pos);
+
+    jack_nframes_t jackFrame = (jack_nframes_t)ticksToFrames(frame, pos.frame_rate);
+    backend->locateTransport(jackClient, jackFrame);
 
-    jack_nframes_t jackFrame = (((float)pos.frame_rate) / 1000.0f * frame);
-    jack_transport_locate(jackClient, jackFrame);
+    retiredChaseSnapshot.reset();
+    pendingChaseSnapshot = chaseSnapshot;
+    pendingChaseFrame = jackFrame;
+    pendingChaseWaitPeriods = 0;
 }//setTime
 
-void JackSingleton::doLoad(boost::archive::xml_iarchive &inputArchive)
+void JackSingleton::prepareChaseCuePoints(int fromTick)
+{
+    chaseEngine.prepareBarCuePoints(fromTick, 16);
+}//prepareChaseCuePoints
+
+void JackSingleton::invalidateChaseCuePoints()
+{
+    chaseEngine.invalidateCuePoints();
+    lookAheadRenderer.invalidate();
+
+    boost::recursive_mutex::scoped_lock lock(mutex);
+    loopSnapshotStale = true;
+
+    //Entries may have been added, or moved to other controllers or ports
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    prepareOutputLanes();
+}//invalidateChaseCuePoints
+
+void JackSingleton::setLoop(bool enabled, int startTick, int endTick)
+{
+    if ((startTick < 0) || (endTick <= startTick)) {
+        enabled = false;
+    }//if
+
+    {
+        boost::recursive_mutex::scoped_lock lock(mutex);
+
+        if ((enabled == loopEnabled) && (startTick == loopStartTick) && (endTick == loopEndTick) && (false == loopSnapshotStale)) {
+            return;
+        }//if
+    }
+
+    //Sample the loop start here so the wrap in the process callback only has to write it out
+    //Latency compensated ports sample past the loop end, so they need to know where it wraps
+    chaseEngine.setLoopRange(enabled, startTick, endTick);
+
+    std::shared_ptr<ChaseSnapshot> snapshot;
+    if (true == enabled) {
+        snapshot = chaseEngine.getSnapshot(startTick);
+    }//if
+
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    //The old snapshot is released when this function returns, off the RT thread
+    loopStartSnapshot.swap(snapshot);
+    loopEnabled = enabled;
+    loopStartTick = startTick;
+    loopEndTick = endTick;
+    loopSnapshotStale = false;
+
+    if (false == enabled) {
+        loopChaseDue = false;
+        loopLocatePending = false;
+    }//if
+
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    for (auto shard : shards) {
+        shareEngineState(*shard);
+    }//foreach
+}//setLoop
+
+void JackSingleton::setLookAheadPeriods(unsigned int periods)
+{
+    lookAheadRenderer.setDepth(periods);
+}//setLookAheadPeriods
+
+unsigned int JackSingleton::getLookAheadPeriods()
+{
+    return lookAheadRenderer.getDepth();
+}//getLookAheadPeriods
+
+bool JackSingleton::getLookAheadEnabled()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    return lookAheadEnabled;
+}//getLookAheadEnabled
+
+void JackSingleton::setLookAheadEnabled(bool enabled, bool renderThread)
+{
+    {
+        boost::recursive_mutex::scoped_lock lock(mutex);
+        lookAheadEnabled = enabled;
+
+        std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+        lockShards(shardLocks);
+
+        for (auto shard : shards) {
+            shareEngineState(*shard);
+        }//foreach
+    }
+
+    //Not under the lock; stopping waits for the render thread
+    if ((true == enabled) && (true == renderThread)) {
+        lookAheadRenderer.start();
+    } else {
+        lookAheadRenderer.stop();
+    }//if
+}//setLookAheadEnabled
+
+void JackSingleton::stepLookAhead()
+{
+    lookAheadRenderer.renderAhead();
+}//stepLookAhead
+
+TelemetryStats JackSingleton::getTelemetry()
+{
+    TelemetryStats stats;
+    for (auto &telemetry : clientTelemetry) {
+        stats.merge(telemetry->read());
+    }//foreach
+
+    return stats;
+}//getTelemetry
+
+void JackSingleton::resetTelemetry()
+{
+    for (auto &telemetry : clientTelemetry) {
+        telemetry->reset();
+    }//foreach
+}//resetTelemetry
+
+LookAheadStats JackSingleton::getLookAheadStats()
+{
+    return lookAheadRenderer.getStats();
+}//getLookAheadStats
+
+void JackSingleton::setOutputPortBudget(const std::string &portName, unsigned int messagesPerSecond)
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    auto portIter = outputPorts.find(portName);
+    if ((portIter != outputPorts.end()) && (findOutputScheduler(portIter->second) != nullptr)) {
+        findOutputScheduler(portIter->second)->setMessagesPerSecond(messagesPerSecond);
+    }//if
+}//setOutputPortBudget
+
+std::map<std::string, OutputSchedulerStats> JackSingleton::getOutputSchedulerStats()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    std::map<std::string, OutputSchedulerStats> stats;
+    for (std::map<std::string, jack_port_t *>::const_iterator iter = outputPorts.begin(); iter != outputPorts.end(); ++iter) {
+        OutputScheduler *scheduler = findOutputScheduler(iter->second);
+        if (scheduler != nullptr) {
+            stats[iter->first] = scheduler->getStats();
+        }//if
+    }//for
+
+    return stats;
+}//getOutputSchedulerStats
+
+std::map<std::string, MidiEncoderStats> JackSingleton::getMidiEncoderStats()
+{
+    boost::recursive_mutex::scoped_lock lock(mutex);
+
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    std::map<std::string, MidiEncoderStats> stats;
+    for (std::map<std::string, jack_port_t *>::const_iterator iter = outputPorts.begin(); iter != outputPorts.end(); ++iter) {
+        MidiEncoder *encoder = findOutputEncoder(iter->second);
+        if (encoder != nullptr) {
+            stats[iter->first] = encoder->getStats();
+        }//if
+    }//for
+
+    return stats;
+}//getMidiEncoderStats
+
+template<class Archive>
+void JackSingleton::doLoad(Archive &inputArchive, unsigned int fileVersion)
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
 
@@ -516,9 +1620,43 @@ void JackSingleton::doLoad(boost::archive::xml_iarchive &inputArchive)
 
     setInputPorts(inputPorts);
     setOutputPorts(outputPorts);
+
+    if (fileVersion >= 2) {
+        std::map<std::string, unsigned int> outputPortBudgets;
+        inputArchive & BOOST_SERIALIZATION_NVP(outputPortBudgets);
+
+        for (auto budgetIter : outputPortBudgets) {
+            setOutputPortBudget(budgetIter.first, budgetIter.second);
+        }//foreach
+    }//if
+
+    if (fileVersion >= 3) {
+        unsigned int tickSubdivisions = 1;
+        inputArchive & BOOST_SERIALIZATION_NVP(tickSubdivisions);
+        setTickSubdivisions(tickSubdivisions);
+    }//if
+
+    if (fileVersion >= 4) {
+        std::map<std::string, int> outputLatencyTrims;
+        std::map<std::string, int> inputLatencyTrims;
+        inputArchive & BOOST_SERIALIZATION_NVP(outputLatencyTrims);
+        inputArchive & BOOST_SERIALIZATION_NVP(inputLatencyTrims);
+
+        this->outputLatencyTrims = outputLatencyTrims;
+        this->inputLatencyTrims = inputLatencyTrims;
+        updatePortLatencies();
+    }//if
+
+    unsigned int engineClients = 1;
+    if (fileVersion >= 5) {
+        inputArchive & BOOST_SERIALIZATION_NVP(engineClients);
+    }//if
+
+    setEngineClients(engineClients);
 }//doLoad
 
-void JackSingleton::doSave(boost::archive::xml_oarchive &outputArchive)
+template<class Archive>
+void JackSingleton::doSave(Archive &outputArchive)
 {
     boost::recursive_mutex::scoped_lock lock(mutex);
 
@@ -527,6 +1665,34 @@ void JackSingleton::doSave(boost::archive::xml_oarchive &outputArchive)
 
     outputArchive & BOOST_SERIALIZATION_NVP(inputPorts);
     outputArchive & BOOST_SERIALIZATION_NVP(outputPorts);
+
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+    lockShards(shardLocks);
+
+    std::map<std::string, unsigned int> outputPortBudgets;
+    for (std::map<std::string, jack_port_t *>::const_iterator iter = this->outputPorts.begin(); iter != this->outputPorts.end(); ++iter) {
+        OutputScheduler *scheduler = findOutputScheduler(iter->second);
+        if (scheduler != nullptr) {
+            outputPortBudgets[iter->first] = scheduler->getMessagesPerSecond();
+        }//if
+    }//for
+
+    outputArchive & BOOST_SERIALIZATION_NVP(outputPortBudgets);
+
+    unsigned int tickSubdivisions = getTickSubdivisions();
+    outputArchive & BOOST_SERIALIZATION_NVP(tickSubdivisions);
+
+    outputArchive & BOOST_SERIALIZATION_NVP(outputLatencyTrims);
+    outputArchive & BOOST_SERIALIZATION_NVP(inputLatencyTrims);
+
+    unsigned int engineClients = getEngineClients();
+    outputArchive & BOOST_SERIALIZATION_NVP(engineClients);
 }//doSave
 
 
+template void JackSingleton::doLoad<boost::archive::xml_iarchive>(boost::archive::xml_iarchive &inputArchive, unsigned int fileVersion);
+template void JackSingleton::doSave<boost::archive::xml_oarchive>(boost::archive::xml_oarchive &outputArchive);
+
+template void JackSingleton::doLoad<BinaryIArchive>(BinaryIArchive &inputArchive, unsigned int fileVersion);
+template void JackSingleton::doSave<BinaryOArchive>(BinaryOArchive &outputArchive);
+
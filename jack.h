@@ -16,25 +16,37 @@ License: Released under the GPL version 3 license. See the included LICENSE.
 #include <boost/thread/mutex.hpp> 
 #include <boost/thread/thread.hpp>
 #include <map>
+#include <set>
 #include <vector>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include "ChaseEngine.h"
+#include "FrameTime.h"
+#include "LookAheadRenderer.h"
+#include "OutputScheduler.h"
+#include "MidiThru.h"
+#include "JackShard.h"
+#include "MidiEncoder.h"
+#include "EngineBackend.h"
+#include "EngineTelemetry.h"
 
 enum class ControlType : char;
 
 struct MidiInputInfoHeader
 {
     jack_port_t *port;
-    int curFrame;
+    FramePosition curFrame; //in frames, not ticks
+    jack_nframes_t frameRate;
     unsigned int bufferPos;
     unsigned int length;
 };//MidiInputInfoHeader
 
 class JackSingleton
 {
+    std::shared_ptr<EngineBackend> backend;
     jack_client_t *jackClient;
     jack_transport_state_t curTransportState;
     int curFrame;
@@ -45,37 +57,131 @@ class JackSingleton
     bool recordMidi;
     std::vector<unsigned char> midiRecordBuffer;
     std::vector<MidiInputInfoHeader> midiRecordBufferHeaders;
+    MidiThru midiThru;
 
     std::map<std::string, jack_port_t *> inputPorts;
     std::map<std::string, jack_port_t *> outputPorts;
 
-    std::map<jack_port_t *, void *> midiOutputBuffersRaw;
-    std::map<jack_port_t *, std::vector<unsigned char> > midiOutputBuffers;
+    std::map<jack_port_t *, void *> midiOutputBuffersRaw; //only ports on the main client, as are these two
+    std::map<jack_port_t *, OutputScheduler> outputSchedulers;
+    std::map<jack_port_t *, MidiEncoder> outputEncoders;
+    std::vector<ChaseValue> directSampledValues;
+
+    std::map<std::string, int /*ms*/> outputLatencyTrims;
+    std::map<std::string, int /*ms*/> inputLatencyTrims;
+    std::map<jack_port_t *, jack_nframes_t> outputLatencies; //playback latency plus trim
+    std::map<jack_port_t *, jack_nframes_t> inputLatencies; //capture latency plus trim
 
-    std::map<jack_port_t *, std::map<unsigned int /*channel*/, std::map<unsigned int /*controller*/, unsigned char /*value*/> > > ccValueCache;
+    std::vector<std::shared_ptr<JackShard> > shards; //extra clients; empty runs everything on the main client
+    std::map<std::string, unsigned int> outputPortOwners; //0 is the main client, n is shards[n-1]
+    std::set<jack_port_t *> mainOutputPorts;
+    std::map<jack_port_t *, JackShard *> shardOutputPorts; //everything else, so thru can be handed over
 
     bool processingMidi;
 
+    ChaseEngine chaseEngine;
+    std::shared_ptr<ChaseSnapshot> pendingChaseSnapshot;
+    std::shared_ptr<ChaseSnapshot> retiredChaseSnapshot;
+    jack_nframes_t pendingChaseFrame;
+    unsigned int pendingChaseWaitPeriods;
+
+    bool loopEnabled;
+    int loopStartTick;
+    int loopEndTick;
+    bool loopSnapshotStale;
+    std::shared_ptr<ChaseSnapshot> loopStartSnapshot; //prefetched so the wrap never samples on the RT thread
+    bool loopChaseDue; //the last period ended exactly on the loop end
+    bool loopLocatePending;
+    jack_nframes_t loopExpectedFrame;
+    jack_nframes_t loopStaleFrame;
+
+    std::vector<std::unique_ptr<EngineTelemetry> > clientTelemetry; //one per possible engine client, 0 is the main one; never resized
+
+    LookAheadRenderer lookAheadRenderer;
+    bool lookAheadEnabled;
+    bool lookAheadRolling;
+    jack_nframes_t lookAheadNextFrame;
+
 //.... N/M input/output ports/buffers, add, delete, rename?
 //       -> process iterates over input ports, etc...
 
     JackSingleton();
 
-    bool hasValueChanged(jack_port_t *port, unsigned int channel, unsigned int msb, unsigned int lsb, 
-                            ControlType controllerType, unsigned int sampledValue);
+    void offerSampledValue(const ChaseValue &chaseValue);
+    void offerChaseSnapshot(const std::shared_ptr<ChaseSnapshot> &snapshot);
+    void drainOutputSchedulers(std::map<jack_port_t *, void *> &portBuffers, std::map<jack_port_t *, OutputScheduler> &schedulers,
+                               std::map<jack_port_t *, MidiEncoder> &encoders, jack_nframes_t startFrame, jack_nframes_t endFrame,
+                               jack_nframes_t frameRate, TelemetryPeriod &telemetryPeriod);
+    void drainOutputScheduler(OutputScheduler &scheduler, MidiEncoder &encoder, void *portBuffer, jack_nframes_t startFrame, jack_nframes_t endFrame,
+                              jack_nframes_t frameRate, TelemetryPeriod &telemetryPeriod);
+    bool isMainOutputPort(jack_port_t *port);
+    void writeThruEvents();
+    bool writeThruEvent(const ThruEvent &event, OutputScheduler &scheduler, MidiEncoder &encoder, void *portBuffer, jack_nframes_t &eventFrame);
+    jack_nframes_t getThruPortLatency(const ThruEvent &event); //capture plus playback, in frames
+    void offerShardValue(JackShard &shard, const ChaseValue &chaseValue, bool force);
+    void updatePortLatencies();
+
+    void lockShards(std::vector<boost::unique_lock<boost::recursive_mutex> > &locks);
+    void shareEngineState(JackShard &shard);
+    jack_client_t *getOutputPortClient(unsigned int owner);
+    void moveOutputPort(const std::string &portName, unsigned int newOwner);
+    void balanceOutputPorts(unsigned int numClients);
+    void routeLookAhead();
+    void prepareOutputLanes();
+
+    //Whichever client owns the port; under our lock and the shards'
+    OutputScheduler *findOutputScheduler(jack_port_t *port);
+    MidiEncoder *findOutputEncoder(jack_port_t *port);
 
 public:
     ~JackSingleton();
     void stopClient();
 
     static JackSingleton &Instance();
+    //Only before the first Instance(); without it the engine talks to a real JACK server
+    static void SetBackend(std::shared_ptr<EngineBackend> backend);
+    EngineBackend &getBackend();
 
     jack_transport_state_t getTransportState();
+    jack_nframes_t getSampleRate();
+    jack_nframes_t getBufferSize();
     int getTransportFrame();
 
     void setTransportState(jack_transport_state_t state);
     void setTime(int frame);
 
+    void prepareChaseCuePoints(int fromTick);
+    void invalidateChaseCuePoints();
+
+    void setLoop(bool enabled, int startTick, int endTick);
+
+    void setLookAheadPeriods(unsigned int periods); //how far ahead of the transport the render thread keeps
+    unsigned int getLookAheadPeriods();
+    bool getLookAheadEnabled();
+    void setLookAheadEnabled(bool enabled, bool renderThread = true); //off samples every period in the callback, which is deterministic
+    void stepLookAhead(); //without the render thread, renders ahead on the calling thread between periods
+    LookAheadStats getLookAheadStats();
+
+    void setOutputPortBudget(const std::string &portName, unsigned int messagesPerSecond); //0 is unlimited
+    std::map<std::string, OutputSchedulerStats> getOutputSchedulerStats();
+    std::map<std::string, MidiEncoderStats> getMidiEncoderStats();
+
+    //Never blocks the process callbacks; summed over every engine client
+    TelemetryStats getTelemetry();
+    void resetTelemetry();
+
+    //Manual adjustment on top of what JACK reports; positive trims send (or stamp) earlier
+    void setOutputLatencyTrim(const std::string &portName, int trimMs);
+    void setInputLatencyTrim(const std::string &portName, int trimMs);
+    int getOutputLatencyTrim(const std::string &portName);
+    int getInputLatencyTrim(const std::string &portName);
+    jack_nframes_t getOutputLatency(const std::string &portName);
+
+    //Spread the output ports over this many JACK clients so JACK2 can run them on separate cores
+    void setEngineClients(unsigned int numClients);
+    unsigned int getEngineClients();
+    std::map<std::string, unsigned int> getOutputPortClients(); //0 is the main client
+
     std::vector<std::string> getInputPorts();
     void setInputPorts(std::vector<std::string> ports);
 
@@ -90,19 +196,39 @@ public:
 
     //Do not use these:
     int process(jack_nframes_t nframes, void *arg);
+    int processShard(JackShard &shard, jack_nframes_t nframes);
     void error(const char *desc);
     void jack_shutdown(void *arg);
+    void xrun();
+    void latencyChanged(jack_latency_callback_mode_t mode);
 
-    void setRecordMidi(bool record);
+    void setRecordMidi(bool record); //stopping also stops the thru
+    void startMidiThru(InsertMode insertMode); //call before setRecordMidi(true)
+    ThruStats getMidiThruStats();
     std::vector<unsigned char> &getRecordBuffer();
     std::vector<MidiInputInfoHeader> &getMidiRecordBufferHeaders();
 
     bool areProcessingMidi();
     void setProcessingMidi(bool processing);
 
-    void doLoad(boost::archive::xml_iarchive &inputArchive);
-    void doSave(boost::archive::xml_oarchive &outputArchive);
+    template<class Archive> void doLoad(Archive &inputArchive, unsigned int fileVersion);
+    template<class Archive> void doSave(Archive &outputArchive);
+
+    friend class SamplingPause;
 };//JackSingleton
 
+//While one's alive nothing on the engine's threads is sampling the project: the process callbacks wait on it and
+// the look-ahead renderer finishes the period it's on first.  For swapping out curve storage a sample could be
+// walking; keep it to the swap, since the callbacks are held up for as long as it lives.
+class SamplingPause
+{
+    std::unique_lock<std::mutex> renderLock;
+    boost::recursive_mutex::scoped_lock lock;
+    std::vector<boost::unique_lock<boost::recursive_mutex> > shardLocks;
+
+public:
+    explicit SamplingPause(JackSingleton &jackSingleton);
+};//SamplingPause
+
 #endif
 
@@ -686,8 +686,15 @@ bool JackPortPort::show_menu(GdkEventButton *ev)
                             "<ui>"
                             "  <popup name='PopupMenu'>"
                             "    <menuitem action='AddPort'/>"
-                            "    <menuitem action='RenamePort'/>"
-                            "    <separator/>"
+                            "    <menuitem action='RenamePort'/>";
+
+    if (false == isInput) {
+        ui_info +=          "    <menuitem action='SetBudget'/>";
+    }//if
+
+    ui_info +=              "    <menuitem action='SetLatencyTrim'/>";
+
+    ui_info +=              "    <separator/>"
                             "    <menuitem action='RemovePort'/>"
                             "  </popup>"
                             "</ui>";
@@ -696,6 +703,8 @@ bool JackPortPort::show_menu(GdkEventButton *ev)
     m_refActionGroup->add(Gtk::Action::create("ContextMenu", "Context Menu"));
     m_refActionGroup->add(Gtk::Action::create("AddPort", "Add Port"), sigc::mem_fun(*std::dynamic_pointer_cast<JackPortModule>(module()), &JackPortModule::menu_addPort));
     m_refActionGroup->add(Gtk::Action::create("RenamePort", "Rename Port"), sigc::mem_fun(*this, &JackPortPort::menu_renamePort));
+    m_refActionGroup->add(Gtk::Action::create("SetBudget", "Output Budget..."), sigc::mem_fun(*this, &JackPortPort::menu_setBudget));
+    m_refActionGroup->add(Gtk::Action::create("SetLatencyTrim", "Latency Trim..."), sigc::mem_fun(*this, &JackPortPort::menu_setLatencyTrim));
     m_refActionGroup->add(Gtk::Action::create("RemovePort", "Remove Port"), sigc::mem_fun(*this, &JackPortPort::menu_removePort));
 
     m_refUIManager = Gtk::UIManager::create();
@@ -771,6 +780,78 @@ void JackPortPort::menu_removePort()
     //module()->removePort(title);
 }//removePort
 
+void JackPortPort::menu_setBudget()
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+    std::map<std::string, OutputSchedulerStats> schedulerStats = jackSingleton.getOutputSchedulerStats();
+    if (schedulerStats.find(title) == schedulerStats.end()) {
+        return; //not made yet
+    }//if
+
+    Gtk::Dialog dialog("Output Budget", true);
+
+    Gtk::Label label("Controller messages per second on " + title + " (0 is unlimited; about 1000 for a 5-pin DIN link):");
+    Gtk::SpinButton spinButton;
+    spinButton.set_range(0, 100000);
+    spinButton.set_increments(100, 1000);
+    spinButton.set_digits(0);
+    spinButton.set_value(schedulerStats[title].messagesPerSecond);
+    spinButton.set_activates_default(true);
+
+    dialog.get_content_area()->pack_start(label, Gtk::PACK_SHRINK);
+    dialog.get_content_area()->pack_start(spinButton, Gtk::PACK_SHRINK);
+    dialog.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    dialog.add_button(Gtk::Stock::OK, Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+    dialog.show_all_children();
+
+    if (dialog.run() == Gtk::RESPONSE_OK) {
+        spinButton.update();
+        jackSingleton.setOutputPortBudget(title, spinButton.get_value_as_int());
+    }//if
+}//menu_setBudget
+
+void JackPortPort::menu_setLatencyTrim()
+{
+    JackSingleton &jackSingleton = JackSingleton::Instance();
+
+    Glib::ustring description;
+    int trimMs = 0;
+    if (true == isInput) {
+        description = "Milliseconds to add to what JACK reports for " + title + " (positive stamps recorded events earlier):";
+        trimMs = jackSingleton.getInputLatencyTrim(title);
+    } else {
+        description = "Milliseconds to add to what JACK reports for " + title + " (positive sends earlier, for gear that's slow to respond):";
+        trimMs = jackSingleton.getOutputLatencyTrim(title);
+    }//if
+
+    Gtk::Dialog dialog("Latency Trim", true);
+
+    Gtk::Label label(description);
+    Gtk::SpinButton spinButton;
+    spinButton.set_range(-1000, 1000);
+    spinButton.set_increments(1, 10);
+    spinButton.set_digits(0);
+    spinButton.set_value(trimMs);
+    spinButton.set_activates_default(true);
+
+    dialog.get_content_area()->pack_start(label, Gtk::PACK_SHRINK);
+    dialog.get_content_area()->pack_start(spinButton, Gtk::PACK_SHRINK);
+    dialog.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    dialog.add_button(Gtk::Stock::OK, Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+    dialog.show_all_children();
+
+    if (dialog.run() == Gtk::RESPONSE_OK) {
+        spinButton.update();
+        if (true == isInput) {
+            jackSingleton.setInputLatencyTrim(title, spinButton.get_value_as_int());
+        } else {
+            jackSingleton.setOutputLatencyTrim(title, spinButton.get_value_as_int());
+        }//if
+    }//if
+}//menu_setLatencyTrim
+
 std::string JackPortPort::getTitle() const
 {
     return title;
@@ -189,6 +189,8 @@ private:
     virtual bool show_menu(GdkEventButton *ev);
     void menu_renamePort();
     void menu_removePort();
+    void menu_setBudget(); //output ports only
+    void menu_setLatencyTrim();
 
     Glib::RefPtr<Gtk::UIManager> m_refUIManager;
     Glib::RefPtr<Gtk::ActionGroup> m_refActionGroup;
@@ -58,6 +58,9 @@ std::cout << "here5" << std::endl;
 
     kit.run(*mainWindow->MainWindow());
 
+    //Closed cleanly, so there's nothing to recover next time
+    mainWindow->closeProjectJournal();
+
 //    std::cout << "EXITING MAIN" << std::endl;
     // reenable if we ever do multiple sequencer windows
 //    kit.run();